@@ -0,0 +1,238 @@
+/// @copyright © 2017 Airtime Media.  All rights reserved.
+
+// Scale benchmark against the local stand-in (see stand-in.js).
+// For each sink type: subscribers per core, time to first frame, stop latency and memory per subscriber.
+// Subscribers replay, so first frame and stop times are those of the replay thread (replayFirstFrame_ms,
+// replayStop_ms): no allocation, connection or core stop is included.
+// Then start/stop churn, to catch leaks.
+// Usage: node bench/bench-scale.js [--subscribers N] [--seconds S] [--cycles C] [--sinks none,file,...]
+//                                  [--out results.json] [--baseline baseline.json] [--tolerance 0.1]
+//                                  [--ffmpegParams '...' (or BENCH_FFMPEG_PARAMS)]
+// Exits with 1 if a metric is worse than the baseline by more than the tolerance.
+
+var fs = require('fs');
+
+var EastWood = require('../libs/index').EastWood;
+var standIn = require('./stand-in');
+
+function parseArgs(argv) {
+  var args = { subscribers: 8, seconds: 5, cycles: 20, churnSubscribers: 4,
+               sinks: standIn.SINK_TYPES.join(','), tolerance: 0.1, ffmpegParams: process.env.BENCH_FFMPEG_PARAMS };
+  for (var i = 2; i + 1 < argv.length; i += 2) {
+    var name = argv[i].replace(/^--/, '');
+    if (!(name in args) && 'out' !== name && 'baseline' !== name) throw new Error('Unknown option ' + argv[i]);
+    args[name] = ('number' === typeof args[name]) ? Number(argv[i + 1]) : argv[i + 1];
+  }
+  return args;
+}
+
+function delay(ms) {
+  return new Promise(function(resolve) { setTimeout(resolve, ms); });
+}
+
+function percentile(values, q) {
+  if (0 === values.length) return -1;
+  var sorted = values.slice().sort(function(a, b) { return a - b; });
+  return sorted[Math.min(sorted.length - 1, Math.floor(q * sorted.length))];
+}
+
+function removeFiles(files) {
+  files.forEach(function(f) {
+    try { fs.unlinkSync(f); } catch (e) { /* not written */ }
+  });
+}
+
+function collectGarbage() {
+  if (global.gc) global.gc();
+}
+
+var nextUser = 0;
+
+function startSubscribers(ew, count, sinkType, args) {
+  var subs = [];
+  var files = [];
+  for (var i = 0; i < count; ++i) {
+    var sub = ew.createSubscriber();
+    files = files.concat(standIn.configure(sub.configuration(), sinkType,
+                                           { userId: 'bench' + (nextUser++), ffmpegParams: args.ffmpegParams }));
+    subs.push(sub);
+  }
+  return Promise.all(subs.map(function(sub) { return sub.start(); }))
+    .then(function() { return { subs: subs, files: files }; });
+}
+
+function stopSubscribers(group) {
+  return Promise.all(group.subs.map(function(sub) { return sub.stop(); }))
+    .then(function() {
+      removeFiles(group.files);
+      return group.subs.map(function(sub) { return sub.stats().stop_ms; });
+    });
+}
+
+/// subscribers playing the stand-in stream in real time, measured for args.seconds after a second of warm-up
+function measureSink(ew, sinkType, args) {
+  collectGarbage();
+  var rssBefore = process.memoryUsage().rss;
+  var group;
+  var cpuStart;
+  var wallStart;
+  var framesStart;
+  var result = { subscribers: args.subscribers };
+  var videoFrames = function() {
+    return group.subs.reduce(function(sum, sub) { return sum + sub.stats().video.frames; }, 0);
+  };
+
+  return startSubscribers(ew, args.subscribers, sinkType, args)
+    .then(function(started) {
+      group = started;
+      return delay(1000);
+    })
+    .then(function() {
+      cpuStart = process.cpuUsage();
+      wallStart = process.hrtime();
+      framesStart = videoFrames();
+      return delay(args.seconds * 1000);
+    })
+    .then(function() {
+      var cpu = process.cpuUsage(cpuStart);
+      var wall = process.hrtime(wallStart);
+      var wallMs = wall[0] * 1e3 + wall[1] / 1e6;
+      var cpuMsPerSec = (cpu.user + cpu.system) / 1e3 / (wallMs / 1e3);
+      var stats = group.subs.map(function(sub) { return sub.stats(); });
+      var ttff = stats.map(function(s) { return s.video.firstFrame_ms; }).filter(function(ms) { return 0 <= ms; });
+
+      result.cpuPerSubscriber_ms = cpuMsPerSec / args.subscribers;
+      result.subscribersPerCore = (0 < cpuMsPerSec) ? 1000 * args.subscribers / cpuMsPerSec : 0;
+      // below the stream rate means the sinks fell behind, and subscribersPerCore is optimistic
+      result.videoFpsPerSubscriber = (videoFrames() - framesStart) / args.subscribers / (wallMs / 1e3);
+      result.replayFirstFrame_ms = { p50: percentile(ttff, 0.5), p90: percentile(ttff, 0.9),
+                                     p99: percentile(ttff, 0.99), missing: stats.length - ttff.length };
+      result.rssPerSubscriber_bytes = (process.memoryUsage().rss - rssBefore) / args.subscribers;
+      result.estimatedPerSubscriber_bytes = stats.reduce(function(sum, s) { return sum + s.memory_bytes; }, 0) /
+                                            args.subscribers;
+      return stopSubscribers(group);
+    })
+    .then(function(stopMs) {
+      result.replayStop_ms = { p50: percentile(stopMs, 0.5), p99: percentile(stopMs, 0.99),
+                               max: percentile(stopMs, 1) };
+      return result;
+    });
+}
+
+/// start/stop cycles. RSS growth after the first cycles settle is reported per cycle.
+function measureChurn(ew, args) {
+  var warmCycles = Math.min(2, args.cycles - 1);
+  var rssWarm = 0;
+  var cycle = 0;
+  var run = function() {
+    if (cycle === warmCycles) {
+      collectGarbage();
+      rssWarm = process.memoryUsage().rss;
+    }
+    if (cycle++ === args.cycles) return Promise.resolve();
+    return startSubscribers(ew, args.churnSubscribers, 'none', args)
+      .then(function(group) { return delay(200).then(function() { return stopSubscribers(group); }); })
+      .then(run);
+  };
+  return run().then(function() {
+    collectGarbage();
+    var measured = args.cycles - warmCycles;
+    return {
+      cycles: args.cycles,
+      subscribersPerCycle: args.churnSubscribers,
+      rssGrowthPerCycle_bytes: (0 < measured) ? (process.memoryUsage().rss - rssWarm) / measured : 0,
+      estimatedAfter_bytes: EastWood.getMemoryUsage().estimated_bytes
+    };
+  });
+}
+
+// metrics compared against the baseline. true if higher is better.
+var COMPARED = {
+  'subscribersPerCore': true,
+  'replayFirstFrame_ms.p50': false,
+  'replayFirstFrame_ms.p99': false,
+  'replayStop_ms.p99': false,
+  'rssPerSubscriber_bytes': false,
+  'estimatedPerSubscriber_bytes': false
+};
+
+function lookup(obj, dotted) {
+  return dotted.split('.').reduce(function(o, key) { return (o && key in o) ? o[key] : undefined; }, obj);
+}
+
+/// @return descriptions of the metrics worse than in @a baseline by more than @a tolerance
+function compare(results, baseline, tolerance) {
+  var regressions = [];
+  var check = function(name, current, base, higherIsBetter) {
+    if ('number' !== typeof current || 'number' !== typeof base || base <= 0) return;
+    var change = (current - base) / base;
+    var line = name + ': ' + base.toFixed(2) + ' -> ' + current.toFixed(2) +
+               ' (' + (0 <= change ? '+' : '') + (change * 100).toFixed(1) + '%)';
+    console.log('  ' + line);
+    if (tolerance < (higherIsBetter ? -change : change)) regressions.push(line);
+  };
+  Object.keys(results.sinks).forEach(function(sinkType) {
+    if (!baseline.sinks || !baseline.sinks[sinkType]) return;
+    Object.keys(COMPARED).forEach(function(metric) {
+      check(sinkType + '.' + metric, lookup(results.sinks[sinkType], metric),
+            lookup(baseline.sinks[sinkType], metric), COMPARED[metric]);
+    });
+  });
+  if (baseline.churn) {
+    // growth is compared as an absolute: a leak free baseline is ~0
+    var growth = results.churn.rssGrowthPerCycle_bytes;
+    var baseGrowth = Math.max(baseline.churn.rssGrowthPerCycle_bytes, 64 * 1024);
+    console.log('  churn.rssGrowthPerCycle_bytes: ' + baseline.churn.rssGrowthPerCycle_bytes + ' -> ' + growth);
+    if ((1 + tolerance) * baseGrowth < growth) regressions.push('churn.rssGrowthPerCycle_bytes: ' + growth);
+  }
+  return regressions;
+}
+
+function main() {
+  var args = parseArgs(process.argv);
+  var ew = new EastWood(EastWood.LogLevel_Fatal, false, false);
+  var results = {
+    node: process.version,
+    cpus: require('os').cpus().length,
+    options: { subscribers: args.subscribers, seconds: args.seconds, stream: standIn.DEFAULT_STREAM },
+    sinks: {}
+  };
+
+  var sinkTypes = args.sinks.split(',');
+  // prepared up front, so that writing the stream is not measured
+  standIn.streamFile();
+  var chain = Promise.resolve();
+  sinkTypes.forEach(function(sinkType) {
+    chain = chain.then(function() { return measureSink(ew, sinkType, args); })
+      .then(function(result) {
+        results.sinks[sinkType] = result;
+        console.log(sinkType + ': ' + result.subscribersPerCore.toFixed(1) + ' subscribers/core, replay first frame p50 ' +
+                    result.replayFirstFrame_ms.p50.toFixed(1) + 'ms p99 ' + result.replayFirstFrame_ms.p99.toFixed(1) +
+                    'ms, replay stop p99 ' + result.replayStop_ms.p99 + 'ms, ' +
+                    (result.rssPerSubscriber_bytes / 1048576).toFixed(1) + 'MB/subscriber');
+      });
+  });
+  chain
+    .then(function() { return measureChurn(ew, args); })
+    .then(function(churn) {
+      results.churn = churn;
+      console.log('churn: ' + churn.cycles + ' cycles, RSS growth ' +
+                  (churn.rssGrowthPerCycle_bytes / 1024).toFixed(0) + 'KB/cycle');
+      if (args.out) fs.writeFileSync(args.out, JSON.stringify(results, null, 2) + '\n');
+      var regressions = [];
+      if (args.baseline) {
+        console.log('Compared to ' + args.baseline + ':');
+        regressions = compare(results, JSON.parse(fs.readFileSync(args.baseline, 'utf8')), args.tolerance);
+        regressions.forEach(function(line) { console.log('REGRESSION ' + line); });
+      }
+      EastWood.stopAll({ deadlineMs: 1000 });
+      process.exitCode = (0 < regressions.length) ? 1 : 0;
+    })
+    .catch(function(e) {
+      console.error(e);
+      EastWood.stopAll({ deadlineMs: 1000 });
+      process.exitCode = 1;
+    });
+}
+
+main();
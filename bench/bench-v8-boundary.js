@@ -0,0 +1,53 @@
+/// @copyright © 2017 Airtime Media.  All rights reserved.
+
+// Microbenchmark of objects built by the addon for JS: calls per second of
+// SubscriberConfig.toObject() and Subscriber.stats().
+// Usage: node bench/bench-v8-boundary.js [durationMs]
+
+var EastWood = require('../libs/index').EastWood;
+
+var durationMs = parseInt(process.argv[2] || '2000', 10);
+
+function measure(name, fn) {
+  // warm up so that the inline caches see the final shapes
+  for (var i = 0; i < 10000; ++i) fn();
+
+  var calls = 0;
+  var start = process.hrtime();
+  var elapsedMs = 0;
+  while (elapsedMs < durationMs) {
+    for (var j = 0; j < 1000; ++j) fn();
+    calls += 1000;
+    var diff = process.hrtime(start);
+    elapsedMs = diff[0] * 1e3 + diff[1] / 1e6;
+  }
+  var perSec = Math.round(calls * 1000 / elapsedMs);
+  console.log(name + ': ' + perSec + ' calls/sec (' + (1e9 / perSec).toFixed(0) + ' ns/call)');
+  return perSec;
+}
+
+const ew = new EastWood(EastWood.LogLevel_Fatal, false, false);
+
+const regular = ew.createSubscriber();
+regular.configuration()
+  .bixbyAllocator('allocator.local', 8192, 'loc')
+  .streamNotifier('notifier.local', 443, 'tag', true, true)
+  .userId('bench').duration('00:10:00')
+  .sink({ sink: EastWood.AudioSink_None }, { sink: EastWood.VideoSink_None });
+
+const ffmpeg = ew.createSubscriber();
+ffmpeg.configuration()
+  .bixby('bixby.local', 8080).streamUrl('stream').userId('bench').duration('infinite')
+  .ffmpegSink('out.mp4', 'ffmpeg_output_format=mp4');
+
+const results = {
+  'toObject(sink)': measure('toObject(sink)', function() { return regular.configuration().toObject(); }),
+  'toObject(ffmpeg)': measure('toObject(ffmpeg)', function() { return ffmpeg.configuration().toObject(); }),
+  'stats': measure('stats', function() { return regular.stats(); })
+};
+
+if (process.env.BENCH_JSON) {
+  console.log(JSON.stringify(results));
+}
+
+EastWood.stopAll({ deadlineMs: 1000 });
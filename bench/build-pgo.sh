@@ -0,0 +1,35 @@
+#!/bin/sh
+# @copyright © 2017 Airtime Media.  All rights reserved.
+#
+# Builds the optimized Linux variant of the addon (-O3, LTO and profile-guided optimization),
+# trained on the synthetic-stream workload of bench-scale.js, and reports its throughput against
+# the plain release build.
+# Usage: bench/build-pgo.sh [bench-scale.js options for the measurements]
+# Leaves the optimized build in build/Release, results in bench-results/ and profiles in pgo-profile/.
+# Both directories are outside build/, which node-gyp rebuild wipes.
+
+set -e
+cd "$(dirname "$0")/.."
+
+NODE_GYP="${NODE_GYP:-node-gyp}"
+PGO_DIR="$(pwd)/pgo-profile"
+RESULTS_DIR="$(pwd)/bench-results"
+TRAIN_OPTIONS="--sinks none,file,ffmpegTranscode --subscribers 4 --seconds 10 --cycles 10"
+
+mkdir -p "$RESULTS_DIR"
+
+echo "== release build"
+$NODE_GYP rebuild --release
+node --expose-gc bench/bench-scale.js "$@" --out "$RESULTS_DIR/release.json"
+
+echo "== instrumented build"
+rm -rf "$PGO_DIR"
+$NODE_GYP rebuild --release -- -Dew_optimize=1 -Dew_pgo=generate -Dew_pgo_dir="$PGO_DIR"
+node --expose-gc bench/bench-scale.js $TRAIN_OPTIONS
+node bench/bench-v8-boundary.js 1000
+
+echo "== optimized build"
+$NODE_GYP rebuild --release -- -Dew_optimize=1 -Dew_pgo=use -Dew_pgo_dir="$PGO_DIR"
+
+# subscribersPerCore of each sink type is the throughput difference
+node --expose-gc bench/bench-scale.js "$@" --out "$RESULTS_DIR/pgo.json" --baseline "$RESULTS_DIR/release.json"
@@ -0,0 +1,361 @@
+/// @copyright © 2017 Airtime Media.  All rights reserved.
+
+// Soak test of the subscriber lifecycle against the local stand-in (see stand-in.js).
+// A share of the subscribers (facadeShare) subscribes through the facade of the core to the black hole of the
+// stand-in, the others replay. Slots run random operations concurrently until the given number of operations
+// is reached:
+//   start    new subscriber, started and kept running for a while
+//   stop     stop() of a running subscriber, with a Promise or a callback
+//   restart  stop() and start() again of the same subscriber, reusing its facade
+//   renew    reconfigure() of a running facade subscriber past the duration of its subscription,
+//            which is then renewed by resubscribing shortly before it ends
+//   idle     new subscriber stopped without start, i.e. without a facade
+//   abort    start() and stop() without waiting for start
+//   twice    stop() twice without waiting for the first
+// After the warmup and at the end, once all slots are stopped, a forced phase starts subscribers through the facade
+// and gives them up right away with stopAll({ deadlineMs: 0 }), so that their stops complete after ForceClose().
+// RSS, file descriptors, threads, the event loop queue (getLoopStats() pendingProbes) and live subscribers are
+// sampled over time. Once warmed up and once done, the garbage is collected, and the two quiet samples are compared.
+// Not covered: media through a facade (the black hole sends none), hence resubscription on a stall.
+// Usage: node --expose-gc bench/soak.js [--slots N] [--operations N] [--warmup N] [--sinks none,file,...]
+//                                       [--facadeShare 0..1] [--forced N]
+//                                       [--maxStopMs MS] [--maxRssGrowthMB MB] [--maxFdGrowth N]
+//                                       [--maxThreadGrowth N] [--maxPendingProbes N] [--seed N] [--out soak.json]
+// Exits with 1 on growth over the limits, a stop slower than maxStopMs (or never completing), or an error.
+// See soak.sh for the sanitizer builds.
+
+var fs = require('fs');
+
+var EastWood = require('../libs/index').EastWood;
+var standIn = require('./stand-in');
+
+function parseArgs(argv) {
+  var args = { slots: 16, operations: 2000, warmup: 200, sinks: 'none,file', facadeShare: 0.25, forced: 8,
+               maxStopMs: 2000, maxRssGrowthMB: 32,
+               maxFdGrowth: 8, maxThreadGrowth: 4, maxPendingProbes: 50, sampleMs: 1000,
+               seed: Date.now() % 0x7fffffff, ffmpegParams: process.env.BENCH_FFMPEG_PARAMS };
+  for (var i = 2; i + 1 < argv.length; i += 2) {
+    var name = argv[i].replace(/^--/, '');
+    if (!(name in args) && 'out' !== name) throw new Error('Unknown option ' + argv[i]);
+    args[name] = ('number' === typeof args[name]) ? Number(argv[i + 1]) : argv[i + 1];
+  }
+  return args;
+}
+
+// short, so that renew resubscribes within the life of a running subscriber
+var FACADE_DURATION = '00:00:05';
+var RENEWED_DURATION = '00:00:20';
+
+function delay(ms) {
+  return new Promise(function(resolve) { setTimeout(resolve, ms); });
+}
+
+/// mulberry32, so that a failing run can be repeated with its seed
+function random(seed) {
+  var state = seed >>> 0;
+  return function() {
+    state = (state + 0x6d2b79f5) >>> 0;
+    var t = state;
+    t = Math.imul(t ^ (t >>> 15), t | 1);
+    t ^= t + Math.imul(t ^ (t >>> 7), t | 61);
+    return ((t ^ (t >>> 14)) >>> 0) / 4294967296;
+  };
+}
+
+function countEntries(dir) {
+  try {
+    return fs.readdirSync(dir).length;
+  } catch (e) {
+    return -1;  // not Linux
+  }
+}
+
+function countThreads() {
+  try {
+    var match = /^Threads:\s+(\d+)/m.exec(fs.readFileSync('/proc/self/status', 'utf8'));
+    return match ? Number(match[1]) : -1;
+  } catch (e) {
+    return -1;
+  }
+}
+
+function sample(startMs) {
+  var states = {};
+  EastWood.listSubscribers().forEach(function(entry) { states[entry.state] = (states[entry.state] || 0) + 1; });
+  return {
+    time_ms: Date.now() - startMs,
+    rss_bytes: process.memoryUsage().rss,
+    fds: countEntries('/proc/self/fd'),
+    threads: countThreads(),
+    pendingProbes: EastWood.getLoopStats().pendingProbes,
+    subscribers: states
+  };
+}
+
+function collectGarbage() {
+  if (!global.gc) return Promise.resolve();
+  // wrappers are collected by the first, their weak callbacks free the subscribers before the next
+  global.gc();
+  return delay(100).then(function() { global.gc(); return delay(100); });
+}
+
+function Soak(ew, args) {
+  this.ew = ew;
+  this.args = args;
+  this.random = random(args.seed);
+  this.sinkTypes = args.sinks.split(',');
+  this.operations = 0;
+  this.counts = {};
+  this.stops = 0;
+  this.maxStopMs = 0;
+  this.failures = [];
+  this.nextUser = 0;
+  this.port = 0;  // of the black hole. none subscribes through the facade until set.
+}
+
+Soak.prototype.pick = function(list) {
+  return list[Math.floor(this.random() * list.length)];
+};
+
+Soak.prototype.fail = function(reason) {
+  if (this.failures.length < 100) this.failures.push(reason);
+  console.error('FAIL ' + reason);
+};
+
+/// @param facade: whether it subscribes through the facade. picked at random by facadeShare if not given.
+/// @return { sub, userId, files, facade }
+Soak.prototype.newSubscriber = function(facade) {
+  var sub = this.ew.createSubscriber();
+  var userId = 'soak' + (this.nextUser++);
+  if (undefined === facade) facade = this.random() < this.args.facadeShare;
+  facade = facade && 0 < this.port;
+  var files = facade ?
+    standIn.configureFacade(sub.configuration(), this.port, { userId: userId, duration: FACADE_DURATION }) :
+    standIn.configure(sub.configuration(), this.pick(this.sinkTypes),
+                      { userId: userId, ffmpegParams: this.args.ffmpegParams });
+  return { sub: sub, userId: userId, files: files, facade: facade };
+};
+
+/// @return Promise resolved once @a entry is stopped. a stop over maxStopMs fails, one never completing too.
+Soak.prototype.stop = function(entry, withCallback) {
+  var self = this;
+  var begin = Date.now();
+  var stopped = withCallback ?
+    new Promise(function(resolve) { entry.sub.stop(resolve); }) :
+    entry.sub.stop();
+  var timer;
+  // waits for a hung stop for a while longer, so that it is told apart from a slow one
+  var hung = new Promise(function(resolve) {
+    timer = setTimeout(function() { resolve('hung'); }, 5 * self.args.maxStopMs);
+  });
+  return Promise.race([stopped, hung]).then(function(result) {
+    clearTimeout(timer);
+    var ms = Date.now() - begin;
+    ++self.stops;
+    self.maxStopMs = Math.max(self.maxStopMs, ms);
+    if ('hung' === result) {
+      self.fail(entry.userId + ': stop did not complete in ' + ms + 'ms, state ' + entry.sub.state());
+    } else if (self.args.maxStopMs < ms) {
+      self.fail(entry.userId + ': stop took ' + ms + 'ms');
+    } else if (false === result) {
+      self.fail(entry.userId + ': stop failed');
+    }
+    entry.files.forEach(function(f) {
+      try { fs.unlinkSync(f); } catch (e) { /* not written */ }
+    });
+  });
+};
+
+/// starts @a entry, a new subscriber if not given
+Soak.prototype.start = function(entry) {
+  var self = this;
+  entry = entry || this.newSubscriber();
+  return entry.sub.start().then(function() {
+    return entry;
+  }, function(e) {
+    self.fail(entry.userId + ': start rejected: ' + e);
+    return self.stop(entry).then(function() { return null; });
+  });
+};
+
+/// runs operations on one slot until the target is reached, and leaves the slot stopped
+Soak.prototype.runSlot = function() {
+  var self = this;
+  var running = null;
+  var step = function() {
+    if (self.target <= self.operations) {
+      return running ? self.stop(running) : Promise.resolve();
+    }
+    ++self.operations;
+    var ops = !running ? ['start', 'start', 'idle', 'abort'] : ['stop', 'stop', 'restart', 'twice'];
+    if (running && running.facade) ops.push('renew');
+    var op = self.pick(ops);
+    self.counts[op] = (self.counts[op] || 0) + 1;
+    var done;
+    switch (op) {
+    case 'start':
+      done = self.start().then(function(entry) { running = entry; });
+      break;
+    case 'stop':
+      done = self.stop(running, 0.5 < self.random()).then(function() { running = null; });
+      break;
+    case 'restart':
+      var restarted = running;
+      done = self.stop(restarted).then(function() {
+        return self.start(restarted);
+      }).then(function(entry) { running = entry; });
+      break;
+    case 'renew':
+      done = self.renew(running);
+      break;
+    case 'idle':
+      done = self.stop(self.newSubscriber());
+      break;
+    case 'abort':
+      var aborted = self.newSubscriber();
+      aborted.sub.start().catch(function() { /* may be rejected by the stop */ });
+      done = self.stop(aborted);
+      break;
+    case 'twice':
+      var twice = running;
+      running = null;
+      twice.sub.stop().catch(function() {});
+      done = self.stop(twice);
+      break;
+    }
+    // runs for a while between operations, up to a second
+    return done.then(function() { return delay(Math.floor(self.random() * 1000)); }).then(step);
+  };
+  return step();
+};
+
+/// @return Promise resolved once @a entry got a duration past that of its subscription, or could not
+Soak.prototype.renew = function(entry) {
+  var self = this;
+  var notRunning = function(e) {
+    // ended by itself meanwhile, e.g. out of retries
+    if (!/not running/.test(String(e))) self.fail(entry.userId + ': reconfigure failed: ' + e);
+  };
+  try {
+    return entry.sub.reconfigure({ duration: RENEWED_DURATION }).catch(notRunning);
+  } catch (e) {
+    notRunning(e);
+    return Promise.resolve();
+  }
+};
+
+/// starts subscribers through the facade and gives up on them with stopAll(), which force closes those whose stop
+/// did not complete at once. Called with all slots stopped, as stopAll() stops every subscriber.
+/// @return Promise resolved once the stops given up on had time to complete
+Soak.prototype.forceClose = function() {
+  var self = this;
+  if (0 === this.port || 0 === this.args.forced) return Promise.resolve();
+  var entries = [];
+  for (var i = 0; i < this.args.forced; ++i) entries.push(this.newSubscriber(true));
+  return Promise.all(entries.map(function(entry) { return entry.sub.start(); }))
+    .then(function() { return delay(Math.floor(self.random() * 1000)); })
+    .then(function() { return EastWood.stopAll({ deadlineMs: 0, joinEventLoop: false }); })
+    .then(function(result) {
+      var forced = result.subscribers.filter(function(s) { return s.forced; }).length;
+      self.counts.forced = (self.counts.forced || 0) + forced;
+      // until then, the late stops keep their subscribers referenced
+      return delay(5 * self.args.maxStopMs);
+    });
+};
+
+Soak.prototype.run = function(target) {
+  var slots = [];
+  this.target = target;
+  for (var i = 0; i < this.args.slots; ++i) slots.push(this.runSlot());
+  return Promise.all(slots);
+};
+
+/// @return failures of growth from @a before to @a after, both quiet
+function checkGrowth(before, after, args) {
+  var failures = [];
+  var rssGrowth = (after.rss_bytes - before.rss_bytes) / 1048576;
+  if (args.maxRssGrowthMB < rssGrowth) failures.push('RSS grew by ' + rssGrowth.toFixed(1) + 'MB');
+  if (0 <= before.fds && args.maxFdGrowth < after.fds - before.fds) {
+    failures.push('file descriptors grew from ' + before.fds + ' to ' + after.fds);
+  }
+  if (0 <= before.threads && args.maxThreadGrowth < after.threads - before.threads) {
+    failures.push('threads grew from ' + before.threads + ' to ' + after.threads);
+  }
+  // every subscriber is stopped and unreachable, so none should be left but those of before
+  var live = function(s) {
+    return Object.keys(s.subscribers).reduce(function(n, state) { return n + s.subscribers[state]; }, 0);
+  };
+  if (live(before) < live(after)) {
+    failures.push('subscribers left after collection: ' + JSON.stringify(after.subscribers));
+  }
+  return failures;
+}
+
+function main() {
+  var args = parseArgs(process.argv);
+  if (!global.gc) console.warn('Run with --expose-gc, or growth is measured with garbage');
+  var ew = new EastWood(EastWood.LogLevel_Fatal, false, false);
+  var soak = new Soak(ew, args);
+  var startMs = Date.now();
+  var samples = [];
+  var maxPendingProbes = 0;
+  var sampler = setInterval(function() {
+    var s = sample(startMs);
+    samples.push(s);
+    maxPendingProbes = Math.max(maxPendingProbes, s.pendingProbes);
+  }, args.sampleMs);
+  var quiet = {};
+
+  console.log('Seed ' + args.seed + ', ' + args.slots + ' slots, ' + args.operations + ' operations');
+  standIn.streamFile();
+  standIn.listenBlackHole(2000)
+    .then(function(server) {
+      server.unref();
+      soak.port = server.address().port;
+      return soak.run(args.warmup);
+    })
+    .then(function() { return soak.forceClose(); })
+    .then(collectGarbage)
+    .then(function() {
+      quiet.warm = sample(startMs);
+      return soak.run(args.warmup + args.operations);
+    })
+    .then(function() { return soak.forceClose(); })
+    .then(collectGarbage)
+    .then(function() {
+      clearInterval(sampler);
+      quiet.done = sample(startMs);
+      checkGrowth(quiet.warm, quiet.done, args).forEach(function(reason) { soak.fail(reason); });
+      if (args.maxPendingProbes < maxPendingProbes) {
+        soak.fail('event loop queue reached ' + maxPendingProbes + ' pending probes');
+      }
+      var results = {
+        options: args,
+        operations: soak.counts,
+        stops: soak.stops,
+        maxStop_ms: soak.maxStopMs,
+        maxPendingProbes: maxPendingProbes,
+        warm: quiet.warm,
+        done: quiet.done,
+        samples: samples,
+        failures: soak.failures
+      };
+      if (args.out) fs.writeFileSync(args.out, JSON.stringify(results, null, 2) + '\n');
+      console.log(soak.operations + ' operations ' + JSON.stringify(soak.counts) + ', ' + soak.stops +
+                  ' stops, slowest ' + soak.maxStopMs + 'ms. RSS ' +
+                  ((quiet.done.rss_bytes - quiet.warm.rss_bytes) / 1048576).toFixed(1) + 'MB, fds ' +
+                  quiet.warm.fds + ' -> ' + quiet.done.fds + ', threads ' + quiet.warm.threads + ' -> ' +
+                  quiet.done.threads + ', pending probes up to ' + maxPendingProbes);
+      console.log(0 < soak.failures.length ? soak.failures.length + ' failures' : 'Passed');
+      EastWood.stopAll({ deadlineMs: 1000 });
+      process.exitCode = (0 < soak.failures.length) ? 1 : 0;
+    })
+    .catch(function(e) {
+      console.error(e);
+      clearInterval(sampler);
+      EastWood.stopAll({ deadlineMs: 1000 });
+      process.exitCode = 1;
+    });
+}
+
+main();
@@ -0,0 +1,41 @@
+#!/bin/sh
+# @copyright © 2017 Airtime Media.  All rights reserved.
+#
+# Runs the soak test (bench/soak.js) on builds of the addon with AddressSanitizer and ThreadSanitizer (Linux).
+# node is not instrumented, so the sanitizer runtime is preloaded. The core libraries are covered only if they
+# were built with the same -fsanitize.
+# Usage: bench/soak.sh [soak.js options]
+# SANITIZERS picks the builds (default "address thread"). Results go to soak-results/, sanitizer reports to
+# soak-results/<sanitizer>.log.*. Leaves the last sanitized build in build/Release: node-gyp rebuild afterwards.
+
+set -e
+cd "$(dirname "$0")/.."
+
+NODE_GYP="${NODE_GYP:-node-gyp}"
+CC="${CC:-gcc}"
+RESULTS_DIR="$(pwd)/soak-results"
+SANITIZERS="${SANITIZERS:-address thread}"
+
+mkdir -p "$RESULTS_DIR"
+status=0
+
+for sanitizer in $SANITIZERS; do
+  echo "== $sanitizer build"
+  $NODE_GYP rebuild --release -- -Dew_sanitize=$sanitizer
+  case $sanitizer in
+    address) runtime=libasan.so ;;
+    thread) runtime=libtsan.so ;;
+    *) echo "Unknown sanitizer $sanitizer"; exit 1 ;;
+  esac
+  runtime="$($CC -print-file-name=$runtime)"
+  # leaks of node itself are not ours. the soak test checks growth instead.
+  if ! LD_PRELOAD="$runtime" \
+       ASAN_OPTIONS="${ASAN_OPTIONS:-detect_leaks=0:halt_on_error=1:log_path=$RESULTS_DIR/address.log}" \
+       TSAN_OPTIONS="${TSAN_OPTIONS:-halt_on_error=1:second_deadlock_stack=1:log_path=$RESULTS_DIR/thread.log}" \
+       node --expose-gc bench/soak.js "$@" --out "$RESULTS_DIR/$sanitizer.json"; then
+    echo "== $sanitizer: FAILED"
+    status=1
+  fi
+done
+
+exit $status
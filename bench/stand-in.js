@@ -0,0 +1,123 @@
+/// @copyright © 2017 Airtime Media.  All rights reserved.
+
+// Local stand-in for the allocator, stream notifier and bixby.
+// Subscribers configured by configure() replay a synthetic stream written by the eastwood_stand_in target
+// (bench/stand_in.cc) instead of subscribing, so that nothing leaves the host.
+// Those configured by configureFacade() do subscribe, to a black hole on the loopback (see listenBlackHole()):
+// they never get media, but go through the facade of the core from allocation to stop.
+
+var childProcess = require('child_process');
+var fs = require('fs');
+var net = require('net');
+var os = require('os');
+var path = require('path');
+
+var EastWood = require('../libs/index').EastWood;
+
+// placeholders. replaying subscribers never connect to them.
+var ALLOCATOR = { host: 'allocator.stand-in', port: 8192, loc: 'local' };
+var NOTIFIER = { host: 'notifier.stand-in', port: 443, tag: 'stand-in' };
+
+var SINK_TYPES = ['none', 'file', 'ffmpegTranscode'];
+
+var DEFAULT_STREAM = { seconds: 20, width: 320, height: 180, fps: 30 };
+
+function standInBinary() {
+  var candidates = ['Release', 'Debug'].map(function(config) {
+    return path.join(__dirname, '..', 'build', config, 'eastwood_stand_in');
+  });
+  for (var i = 0; i < candidates.length; ++i) {
+    if (fs.existsSync(candidates[i])) return candidates[i];
+  }
+  throw new Error('eastwood_stand_in is not built. Run node-gyp build first.');
+}
+
+/**
+ * Returns the capture file of a synthetic stream, written on first use.
+ * @param stream: { seconds, width, height, fps }, DEFAULT_STREAM for missing ones
+ */
+function streamFile(stream) {
+  var s = Object.assign({}, DEFAULT_STREAM, stream);
+  var filename = path.join(os.tmpdir(),
+    'eastwood-stand-in-' + [s.seconds, s.width, s.height, s.fps].join('-') + '.ewcap');
+  if (!fs.existsSync(filename)) {
+    childProcess.execFileSync(standInBinary(), [filename, s.seconds, s.width, s.height, s.fps].map(String),
+                              { stdio: 'inherit' });
+  }
+  return filename;
+}
+
+/**
+ * Configures @a config to play the synthetic stream into a sink of @a sinkType.
+ * @param sinkType: one of SINK_TYPES
+ * @param options: { userId, speed (1 is real-time, 0 as fast as possible), stream (see streamFile),
+ *                   outputDir (for file and FFmpeg sinks), ffmpegParams }
+ * @return output filenames to remove once stopped
+ */
+function configure(config, sinkType, options) {
+  var outputBase = path.join(options.outputDir || os.tmpdir(), 'eastwood-bench-' + options.userId);
+  config
+    .bixbyAllocator(ALLOCATOR.host, ALLOCATOR.port, ALLOCATOR.loc)
+    .streamNotifier(NOTIFIER.host, NOTIFIER.port, NOTIFIER.tag, false, false)
+    .userId(options.userId)
+    .duration('infinite')
+    .replayFile(streamFile(options.stream), ('speed' in options) ? options.speed : 1);
+  switch (sinkType) {
+  case 'none':
+    config.sink({ sink: EastWood.AudioSink_None }, { sink: EastWood.VideoSink_None });
+    return [];
+  case 'file':
+    config.sink({ sink: EastWood.AudioSink_File, filename: outputBase + '.audio' },
+                { sink: EastWood.VideoSink_File, filename: outputBase + '.video' });
+    return [outputBase + '.audio', outputBase + '.video'];
+  case 'ffmpegTranscode':
+    config.ffmpegSink(outputBase + '.mp4', options.ffmpegParams ||
+      'ffmpeg_output_format=mp4 ffmpeg_force_video_codec=h264 ffmpeg_force_audio_codec=aac');
+    return [outputBase + '.mp4'];
+  default:
+    throw new Error('Unknown sink type ' + sinkType);
+  }
+}
+
+/**
+ * Listens on the loopback for the allocator and the notifier of configureFacade(). Each connection is held for up to
+ * @a holdMs (random), then closed, so that subscriptions fail and retry at random points.
+ * @return Promise resolved with the server, its port at server.address().port. close() it once done.
+ */
+function listenBlackHole(holdMs) {
+  var server = net.createServer(function(socket) {
+    socket.on('error', function() { /* reset by the subscriber */ });
+    socket.resume();  // drops what is sent
+    var timer = setTimeout(function() { socket.destroy(); }, Math.floor(Math.random() * holdMs));
+    socket.on('close', function() { clearTimeout(timer); });
+  });
+  return new Promise(function(resolve, reject) {
+    server.on('error', reject);
+    server.listen(0, '127.0.0.1', function() { resolve(server); });
+  });
+}
+
+/**
+ * Configures @a config to subscribe through the black hole at @a port, without sinks.
+ * @param options: { userId, duration (as SubscriberConfig.duration(). default '00:00:30') }
+ * @return output filenames to remove once stopped, i.e. none
+ */
+function configureFacade(config, port, options) {
+  config
+    .bixbyAllocator('127.0.0.1', port, 'local')
+    .streamNotifier('127.0.0.1', port, NOTIFIER.tag, false, false)
+    .userId(options.userId)
+    .duration(options.duration || '00:00:30')
+    .subscriptionErrorRetry(1000, 100, 1.5)
+    .sink({ sink: EastWood.AudioSink_None }, { sink: EastWood.VideoSink_None });
+  return [];
+}
+
+module.exports = {
+  SINK_TYPES: SINK_TYPES,
+  DEFAULT_STREAM: DEFAULT_STREAM,
+  streamFile: streamFile,
+  configure: configure,
+  listenBlackHole: listenBlackHole,
+  configureFacade: configureFacade
+};
@@ -0,0 +1,112 @@
+/// @copyright © 2017 Airtime Media.  All rights reserved.
+
+// Local stand-in for the allocator, stream notifier and bixby: writes a capture file of a synthetic stream,
+// which subscribers configured with replayFile() play instead of subscribing.
+// Audio is a 440Hz tone (48kHz stereo, 16-bit, 20ms frames). Video is I420 with moving bars.
+// Usage: eastwood_stand_in <capture file> [seconds=10] [width=640] [height=360] [fps=30]
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "capture_format.h"
+
+using namespace std;
+using namespace ew;
+
+namespace {
+
+constexpr uint32_t kSampleRate = 48000;
+constexpr uint8_t kChannels = 2;
+constexpr int64_t kAudioFrameUs = 20000;
+constexpr uint8_t kTrackAudio = 0;  // FrameTrack of media_frame.h, which needs mediacore
+constexpr uint8_t kTrackVideo = 1;
+
+bool WriteFrame(FILE* file, const CaptureRecord& record, const vector<uint8_t>& payload) {
+  return 1 == fwrite(&record, sizeof(record), 1, file) && 1 == fwrite(payload.data(), payload.size(), 1, file);
+}
+
+void FillAudio(int64_t first_sample, vector<uint8_t>& payload) {
+  auto samples = reinterpret_cast<int16_t*>(payload.data());
+  auto count = payload.size() / sizeof(int16_t) / kChannels;
+  for (size_t i = 0; i < count; ++i) {
+    auto t = static_cast<double>(first_sample + i) / kSampleRate;
+    auto value = static_cast<int16_t>(8000 * sin(2 * M_PI * 440 * t));
+    for (uint8_t c = 0; c < kChannels; ++c) samples[i * kChannels + c] = value;
+  }
+}
+
+void FillVideo(uint32_t frame, uint16_t width, uint16_t height, vector<uint8_t>& payload) {
+  auto luma = payload.data();
+  for (uint32_t y = 0; y < height; ++y) {
+    for (uint32_t x = 0; x < width; ++x) {
+      luma[y * width + x] = static_cast<uint8_t>(((x + frame * 4) / 32 % 2) ? 200 : 40);
+    }
+  }
+  // chroma planes stay grey, apart from a tint changing every second
+  memset(luma + width * height, 128 + frame % 30, payload.size() - width * height);
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  if (argc < 2) {
+    fprintf(stderr, "Usage: %s <capture file> [seconds=10] [width=640] [height=360] [fps=30]\n", argv[0]);
+    return 2;
+  }
+  auto seconds = (2 < argc) ? atoi(argv[2]) : 10;
+  auto width = static_cast<uint16_t>((3 < argc) ? atoi(argv[3]) : 640);
+  auto height = static_cast<uint16_t>((4 < argc) ? atoi(argv[4]) : 360);
+  auto fps = (5 < argc) ? atoi(argv[5]) : 30;
+  if (seconds <= 0 || 0 == width || 0 == height || width % 2 || height % 2 || fps <= 0) {
+    fprintf(stderr, "Invalid arguments\n");
+    return 2;
+  }
+
+  auto file = fopen(argv[1], "wb");
+  if (!file || 1 != fwrite(kCaptureMagic, sizeof(kCaptureMagic) - 1, 1, file)) {
+    fprintf(stderr, "Cannot create %s\n", argv[1]);
+    return 1;
+  }
+
+  vector<uint8_t> audio(kSampleRate * kAudioFrameUs / 1000000 * kChannels * sizeof(int16_t));
+  vector<uint8_t> video(width * height * 3 / 2);
+  const int64_t end_us = seconds * int64_t(1000000);
+  const int64_t video_frame_us = 1000000 / fps;
+  int64_t audio_us = 0;
+  int64_t video_us = 0;
+  uint32_t video_frames = 0;
+  auto ok = true;
+  // frames in arrival order, as a live stream would deliver them
+  while (ok && (audio_us < end_us || video_us < end_us)) {
+    CaptureRecord record = {};
+    if (audio_us <= video_us) {
+      FillAudio(audio_us * kSampleRate / 1000000, audio);
+      record.arrival_ns = audio_us * 1000;
+      record.timestamp_us = audio_us;
+      record.size = static_cast<uint32_t>(audio.size());
+      record.sample_rate = kSampleRate;
+      record.channels = kChannels;
+      record.track = kTrackAudio;
+      ok = WriteFrame(file, record, audio);
+      audio_us += kAudioFrameUs;
+    } else {
+      FillVideo(video_frames++, width, height, video);
+      record.arrival_ns = video_us * 1000;
+      record.timestamp_us = video_us;
+      record.size = static_cast<uint32_t>(video.size());
+      record.width = width;
+      record.height = height;
+      record.track = kTrackVideo;
+      ok = WriteFrame(file, record, video);
+      video_us += video_frame_us;
+    }
+  }
+  if (0 != fclose(file) || !ok) {
+    fprintf(stderr, "Failed to write %s\n", argv[1]);
+    return 1;
+  }
+  return 0;
+}
@@ -1,119 +1,169 @@
 {
+  "variables": {
+    # Linux optimized variant (-O3 and LTO), optionally with profile-guided optimization:
+    #   node-gyp rebuild -- -Dew_optimize=1 -Dew_pgo=generate|use
+    # see bench/build-pgo.sh
+    "ew_optimize%": 0,
+    "ew_pgo%": "off",
+    "ew_pgo_dir%": "<(module_root_dir)/pgo-profile",
+    # Linux build counting heap allocations per media thread, reported by stats() and getLoopStats():
+    #   node-gyp rebuild -- -Dew_count_allocations=1
+    "ew_count_allocations%": 0,
+    # Linux build with AddressSanitizer or ThreadSanitizer, for the soak test (see bench/soak.sh):
+    #   node-gyp rebuild -- -Dew_sanitize=address|thread
+    "ew_sanitize%": "",
+    'conditions': [
+      [
+        'OS=="mac"', {
+          'at_build_dir': '../../build/osx-x86_64-release',
+          'webrtc_out_dir': '../../build/osx-x86_64-release/third_party/webrtc/osx/Debug/obj.target'
+        }
+      ],
+      [
+        'OS=="linux"', {
+          'at_build_dir': '../../build/linux-x86_64-release',
+          'webrtc_out_dir': '../../build/linux-x86_64-release/third_party/webrtc/linux/Release/obj.target'
+        }
+      ]
+    ]
+  },
   "targets": [
     {
      "target_name": "eastwood_addon",
      "sources": [
        "src/eastwood_addon.cc",
+       "src/addon_data.cc",
+       "src/v8_cache.cc",
        "src/eastwood.cc",
        "src/subscriber.cc",
+       "src/sink_tap.cc",
+       "src/frame_trace.cc",
+       "src/loop_stats.cc",
+       "src/pipeline_trace.cc",
+       "src/memory_watch.cc",
+       "src/capacity.cc",
+       "src/encoder_budget.cc",
+       "src/frame_capture.cc",
+       "src/plugin_sink.cc",
+       "src/composite_mixer.cc",
+       "src/composite.cc",
+       "src/memory_segments.cc",
+       "src/stream_sink.cc",
+       "src/frame_pool.cc",
+       "src/alloc_counter.cc",
+       "src/latency.cc",
+       "src/playout_buffer.cc",
+       "src/timeline.cc",
+       "src/lifecycle.cc",
+       "src/js_queue.cc",
        "node_modules/node-media-utils/src/addon_util/addon_util.cc"
      ],
 
       'libraries': [
-        # relative path from build/ directory
-        '../../build/osx-x86_64-release/mediacore/mediacore/libmediacore.a',
-        '../../build/osx-x86_64-release/carmel/carmel/libcarmel.a',
-        '../../build/osx-x86_64-release/carmel/carmel/libbixbyproto.a',
-        '../../build/osx-x86_64-release/carmel/carmel/libat-wireproto.a',
-        '../../build/osx-x86_64-release/libtecate/tecate/libtecate.a',
-        '../../build/osx-x86_64-release/libtecate/tecate/libstream_notificationproto.a',
-        '../../build/osx-x86_64-release/libtecate/tecate/libtecate_legacy_pubsubproto.a',
-        '../../build/osx-x86_64-release/libtecate/tecate/libstream_managementproto.a',
-        '../../build/osx-x86_64-release/libtecate/tecate/libtecate_commonproto.a',
-        '../../build/osx-x86_64-release/eastwood-core/facade/libew-facade.a',
-        '../../build/osx-x86_64-release/eastwood-core/eastwood/libew-common.a',
-        '../../build/osx-x86_64-release/eastwood-core/eastwood/libew-source.a',
-        '../../build/osx-x86_64-release/eastwood-core/eastwood/libew-sink.a',
-        '../../build/osx-x86_64-release/eastwood-core/eastwood/libew-ffmpeg.a',
-        '../../build/osx-x86_64-release/eastwood-core/eastwood/libew-subscribe.a',
-        '../../build/osx-x86_64-release/eastwood-core/eastwood/libew-stats.a',
-        '../../build/osx-x86_64-release/ffmpeg/build/x86_64/libavformat/libavformat.a',
-        '../../build/osx-x86_64-release/ffmpeg/build/x86_64/libavcodec/libavcodec.a',
-        '../../build/osx-x86_64-release/ffmpeg/build/x86_64/libswscale/libswscale.a',
-        '../../build/osx-x86_64-release/ffmpeg/build/x86_64/libswresample/libswresample.a',
-        '../../build/osx-x86_64-release/ffmpeg/build/x86_64/libavfilter/libavfilter.a',
-        '../../build/osx-x86_64-release/ffmpeg/build/x86_64/libavutil/libavutil.a',
-        '../../build/osx-x86_64-release/x264/build/x86_64/libx264.a',
-        '../../build/osx-x86_64-release/rtmpdump/build/x86_64/lib/librtmp.a',
-        '../../build/osx-x86_64-release/freetype/libfreetype.a',
-        '../../build/osx-x86_64-release/boost/libat_boost_execution_monitor.a',
-        '../../build/osx-x86_64-release/boost/libat_boost_random.a',
-        '../../build/osx-x86_64-release/boost/libat_boost_system.a',
-        '../../build/osx-x86_64-release/boost/libat_boost_atomic.a',
-        '../../build/osx-x86_64-release/boost/libat_boost_log.a',
-        '../../build/osx-x86_64-release/boost/libat_boost_filesystem.a',
-        '../../build/osx-x86_64-release/boost/libat_boost_regex.a',
-        '../../build/osx-x86_64-release/boost/libat_boost_program_options.a',
-        '../../build/osx-x86_64-release/boost/libat_boost_thread.a',
-        '../../build/osx-x86_64-release/third_party/webrtc/osx/Debug/obj.target/webrtc/modules/libcng.a',
-        '../../build/osx-x86_64-release/third_party/webrtc/osx/Debug/obj.target/webrtc/modules/libg711.a',
-        '../../build/osx-x86_64-release/third_party/webrtc/osx/Debug/obj.target/webrtc/modules/libg722.a',
-        '../../build/osx-x86_64-release/third_party/webrtc/osx/Debug/obj.target/webrtc/modules/libpcm16b.a',
-        '../../build/osx-x86_64-release/third_party/webrtc/osx/Debug/obj.target/webrtc/modules/libred.a',
-        '../../build/osx-x86_64-release/third_party/webrtc/osx/Debug/obj.target/webrtc/modules/libaudio_coding_module.a',
-        '../../build/osx-x86_64-release/third_party/webrtc/osx/Debug/obj.target/webrtc/modules/libaudio_conference_mixer.a',
-        '../../build/osx-x86_64-release/third_party/webrtc/osx/Debug/obj.target/webrtc/modules/libaudio_decoder_interface.a',
-        '../../build/osx-x86_64-release/third_party/webrtc/osx/Debug/obj.target/webrtc/modules/libaudio_encoder_interface.a',
-        '../../build/osx-x86_64-release/third_party/webrtc/osx/Debug/obj.target/webrtc/modules/libaudio_device.a',
-        '../../build/osx-x86_64-release/third_party/webrtc/osx/Debug/obj.target/webrtc/modules/libaudio_processing.a',
-        '../../build/osx-x86_64-release/third_party/webrtc/osx/Debug/obj.target/webrtc/modules/libaudio_processing_sse2.a',
-        '../../build/osx-x86_64-release/third_party/webrtc/osx/Debug/obj.target/webrtc/modules/libbitrate_controller.a',
-        '../../build/osx-x86_64-release/third_party/webrtc/osx/Debug/obj.target/webrtc/common_audio/libcommon_audio.a',
-        '../../build/osx-x86_64-release/third_party/webrtc/osx/Debug/obj.target/webrtc/common_audio/libcommon_audio_sse2.a',
-        '../../build/osx-x86_64-release/third_party/webrtc/osx/Debug/obj.target/webrtc/common_video/libcommon_video.a',
-        '../../build/osx-x86_64-release/third_party/webrtc/osx/Debug/obj.target/webrtc/modules/libcongestion_controller.a',
-        '../../build/osx-x86_64-release/third_party/webrtc/osx/Debug/obj.target/webrtc/tools/libframe_editing_lib.a',
-        '../../build/osx-x86_64-release/third_party/webrtc/osx/Debug/obj.target/webrtc/modules/libilbc.a',
-        '../../build/osx-x86_64-release/third_party/webrtc/osx/Debug/obj.target/webrtc/modules/libisac.a',
-        '../../build/osx-x86_64-release/third_party/webrtc/osx/Debug/obj.target/webrtc/modules/libisac_common.a',
-        '../../build/osx-x86_64-release/third_party/webrtc/osx/Debug/obj.target/webrtc/modules/libisac_fix.a',
-        '../../build/osx-x86_64-release/third_party/webrtc/osx/Debug/obj.target/webrtc/base/librtc_base.a',
-        '../../build/osx-x86_64-release/third_party/webrtc/osx/Debug/obj.target/webrtc/base/librtc_base_approved.a',
-        '../../build/osx-x86_64-release/third_party/webrtc/osx/Debug/obj.target/webrtc/librtc_event_log.a',
-        '../../build/osx-x86_64-release/third_party/webrtc/osx/Debug/obj.target/webrtc/media/librtc_media.a',
-        '../../build/osx-x86_64-release/third_party/webrtc/osx/Debug/obj.target/webrtc/p2p/librtc_p2p.a',
-        '../../build/osx-x86_64-release/third_party/webrtc/osx/Debug/obj.target/webrtc/pc/librtc_pc.a',
-        '../../build/osx-x86_64-release/third_party/webrtc/osx/Debug/obj.target/webrtc/modules/librent_a_codec.a',
-        '../../build/osx-x86_64-release/third_party/webrtc/osx/Debug/obj.target/webrtc/api/libjingle_peerconnection.a',
-        '../../build/osx-x86_64-release/third_party/webrtc/osx/Debug/obj.target/webrtc/sound/librtc_sound.a',
-        '../../build/osx-x86_64-release/third_party/webrtc/osx/Debug/obj.target/webrtc/p2p/libstunprober.a',
-        '../../build/osx-x86_64-release/third_party/webrtc/osx/Debug/obj.target/webrtc/modules/libmedia_file.a',
-        '../../build/osx-x86_64-release/third_party/webrtc/osx/Debug/obj.target/webrtc/modules/libneteq.a',
-        '../../build/osx-x86_64-release/third_party/webrtc/osx/Debug/obj.target/third_party/openmax_dl/dl/libopenmax_dl.a',
-        '../../build/osx-x86_64-release/third_party/webrtc/osx/Debug/obj.target/webrtc/modules/libpaced_sender.a',
-        '../../build/osx-x86_64-release/third_party/webrtc/osx/Debug/obj.target/webrtc/modules/libremote_bitrate_estimator.a',
-        '../../build/osx-x86_64-release/third_party/webrtc/osx/Debug/obj.target/webrtc/modules/librtp_rtcp.a',
-        '../../build/osx-x86_64-release/third_party/webrtc/osx/Debug/obj.target/webrtc/system_wrappers/libsystem_wrappers.a',
-        '../../build/osx-x86_64-release/third_party/webrtc/osx/Debug/obj.target/webrtc/system_wrappers/libfield_trial_default.a',
-        '../../build/osx-x86_64-release/third_party/webrtc/osx/Debug/obj.target/webrtc/system_wrappers/libmetrics_default.a',
-        '../../build/osx-x86_64-release/third_party/webrtc/osx/Debug/obj.target/third_party/usrsctp/libusrsctplib.a',
-        '../../build/osx-x86_64-release/third_party/webrtc/osx/Debug/obj.target/webrtc/modules/libvideo_capture_module.a',
-        '../../build/osx-x86_64-release/third_party/webrtc/osx/Debug/obj.target/webrtc/modules/libvideo_capture.a',
-        '../../build/osx-x86_64-release/third_party/webrtc/osx/Debug/obj.target/webrtc/modules/video_coding/utility/libvideo_coding_utility.a',
-        '../../build/osx-x86_64-release/third_party/webrtc/osx/Debug/obj.target/webrtc/modules/libvideo_processing.a',
-        '../../build/osx-x86_64-release/third_party/webrtc/osx/Debug/obj.target/webrtc/modules/libvideo_processing_sse2.a',
-        '../../build/osx-x86_64-release/third_party/webrtc/osx/Debug/obj.target/webrtc/modules/libvideo_render.a',
-        '../../build/osx-x86_64-release/third_party/webrtc/osx/Debug/obj.target/webrtc/modules/libvideo_render_module.a',
-        '../../build/osx-x86_64-release/third_party/webrtc/osx/Debug/obj.target/webrtc/voice_engine/libvoice_engine.a',
-        '../../build/osx-x86_64-release/third_party/webrtc/osx/Debug/obj.target/webrtc/libwebrtc.a',
-        '../../build/osx-x86_64-release/third_party/webrtc/osx/Debug/obj.target/webrtc/libwebrtc_common.a',
-        '../../build/osx-x86_64-release/third_party/webrtc/osx/Debug/obj.target/webrtc/modules/libwebrtc_i420.a',
-        '../../build/osx-x86_64-release/third_party/webrtc/osx/Debug/obj.target/webrtc/modules/libwebrtc_opus.a',
-        '../../build/osx-x86_64-release/third_party/webrtc/osx/Debug/obj.target/webrtc/modules/libwebrtc_utility.a',
-        '../../build/osx-x86_64-release/third_party/webrtc/osx/Debug/obj.target/webrtc/modules/libwebrtc_video_coding.a',
-        '../../build/osx-x86_64-release/third_party/webrtc/osx/Debug/obj.target/webrtc/modules/video_coding/codecs/vp8/libwebrtc_vp8.a',
-        '../../build/osx-x86_64-release/third_party/webrtc/osx/Debug/obj.target/webrtc/modules/video_coding/codecs/vp9/libwebrtc_vp9.a',
-        '../../build/osx-x86_64-release/third_party/webrtc/osx/Debug/obj.target/webrtc/modules/libwebrtc_h264.a',
-        '../../build/osx-x86_64-release/jangle/jangle/libjangle-webrtc.a',
-        '../../build/osx-x86_64-release/third_party/libsrtp/build/x86_64/lib/libsrtp.a',
-        '../../build/osx-x86_64-release/libyuv/libyuv.a',
-        '../../build/osx-x86_64-release/libvpx/x86_64/libvpx.a',
-        '../../build/osx-x86_64-release/opus/build/x86_64/.libs/libopus.a',
-        '../../build/osx-x86_64-release/protobuf/src/cmake/libprotobuf.a',
-        '../../build/osx-x86_64-release/boringssl/src/ssl/libssl.a',
-        '../../build/osx-x86_64-release/boringssl/src/decrepit/libdecrepit.a',
-        '../../build/osx-x86_64-release/boringssl/src/crypto/libcrypto.a',
-        '../../build/osx-x86_64-release/jsoncpp/lib_json/libjsoncpp.a'
+        # relative path from build/ directory, see at_build_dir
+        '<(at_build_dir)/mediacore/mediacore/libmediacore.a',
+        '<(at_build_dir)/carmel/carmel/libcarmel.a',
+        '<(at_build_dir)/carmel/carmel/libbixbyproto.a',
+        '<(at_build_dir)/carmel/carmel/libat-wireproto.a',
+        '<(at_build_dir)/libtecate/tecate/libtecate.a',
+        '<(at_build_dir)/libtecate/tecate/libstream_notificationproto.a',
+        '<(at_build_dir)/libtecate/tecate/libtecate_legacy_pubsubproto.a',
+        '<(at_build_dir)/libtecate/tecate/libstream_managementproto.a',
+        '<(at_build_dir)/libtecate/tecate/libtecate_commonproto.a',
+        '<(at_build_dir)/eastwood-core/facade/libew-facade.a',
+        '<(at_build_dir)/eastwood-core/eastwood/libew-common.a',
+        '<(at_build_dir)/eastwood-core/eastwood/libew-source.a',
+        '<(at_build_dir)/eastwood-core/eastwood/libew-sink.a',
+        '<(at_build_dir)/eastwood-core/eastwood/libew-ffmpeg.a',
+        '<(at_build_dir)/eastwood-core/eastwood/libew-subscribe.a',
+        '<(at_build_dir)/eastwood-core/eastwood/libew-stats.a',
+        '<(at_build_dir)/ffmpeg/build/x86_64/libavformat/libavformat.a',
+        '<(at_build_dir)/ffmpeg/build/x86_64/libavcodec/libavcodec.a',
+        '<(at_build_dir)/ffmpeg/build/x86_64/libswscale/libswscale.a',
+        '<(at_build_dir)/ffmpeg/build/x86_64/libswresample/libswresample.a',
+        '<(at_build_dir)/ffmpeg/build/x86_64/libavfilter/libavfilter.a',
+        '<(at_build_dir)/ffmpeg/build/x86_64/libavutil/libavutil.a',
+        '<(at_build_dir)/x264/build/x86_64/libx264.a',
+        '<(at_build_dir)/rtmpdump/build/x86_64/lib/librtmp.a',
+        '<(at_build_dir)/freetype/libfreetype.a',
+        '<(at_build_dir)/boost/libat_boost_execution_monitor.a',
+        '<(at_build_dir)/boost/libat_boost_random.a',
+        '<(at_build_dir)/boost/libat_boost_system.a',
+        '<(at_build_dir)/boost/libat_boost_atomic.a',
+        '<(at_build_dir)/boost/libat_boost_log.a',
+        '<(at_build_dir)/boost/libat_boost_filesystem.a',
+        '<(at_build_dir)/boost/libat_boost_regex.a',
+        '<(at_build_dir)/boost/libat_boost_program_options.a',
+        '<(at_build_dir)/boost/libat_boost_thread.a',
+        '<(webrtc_out_dir)/webrtc/modules/libcng.a',
+        '<(webrtc_out_dir)/webrtc/modules/libg711.a',
+        '<(webrtc_out_dir)/webrtc/modules/libg722.a',
+        '<(webrtc_out_dir)/webrtc/modules/libpcm16b.a',
+        '<(webrtc_out_dir)/webrtc/modules/libred.a',
+        '<(webrtc_out_dir)/webrtc/modules/libaudio_coding_module.a',
+        '<(webrtc_out_dir)/webrtc/modules/libaudio_conference_mixer.a',
+        '<(webrtc_out_dir)/webrtc/modules/libaudio_decoder_interface.a',
+        '<(webrtc_out_dir)/webrtc/modules/libaudio_encoder_interface.a',
+        '<(webrtc_out_dir)/webrtc/modules/libaudio_device.a',
+        '<(webrtc_out_dir)/webrtc/modules/libaudio_processing.a',
+        '<(webrtc_out_dir)/webrtc/modules/libaudio_processing_sse2.a',
+        '<(webrtc_out_dir)/webrtc/modules/libbitrate_controller.a',
+        '<(webrtc_out_dir)/webrtc/common_audio/libcommon_audio.a',
+        '<(webrtc_out_dir)/webrtc/common_audio/libcommon_audio_sse2.a',
+        '<(webrtc_out_dir)/webrtc/common_video/libcommon_video.a',
+        '<(webrtc_out_dir)/webrtc/modules/libcongestion_controller.a',
+        '<(webrtc_out_dir)/webrtc/tools/libframe_editing_lib.a',
+        '<(webrtc_out_dir)/webrtc/modules/libilbc.a',
+        '<(webrtc_out_dir)/webrtc/modules/libisac.a',
+        '<(webrtc_out_dir)/webrtc/modules/libisac_common.a',
+        '<(webrtc_out_dir)/webrtc/modules/libisac_fix.a',
+        '<(webrtc_out_dir)/webrtc/base/librtc_base.a',
+        '<(webrtc_out_dir)/webrtc/base/librtc_base_approved.a',
+        '<(webrtc_out_dir)/webrtc/librtc_event_log.a',
+        '<(webrtc_out_dir)/webrtc/media/librtc_media.a',
+        '<(webrtc_out_dir)/webrtc/p2p/librtc_p2p.a',
+        '<(webrtc_out_dir)/webrtc/pc/librtc_pc.a',
+        '<(webrtc_out_dir)/webrtc/modules/librent_a_codec.a',
+        '<(webrtc_out_dir)/webrtc/api/libjingle_peerconnection.a',
+        '<(webrtc_out_dir)/webrtc/sound/librtc_sound.a',
+        '<(webrtc_out_dir)/webrtc/p2p/libstunprober.a',
+        '<(webrtc_out_dir)/webrtc/modules/libmedia_file.a',
+        '<(webrtc_out_dir)/webrtc/modules/libneteq.a',
+        '<(webrtc_out_dir)/third_party/openmax_dl/dl/libopenmax_dl.a',
+        '<(webrtc_out_dir)/webrtc/modules/libpaced_sender.a',
+        '<(webrtc_out_dir)/webrtc/modules/libremote_bitrate_estimator.a',
+        '<(webrtc_out_dir)/webrtc/modules/librtp_rtcp.a',
+        '<(webrtc_out_dir)/webrtc/system_wrappers/libsystem_wrappers.a',
+        '<(webrtc_out_dir)/webrtc/system_wrappers/libfield_trial_default.a',
+        '<(webrtc_out_dir)/webrtc/system_wrappers/libmetrics_default.a',
+        '<(webrtc_out_dir)/third_party/usrsctp/libusrsctplib.a',
+        '<(webrtc_out_dir)/webrtc/modules/libvideo_capture_module.a',
+        '<(webrtc_out_dir)/webrtc/modules/libvideo_capture.a',
+        '<(webrtc_out_dir)/webrtc/modules/video_coding/utility/libvideo_coding_utility.a',
+        '<(webrtc_out_dir)/webrtc/modules/libvideo_processing.a',
+        '<(webrtc_out_dir)/webrtc/modules/libvideo_processing_sse2.a',
+        '<(webrtc_out_dir)/webrtc/modules/libvideo_render.a',
+        '<(webrtc_out_dir)/webrtc/modules/libvideo_render_module.a',
+        '<(webrtc_out_dir)/webrtc/voice_engine/libvoice_engine.a',
+        '<(webrtc_out_dir)/webrtc/libwebrtc.a',
+        '<(webrtc_out_dir)/webrtc/libwebrtc_common.a',
+        '<(webrtc_out_dir)/webrtc/modules/libwebrtc_i420.a',
+        '<(webrtc_out_dir)/webrtc/modules/libwebrtc_opus.a',
+        '<(webrtc_out_dir)/webrtc/modules/libwebrtc_utility.a',
+        '<(webrtc_out_dir)/webrtc/modules/libwebrtc_video_coding.a',
+        '<(webrtc_out_dir)/webrtc/modules/video_coding/codecs/vp8/libwebrtc_vp8.a',
+        '<(webrtc_out_dir)/webrtc/modules/video_coding/codecs/vp9/libwebrtc_vp9.a',
+        '<(webrtc_out_dir)/webrtc/modules/libwebrtc_h264.a',
+        '<(at_build_dir)/jangle/jangle/libjangle-webrtc.a',
+        '<(at_build_dir)/third_party/libsrtp/build/x86_64/lib/libsrtp.a',
+        '<(at_build_dir)/libyuv/libyuv.a',
+        '<(at_build_dir)/libvpx/x86_64/libvpx.a',
+        '<(at_build_dir)/opus/build/x86_64/.libs/libopus.a',
+        '<(at_build_dir)/protobuf/src/cmake/libprotobuf.a',
+        '<(at_build_dir)/boringssl/src/ssl/libssl.a',
+        '<(at_build_dir)/boringssl/src/decrepit/libdecrepit.a',
+        '<(at_build_dir)/boringssl/src/crypto/libcrypto.a',
+        '<(at_build_dir)/jsoncpp/lib_json/libjsoncpp.a'
       ],
 
       'configurations': {
@@ -135,6 +185,7 @@
         "../at-deps/carmel/include",
         "../at-deps/eastwood-core",
         "../at-deps/third_party/boost/src",
+        "../at-deps/third_party/libyuv/include",
         "node_modules/node-media-utils/src"
       ],
 
@@ -173,7 +224,9 @@
             'defines': [
               'LINUX',
               'HASH_NAMESPACE=__gnu_cxx',
-              'WEBRTC_LINUX'
+              'WEBRTC_LINUX',
+              'AT_USE_BOOST_MUTEX',
+              'AT_USE_BOOST_THREAD'
             ],
             
             'include_dirs': [
@@ -183,11 +236,88 @@
               '-fPIC',
             ],
 
+            # the core libraries need RTTI and exceptions, which node turns off
+            'cflags_cc!': [ '-fno-rtti', '-fno-exceptions' ],
+            'cflags_cc': [
+              '-std=c++14', '-frtti', '-fexceptions',
+              '-Wno-unused-parameter', '-Wno-unused-function', '-Wno-attributes'
+            ],
+
+            # GNU ld resolves static libraries in one pass, and the core libraries refer to each other
+            'libraries+': [
+              '-Wl,--start-group'
+            ],
             'libraries': [
+              '-Wl,--end-group',
+              '-lpthread', '-ldl', '-lrt', '-lX11', '-lXext'
+            ],
+
+            'conditions': [
+              [
+                'ew_optimize==1', {
+                  # LTO covers the addon sources. the core libraries join only if built with -flto too.
+                  'cflags': [ '-O3', '-flto' ],
+                  'ldflags': [ '-O3', '-flto' ]
+                }
+              ],
+              [
+                'ew_pgo=="generate"', {
+                  # media threads update counters concurrently
+                  'cflags': [ '-fprofile-generate=<(ew_pgo_dir)', '-fprofile-update=atomic' ],
+                  'ldflags': [ '-fprofile-generate=<(ew_pgo_dir)' ]
+                }
+              ],
+              [
+                'ew_pgo=="use"', {
+                  'cflags': [ '-fprofile-use=<(ew_pgo_dir)', '-fprofile-correction', '-Wno-missing-profile' ],
+                  'ldflags': [ '-fprofile-use=<(ew_pgo_dir)' ]
+                }
+              ],
+              [
+                'ew_count_allocations==1', {
+                  'defines': [ 'EW_COUNT_ALLOCATIONS' ],
+                  # the counting operator new of the addon must not replace the one of node
+                  'ldflags': [ '-Wl,-Bsymbolic' ]
+                }
+              ],
+              [
+                'ew_sanitize!=""', {
+                  # covers the addon sources. node is not instrumented, so the runtime is preloaded.
+                  'cflags': [ '-fsanitize=<(ew_sanitize)', '-fno-omit-frame-pointer', '-g' ],
+                  'ldflags': [ '-fsanitize=<(ew_sanitize)' ]
+                }
+              ]
             ]
           }
         ]
       ]
+    },
+    {
+      # stand-in stream writer of the benchmarks. depends on nothing but the capture format.
+      "target_name": "eastwood_stand_in",
+      "type": "executable",
+      "sources": [
+        "bench/stand_in.cc"
+      ],
+      "include_dirs": [
+        "src"
+      ],
+      'conditions': [
+        [
+          'OS=="mac"', {
+            'xcode_settings': {
+              'OTHER_CPLUSPLUSFLAGS' : [ '-std=c++14', '-stdlib=libc++' ],
+              'OTHER_LDFLAGS': [ '-stdlib=libc++' ],
+              'MACOSX_DEPLOYMENT_TARGET': '10.12'
+            }
+          }
+        ],
+        [
+          'OS=="linux"', {
+            'cflags_cc': [ '-std=c++14' ]
+          }
+        ]
+      ]
     }
   ]
 }
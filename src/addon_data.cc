@@ -0,0 +1,101 @@
+/// @copyright © 2017 Airtime Media.  All rights reserved.
+
+#include <algorithm>
+#include <map>
+#include <mutex>
+
+#include "addon_data.h"
+#include "loop_stats.h"
+#include "subscriber.h"
+
+namespace ew {
+
+using v8::Isolate;
+
+using namespace std;
+
+namespace {
+
+mutex registry_mutex;
+map<Isolate*, AddonData*> registry;  // guarded by registry_mutex
+
+mutex event_loop_mutex;
+at::Ptr<at::EventLoop> shared_event_loop;  // guarded by event_loop_mutex
+uint32_t event_loop_users = 0;             // guarded by event_loop_mutex
+
+}  // anonymous namespace
+
+AddonData* AddonData::Create(Isolate* isolate) {
+  {
+    // another context of the same isolate (e.g. vm module) shares the data
+    lock_guard<mutex> lock(registry_mutex);
+    auto it = registry.find(isolate);
+    if (it != registry.end()) return it->second;
+  }
+  auto data = new AddonData();
+  data->isolate = isolate;
+  data->uv_loop = node::GetCurrentEventLoop(isolate);
+  data->v8_cache.reset(new V8Cache(isolate));
+  data->memory_watch.reset(new MemoryWatch(data));
+  data->capacity.reset(new CapacityModel(data));
+  {
+    lock_guard<mutex> lock(registry_mutex);
+    registry[isolate] = data;
+  }
+  node::AddEnvironmentCleanupHook(isolate, Cleanup, data);
+  return data;
+}
+
+AddonData* AddonData::Get(Isolate* isolate) {
+  lock_guard<mutex> lock(registry_mutex);
+  auto it = registry.find(isolate);
+  assert(it != registry.end());
+  return it->second;
+}
+
+const at::Ptr<at::EventLoop>& AddonData::AcquireEventLoop() {
+  if (event_loop) return event_loop;
+  lock_guard<mutex> lock(event_loop_mutex);
+  if (!shared_event_loop) {
+    // this allocates (# of cores - 2) threads
+    auto num_threads = max<uint32_t>(1, at::EventLoopImpl::GetDefaultNumThreads() - 2);
+    shared_event_loop = at::EventLoop::New(num_threads);
+    LoopStats::Instance().StartProbe(shared_event_loop, num_threads);
+  }
+  ++event_loop_users;
+  event_loop = shared_event_loop;
+  return event_loop;
+}
+
+void AddonData::ReleaseEventLoop() {
+  if (!event_loop) return;
+  event_loop.reset();
+  lock_guard<mutex> lock(event_loop_mutex);
+  if (0 == --event_loop_users) {
+    LoopStats::Instance().StopProbe();
+    shared_event_loop->Stop();  // runs already queued tasks, then joins the threads
+    shared_event_loop.reset();
+  }
+}
+
+void AddonData::Cleanup(void* arg) {
+  auto data = static_cast<AddonData*>(arg);
+  // their timers and async handles belong to the loop being torn down, and the subscribers may outlive it
+  auto subscribers = data->subscribers;
+  for (auto subscriber : subscribers) subscriber->CloseForCleanup();
+  // without this, event loop threads would keep the process from exiting
+  data->ReleaseEventLoop();
+  data->memory_watch.reset();
+  data->capacity.reset();
+  data->eastwood_constructor.Reset();
+  data->subscriber_constructor.Reset();
+  data->subscriber_config_constructor.Reset();
+  data->composite_constructor.Reset();
+  {
+    lock_guard<mutex> lock(registry_mutex);
+    registry.erase(data->isolate);
+  }
+  delete data;
+}
+
+}  // namespace ew
@@ -0,0 +1,67 @@
+/// @copyright © 2017 Airtime Media.  All rights reserved.
+
+#ifndef ADDON_DATA_H_
+#define ADDON_DATA_H_
+
+#include <node.h>
+#include <uv.h>
+
+#include <memory>
+#include <set>
+
+#include "mediacore/defs.h"
+#include "mediacore/async/eventloop.h"
+#include "v8_cache.h"
+#include "memory_watch.h"
+#include "capacity.h"
+
+
+namespace ew {
+
+class Subscriber;
+
+/**
+ * State of the addon per isolate (i.e. main thread and each worker_thread).
+ * Everything here is only touched on the thread that owns the isolate,
+ * except the native event loop, which is shared by all isolates of the process.
+ */
+struct AddonData {
+  v8::Isolate* isolate = nullptr;
+  uv_loop_t* uv_loop = nullptr;
+
+  v8::Persistent<v8::Function> eastwood_constructor;
+  v8::Persistent<v8::Function> subscriber_constructor;
+  v8::Persistent<v8::Function> subscriber_config_constructor;
+  v8::Persistent<v8::Function> composite_constructor;
+
+  /// property keys and object templates for objects handed to JS
+  std::unique_ptr<V8Cache> v8_cache;
+
+  /// native memory accounting of the subscribers
+  std::unique_ptr<MemoryWatch> memory_watch;
+  /// capacity model for admission control
+  std::unique_ptr<CapacityModel> capacity;
+
+  /// live subscribers created in this isolate
+  std::set<Subscriber*> subscribers;
+
+  /// reference to the shared event loop. null until the first EastWood is created, or after released.
+  at::Ptr<at::EventLoop> event_loop;
+
+  /// Creates the data of @a isolate and registers its cleanup on environment teardown.
+  static AddonData* Create(v8::Isolate* isolate);
+  /// @return data of @a isolate. Create() must have been called.
+  static AddonData* Get(v8::Isolate* isolate);
+
+  /// Takes a reference to the shared event loop, creating it on first use.
+  const at::Ptr<at::EventLoop>& AcquireEventLoop();
+  /// Drops the reference. The last one stops the loop after draining queued tasks and joins its threads.
+  void ReleaseEventLoop();
+
+ private:
+  static void Cleanup(void* arg);
+};
+
+}  // namespace ew
+
+#endif  // ADDON_DATA_H_
@@ -0,0 +1,59 @@
+/// @copyright © 2017 Airtime Media.  All rights reserved.
+
+#include "alloc_counter.h"
+
+#ifdef EW_COUNT_ALLOCATIONS
+#include <cstdlib>
+#include <new>
+#endif
+
+namespace ew {
+
+#ifdef EW_COUNT_ALLOCATIONS
+
+namespace {
+thread_local uint64_t t_allocations = 0;
+}  // namespace
+
+uint64_t AllocCounter::Thread() { return t_allocations; }
+
+}  // namespace ew
+
+// The addon is linked with -Bsymbolic in this build, so that these serve the addon and the core libraries
+// linked into it, while node keeps its own. Memory is from malloc() either way, so a block may be freed
+// by the other side.
+
+namespace {
+
+void* Allocate(size_t size) {
+  ++ew::t_allocations;
+  if (auto p = malloc(size ? size : 1)) return p;
+  throw std::bad_alloc();
+}
+
+}  // namespace
+
+void* operator new(size_t size) { return Allocate(size); }
+void* operator new[](size_t size) { return Allocate(size); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+  ++ew::t_allocations;
+  return malloc(size ? size : 1);
+}
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+  ++ew::t_allocations;
+  return malloc(size ? size : 1);
+}
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { free(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { free(p); }
+
+#else
+
+uint64_t AllocCounter::Thread() { return 0; }
+
+}  // namespace ew
+
+#endif  // EW_COUNT_ALLOCATIONS
@@ -0,0 +1,30 @@
+/// @copyright © 2017 Airtime Media.  All rights reserved.
+
+#ifndef ALLOC_COUNTER_H_
+#define ALLOC_COUNTER_H_
+
+#include <cstdint>
+
+
+namespace ew {
+
+/**
+ * Heap allocations made by the calling thread through operator new, in the addon and the core libraries
+ * linked into it. Counted only in builds with EW_COUNT_ALLOCATIONS (node-gyp rebuild -- -Dew_count_allocations=1),
+ * which replace operator new for the addon. Used to check that the media path is allocation-free once warm.
+ */
+struct AllocCounter {
+  static constexpr bool Enabled() {
+#ifdef EW_COUNT_ALLOCATIONS
+    return true;
+#else
+    return false;
+#endif
+  }
+  /// @return allocations by the calling thread so far (0 if not counted)
+  static uint64_t Thread();
+};
+
+}  // namespace ew
+
+#endif  // ALLOC_COUNTER_H_
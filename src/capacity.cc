@@ -0,0 +1,247 @@
+/// @copyright © 2017 Airtime Media.  All rights reserved.
+
+#include <time.h>
+
+#include <algorithm>
+#include <limits>
+#include <mutex>
+#include <thread>
+
+#include "capacity.h"
+#include "addon_data.h"
+#include "memory_watch.h"
+#include "steady_clock.h"
+#include "subscriber.h"
+#include "uv_handles.h"
+
+namespace ew {
+
+using namespace std;
+
+constexpr uint32_t CapacityModel::kMaxShedLevel;
+constexpr double CapacityModel::kRecoverFraction;
+
+namespace {
+
+mutex policy_mutex;
+AdmissionPolicy admission_policy;  // guarded by policy_mutex
+bool has_policy = false;           // guarded by policy_mutex
+LoadSheddingPolicy shedding_policy;  // guarded by policy_mutex
+
+int64_t ProcessCpuNs() {
+  timespec ts;
+  if (0 != clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts)) return 0;
+  return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+}  // anonymous namespace
+
+CapacityModel::CapacityModel(AddonData* data)
+  : data_(data), cpus_(max(1u, thread::hardware_concurrency())) {
+}
+
+CapacityModel::~CapacityModel() {
+  if (timer_) CloseHandle(timer_);
+}
+
+void CapacityModel::Start() {
+  if (timer_) return;
+  last_sample_ns_ = SteadyNowNs();
+  last_cpu_ns_ = ProcessCpuNs();
+  timer_ = NewBackgroundTimer(data_->uv_loop, this);
+  uv_timer_start(timer_, OnTimer, kIntervalMs, kIntervalMs);
+}
+
+void CapacityModel::OnTimer(uv_timer_t* timer) {
+  static_cast<CapacityModel*>(timer->data)->Sample();
+}
+
+void CapacityModel::Sample() {
+  auto now_ns = SteadyNowNs();
+  auto cpu_ns = ProcessCpuNs();
+  auto elapsed_ns = now_ns - last_sample_ns_;
+  if (elapsed_ns <= 0) return;
+  auto cpu_delta_ns = cpu_ns - last_cpu_ns_;
+  last_sample_ns_ = now_ns;
+  last_cpu_ns_ = cpu_ns;
+  cpu_used_ += kSmoothing * (static_cast<double>(cpu_delta_ns) / (elapsed_ns * cpus_) - cpu_used_);
+
+  // sink delivery time of each running subscriber since the last sample
+  array<int64_t, kNumSinkClasses> delivery_ns{};
+  array<uint32_t, kNumSinkClasses> counts{};
+  map<uint32_t, int64_t> last_delivery_ns;
+  int64_t delivery_total_ns = 0;
+  int64_t memory_bytes = 0;
+  uint32_t running = 0;
+  for (auto subscriber : data_->subscribers) {
+    if (!subscriber->facade_) continue;
+    auto total_ns = subscriber->audio_track_->delivery.total_ns.load(memory_order_relaxed)
+                  + subscriber->video_track_->delivery.total_ns.load(memory_order_relaxed);
+    auto it = last_delivery_ns_.find(subscriber->id_);
+    auto delta_ns = total_ns - (it == last_delivery_ns_.end() ? 0 : it->second);
+    last_delivery_ns[subscriber->id_] = total_ns;
+    delivery_ns[subscriber->sink_class_] += delta_ns;
+    ++counts[subscriber->sink_class_];
+    delivery_total_ns += delta_ns;
+    memory_bytes += subscriber->memory_bytes_;
+    ++running;
+  }
+  last_delivery_ns_.swap(last_delivery_ns);
+  subscribers_ = counts;
+  memory_per_subscriber_ = (0 < running) ? memory_bytes / running : 0;
+
+  if (0 < running) {
+    // the rest of the process' CPU (network, decoding, loop) is shared evenly
+    auto shared_ns = max<int64_t>(0, cpu_delta_ns - delivery_total_ns) / running;
+    for (size_t c = 0; c < kNumSinkClasses; ++c) {
+      if (0 == counts[c]) continue;
+      auto ms_per_s = (static_cast<double>(delivery_ns[c]) / counts[c] + shared_ns) / elapsed_ns * 1000;
+      cpu_ms_[c] = (0 == cpu_ms_[c]) ? ms_per_s : cpu_ms_[c] + kSmoothing * (ms_per_s - cpu_ms_[c]);
+    }
+  }
+
+  // queue wait of the last interval, over all loop threads
+  LatencyHistogram::Snapshot queue_wait;
+  for (const auto& thread : LoopStats::Instance().Threads()) {
+    auto snapshot = thread->queue_wait.Take();
+    for (size_t i = 0; i < LatencyHistogram::kBuckets; ++i) queue_wait.buckets[i] += snapshot.buckets[i];
+    queue_wait.count += snapshot.count;
+    queue_wait.max_us = max(queue_wait.max_us, snapshot.max_us);
+  }
+  LatencyHistogram::Snapshot recent;
+  for (size_t i = 0; i < LatencyHistogram::kBuckets; ++i) {
+    recent.buckets[i] = queue_wait.buckets[i] - min(queue_wait.buckets[i], last_queue_wait_.buckets[i]);
+    recent.count += recent.buckets[i];
+  }
+  recent.max_us = queue_wait.max_us;
+  last_queue_wait_ = queue_wait;
+  queue_wait_p99_ms_ = recent.Percentile(0.99) / 1000.0;
+
+  UpdateShedding();
+}
+
+void CapacityModel::UpdateShedding() {
+  auto policy = Shedding();
+  auto over = [&policy](double queue_wait_ms, double cpu_used) {
+    return (0 < policy.queue_wait_ms && policy.queue_wait_ms < queue_wait_ms)
+        || (0 < policy.cpu_used && policy.cpu_used < cpu_used);
+  };
+  auto level = shed_level_;
+  if (over(queue_wait_p99_ms_, cpu_used_)) {
+    level = min(level + 1, kMaxShedLevel);
+  } else if (0 < level && !over(queue_wait_p99_ms_ / kRecoverFraction, cpu_used_ / kRecoverFraction)) {
+    --level;
+  }
+  shed_level_ = level;
+  // subscribers started since the last sample get it too. the taps read it with each video frame.
+  for (auto subscriber : data_->subscribers) {
+    subscriber->video_track_->keep_every.store(KeepEvery(level, subscriber->priority_), memory_order_relaxed);
+  }
+}
+
+uint32_t CapacityModel::KeepEvery(uint32_t level, Priority priority) {
+  // each class is shed in two steps, the lowest first
+  auto steps = static_cast<int>(level) - 2 * static_cast<int>(priority);
+  if (kPriorityHigh == priority || steps <= 0) return 1;
+  return 1u << min(steps, 2);
+}
+
+uint32_t CapacityModel::Admissible(SinkClass sink_class) const {
+  auto policy = Policy();
+  auto result = numeric_limits<uint32_t>::max();
+  if (0 < policy.max_queue_wait_ms && policy.max_queue_wait_ms < queue_wait_p99_ms_) return 0;
+
+  if (0 < cpu_ms_[sink_class]) {
+    auto free_ms = (1.0 - policy.cpu_headroom - cpu_used_) * cpus_ * 1000;
+    result = min(result, static_cast<uint32_t>(max(0.0, free_ms / cpu_ms_[sink_class])));
+  }
+  auto limit = MemoryWatch::ProcessLimit();
+  if (0 < limit && 0 < memory_per_subscriber_) {
+    auto free_bytes = limit - (int64_t(policy.memory_headroom_mb) << 20) - MemoryWatch::RssBytes();
+    result = min(result, static_cast<uint32_t>(max<int64_t>(0, free_bytes / memory_per_subscriber_)));
+  }
+  return result;
+}
+
+string CapacityModel::CheckAdmission(SinkClass sink_class) const {
+  auto policy = Policy();
+  if (0 < policy.max_queue_wait_ms && policy.max_queue_wait_ms < queue_wait_p99_ms_) {
+    return "loop queue wait " + to_string(queue_wait_p99_ms_) + "ms";
+  }
+  if (0 < policy.cpu_headroom &&
+      1.0 - policy.cpu_headroom < cpu_used_ + cpu_ms_[sink_class] / (cpus_ * 1000)) {
+    return "cpu " + to_string(cpu_used_);
+  }
+  auto limit = MemoryWatch::ProcessLimit();
+  if (0 < policy.memory_headroom_mb && 0 < limit &&
+      limit - (int64_t(policy.memory_headroom_mb) << 20) < MemoryWatch::RssBytes() + memory_per_subscriber_) {
+    return "memory " + to_string(MemoryWatch::RssBytes()) + " bytes";
+  }
+  return "";
+}
+
+void CapacityModel::SetPolicy(const AdmissionPolicy& policy) {
+  lock_guard<mutex> lock(policy_mutex);
+  admission_policy = policy;
+  has_policy = (0 < policy.cpu_headroom || 0 < policy.memory_headroom_mb || 0 < policy.max_queue_wait_ms);
+}
+
+AdmissionPolicy CapacityModel::Policy() {
+  lock_guard<mutex> lock(policy_mutex);
+  return admission_policy;
+}
+
+bool CapacityModel::HasPolicy() {
+  lock_guard<mutex> lock(policy_mutex);
+  return has_policy;
+}
+
+void CapacityModel::SetShedding(const LoadSheddingPolicy& policy) {
+  lock_guard<mutex> lock(policy_mutex);
+  shedding_policy = policy;
+}
+
+LoadSheddingPolicy CapacityModel::Shedding() {
+  lock_guard<mutex> lock(policy_mutex);
+  return shedding_policy;
+}
+
+bool CapacityModel::ParsePriority(const string& name, Priority& priority) {
+  for (auto p : { kPriorityLow, kPriorityNormal, kPriorityHigh }) {
+    if (name == PriorityString(p)) {
+      priority = p;
+      return true;
+    }
+  }
+  return false;
+}
+
+const char* CapacityModel::PriorityString(Priority priority) {
+  switch (priority) {
+    case kPriorityLow:
+      return "low";
+    case kPriorityHigh:
+      return "high";
+    default:
+      return "normal";
+  }
+}
+
+const char* CapacityModel::SinkClassString(SinkClass sink_class) {
+  switch (sink_class) {
+    case kSinkClassNone:
+      return "none";
+    case kSinkClassFile:
+      return "file";
+    case kSinkClassRemux:
+      return "ffmpegRemux";
+    case kSinkClassTranscode:
+      return "ffmpegTranscode";
+    case kSinkClassPlugin:
+      return "plugin";
+    default:
+      return "undefined";
+  }
+}
+
+}  // namespace ew
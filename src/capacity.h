@@ -0,0 +1,130 @@
+/// @copyright © 2017 Airtime Media.  All rights reserved.
+
+#ifndef CAPACITY_H_
+#define CAPACITY_H_
+
+#include <uv.h>
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <string>
+
+#include "loop_stats.h"
+
+
+namespace ew {
+
+struct AddonData;
+
+/// Kinds of subscribers whose costs differ by an order of magnitude
+enum SinkClass {
+  kSinkClassNone = 0,     // frames discarded
+  kSinkClassFile,         // raw frames written to files
+  kSinkClassRemux,        // FFmpeg without re-encoding
+  kSinkClassTranscode,    // FFmpeg with encoding
+  kSinkClassPlugin,       // native sink plugin
+  kNumSinkClasses
+};
+
+/// Priority class of a subscriber, set by SubscriberConfig.priority()
+enum Priority : uint8_t {
+  kPriorityLow = 0,  // e.g. archival recordings and monitoring. shed first.
+  kPriorityNormal,
+  kPriorityHigh,     // e.g. paid live restreams. never shed.
+  kNumPriorities
+};
+
+/// Overload starting load shedding (see EastWood.setLoadShedding()). Zero disables each check.
+struct LoadSheddingPolicy {
+  uint32_t queue_wait_ms = 0;  // recent p99 of loop queue wait
+  double cpu_used = 0;         // fraction of all cores used by the process
+};
+
+/// Thresholds for admitting one more subscriber. Zero disables each check.
+struct AdmissionPolicy {
+  double cpu_headroom = 0;       // fraction of all cores to keep free
+  uint32_t memory_headroom_mb = 0;  // RSS to keep below the process memory limit
+  uint32_t max_queue_wait_ms = 0;   // recent p99 of loop queue wait
+};
+
+/**
+ * Live capacity model of the subscribers of one isolate, sampled every second on JS thread.
+ * CPU of each subscriber is its sink delivery time plus an equal share of the rest of process CPU time,
+ * smoothed per sink class.
+ */
+class CapacityModel {
+ public:
+  explicit CapacityModel(AddonData* data);
+  ~CapacityModel();
+
+  /// Starts periodic sampling if not yet. Called when a subscriber starts.
+  void Start();
+
+  /// @return reason of rejection, or empty if one more subscriber of @a sink_class is admitted
+  std::string CheckAdmission(SinkClass sink_class) const;
+  /// @return how many more subscribers of @a sink_class fit under the policy (or under full capacity)
+  uint32_t Admissible(SinkClass sink_class) const;
+
+  static void SetPolicy(const AdmissionPolicy& policy);
+  static AdmissionPolicy Policy();
+  static bool HasPolicy();
+
+  static const char* SinkClassString(SinkClass sink_class);
+
+  static void SetShedding(const LoadSheddingPolicy& policy);
+  static LoadSheddingPolicy Shedding();
+  /// @return false if @a name is not a priority class
+  static bool ParsePriority(const std::string& name, Priority& priority);
+  static const char* PriorityString(Priority priority);
+  /// @return share of a class in weighted fair sharing, e.g. of the encoder thread budget
+  static uint32_t PriorityWeight(Priority priority) { return 1u << priority; }
+  /// @return 1 if every video frame of @a priority is delivered at shedding @a level, N if one in N
+  static uint32_t KeepEvery(uint32_t level, Priority priority);
+
+  uint32_t cpus() const { return cpus_; }
+  /// fraction of all cores used by the process
+  double cpu_used() const { return cpu_used_; }
+  /// CPU milliseconds per second of one subscriber of @a sink_class. 0 until observed.
+  double cpu_ms(SinkClass sink_class) const { return cpu_ms_[sink_class]; }
+  uint32_t subscribers(SinkClass sink_class) const { return subscribers_[sink_class]; }
+  /// p99 of loop queue wait over the last sample interval
+  double queue_wait_p99_ms() const { return queue_wait_p99_ms_; }
+  int64_t memory_per_subscriber() const { return memory_per_subscriber_; }
+  /// 0 while not overloaded. rises by one per sample while overloaded, falls by one once under kRecoverFraction.
+  uint32_t shed_level() const { return shed_level_; }
+
+  static constexpr uint64_t kIntervalMs = 1000;
+  static constexpr double kSmoothing = 0.2;  // weight of the latest sample
+  /// low priority video goes to 1/2 then 1/4 of its frames, then normal priority likewise
+  static constexpr uint32_t kMaxShedLevel = 4;
+  /// of the shedding thresholds, below which shedding eases, so that it does not flap
+  static constexpr double kRecoverFraction = 0.8;
+
+ private:
+  static void OnTimer(uv_timer_t* timer);
+  void Sample();
+  /// Moves the shedding level and applies it to the subscribers. After the sample.
+  void UpdateShedding();
+
+  AddonData* data_;
+  uv_timer_t* timer_ = nullptr;
+  const uint32_t cpus_;
+
+  int64_t last_sample_ns_ = 0;
+  int64_t last_cpu_ns_ = 0;
+  std::map<uint32_t, int64_t> last_delivery_ns_;  // by subscriber id
+  LatencyHistogram::Snapshot last_queue_wait_;
+
+  double cpu_used_ = 0;
+  std::array<double, kNumSinkClasses> cpu_ms_{};
+  std::array<uint32_t, kNumSinkClasses> subscribers_{};
+  double queue_wait_p99_ms_ = 0;
+  int64_t memory_per_subscriber_ = 0;
+  uint32_t shed_level_ = 0;
+};
+
+}  // namespace ew
+
+#endif  // CAPACITY_H_
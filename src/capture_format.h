@@ -0,0 +1,33 @@
+/// @copyright © 2017 Airtime Media.  All rights reserved.
+
+#ifndef CAPTURE_FORMAT_H_
+#define CAPTURE_FORMAT_H_
+
+#include <cstdint>
+
+
+namespace ew {
+
+/**
+ * Capture file layout (host byte order):
+ *   kCaptureMagic without its terminator, then for each frame a CaptureRecord followed by its payload.
+ * Depends on nothing else, so that tools outside the addon (see bench/stand_in.cc) can write captures.
+ */
+constexpr char kCaptureMagic[9] = "EWCAP001";
+
+struct CaptureRecord {
+  int64_t arrival_ns;    // since the first frame of the capture
+  int64_t timestamp_us;
+  uint32_t size;
+  uint32_t sample_rate;
+  uint16_t width;
+  uint16_t height;
+  uint8_t channels;
+  uint8_t track;         // FrameTrack
+  uint8_t reserved[2];
+};
+static_assert(sizeof(CaptureRecord) == 32, "CaptureRecord layout is part of the file format");
+
+}  // namespace ew
+
+#endif  // CAPTURE_FORMAT_H_
@@ -0,0 +1,137 @@
+/// @copyright © 2017 Airtime Media.  All rights reserved.
+
+#include <utility>
+
+#include "composite.h"
+#include "capacity.h"
+#include "addon_util/addon_util.h"
+
+#include "eastwood/ffmpeg/ffmpeg_stream_sink_factory.h"
+
+namespace ew {
+
+using v8::Context;
+using v8::Exception;
+using v8::FunctionCallbackInfo;
+using v8::Isolate;
+using v8::Local;
+using v8::Object;
+using v8::Promise;
+using v8::Undefined;
+using v8::Value;
+
+using namespace std;
+using namespace string_literals;
+
+using namespace at::node_addon;
+
+// --------------------------------------------
+
+Composite::Composite(AddonData* addon)
+  : log_(at::log::keywords::channel = "addon.Composite")
+  , addon_(addon) {
+}
+
+Composite::~Composite() {
+  if (mixer_) mixer_->Stop();
+}
+
+void Composite::start(const FunctionCallbackInfo<Value>& args) {
+  if (!CheckArgs("start", args, 0, 0)) return;
+  Composite* self = Unwrap<Composite>(args.Holder());
+  assert(self);
+
+  auto context = args.GetIsolate()->GetCurrentContext();
+  auto resolver = Promise::Resolver::New(context).ToLocalChecked();
+  args.GetReturnValue().Set(resolver->GetPromise());
+  if (self->encoder_lease_) {
+    resolver->Reject(context, Exception::Error(ToLocalString("Already started"))).FromJust();
+    return;
+  }
+
+  AT_LOG_INFO(self->log_, "Starting " << self->output_);
+  using at::eastwood::FFmpegStreamSinkFactory;
+  // always a transcode: the pictures are made here
+  auto options = *self->options_;
+  self->encoder_lease_ = EncoderBudget::Instance().Acquire(CapacityModel::PriorityWeight(kPriorityNormal));
+  options.emplace(EncoderBudget::kThreadsOption, to_string(self->encoder_lease_->threads));
+  if (!self->encoder_lease_->preset.empty()) {
+    options.emplace(EncoderBudget::kPresetOption, self->encoder_lease_->preset);
+  }
+  auto factory = FFmpegStreamSinkFactory(self->output_, options);
+  self->output_failed_ = false;
+  factory.RegisterStreamOutputFailureHandler([self]() {
+    AT_LOG_ERROR(self->log_, "Output failure");
+    self->output_failed_ = true;
+  });
+  auto a_v_sinks = factory.CreateSinks(at::eastwood::AudioSinkConfig(), at::eastwood::VideoSinkConfig());
+  if (self->output_failed_) {
+    self->encoder_lease_.reset();
+    resolver->Reject(context, Exception::Error(ToLocalString("Failed to create sinks: output failure"))).FromJust();
+    return;
+  }
+  self->mixer_->Start(move(a_v_sinks.first), move(a_v_sinks.second));
+  AT_LOG_INFO(self->log_, "Started");
+  resolver->Resolve(context, Undefined(args.GetIsolate())).FromJust();
+}
+
+void Composite::stop(const FunctionCallbackInfo<Value>& args) {
+  if (!CheckArgs("stop", args, 0, 0)) return;
+  Composite* self = Unwrap<Composite>(args.Holder());
+  assert(self);
+
+  auto context = args.GetIsolate()->GetCurrentContext();
+  auto resolver = Promise::Resolver::New(context).ToLocalChecked();
+  args.GetReturnValue().Set(resolver->GetPromise());
+  auto started = static_cast<bool>(self->encoder_lease_);
+  if (started) {
+    AT_LOG_INFO(self->log_, "Stopping");
+    self->mixer_->Stop();  // joins the composer, and closes the output
+    self->encoder_lease_.reset();
+  }
+  resolver->Resolve(context, ToLocalBoolean(started)).FromJust();
+}
+
+void Composite::stats(const FunctionCallbackInfo<Value>& args) {
+  if (!CheckArgs("stats", args, 0, 0)) return;
+  Composite* self = Unwrap<Composite>(args.Holder());
+  assert(self);
+
+  auto context = args.GetIsolate()->GetCurrentContext();
+  const auto& cache = *self->addon_->v8_cache;
+  const auto& k = cache.keys;
+  auto stats = self->mixer_->stats();
+  auto obj = cache.NewObject(context, V8Cache::kShapeCompositeStats);
+  cache.Put(context, obj, k.inputs, ToLocalInteger(stats.inputs));
+  cache.Put(context, obj, k.audioFrames, ToLocalNumber(static_cast<double>(stats.audio_frames)));
+  cache.Put(context, obj, k.videoFrames, ToLocalNumber(static_cast<double>(stats.video_frames)));
+  cache.Put(context, obj, k.late, ToLocalNumber(static_cast<double>(stats.late)));
+  cache.Put(context, obj, k.dropped, ToLocalNumber(static_cast<double>(stats.dropped)));
+  cache.Put(context, obj, k.compose_ms, ToLocalNumber(stats.compose_ms));
+  cache.Put(context, obj, k.outputFailed, ToLocalBoolean(self->output_failed_.load()));
+  args.GetReturnValue().Set(obj);
+}
+
+bool Composite::IsInstance(Isolate* isolate, Local<Value> value) {
+  if (!value->IsObject()) return false;
+  auto ctor = AddonData::Get(isolate)->composite_constructor.Get(isolate);
+  return value->InstanceOf(isolate->GetCurrentContext(), ctor).FromMaybe(false);
+}
+
+void Composite::Init(Local<Object> exports, AddonData* data) {
+  InitClass(exports, "Composite", New, data->composite_constructor,
+    AT_ADDON_PROTOTYPE_METHOD(start),
+    AT_ADDON_PROTOTYPE_METHOD(stop),
+    AT_ADDON_PROTOTYPE_METHOD(stats)
+  );
+}
+
+Local<Object> Composite::NewInstance(const FunctionCallbackInfo<Value>& args) {
+  return NewV8Instance(AddonData::Get(args.GetIsolate())->composite_constructor, args);
+}
+
+void Composite::New(const FunctionCallbackInfo<Value>& args) {
+  NewCppInstance(args, new Composite(AddonData::Get(args.GetIsolate())));
+}
+
+}  // namespace ew
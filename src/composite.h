@@ -0,0 +1,94 @@
+/// @copyright © 2017 Airtime Media.  All rights reserved.
+
+#ifndef COMPOSITE_H_
+#define COMPOSITE_H_
+
+#include <node.h>
+#include <node_object_wrap.h>
+
+#include <atomic>
+#include <memory>
+#include <string>
+
+#include "mediacore/defs.h"
+#include "mediacore/base/logging.h"
+#include "eastwood/ffmpeg/ffmpeg_stream_sink_factory.h"
+
+#include "addon_data.h"
+#include "composite_mixer.h"
+#include "encoder_budget.h"
+#include "addon_util/addon_util.h"
+
+
+namespace ew {
+
+/**
+ * One FFMpeg output composed of several subscribers: their audio mixed and their video tiled in a grid.
+ * Made by EastWood.createComposite(). Subscribers join with SubscriberConfig.compositeSink().
+ * The composite encodes once for all of them, at the layout given.
+ */
+class Composite : public node::ObjectWrap {
+ public:
+  static bool IsInstance(v8::Isolate* isolate, v8::Local<v8::Value> value);
+  const std::shared_ptr<CompositeMixer>& mixer() const { return mixer_; }
+
+ private:
+  /**
+   * Starts composing into the output. Subscribers may join before or after.
+   * Signature:
+   *  Promise start();
+   * @return Promise resolved once the output is open, rejected if it could not be created or already started
+   */
+  static void start(const v8::FunctionCallbackInfo<v8::Value>& args);
+
+  /**
+   * Stops composing and closes the output. Subscribers still feeding it keep running, with their frames ignored.
+   * Signature:
+   *  Promise stop();
+   * @return Promise resolved with false if not started
+   */
+  static void stop(const v8::FunctionCallbackInfo<v8::Value>& args);
+
+  /**
+   * Returns a snapshot of runtime statistics.
+   * Signature:
+   *  Object stats();
+   * @return { inputs (subscribers feeding it), audioFrames, videoFrames (composed),
+   *           late (ticks composed behind schedule), dropped (input audio frames not in the layout format
+   *           or over the queue limit), compose_ms (average time to compose a picture),
+   *           outputFailed: Boolean }
+   */
+  static void stats(const v8::FunctionCallbackInfo<v8::Value>& args);
+
+  /// @internal Used for V8 framework
+  static void Init(v8::Local<v8::Object> exports, AddonData* data);
+
+  /// @internal only internally used
+  explicit Composite(AddonData* addon);
+  ~Composite();
+
+  using FFmpegOptions = at::eastwood::FFmpegStreamSinkFactory::OptionMap;
+
+  mutable at::Logger log_;
+  AddonData* addon_;
+  /// shared with the configs of the subscribers joining it
+  std::shared_ptr<CompositeMixer> mixer_;
+  std::string output_;
+  std::shared_ptr<const FFmpegOptions> options_;
+  /// threading of the encoder. released once the output is closed.
+  std::shared_ptr<const EncoderLease> encoder_lease_;
+  std::atomic<bool> output_failed_{false};
+
+  /// @internal Used by V8 framework
+  static void New(const v8::FunctionCallbackInfo<v8::Value>& args);
+
+  /// @internal Used by EastWood
+  static v8::Local<v8::Object> NewInstance(const v8::FunctionCallbackInfo<v8::Value>& args);
+  friend class EastWood;
+
+  AT_ADDON_CLASS;
+};
+
+}  // namespace ew
+
+#endif  // COMPOSITE_H_
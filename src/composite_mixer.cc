@@ -0,0 +1,340 @@
+/// @copyright © 2017 Airtime Media.  All rights reserved.
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "libyuv/scale.h"
+
+#include "composite_mixer.h"
+#include "media_frame.h"
+#include "pipeline_trace.h"
+#include "steady_clock.h"
+
+namespace ew {
+
+using namespace std;
+
+constexpr uint32_t CompositeInput::kMaxQueuedAudioMs;
+constexpr int64_t CompositeMixer::kAudioFrameMs;
+
+namespace {
+
+/// acc[i] += in[i], saturating to int16
+void MixSaturate(int16_t* acc, const int16_t* in, size_t count) {
+  size_t i = 0;
+#if defined(__SSE2__)
+  for (; i + 8 <= count; i += 8) {
+    auto a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(acc + i));
+    auto b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(acc + i), _mm_adds_epi16(a, b));
+  }
+#elif defined(__ARM_NEON)
+  for (; i + 8 <= count; i += 8) {
+    vst1q_s16(acc + i, vqaddq_s16(vld1q_s16(acc + i), vld1q_s16(in + i)));
+  }
+#endif
+  for (; i < count; ++i) {
+    acc[i] = static_cast<int16_t>(max(-32768, min(32767, acc[i] + in[i])));
+  }
+}
+
+size_t I420Size(uint32_t width, uint32_t height) {
+  return width * height + 2 * ((width + 1) / 2) * ((height + 1) / 2);
+}
+
+}  // namespace
+
+CompositeInput::CompositeInput(uint32_t subscriber_id, const CompositeLayout& layout, shared_ptr<FramePool> pool)
+  : subscriber_id_(subscriber_id), layout_(layout), pool_(move(pool)),
+    pcm_(layout.sample_rate * layout.channels * kMaxQueuedAudioMs / 1000) {
+}
+
+void CompositeInput::PushAudio(const at::AudioFrame& frame) {
+  auto meta = MetaOf(frame);
+  // no resampling here: the composite is set up with the format of its participants
+  if (meta.sample_rate != layout_.sample_rate || meta.channels != layout_.channels) {
+    dropped_.fetch_add(1, memory_order_relaxed);
+    return;
+  }
+  audio_frames_.fetch_add(1, memory_order_relaxed);
+  auto samples = reinterpret_cast<const int16_t*>(PayloadOf(frame));
+  auto count = meta.size / sizeof(int16_t);
+  auto capacity = pcm_.size();
+  if (capacity < count) {
+    samples += count - capacity;
+    count = capacity;
+  }
+  lock_guard<mutex> lock(mutex_);
+  if (capacity < pcm_size_ + count) {
+    // the composer is behind or this input runs fast. keeps the latest audio.
+    dropped_.fetch_add(1, memory_order_relaxed);
+    auto excess = pcm_size_ + count - capacity;
+    pcm_begin_ = (pcm_begin_ + excess) % capacity;
+    pcm_size_ -= excess;
+  }
+  auto end = (pcm_begin_ + pcm_size_) % capacity;
+  auto first = min(count, capacity - end);
+  copy(samples, samples + first, pcm_.begin() + end);
+  copy(samples + first, samples + count, pcm_.begin());
+  pcm_size_ += count;
+}
+
+void CompositeInput::PushVideo(const at::VideoFrame& frame) {
+  auto meta = MetaOf(frame);
+  if (0 == meta.width || 0 == meta.height || meta.size < I420Size(meta.width, meta.height)) return;
+  video_frames_.fetch_add(1, memory_order_relaxed);
+  Picture picture;
+  picture.i420 = pool_->Copy(PayloadOf(frame), meta.size);
+  picture.width = meta.width;
+  picture.height = meta.height;
+  lock_guard<mutex> lock(mutex_);
+  swap(picture_, picture);
+}
+
+size_t CompositeInput::MixAudio(int16_t* acc, size_t count) {
+  lock_guard<mutex> lock(mutex_);
+  count = min(count, pcm_size_);
+  auto first = min(count, pcm_.size() - pcm_begin_);
+  MixSaturate(acc, pcm_.data() + pcm_begin_, first);
+  MixSaturate(acc + first, pcm_.data(), count - first);
+  pcm_begin_ = (pcm_begin_ + count) % pcm_.size();
+  pcm_size_ -= count;
+  return count;
+}
+
+CompositeInput::Picture CompositeInput::LatestPicture() const {
+  lock_guard<mutex> lock(mutex_);
+  return picture_;
+}
+
+CompositeMixer::CompositeMixer(const CompositeLayout& layout)
+  : layout_(layout),
+    mix_(layout.sample_rate * kAudioFrameMs / 1000 * layout.channels),
+    canvas_(I420Size(layout.width, layout.height)) {
+}
+
+CompositeMixer::~CompositeMixer() {
+  Stop();
+}
+
+shared_ptr<CompositeInput> CompositeMixer::AddInput(uint32_t subscriber_id, shared_ptr<FramePool> pool) {
+  auto input = shared_ptr<CompositeInput>(new CompositeInput(subscriber_id, layout_, move(pool)));
+  lock_guard<mutex> lock(inputs_mutex_);
+  // inputs that left, e.g. of subscribers stopped and started again, would pile up otherwise
+  inputs_.erase(remove_if(inputs_.begin(), inputs_.end(),
+                          [](const weak_ptr<CompositeInput>& weak) { return weak.expired(); }),
+                inputs_.end());
+  inputs_.push_back(input);
+  return input;
+}
+
+void CompositeMixer::Inputs(vector<shared_ptr<CompositeInput>>& inputs) const {
+  inputs.clear();
+  lock_guard<mutex> lock(inputs_mutex_);
+  for (const auto& weak : inputs_) {
+    if (auto input = weak.lock()) inputs.push_back(move(input));
+  }
+}
+
+bool CompositeMixer::Start(AudioSinkPtr audio, VideoSinkPtr video) {
+  lock_guard<mutex> lock(mutex_);
+  if (running_) return false;
+  running_ = true;
+  audio_sink_ = move(audio);
+  video_sink_ = move(video);
+  // the composer thread takes a share of the tiles too
+  auto workers = max(1u, min(4u, thread::hardware_concurrency() / 2)) - 1;
+  workers_stopping_ = false;
+  for (auto i = 0u; i < workers; ++i) workers_.emplace_back([this]() { Work(); });
+  thread_ = thread([this]() { Run(); });
+  return true;
+}
+
+void CompositeMixer::Stop() {
+  {
+    lock_guard<mutex> lock(mutex_);
+    if (!running_) return;
+    running_ = false;
+  }
+  wake_.notify_one();
+  thread_.join();
+  {
+    lock_guard<mutex> lock(jobs_mutex_);
+    workers_stopping_ = true;
+  }
+  jobs_wake_.notify_all();
+  for (auto& worker : workers_) worker.join();
+  workers_.clear();
+  audio_sink_ = AudioSinkPtr();
+  video_sink_ = VideoSinkPtr();
+}
+
+void CompositeMixer::Run() {
+  const auto audio_period_ns = kAudioFrameMs * 1000000;
+  const auto video_period_ns = int64_t(1000000000) / layout_.fps;
+  auto start_ns = SteadyNowNs();
+  uint64_t audio_index = 0;
+  uint64_t video_index = 0;
+  auto next_video_ns = start_ns;
+  unique_lock<mutex> lock(mutex_);
+  while (running_) {
+    auto next_audio_ns = start_ns + static_cast<int64_t>(audio_index) * audio_period_ns;
+    auto due_ns = min(next_audio_ns, next_video_ns);
+    wake_.wait_for(lock, chrono::nanoseconds(max<int64_t>(0, due_ns - SteadyNowNs())),
+                   [this]() { return !running_; });
+    if (!running_) break;
+    lock.unlock();
+    auto now_ns = SteadyNowNs();
+    if (next_audio_ns <= now_ns) {
+      // audio stays continuous. a late composer catches up.
+      if (next_audio_ns + audio_period_ns <= now_ns) late_.fetch_add(1, memory_order_relaxed);
+      MixAudio(static_cast<int64_t>(audio_index++) * kAudioFrameMs * 1000);
+    }
+    if (next_video_ns <= now_ns) {
+      ComposeVideo(static_cast<int64_t>(video_index++) * 1000000 / layout_.fps);
+      next_video_ns += video_period_ns;
+      if (next_video_ns <= SteadyNowNs()) {
+        // pictures are skipped instead
+        late_.fetch_add(1, memory_order_relaxed);
+        next_video_ns = SteadyNowNs() + video_period_ns;
+      }
+    }
+    lock.lock();
+  }
+}
+
+void CompositeMixer::MixAudio(int64_t timestamp_us) {
+  TraceSpan span("composite.mix");
+  fill(mix_.begin(), mix_.end(), 0);
+  Inputs(live_inputs_);
+  for (const auto& input : live_inputs_) input->MixAudio(mix_.data(), mix_.size());
+  live_inputs_.clear();
+  FrameMeta meta;
+  meta.timestamp_us = timestamp_us;
+  meta.size = static_cast<uint32_t>(mix_.size() * sizeof(int16_t));
+  meta.sample_rate = layout_.sample_rate;
+  meta.channels = layout_.channels;
+  if (audio_sink_) audio_sink_->OnAudioFrame(MakeAudioFrame(meta, reinterpret_cast<const uint8_t*>(mix_.data())));
+  audio_frames_.fetch_add(1, memory_order_relaxed);
+}
+
+void CompositeMixer::ComposeVideo(int64_t timestamp_us) {
+  TraceSpan span("composite.compose");
+  auto begin_ns = SteadyNowNs();
+  const uint32_t width = layout_.width;
+  const uint32_t height = layout_.height;
+  auto y_plane = canvas_.data();
+  auto u_plane = y_plane + width * height;
+  memset(y_plane, 16, width * height);  // black
+  memset(u_plane, 128, 2 * (width / 2) * (height / 2));
+
+  Inputs(live_inputs_);
+  for (const auto& input : live_inputs_) {
+    auto picture = input->LatestPicture();
+    if (picture.i420) pictures_.push_back(move(picture));
+  }
+  live_inputs_.clear();
+
+  // grid layout, each picture fit into its tile with its aspect ratio kept
+  if (!pictures_.empty()) {
+    auto cols = static_cast<uint32_t>(ceil(sqrt(pictures_.size())));
+    auto rows = static_cast<uint32_t>((pictures_.size() + cols - 1) / cols);
+    auto tile_w = (width / cols) & ~1u;
+    auto tile_h = (height / rows) & ~1u;
+    for (size_t i = 0; i < pictures_.size(); ++i) {
+      const auto& picture = pictures_[i];
+      auto scale = min(static_cast<double>(tile_w) / picture.width, static_cast<double>(tile_h) / picture.height);
+      auto dst_w = max(2u, static_cast<uint32_t>(picture.width * scale) & ~1u);
+      auto dst_h = max(2u, static_cast<uint32_t>(picture.height * scale) & ~1u);
+      auto x = static_cast<uint32_t>((i % cols) * tile_w + ((tile_w - dst_w) / 2 & ~1u));
+      auto y = static_cast<uint32_t>((i / cols) * tile_h + ((tile_h - dst_h) / 2 & ~1u));
+      tiles_.push_back({ &picture, x, y, dst_w, dst_h });
+    }
+  }
+  RunTiles();
+  tiles_.clear();
+  pictures_.clear();  // buffers back to the pools of the inputs
+
+  FrameMeta meta;
+  meta.timestamp_us = timestamp_us;
+  meta.size = static_cast<uint32_t>(canvas_.size());
+  meta.width = layout_.width;
+  meta.height = layout_.height;
+  if (video_sink_) video_sink_->OnVideoFrame(MakeVideoFrame(meta, canvas_.data()));
+  video_frames_.fetch_add(1, memory_order_relaxed);
+  compose_ns_.fetch_add(SteadyNowNs() - begin_ns, memory_order_relaxed);
+}
+
+void CompositeMixer::ScaleTile(const Tile& tile) {
+  const uint32_t width = layout_.width;
+  const uint32_t height = layout_.height;
+  auto y_plane = canvas_.data();
+  auto u_plane = y_plane + width * height;
+  auto v_plane = u_plane + (width / 2) * (height / 2);
+  const uint32_t src_w = tile.picture->width;
+  const uint32_t src_h = tile.picture->height;
+  auto src_y = tile.picture->i420.data();
+  auto src_u = src_y + src_w * src_h;
+  auto src_v = src_u + ((src_w + 1) / 2) * ((src_h + 1) / 2);
+  libyuv::I420Scale(src_y, src_w, src_u, (src_w + 1) / 2, src_v, (src_w + 1) / 2, src_w, src_h,
+                    y_plane + tile.y * width + tile.x, width,
+                    u_plane + (tile.y / 2) * (width / 2) + tile.x / 2, width / 2,
+                    v_plane + (tile.y / 2) * (width / 2) + tile.x / 2, width / 2,
+                    tile.width, tile.height, libyuv::kFilterBilinear);
+}
+
+void CompositeMixer::RunTiles() {
+  if (tiles_.empty()) return;
+  unique_lock<mutex> lock(jobs_mutex_);
+  num_jobs_ = tiles_.size();
+  next_job_ = 0;
+  pending_jobs_ = tiles_.size();
+  jobs_wake_.notify_all();
+  while (next_job_ < num_jobs_) {
+    const auto& tile = tiles_[next_job_++];
+    lock.unlock();
+    ScaleTile(tile);
+    lock.lock();
+    --pending_jobs_;
+  }
+  jobs_done_.wait(lock, [this]() { return 0 == pending_jobs_; });
+  num_jobs_ = 0;
+}
+
+void CompositeMixer::Work() {
+  unique_lock<mutex> lock(jobs_mutex_);
+  while (true) {
+    jobs_wake_.wait(lock, [this]() { return workers_stopping_ || next_job_ < num_jobs_; });
+    if (workers_stopping_) return;
+    const auto& tile = tiles_[next_job_++];
+    lock.unlock();
+    ScaleTile(tile);
+    lock.lock();
+    if (0 == --pending_jobs_) jobs_done_.notify_all();
+  }
+}
+
+CompositeMixer::Stats CompositeMixer::stats() const {
+  Stats stats;
+  vector<shared_ptr<CompositeInput>> inputs;
+  Inputs(inputs);
+  for (const auto& input : inputs) {
+    ++stats.inputs;
+    stats.dropped += input->dropped_.load(memory_order_relaxed);
+  }
+  stats.audio_frames = audio_frames_.load(memory_order_relaxed);
+  stats.video_frames = video_frames_.load(memory_order_relaxed);
+  stats.late = late_.load(memory_order_relaxed);
+  stats.compose_ms = (0 < stats.video_frames)
+                   ? compose_ns_.load(memory_order_relaxed) / 1e6 / stats.video_frames : 0;
+  return stats;
+}
+
+}  // namespace ew
@@ -0,0 +1,177 @@
+/// @copyright © 2017 Airtime Media.  All rights reserved.
+
+#ifndef COMPOSITE_MIXER_H_
+#define COMPOSITE_MIXER_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "eastwood/sink/audio_sink.h"
+#include "eastwood/sink/video_sink.h"
+
+#include "frame_pool.h"
+#include "sink_tap.h"
+
+
+namespace ew {
+
+/// Output format of a composite
+struct CompositeLayout {
+  uint16_t width = 1280;       // even
+  uint16_t height = 720;       // even
+  uint32_t fps = 30;
+  uint32_t sample_rate = 48000;
+  uint8_t channels = 2;
+};
+
+/**
+ * Frames of one subscriber feeding a composite. Written by its pipeline threads, read by the composer.
+ * Audio is queued (up to kMaxQueuedAudioMs) in a fixed ring. Only the latest video frame is kept,
+ * copied into a buffer of the subscriber's pool.
+ */
+class CompositeInput {
+ public:
+  void PushAudio(const at::AudioFrame& frame);
+  void PushVideo(const at::VideoFrame& frame);
+
+  /// Mixes up to @a count samples (all channels) into @a acc, saturating. @return samples mixed
+  size_t MixAudio(int16_t* acc, size_t count);
+
+  struct Picture {
+    FrameBuffer i420;
+    uint16_t width = 0;
+    uint16_t height = 0;
+  };
+  Picture LatestPicture() const;
+
+  static constexpr uint32_t kMaxQueuedAudioMs = 500;
+
+ private:
+  friend class CompositeMixer;
+  CompositeInput(uint32_t subscriber_id, const CompositeLayout& layout, std::shared_ptr<FramePool> pool);
+
+  const uint32_t subscriber_id_;
+  const CompositeLayout layout_;
+  const std::shared_ptr<FramePool> pool_;
+  mutable std::mutex mutex_;
+  std::vector<int16_t> pcm_;  // ring of kMaxQueuedAudioMs. guarded by mutex_
+  size_t pcm_begin_ = 0;      // guarded by mutex_
+  size_t pcm_size_ = 0;       // guarded by mutex_
+  Picture picture_;          // guarded by mutex_
+  std::atomic<uint64_t> dropped_{0};     // audio frames not matching the layout, or over the queue limit
+  std::atomic<uint64_t> audio_frames_{0};
+  std::atomic<uint64_t> video_frames_{0};
+};
+
+/**
+ * Mixes the audio and tiles the video of several subscribers into one output.
+ * A composer thread makes one audio frame every kAudioFrameMs and one picture per 1/fps,
+ * scaling the tiles on a worker pool, and hands them to the output sinks. So N inputs cost one encode.
+ */
+class CompositeMixer {
+ public:
+  explicit CompositeMixer(const CompositeLayout& layout);
+  ~CompositeMixer();
+
+  /// Registers an input, copying pictures into buffers of @a pool. It leaves the composite when released.
+  std::shared_ptr<CompositeInput> AddInput(uint32_t subscriber_id, std::shared_ptr<FramePool> pool);
+
+  /// Starts composing into the sinks. @return false if already started
+  bool Start(AudioSinkPtr audio, VideoSinkPtr video);
+  /// Stops composing and releases the sinks (i.e. closes the output)
+  void Stop();
+
+  const CompositeLayout& layout() const { return layout_; }
+
+  struct Stats {
+    uint32_t inputs = 0;
+    uint64_t audio_frames = 0;  // composed
+    uint64_t video_frames = 0;  // composed
+    uint64_t late = 0;          // ticks composed after the next was due
+    uint64_t dropped = 0;       // input audio frames dropped
+    double compose_ms = 0;      // average picture composition time
+  };
+  Stats stats() const;
+
+  static constexpr int64_t kAudioFrameMs = 20;
+
+ private:
+  void Run();
+  void MixAudio(int64_t timestamp_us);
+  void ComposeVideo(int64_t timestamp_us);
+  /// Fills @a inputs with the live inputs, reusing its capacity
+  void Inputs(std::vector<std::shared_ptr<CompositeInput>>& inputs) const;
+
+  /// A picture fit into its place on the canvas
+  struct Tile {
+    const CompositeInput::Picture* picture;
+    uint32_t x, y, width, height;
+  };
+  void ScaleTile(const Tile& tile);
+  /// Scales tiles_ on the workers and the calling thread, and returns once all are done
+  void RunTiles();
+  void Work();
+
+  const CompositeLayout layout_;
+
+  mutable std::mutex inputs_mutex_;
+  std::vector<std::weak_ptr<CompositeInput>> inputs_;  // guarded by inputs_mutex_
+
+  AudioSinkPtr audio_sink_;  // touched by the composer thread while running
+  VideoSinkPtr video_sink_;
+  std::vector<int16_t> mix_;
+  std::vector<uint8_t> canvas_;
+  // reused by the composer thread from tick to tick, so that it does not allocate once warm
+  std::vector<std::shared_ptr<CompositeInput>> live_inputs_;
+  std::vector<CompositeInput::Picture> pictures_;
+  std::vector<Tile> tiles_;
+
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  bool running_ = false;  // guarded by mutex_
+  std::thread thread_;
+
+  // tile workers
+  std::mutex jobs_mutex_;
+  std::condition_variable jobs_wake_;
+  std::condition_variable jobs_done_;
+  size_t num_jobs_ = 0;      // tiles_ being scaled. guarded by jobs_mutex_
+  size_t next_job_ = 0;      // guarded by jobs_mutex_
+  size_t pending_jobs_ = 0;  // guarded by jobs_mutex_
+  bool workers_stopping_ = false;  // guarded by jobs_mutex_
+  std::vector<std::thread> workers_;
+
+  std::atomic<uint64_t> audio_frames_{0};
+  std::atomic<uint64_t> video_frames_{0};
+  std::atomic<uint64_t> late_{0};
+  std::atomic<int64_t> compose_ns_{0};
+};
+
+/// Audio sink of a subscriber feeding a composite
+class CompositeAudioSink : public at::eastwood::AudioSink {
+ public:
+  explicit CompositeAudioSink(std::shared_ptr<CompositeInput> input) : input_(std::move(input)) {}
+  void OnAudioFrame(const at::AudioFrame& frame) override { input_->PushAudio(frame); }
+
+ private:
+  std::shared_ptr<CompositeInput> input_;
+};
+
+/// Video counterpart of CompositeAudioSink
+class CompositeVideoSink : public at::eastwood::VideoSink {
+ public:
+  explicit CompositeVideoSink(std::shared_ptr<CompositeInput> input) : input_(std::move(input)) {}
+  void OnVideoFrame(const at::VideoFrame& frame) override { input_->PushVideo(frame); }
+
+ private:
+  std::shared_ptr<CompositeInput> input_;
+};
+
+}  // namespace ew
+
+#endif  // COMPOSITE_MIXER_H_
@@ -1,19 +1,40 @@
 /// @copyright © 2017 Airtime Media.  All rights reserved.
 
 #include <algorithm>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
 #include <utility>
+#include <vector>
 #include <boost/property_tree/ptree.hpp>
 #include <boost/property_tree/ini_parser.hpp>
 
 #include "eastwood.h"
 #include "subscriber.h"
+#include "composite.h"
+#include "frame_trace.h"
+#include "loop_stats.h"
+#include "pipeline_trace.h"
+#include "encoder_budget.h"
+#include "alloc_counter.h"
 #include "addon_util/addon_util.h"
 
 namespace ew {
 
+using v8::Array;
+using v8::Context;
 using v8::Function;
 using v8::FunctionCallbackInfo;
+using v8::FunctionTemplate;
+using v8::HandleScope;
+using v8::Exception;
+using v8::Isolate;
+using v8::Local;
+using v8::Object;
 using v8::Persistent;
+using v8::Promise;
+using v8::Value;
 
 using namespace std;
 using namespace string_literals;
@@ -21,8 +42,8 @@ using namespace chrono_literals;
 
 using namespace at::node_addon;
 
-Persistent<Function> EastWood::constructor;
-at::Ptr<at::EventLoop> EastWood::event_loop;
+// logging is process-wide, shared by all isolates
+static once_flag logging_initialized;
 
 
 // --------------------------------------------
@@ -57,16 +78,15 @@ static void SetLogLevel(EastWood::LogLevel level) {
 }
 
 
-EastWood::EastWood(LogLevel level, bool log_to_console, bool log_to_syslog, const string& log_props_file)
+EastWood::EastWood(AddonData* data, LogLevel level,
+                   bool log_to_console, bool log_to_syslog, const string& log_props_file)
   : log_(at::log::keywords::channel = "addon.EastWood") {
-  if (!event_loop) {
-    event_loop = at::EventLoop::New(max<uint32_t>(1, at::EventLoopImpl::GetDefaultNumThreads() - 2));
-    // this allocates (# of cores - 2) threads
-  
+  data->AcquireEventLoop();
+  call_once(logging_initialized, [&]() {
     boost::property_tree::ptree log_props = LoadLogPropertiesFiles(log_props_file);
     at::InitLogging(log_to_console, log_to_syslog, log_props);
     SetLogLevel(level);
-  }
+  });
 }
 
 EastWood::~EastWood() {
@@ -82,6 +102,9 @@ string EastWood::SinkString(SinkType sink) {
       return "none";
     case VideoSink_File:
       return "file";
+    case AudioSink_Stream:
+    case VideoSink_Stream:
+      return "stream";
     case Sink_Undefined:
       return "undefined";
     default:
@@ -89,9 +112,11 @@ string EastWood::SinkString(SinkType sink) {
   }
 }
 
-void EastWood::Init(Local<Object> exports) {
-  InitClass(exports, "EastWood", New, constructor,
+void EastWood::Init(Local<Object> exports, AddonData* data) {
+  InitClass(exports, "EastWood", New, data->eastwood_constructor,
     AT_ADDON_PROTOTYPE_METHOD(createSubscriber),
+    AT_ADDON_PROTOTYPE_METHOD(createConfigTemplate),
+    AT_ADDON_PROTOTYPE_METHOD(createComposite),
 
     AT_ADDON_CLASS_CONSTANT(LogLevel_Fatal),
     AT_ADDON_CLASS_CONSTANT(LogLevel_Error),
@@ -102,10 +127,42 @@ void EastWood::Init(Local<Object> exports) {
     AT_ADDON_CLASS_CONSTANT(AudioSink_None),
     AT_ADDON_CLASS_CONSTANT(AudioSink_File),
     AT_ADDON_CLASS_CONSTANT(VideoSink_None),
-    AT_ADDON_CLASS_CONSTANT(VideoSink_File)
+    AT_ADDON_CLASS_CONSTANT(VideoSink_File),
+    AT_ADDON_CLASS_CONSTANT(AudioSink_Stream),
+    AT_ADDON_CLASS_CONSTANT(VideoSink_Stream)
   );
 
-  Subscriber::Init(exports);
+  auto isolate = exports->GetIsolate();
+  auto context = isolate->GetCurrentContext();
+  data->eastwood_constructor.Get(isolate)->Set(context, ToLocalString("stopAll"),
+      FunctionTemplate::New(isolate, stopAll)->GetFunction(context).ToLocalChecked()).FromJust();
+  data->eastwood_constructor.Get(isolate)->Set(context, ToLocalString("dumpFrameTrace"),
+      FunctionTemplate::New(isolate, dumpFrameTrace)->GetFunction(context).ToLocalChecked()).FromJust();
+  data->eastwood_constructor.Get(isolate)->Set(context, ToLocalString("getLoopStats"),
+      FunctionTemplate::New(isolate, getLoopStats)->GetFunction(context).ToLocalChecked()).FromJust();
+  data->eastwood_constructor.Get(isolate)->Set(context, ToLocalString("setMemoryLimit"),
+      FunctionTemplate::New(isolate, setMemoryLimit)->GetFunction(context).ToLocalChecked()).FromJust();
+  data->eastwood_constructor.Get(isolate)->Set(context, ToLocalString("getMemoryUsage"),
+      FunctionTemplate::New(isolate, getMemoryUsage)->GetFunction(context).ToLocalChecked()).FromJust();
+  data->eastwood_constructor.Get(isolate)->Set(context, ToLocalString("setAdmission"),
+      FunctionTemplate::New(isolate, setAdmission)->GetFunction(context).ToLocalChecked()).FromJust();
+  data->eastwood_constructor.Get(isolate)->Set(context, ToLocalString("getCapacity"),
+      FunctionTemplate::New(isolate, getCapacity)->GetFunction(context).ToLocalChecked()).FromJust();
+  data->eastwood_constructor.Get(isolate)->Set(context, ToLocalString("setLoadShedding"),
+      FunctionTemplate::New(isolate, setLoadShedding)->GetFunction(context).ToLocalChecked()).FromJust();
+  data->eastwood_constructor.Get(isolate)->Set(context, ToLocalString("setEncoderBudget"),
+      FunctionTemplate::New(isolate, setEncoderBudget)->GetFunction(context).ToLocalChecked()).FromJust();
+  data->eastwood_constructor.Get(isolate)->Set(context, ToLocalString("getEncoderBudget"),
+      FunctionTemplate::New(isolate, getEncoderBudget)->GetFunction(context).ToLocalChecked()).FromJust();
+  data->eastwood_constructor.Get(isolate)->Set(context, ToLocalString("listSubscribers"),
+      FunctionTemplate::New(isolate, listSubscribers)->GetFunction(context).ToLocalChecked()).FromJust();
+  data->eastwood_constructor.Get(isolate)->Set(context, ToLocalString("startTrace"),
+      FunctionTemplate::New(isolate, startTrace)->GetFunction(context).ToLocalChecked()).FromJust();
+  data->eastwood_constructor.Get(isolate)->Set(context, ToLocalString("stopTrace"),
+      FunctionTemplate::New(isolate, stopTrace)->GetFunction(context).ToLocalChecked()).FromJust();
+
+  Subscriber::Init(exports, data);
+  Composite::Init(exports, data);
 }
 
 void EastWood::New(const FunctionCallbackInfo<Value>& args) {
@@ -127,13 +184,662 @@ void EastWood::New(const FunctionCallbackInfo<Value>& args) {
   auto log_to_console = ToBool(args[1]);
   auto log_to_syslog = ToBool(args[2]);
   auto log_props_file = ((3 < args.Length()) ? ToString(args[3]) : ""s);
-  NewCppInstance<EastWood>(args, new EastWood(log_level, log_to_console, log_to_syslog, log_props_file));
+  auto data = AddonData::Get(args.GetIsolate());
+  NewCppInstance<EastWood>(args, new EastWood(data, log_level, log_to_console, log_to_syslog, log_props_file));
 }
 
 void EastWood::createSubscriber(const FunctionCallbackInfo<Value>& args) {
-  if (!CheckArgs("createSubscriber", args, 0, 0)) return;
+  auto isolate = args.GetIsolate();
+  if (!CheckArgs("createSubscriber", args, 0, 2,
+      [isolate](Local<Value> arg0, string& err_msg) {
+        if (!Subscriber::SubscriberConfig::IsInstance(isolate, arg0)) return false;
+        auto config = Unwrap<Subscriber::SubscriberConfig>(Local<Object>::Cast(arg0));
+        if (!config->frozen_) {
+          err_msg = "Need config template made by createConfigTemplate()";
+          return false;
+        }
+        return true;
+      },
+      [](Local<Value> arg1, string& err_msg) { return arg1->IsObject(); })) return;
+
+  auto subscriber = Subscriber::NewInstance(args);
+  if (0 < args.Length()) {
+    auto tmpl = Unwrap<Subscriber::SubscriberConfig>(Local<Object>::Cast(args[0]));
+    auto config = Unwrap<Subscriber::SubscriberConfig>(
+                    Unwrap<Subscriber>(subscriber)->config_.Get(isolate));
+    config->CopyFrom(*tmpl);
+    auto err_msg = ""s;
+    if (1 < args.Length()
+     && !config->ApplyOverrides(isolate->GetCurrentContext(), Local<Object>::Cast(args[1]), err_msg)) {
+      ThrowException(args, Exception::Error, err_msg);
+      return;
+    }
+  }
+  args.GetReturnValue().Set(subscriber);
+}
+
+void EastWood::createConfigTemplate(const FunctionCallbackInfo<Value>& args) {
+  auto isolate = args.GetIsolate();
+  if (!CheckArgs("createConfigTemplate", args, 1, 1,
+      [isolate](Local<Value> arg0, string& err_msg) {
+        return Subscriber::SubscriberConfig::IsInstance(isolate, arg0);
+      })) return;
+
+  auto source = Unwrap<Subscriber::SubscriberConfig>(Local<Object>::Cast(args[0]));
+  if (!source->VerifyConfigIntegrity(args, true)) {
+    // thrown
+    return;
+  }
+  auto tmpl_obj = Subscriber::SubscriberConfig::NewInstance(args);
+  auto tmpl = Unwrap<Subscriber::SubscriberConfig>(tmpl_obj);
+  tmpl->CopyFrom(*source);
+  tmpl->frozen_ = true;
+  args.GetReturnValue().Set(tmpl_obj);
+}
+
+void EastWood::createComposite(const FunctionCallbackInfo<Value>& args) {
+  auto isolate = args.GetIsolate();
+  auto context = isolate->GetCurrentContext();
+  const auto& cache = *AddonData::Get(isolate)->v8_cache;
+  const auto& k = cache.keys;
+  CompositeLayout layout;
+  if (!CheckArgs("createComposite", args, 3, 3,
+      [&](Local<Value> arg0, string& err_msg) {
+        if (!arg0->IsObject()) return false;
+        auto options = arg0->ToObject(context).ToLocalChecked();
+        // each is optional. @return false if given and not a positive integer up to limit
+        auto get = [&](const v8::Eternal<v8::String>& key, const char* name, uint32_t limit, uint32_t& out) {
+          auto val = options->Get(context, cache.Key(key)).ToLocalChecked();
+          if (val->IsUndefined()) return true;
+          if (!val->IsUint32() || 0 == ToUint32(val) || limit < ToUint32(val)) {
+            err_msg = name + " must be positive integer up to "s + to_string(limit);
+            return false;
+          }
+          out = ToUint32(val);
+          return true;
+        };
+        uint32_t width = layout.width;
+        uint32_t height = layout.height;
+        uint32_t channels = layout.channels;
+        if (!get(k.width, "width", 4096, width) || !get(k.height, "height", 4096, height)
+         || !get(k.fps, "fps", 60, layout.fps) || !get(k.sampleRate, "sampleRate", 192000, layout.sample_rate)
+         || !get(k.channels, "channels", 2, channels)) {
+          return false;
+        }
+        if (0 != width % 2 || 0 != height % 2) {
+          err_msg = "width and height must be even";
+          return false;
+        }
+        if (0 != layout.sample_rate % (1000 / CompositeMixer::kAudioFrameMs)) {
+          err_msg = "sampleRate must be a multiple of " + to_string(1000 / CompositeMixer::kAudioFrameMs);
+          return false;
+        }
+        layout.width = static_cast<uint16_t>(width);
+        layout.height = static_cast<uint16_t>(height);
+        layout.channels = static_cast<uint8_t>(channels);
+        return true;
+      },
+      [](Local<Value> arg1, string& err_msg) {
+        if (!arg1->IsString()) return false;
+        if (ToString(arg1).empty()) {
+          err_msg = "output cannot be empty";
+          return false;
+        }
+        return true;
+      },
+      [](Local<Value> arg2, string& err_msg) { return arg2->IsString(); })) return;
+
+  auto composite_obj = Composite::NewInstance(args);
+  auto composite = Unwrap<Composite>(composite_obj);
+  composite->mixer_ = make_shared<CompositeMixer>(layout);
+  composite->output_ = ToString(args[1]);
+  composite->options_ = Subscriber::SubscriberConfig::ParseFFmpegParams(ToString(args[2]));
+  args.GetReturnValue().Set(composite_obj);
+}
+
+namespace {
+
+/// State of one stopAll() call. Created and finished on JS thread.
+struct StopAllTask {
+  struct Entry {
+    Subscriber* subscriber = nullptr;
+    Persistent<Object> handle;  // keeps subscriber alive until finished
+    atomic<bool> done{false};
+  };
+
+  AddonData* data = nullptr;
+  Isolate* isolate = nullptr;
+  Persistent<Context> context;
+  Persistent<Promise::Resolver> resolver;
+  vector<unique_ptr<Entry>> entries;
+  bool join_event_loop = true;
+
+  mutex finish_mutex;
+  bool finished = false;  // guarded by finish_mutex. no more async wake-up once set.
+  uv_async_t done_async;  // wakes JS thread up on each stop completion
+  uv_timer_t deadline_timer;
+  int open_handles = 0;
+  shared_ptr<StopAllTask> self_ref;  // released when both handles are closed
+
+  void OnStopped(Entry* entry) {
+    entry->done = true;
+    lock_guard<mutex> lock(finish_mutex);
+    if (!finished) uv_async_send(&done_async);
+  }
+
+  bool AllDone() const {
+    return all_of(entries.begin(), entries.end(), [](const unique_ptr<Entry>& e) { return e->done.load(); });
+  }
+
+  void Finish(bool deadline_exceeded);
+};
+
+void StopAllTask::Finish(bool deadline_exceeded) {
+  {
+    lock_guard<mutex> lock(finish_mutex);
+    if (finished) return;
+    finished = true;
+  }
+  uv_timer_stop(&deadline_timer);
+  auto on_close = [](uv_handle_t* handle) {
+    auto task = static_cast<StopAllTask*>(handle->data);
+    if (0 == --task->open_handles) task->self_ref.reset();
+  };
+  uv_close(reinterpret_cast<uv_handle_t*>(&done_async), on_close);
+  uv_close(reinterpret_cast<uv_handle_t*>(&deadline_timer), on_close);
+
+  HandleScope scope(isolate);
+  auto ctx = context.Get(isolate);
+  Context::Scope context_scope(ctx);
+  // runs microtasks (i.e. promise reactions) when leaving
+  node::CallbackScope callback_scope(isolate, Object::New(isolate), {0, 0});
+
+  const auto& cache = *data->v8_cache;
+  const auto& k = cache.keys;
+  auto list = Array::New(isolate, static_cast<int>(entries.size()));
+  uint32_t i = 0;
+  for (auto& entry : entries) {
+    auto forced = !entry->done.load();
+    if (forced) entry->subscriber->ForceClose();
+    auto item = cache.NewObject(ctx, V8Cache::kShapeStopTiming);
+    cache.Put(ctx, item, k.userId, ToLocalString(entry->subscriber->UserId()));
+    cache.Put(ctx, item, k.stop_ms,
+              ToLocalNumber(forced ? -1.0 : static_cast<double>(entry->subscriber->stop_latency_ms_)));
+    cache.Put(ctx, item, k.forced, ToLocalBoolean(forced));
+    list->Set(ctx, i++, item).FromJust();
+    entry->handle.Reset();
+  }
+
+  if (join_event_loop) {
+    data->ReleaseEventLoop();
+  }
+
+  auto result = cache.NewObject(ctx, V8Cache::kShapeStopAllResult);
+  cache.Put(ctx, result, k.deadlineExceeded, ToLocalBoolean(deadline_exceeded));
+  cache.Put(ctx, result, k.subscribers, list);
+  resolver.Get(isolate)->Resolve(ctx, result).FromJust();
+  resolver.Reset();
+  context.Reset();
+}
+
+/// Writes a trace file on the libuv thread pool. Created and finished on JS thread.
+struct WriteTraceWork {
+  uv_work_t req;
+  Isolate* isolate = nullptr;
+  Persistent<Context> context;
+  Persistent<Promise::Resolver> resolver;
+  string filename;
+  vector<TraceEvent> events;
+  uint64_t dropped = 0;
+  bool written = false;
+
+  static void Write(uv_work_t* req) {
+    auto work = static_cast<WriteTraceWork*>(req->data);
+    work->written = PipelineTrace::WriteChromeTrace(work->filename, work->events);
+  }
+
+  static void AfterWrite(uv_work_t* req, int status) {
+    unique_ptr<WriteTraceWork> work(static_cast<WriteTraceWork*>(req->data));
+    auto isolate = work->isolate;
+    HandleScope scope(isolate);
+    auto ctx = work->context.Get(isolate);
+    Context::Scope context_scope(ctx);
+    node::CallbackScope callback_scope(isolate, Object::New(isolate), {0, 0});
+
+    auto resolver = work->resolver.Get(isolate);
+    if (!work->written) {
+      resolver->Reject(ctx, Exception::Error(ToLocalString("Failed to write trace to " + work->filename))).FromJust();
+    } else {
+      const auto& cache = *AddonData::Get(isolate)->v8_cache;
+      const auto& k = cache.keys;
+      auto result = cache.NewObject(ctx, V8Cache::kShapeTraceResult);
+      cache.Put(ctx, result, k.filename, ToLocalString(work->filename));
+      cache.Put(ctx, result, k.events, ToLocalNumber(static_cast<double>(work->events.size())));
+      cache.Put(ctx, result, k.dropped, ToLocalNumber(static_cast<double>(work->dropped)));
+      resolver->Resolve(ctx, result).FromJust();
+    }
+    work->resolver.Reset();
+    work->context.Reset();
+  }
+};
+
+}  // anonymous namespace
+
+void EastWood::setMemoryLimit(const FunctionCallbackInfo<Value>& args) {
+  if (!CheckArgs("setMemoryLimit", args, 1, 1,
+      [](Local<Value> arg0, string& err_msg) { return arg0->IsUint32(); })) return;
+  MemoryWatch::SetProcessLimit(int64_t(ToUint32(args[0])) << 20);
+}
+
+void EastWood::getMemoryUsage(const FunctionCallbackInfo<Value>& args) {
+  if (!CheckArgs("getMemoryUsage", args, 0, 0)) return;
+
+  auto isolate = args.GetIsolate();
+  auto context = isolate->GetCurrentContext();
+  auto data = AddonData::Get(isolate);
+  const auto& cache = *data->v8_cache;
+  const auto& k = cache.keys;
+  int64_t estimated = 0;
+  for (auto subscriber : data->subscribers) {
+    estimated += subscriber->memory_bytes_;
+  }
+  auto result = cache.NewObject(context, V8Cache::kShapeMemoryUsage);
+  cache.Put(context, result, k.rss_bytes, ToLocalNumber(static_cast<double>(MemoryWatch::ReadRssBytes())));
+  cache.Put(context, result, k.estimated_bytes, ToLocalNumber(static_cast<double>(estimated)));
+  cache.Put(context, result, k.limit_bytes, ToLocalNumber(static_cast<double>(MemoryWatch::ProcessLimit())));
+  args.GetReturnValue().Set(result);
+}
+
+void EastWood::setAdmission(const FunctionCallbackInfo<Value>& args) {
+  auto isolate = args.GetIsolate();
+  auto context = isolate->GetCurrentContext();
+  const auto& cache = *AddonData::Get(isolate)->v8_cache;
+  AdmissionPolicy policy;
+  if (!CheckArgs("setAdmission", args, 1, 1,
+      [&](Local<Value> arg0, string& err_msg) {
+        if (!arg0->IsObject()) return false;
+        auto options = arg0->ToObject(context).ToLocalChecked();
+        auto cpu = options->Get(context, cache.Key(cache.keys.cpuHeadroom)).ToLocalChecked();
+        if (!cpu->IsUndefined()) {
+          if (!cpu->IsNumber() || ToDouble(cpu) < 0 || 1 < ToDouble(cpu)) {
+            err_msg = "cpuHeadroom must be between 0 and 1";
+            return false;
+          }
+          policy.cpu_headroom = ToDouble(cpu);
+        }
+        auto memory = options->Get(context, cache.Key(cache.keys.memoryHeadroom_mb)).ToLocalChecked();
+        if (!memory->IsUndefined()) {
+          if (!memory->IsUint32()) {
+            err_msg = "memoryHeadroom_mb must be zero or positive integer";
+            return false;
+          }
+          policy.memory_headroom_mb = ToUint32(memory);
+        }
+        auto queue_wait = options->Get(context, cache.Key(cache.keys.maxQueueWait_ms)).ToLocalChecked();
+        if (!queue_wait->IsUndefined()) {
+          if (!queue_wait->IsUint32()) {
+            err_msg = "maxQueueWait_ms must be zero or positive integer";
+            return false;
+          }
+          policy.max_queue_wait_ms = ToUint32(queue_wait);
+        }
+        return true;
+      })) return;
+  CapacityModel::SetPolicy(policy);
+}
+
+void EastWood::setLoadShedding(const FunctionCallbackInfo<Value>& args) {
+  auto isolate = args.GetIsolate();
+  auto context = isolate->GetCurrentContext();
+  const auto& cache = *AddonData::Get(isolate)->v8_cache;
+  LoadSheddingPolicy policy;
+  if (!CheckArgs("setLoadShedding", args, 1, 1,
+      [&](Local<Value> arg0, string& err_msg) {
+        if (!arg0->IsObject()) return false;
+        auto options = arg0->ToObject(context).ToLocalChecked();
+        auto queue_wait = options->Get(context, cache.Key(cache.keys.queueWait_ms)).ToLocalChecked();
+        if (!queue_wait->IsUndefined()) {
+          if (!queue_wait->IsUint32()) {
+            err_msg = "queueWait_ms must be zero or positive integer";
+            return false;
+          }
+          policy.queue_wait_ms = ToUint32(queue_wait);
+        }
+        auto cpu = options->Get(context, cache.Key(cache.keys.cpuUsed)).ToLocalChecked();
+        if (!cpu->IsUndefined()) {
+          if (!cpu->IsNumber() || ToDouble(cpu) < 0 || 1 < ToDouble(cpu)) {
+            err_msg = "cpuUsed must be between 0 and 1";
+            return false;
+          }
+          policy.cpu_used = ToDouble(cpu);
+        }
+        return true;
+      })) return;
+  CapacityModel::SetShedding(policy);
+}
+
+void EastWood::getCapacity(const FunctionCallbackInfo<Value>& args) {
+  if (!CheckArgs("getCapacity", args, 0, 0)) return;
+
+  auto isolate = args.GetIsolate();
+  auto context = isolate->GetCurrentContext();
+  auto data = AddonData::Get(isolate);
+  const auto& cache = *data->v8_cache;
+  const auto& k = cache.keys;
+  const auto& model = *data->capacity;
+
+  const v8::Eternal<v8::String>* class_keys[kNumSinkClasses] = { &k.none, &k.file, &k.ffmpegRemux, &k.ffmpegTranscode,
+                                                                  &k.plugin };
+  auto per_class = [&](function<double(SinkClass)> value) {
+    auto obj = cache.NewObject(context, V8Cache::kShapeSinkClasses);
+    for (auto c = 0; c < kNumSinkClasses; ++c) {
+      cache.Put(context, obj, *class_keys[c], ToLocalNumber(value(static_cast<SinkClass>(c))));
+    }
+    return obj;
+  };
+
+  auto result = cache.NewObject(context, V8Cache::kShapeCapacity);
+  cache.Put(context, result, k.cpus, ToLocalInteger(model.cpus()));
+  cache.Put(context, result, k.cpuUsed, ToLocalNumber(model.cpu_used()));
+  cache.Put(context, result, k.subscribers, per_class([&model](SinkClass c) { return model.subscribers(c); }));
+  cache.Put(context, result, k.cpuPerSubscriber_ms, per_class([&model](SinkClass c) { return model.cpu_ms(c); }));
+  cache.Put(context, result, k.admissible, per_class([&model](SinkClass c) { return model.Admissible(c); }));
+
+  auto loop = cache.NewObject(context, V8Cache::kShapeCapacityLoop);
+  cache.Put(context, loop, k.queueWaitP99_ms, ToLocalNumber(model.queue_wait_p99_ms()));
+  cache.Put(context, loop, k.pendingProbes,
+            ToLocalNumber(static_cast<double>(LoopStats::Instance().PendingProbes())));
+  cache.Put(context, result, k.loop, loop);
+
+  auto memory = cache.NewObject(context, V8Cache::kShapeCapacityMemory);
+  cache.Put(context, memory, k.rss_bytes, ToLocalNumber(static_cast<double>(MemoryWatch::RssBytes())));
+  cache.Put(context, memory, k.limit_bytes, ToLocalNumber(static_cast<double>(MemoryWatch::ProcessLimit())));
+  cache.Put(context, memory, k.perSubscriber_bytes,
+            ToLocalNumber(static_cast<double>(model.memory_per_subscriber())));
+  cache.Put(context, result, k.memory, memory);
+
+  auto policy = CapacityModel::Policy();
+  auto admission = cache.NewObject(context, V8Cache::kShapeAdmission);
+  cache.Put(context, admission, k.cpuHeadroom, ToLocalNumber(policy.cpu_headroom));
+  cache.Put(context, admission, k.memoryHeadroom_mb, ToLocalInteger(policy.memory_headroom_mb));
+  cache.Put(context, admission, k.maxQueueWait_ms, ToLocalInteger(policy.max_queue_wait_ms));
+  cache.Put(context, result, k.admission, admission);
+
+  auto shedding_policy = CapacityModel::Shedding();
+  auto shedding = cache.NewObject(context, V8Cache::kShapeLoadShedding);
+  cache.Put(context, shedding, k.queueWait_ms, ToLocalInteger(shedding_policy.queue_wait_ms));
+  cache.Put(context, shedding, k.cpuUsed, ToLocalNumber(shedding_policy.cpu_used));
+  cache.Put(context, shedding, k.level, ToLocalInteger(model.shed_level()));
+  cache.Put(context, result, k.shedding, shedding);
+  args.GetReturnValue().Set(result);
+}
+
+void EastWood::setEncoderBudget(const FunctionCallbackInfo<Value>& args) {
+  auto isolate = args.GetIsolate();
+  auto context = isolate->GetCurrentContext();
+  const auto& cache = *AddonData::Get(isolate)->v8_cache;
+  auto threads = 0u;
+  auto adapt_preset = false;
+  if (!CheckArgs("setEncoderBudget", args, 1, 1,
+      [&](Local<Value> arg0, string& err_msg) {
+        if (!arg0->IsObject()) return false;
+        auto options = arg0->ToObject(context).ToLocalChecked();
+        auto threads_val = options->Get(context, cache.Key(cache.keys.threads)).ToLocalChecked();
+        if (!threads_val->IsUndefined()) {
+          if (!threads_val->IsUint32()) {
+            err_msg = "threads must be zero or positive integer";
+            return false;
+          }
+          threads = ToUint32(threads_val);
+        }
+        auto adapt_val = options->Get(context, cache.Key(cache.keys.adaptPreset)).ToLocalChecked();
+        if (!adapt_val->IsUndefined()) {
+          if (!adapt_val->IsBoolean()) {
+            err_msg = "adaptPreset must be boolean";
+            return false;
+          }
+          adapt_preset = ToBool(adapt_val);
+        }
+        return true;
+      })) return;
+  EncoderBudget::Instance().Configure(threads, adapt_preset);
+}
+
+void EastWood::getEncoderBudget(const FunctionCallbackInfo<Value>& args) {
+  if (!CheckArgs("getEncoderBudget", args, 0, 0)) return;
+
+  auto isolate = args.GetIsolate();
+  auto context = isolate->GetCurrentContext();
+  const auto& cache = *AddonData::Get(isolate)->v8_cache;
+  const auto& k = cache.keys;
+  const auto& budget = EncoderBudget::Instance();
+  auto result = cache.NewObject(context, V8Cache::kShapeEncoderBudget);
+  cache.Put(context, result, k.threads, ToLocalInteger(budget.Threads()));
+  cache.Put(context, result, k.adaptPreset, ToLocalBoolean(budget.AdaptPreset()));
+  cache.Put(context, result, k.encoders, ToLocalInteger(budget.Encoders()));
+  cache.Put(context, result, k.leasedThreads, ToLocalInteger(budget.LeasedThreads()));
+  cache.Put(context, result, k.perEncoder,
+            ToLocalInteger(budget.NextEncoderThreads(CapacityModel::PriorityWeight(kPriorityNormal))));
+  args.GetReturnValue().Set(result);
+}
+
+void EastWood::listSubscribers(const FunctionCallbackInfo<Value>& args) {
+  if (!CheckArgs("listSubscribers", args, 0, 0)) return;
+
+  auto isolate = args.GetIsolate();
+  auto context = isolate->GetCurrentContext();
+  auto data = AddonData::Get(isolate);
+  const auto& cache = *data->v8_cache;
+  const auto& k = cache.keys;
+  vector<const Subscriber*> subscribers(data->subscribers.begin(), data->subscribers.end());
+  sort(subscribers.begin(), subscribers.end(),
+       [](const Subscriber* a, const Subscriber* b) { return a->id_ < b->id_; });
+  auto list = Array::New(isolate, static_cast<int>(subscribers.size()));
+  uint32_t i = 0;
+  for (auto subscriber : subscribers) {
+    const auto& lifecycle = *subscriber->lifecycle_;
+    auto item = cache.NewObject(context, V8Cache::kShapeSubscriberState);
+    cache.Put(context, item, k.subscriber, ToLocalInteger(subscriber->id_));
+    cache.Put(context, item, k.userId, ToLocalString(subscriber->UserId()));
+    cache.Put(context, item, k.state, Subscriber::StateKey(cache, lifecycle.state()));
+    cache.Put(context, item, k.since_ms, ToLocalNumber(static_cast<double>(lifecycle.since_ms())));
+    list->Set(context, i++, item).FromJust();
+  }
+  args.GetReturnValue().Set(list);
+}
+
+void EastWood::startTrace(const FunctionCallbackInfo<Value>& args) {
+  if (!CheckArgs("startTrace", args, 0, 0)) return;
+  args.GetReturnValue().Set(ToLocalBoolean(PipelineTrace::Instance().Start()));
+}
+
+void EastWood::stopTrace(const FunctionCallbackInfo<Value>& args) {
+  if (!CheckArgs("stopTrace", args, 1, 1,
+      [](Local<Value> arg0, string& err_msg) { return arg0->IsString() && 0 < ToString(arg0).size(); })) return;
+
+  auto isolate = args.GetIsolate();
+  auto context = isolate->GetCurrentContext();
+  auto work = make_unique<WriteTraceWork>();
+  if (!PipelineTrace::Instance().Stop(work->events, work->dropped)) {
+    ThrowException(args, Exception::Error, "Tracing is not started");
+    return;
+  }
+  auto resolver = Promise::Resolver::New(context).ToLocalChecked();
+  args.GetReturnValue().Set(resolver->GetPromise());
+  work->isolate = isolate;
+  work->context.Reset(isolate, context);
+  work->resolver.Reset(isolate, resolver);
+  work->filename = ToString(args[0]);
+  work->req.data = work.get();
+  uv_queue_work(AddonData::Get(isolate)->uv_loop, &work->req, WriteTraceWork::Write, WriteTraceWork::AfterWrite);
+  work.release();  // deleted by AfterWrite
+}
+
+void EastWood::dumpFrameTrace(const FunctionCallbackInfo<Value>& args) {
+  if (!CheckArgs("dumpFrameTrace", args, 0, 1,
+      [](Local<Value> arg0, string& err_msg) { return arg0->IsNumber() && 0 < ToDouble(arg0); })) return;
+
+  auto isolate = args.GetIsolate();
+  auto context = isolate->GetCurrentContext();
+  const auto& cache = *AddonData::Get(isolate)->v8_cache;
+  const auto& k = cache.keys;
+  auto seconds = 1 == args.Length() ? ToDouble(args[0]) : double(kDefaultFrameTraceDumpSeconds);
+  auto records = FrameTrace::Instance().Dump(seconds);
+  auto result = Array::New(isolate, static_cast<int>(records.size()));
+  uint32_t i = 0;
+  for (const auto& record : records) {
+    auto item = cache.NewObject(context, V8Cache::kShapeFrameInfo);
+    cache.Put(context, item, k.time_ms, ToLocalNumber(record.time_ns / 1e6));
+    cache.Put(context, item, k.subscriber, ToLocalInteger(record.subscriber_id));
+    cache.Put(context, item, k.track, ToLocalString(TrackString(record.track)));
+    cache.Put(context, item, k.seq, ToLocalInteger(record.seq));
+    cache.Put(context, item, k.timestamp_us, ToLocalNumber(static_cast<double>(record.timestamp_us)));
+    cache.Put(context, item, k.size, ToLocalInteger(record.size));
+    cache.Put(context, item, k.width, ToLocalInteger(record.width));
+    cache.Put(context, item, k.height, ToLocalInteger(record.height));
+    result->Set(context, i++, item).FromJust();
+  }
+  args.GetReturnValue().Set(result);
+}
+
+void EastWood::getLoopStats(const FunctionCallbackInfo<Value>& args) {
+  if (!CheckArgs("getLoopStats", args, 0, 1,
+      [](Local<Value> arg0, string& err_msg) { return arg0->IsUint32(); })) return;
+
+  auto isolate = args.GetIsolate();
+  auto context = isolate->GetCurrentContext();
+  auto data = AddonData::Get(isolate);
+  const auto& cache = *data->v8_cache;
+  const auto& k = cache.keys;
+  auto max_sources = 1 == args.Length() ? ToUint32(args[0]) : uint32_t(kDefaultSlowestTaskSources);
+
+  auto histogram = [&cache, &k, isolate, context](const LatencyHistogram& histogram) {
+    auto snapshot = histogram.Take();
+    auto obj = cache.NewObject(context, V8Cache::kShapeHistogram);
+    cache.Put(context, obj, k.count, ToLocalNumber(static_cast<double>(snapshot.count)));
+    cache.Put(context, obj, k.p50_us, ToLocalNumber(static_cast<double>(snapshot.Percentile(0.5))));
+    cache.Put(context, obj, k.p99_us, ToLocalNumber(static_cast<double>(snapshot.Percentile(0.99))));
+    cache.Put(context, obj, k.max_us, ToLocalNumber(static_cast<double>(snapshot.max_us)));
+    auto buckets = Array::New(isolate, static_cast<int>(snapshot.buckets.size()));
+    for (uint32_t i = 0; i < snapshot.buckets.size(); ++i) {
+      buckets->Set(context, i, ToLocalNumber(static_cast<double>(snapshot.buckets[i]))).FromJust();
+    }
+    cache.Put(context, obj, k.buckets, buckets);
+    return obj;
+  };
+
+  auto& loop_stats = LoopStats::Instance();
+  auto thread_stats = loop_stats.Threads();
+  auto threads = Array::New(isolate, static_cast<int>(thread_stats.size()));
+  uint32_t i = 0;
+  for (const auto& stats : thread_stats) {
+    auto obj = cache.NewObject(context, V8Cache::kShapeLoopThread);
+    cache.Put(context, obj, k.thread, ToLocalInteger(stats->index));
+    cache.Put(context, obj, k.tasks, ToLocalNumber(static_cast<double>(stats->tasks.load(memory_order_relaxed))));
+    cache.Put(context, obj, k.queueWait, histogram(stats->queue_wait));
+    cache.Put(context, obj, k.run, histogram(stats->run));
+    cache.Put(context, obj, k.lag, histogram(stats->lag));
+    cache.Put(context, obj, k.allocations, ToLocalNumber(AllocCounter::Enabled()
+        ? static_cast<double>(stats->allocations.load(memory_order_relaxed)) : -1.0));
+    threads->Set(context, i++, obj).FromJust();
+  }
+
+  struct Source {
+    Subscriber* subscriber;
+    const TrackContext* track;
+    int64_t total_ns;
+  };
+  vector<Source> sources;
+  for (auto subscriber : data->subscribers) {
+    for (auto track : { subscriber->audio_track_.get(), subscriber->video_track_.get() }) {
+      auto calls = track->delivery.calls.load(memory_order_relaxed);
+      if (0 == calls) continue;
+      sources.push_back({ subscriber, track, track->delivery.total_ns.load(memory_order_relaxed) });
+    }
+  }
+  auto num_sources = min<size_t>(max_sources, sources.size());
+  partial_sort(sources.begin(), sources.begin() + num_sources, sources.end(),
+               [](const Source& a, const Source& b) { return a.total_ns > b.total_ns; });
+  auto slowest = Array::New(isolate, static_cast<int>(num_sources));
+  for (i = 0; i < num_sources; ++i) {
+    const auto& source = sources[i];
+    auto obj = cache.NewObject(context, V8Cache::kShapeTaskSource);
+    cache.Put(context, obj, k.subscriber, ToLocalInteger(source.track->subscriber_id));
+    cache.Put(context, obj, k.userId, ToLocalString(source.subscriber->UserId()));
+    cache.Put(context, obj, k.track, ToLocalString(TrackString(source.track->track)));
+    cache.Put(context, obj, k.sink, ToLocalString(source.track->sink));
+    cache.Put(context, obj, k.calls,
+              ToLocalNumber(static_cast<double>(source.track->delivery.calls.load(memory_order_relaxed))));
+    cache.Put(context, obj, k.total_ms, ToLocalNumber(source.total_ns / 1e6));
+    cache.Put(context, obj, k.max_ms, ToLocalNumber(source.track->delivery.max_ns.load(memory_order_relaxed) / 1e6));
+    slowest->Set(context, i, obj).FromJust();
+  }
 
-  args.GetReturnValue().Set(Subscriber::NewInstance(args));
+  auto result = cache.NewObject(context, V8Cache::kShapeLoopStats);
+  cache.Put(context, result, k.pendingProbes, ToLocalNumber(static_cast<double>(loop_stats.PendingProbes())));
+  cache.Put(context, result, k.threads, threads);
+  cache.Put(context, result, k.slowest, slowest);
+  args.GetReturnValue().Set(result);
+}
+
+void EastWood::stopAll(const FunctionCallbackInfo<Value>& args) {
+  if (!CheckArgs("stopAll", args, 0, 1,
+      [](Local<Value> arg0, string& err_msg) { return arg0->IsObject(); })) return;
+
+  auto isolate = args.GetIsolate();
+  auto context = isolate->GetCurrentContext();
+  const auto& cache = *AddonData::Get(isolate)->v8_cache;
+  auto deadline_ms = kDefaultStopAllDeadlineMs;
+  auto join_event_loop = true;
+  if (1 == args.Length()) {
+    auto options = args[0]->ToObject(context).ToLocalChecked();
+    auto deadline = options->Get(context, cache.Key(cache.keys.deadlineMs)).ToLocalChecked();
+    if (deadline->IsUint32()) deadline_ms = ToUint32(deadline);
+    auto join = options->Get(context, cache.Key(cache.keys.joinEventLoop)).ToLocalChecked();
+    if (join->IsBoolean()) join_event_loop = ToBool(join);
+  }
+
+  auto resolver = Promise::Resolver::New(context).ToLocalChecked();
+  args.GetReturnValue().Set(resolver->GetPromise());
+
+  auto task = make_shared<StopAllTask>();
+  task->self_ref = task;
+  task->data = AddonData::Get(isolate);
+  task->isolate = isolate;
+  task->context.Reset(isolate, context);
+  task->resolver.Reset(isolate, resolver);
+  task->join_event_loop = join_event_loop;
+  auto loop = task->data->uv_loop;
+  uv_async_init(loop, &task->done_async, [](uv_async_t* async) {
+    auto task = static_cast<StopAllTask*>(async->data);
+    if (task->AllDone()) task->Finish(false);
+  });
+  task->done_async.data = task.get();
+  uv_timer_init(loop, &task->deadline_timer);
+  task->deadline_timer.data = task.get();
+  task->open_handles = 2;
+
+  for (auto subscriber : task->data->subscribers) {
+    auto entry = make_unique<StopAllTask::Entry>();
+    entry->subscriber = subscriber;
+    entry->handle.Reset(isolate, subscriber->handle());
+    task->entries.push_back(move(entry));
+  }
+  // all stops are issued before waiting on any of them
+  for (auto& entry : task->entries) {
+    auto e = entry.get();
+    e->subscriber->StopFacade([task, e](exception_ptr ex, bool result) {
+      task->OnStopped(e);
+    });
+  }
+
+  if (task->AllDone()) {
+    task->Finish(false);
+    return;
+  }
+  uv_timer_start(&task->deadline_timer, [](uv_timer_t* timer) {
+    static_cast<StopAllTask*>(timer->data)->Finish(true);
+  }, deadline_ms, 0);
 }
 
 }  // namespace ew
@@ -12,6 +12,7 @@
 #include "tecate/defs.h"
 #include "mediacore/async/eventloop.h"
 #include "mediacore/base/logging.h"
+#include "addon_data.h"
 
 
 namespace ew {
@@ -22,34 +23,211 @@ class EastWood : public node::ObjectWrap {
   enum SinkType {
     Sink_Undefined = 0,
     AudioSink_None, AudioSink_File,
-    VideoSink_None, VideoSink_File
+    VideoSink_None, VideoSink_File,
+    AudioSink_Stream, VideoSink_Stream  // raw frames to an fd, a FIFO or a Unix socket
   };
   enum LogLevel { LogLevel_Fatal = 0, LogLevel_Error = 1, LogLevel_Warning = 2, LogLevel_Info = 3, LogLevel_Debug = 4 };
 
   static std::string SinkString(SinkType sink);
 
-  static void Init(v8::Local<v8::Object> exports);
-
-  static at::Ptr<at::EventLoop> event_loop;
+  static void Init(v8::Local<v8::Object> exports, AddonData* data);
 
  private:
-  EastWood(LogLevel level,
+  EastWood(AddonData* data, LogLevel level,
            bool log_to_console, bool log_to_syslog, const std::string& log_props_file = "");
   ~EastWood();
 
   /**
    * Creates a Subscriber instance.
    * Signature:
-   *  Subscriber createSubscriber();
+   *  Subscriber createSubscriber([SubscriberConfig configTemplate, [Object overrides]]);
    * @return Subscriber
+   * @param configTemplate: template made by createConfigTemplate(). the subscriber starts with its copy.
+   * @param overrides: { userId: String, tag: String, streamURL: String, output: String }, each optional.
+   *                   'output' replaces FFMpeg sink output.
    */
   static void createSubscriber(const v8::FunctionCallbackInfo<v8::Value>& args);
 
+  /**
+   * Creates an immutable configuration template shared by many subscribers.
+   * The given config is verified (except user id) and copied. FFMpeg parameters are parsed only once
+   * and the result is shared by every subscriber created from the template.
+   * Signature:
+   *  SubscriberConfig createConfigTemplate(SubscriberConfig config);
+   * @return frozen SubscriberConfig. setters throw.
+   * @throw exception if @a config is incomplete or incorrect.
+   */
+  static void createConfigTemplate(const v8::FunctionCallbackInfo<v8::Value>& args);
+
+  /**
+   * Creates a Composite: one FFMpeg output mixing the audio and tiling the video of the subscribers
+   * configured with compositeSink(). Input audio must be in the layout's sample rate and channels.
+   * Signature:
+   *  Composite createComposite(Object layout, String output, String param);
+   * @return Composite
+   * @param layout: { width: Number (even. default 1280), height: Number (even. default 720),
+   *                  fps: Number (default 30), sampleRate: Number (default 48000), channels: Number (1 or 2. default 2) }
+   * @param output: output destination (filename or rtmp-URL)
+   * @param param: ffmpeg parameters. see libew-ffmpeg
+   */
+  static void createComposite(const v8::FunctionCallbackInfo<v8::Value>& args);
+
+  /**
+   * Stops all subscribers of this isolate in parallel, then releases the event loop.
+   * Subscribers not stopped by the deadline are force-closed.
+   * The shared event loop is drained and its threads are joined once no isolate uses it.
+   * Signature:
+   *  Promise stopAll([Object options]);  (class method)
+   * @param options: { deadlineMs: Number (default 10000),
+   *                   joinEventLoop: Boolean (default true) }
+   * @return Promise resolved with { deadlineExceeded: Boolean,
+   *                                 subscribers: [ { userId, stop_ms, forced } ] }
+   */
+  static void stopAll(const v8::FunctionCallbackInfo<v8::Value>& args);
+
+  /**
+   * Retrieves recent per-frame trace records of subscribers configured with frameTrace()
+   * Signature:
+   *  Array dumpFrameTrace([Number seconds]);  (class method)
+   * @param seconds: how far back to look (default 10)
+   * @return [ { time_ms, subscriber, track, seq, timestamp_us, size, width, height } ], oldest first.
+   *         time_ms is monotonic clock, comparable between records only.
+   */
+  static void dumpFrameTrace(const v8::FunctionCallbackInfo<v8::Value>& args);
+
+  /**
+   * Reports health of the shared event loop, to find out when it saturates.
+   * Queue wait and timer lag are sampled by probe tasks posted every 100ms.
+   * Run time covers probes and frame deliveries to sinks.
+   * Histograms have log2 buckets: buckets[0] counts durations below 1us, buckets[i] [2^(i-1), 2^i) us.
+   * Signature:
+   *  Object getLoopStats([Number slowest]);  (class method)
+   * @param slowest: max number of task sources to list (default 10)
+   * @return { pendingProbes: Number (probes queued and not yet run),
+   *           threads: [ { thread, tasks, queueWait, run, lag,
+   *                        allocations (heap allocations by the thread, decode included. -1 unless built
+   *                        with -Dew_count_allocations=1) } ],
+   *           slowest: [ { subscriber, userId, track, sink, calls, total_ms, max_ms } ] }
+   *         where each histogram is { count, p50_us, p99_us, max_us, buckets: [Number] }.
+   *         slowest lists sinks of subscribers of this isolate, by total time spent.
+   */
+  static void getLoopStats(const v8::FunctionCallbackInfo<v8::Value>& args);
+
+  /**
+   * Starts recording pipeline spans (frame delivery to sinks, loop queue wait, subscriber start etc.)
+   * with subscriber id and frame number, until stopTrace() is called.
+   * Signature:
+   *  Boolean startTrace();  (class method)
+   * @return false if already recording
+   */
+  static void startTrace(const v8::FunctionCallbackInfo<v8::Value>& args);
+
+  /**
+   * Stops recording and writes the spans as Chrome trace-event JSON,
+   * which can be opened with chrome://tracing or https://ui.perfetto.dev
+   * Signature:
+   *  Promise stopTrace(String filename);  (class method)
+   * @return Promise resolved with { filename, events, dropped } once written, rejected on write failure
+   * @throw exception if not recording
+   */
+  static void stopTrace(const v8::FunctionCallbackInfo<v8::Value>& args);
+
+  /**
+   * Sets process-wide memory limit. While the process RSS is over it, Subscriber.start() rejects.
+   * Signature:
+   *  void setMemoryLimit(uint32_t megabytes);  (class method)
+   * @param megabytes: limit of resident memory in MB. zero disables.
+   */
+  static void setMemoryLimit(const v8::FunctionCallbackInfo<v8::Value>& args);
+
+  /**
+   * Reports memory of the process and estimated native memory of the subscribers of this isolate.
+   * Signature:
+   *  Object getMemoryUsage();  (class method)
+   * @return { rss_bytes: Number (0 if unavailable), estimated_bytes: Number, limit_bytes: Number (0 if unlimited) }
+   */
+  static void getMemoryUsage(const v8::FunctionCallbackInfo<v8::Value>& args);
+
+  /**
+   * Sets admission policy checked by Subscriber.start(), process-wide. Zero (or omitted) disables each check.
+   * Signature:
+   *  void setAdmission(Object policy);  (class method)
+   * @param policy: { cpuHeadroom: Number (fraction of all cores to keep free, 0 to 1),
+   *                  memoryHeadroom_mb: Number (RSS to keep below the limit of setMemoryLimit()),
+   *                  maxQueueWait_ms: Number (recent p99 of event loop queue wait) }
+   */
+  static void setAdmission(const v8::FunctionCallbackInfo<v8::Value>& args);
+
+  /**
+   * Reports the live capacity model of this isolate, updated every second while subscribers run.
+   * Sink classes are none, file, ffmpegRemux (FFmpeg with stream copy), ffmpegTranscode and plugin.
+   * Signature:
+   *  Object getCapacity();  (class method)
+   * @return { cpus: Number, cpuUsed: Number (fraction of all cores used by the process),
+   *           subscribers: { <sink class>: Number (running) },
+   *           cpuPerSubscriber_ms: { <sink class>: Number (CPU ms per second of one subscriber. 0 until observed) },
+   *           admissible: { <sink class>: Number (more subscribers that fit the policy or the host.
+   *                                                   4294967295 while nothing limits it yet) },
+   *           loop: { queueWaitP99_ms, pendingProbes },
+   *           memory: { rss_bytes, limit_bytes, perSubscriber_bytes },
+   *           admission: { cpuHeadroom, memoryHeadroom_mb, maxQueueWait_ms },
+   *           shedding: { queueWait_ms, cpuUsed (as set by setLoadShedding()),
+   *                       level: Number (0 while not shedding, up to 4) } }
+   */
+  static void getCapacity(const v8::FunctionCallbackInfo<v8::Value>& args);
+
+  /**
+   * Sets overload at which video of lower priority classes is shed (see SubscriberConfig.priority()),
+   * process-wide and checked each second with the capacity model. Zero (or omitted) disables each check.
+   * Each second over either threshold raises the level by one, each second under 80% of both lowers it by one:
+   * level 1 delivers 1/2 of the video frames of 'low' subscribers, 2 1/4, 3 1/2 of 'normal' ones as well,
+   * and 4 1/4 of them.
+   * Signature:
+   *  void setLoadShedding(Object policy);  (class method)
+   * @param policy: { queueWait_ms: Number (recent p99 of event loop queue wait),
+   *                  cpuUsed: Number (fraction of all cores used by the process, 0 to 1) }
+   */
+  static void setLoadShedding(const v8::FunctionCallbackInfo<v8::Value>& args);
+
+  /**
+   * Sets thread budget shared by all FFmpeg transcodes of the process.
+   * Each transcode started afterwards gets a share among the running ones, weighted by priority class
+   * (see SubscriberConfig.priority()): 'high' weighs 4, 'normal' 2 and 'low' 1. The share is capped at the
+   * threads the running ones left, so that the budget is not over-committed (but each gets at least one).
+   * Signature:
+   *  void setEncoderBudget(Object options);  (class method)
+   * @param options: { threads: Number (budget. 0 is all cores but two. default 0),
+   *                   adaptPreset: Boolean (faster x264 preset for encoders with less than 4 threads. default false) }
+   */
+  static void setEncoderBudget(const v8::FunctionCallbackInfo<v8::Value>& args);
+
+  /**
+   * Signature:
+   *  Object getEncoderBudget();  (class method)
+   * @return { threads, adaptPreset, encoders (running transcodes), leasedThreads (threads taken by them),
+   *           perEncoder (threads the next one of normal priority gets) }
+   */
+  static void getEncoderBudget(const v8::FunctionCallbackInfo<v8::Value>& args);
+
+  /**
+   * Lists the subscribers of this isolate with their lifecycle state (see Subscriber.state()), read without
+   * going to any other thread.
+   * Signature:
+   *  Array listSubscribers();  (class method)
+   * @return [ { subscriber: Number (id, as in frame traces), userId: String, state: String,
+   *             since_ms: Number (when the state was entered, in milliseconds since the Unix epoch) } ]
+   *         ordered by id
+   */
+  static void listSubscribers(const v8::FunctionCallbackInfo<v8::Value>& args);
+
+  static constexpr uint32_t kDefaultStopAllDeadlineMs = 10000;
+  static constexpr uint32_t kDefaultSlowestTaskSources = 10;
+  static constexpr double kDefaultFrameTraceDumpSeconds = 10;
+
   mutable at::Logger log_;
 
   /// @internal called by V8 framewodk
   static void New(const v8::FunctionCallbackInfo<v8::Value>& args);
-  static v8::Persistent<v8::Function> constructor;
 
   AT_ADDON_CLASS;
 };
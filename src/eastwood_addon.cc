@@ -1,15 +1,19 @@
 #include <node.h>
 #include "eastwood.h"
+#include "addon_data.h"
 
 namespace ew {
 
+using v8::Context;
 using v8::Local;
 using v8::Object;
+using v8::Value;
 
-void InitAll(Local<Object> exports) {
-  EastWood::Init(exports);
+/// Called once per context (main thread and each worker_thread), with its own class templates.
+void InitAll(Local<Object> exports, Local<Value> module, Local<Context> context, void* priv) {
+  EastWood::Init(exports, AddonData::Create(context->GetIsolate()));
 }
 
-NODE_MODULE(eastwood_addon, InitAll)
+NODE_MODULE_CONTEXT_AWARE(eastwood_addon, InitAll)
 
 }  // namespace ew
@@ -0,0 +1,88 @@
+/// @copyright © 2017 Airtime Media.  All rights reserved.
+
+#ifndef EASTWOOD_SINK_PLUGIN_H_
+#define EASTWOOD_SINK_PLUGIN_H_
+
+/**
+ * C ABI of sink plugins, loaded by SubscriberConfig.pluginSink(path, params).
+ * A plugin is a shared object exporting EW_SINK_PLUGIN_ENTRY, which returns a static ew_sink_plugin.
+ * It depends on nothing but this header, so plugins build without the addon or the core libraries.
+ *
+ * Threading:
+ *  - open() is called on the JS thread, once per subscriber using the plugin.
+ *  - on_audio_frame() and on_video_frame() are called on the subscriber's pipeline threads.
+ *    Frames of one track never overlap, but audio and video frames may arrive concurrently.
+ *  - get_stats() may be called on the JS thread at any time between open() and flush().
+ *  - flush() and then close() are called once, after the last frame and the last get_stats(),
+ *    on whichever thread releases the subscriber's sinks.
+ * Frame data is valid only during the call. Calls must not block for long: they run on the
+ * event loop shared by all subscribers.
+ *
+ * Compatibility: fields are only ever appended. The addon accepts a plugin whose abi_version
+ * equals EW_SINK_PLUGIN_ABI_VERSION and reads no field beyond struct_size.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define EW_SINK_PLUGIN_ABI_VERSION 1
+#define EW_SINK_PLUGIN_ENTRY "ew_sink_plugin_entry"
+
+/// Interleaved 16-bit PCM
+typedef struct ew_audio_frame {
+  const uint8_t* data;
+  uint32_t size;          /* bytes */
+  uint32_t sample_rate;
+  uint32_t channels;
+  int64_t timestamp_us;   /* media timestamp */
+} ew_audio_frame;
+
+/// I420
+typedef struct ew_video_frame {
+  const uint8_t* data;
+  uint32_t size;          /* bytes */
+  uint32_t width;
+  uint32_t height;
+  int64_t timestamp_us;   /* media timestamp */
+} ew_video_frame;
+
+typedef struct ew_sink_stats {
+  uint64_t frames;        /* frames consumed */
+  uint64_t bytes;         /* bytes written out, if any */
+  uint64_t errors;
+} ew_sink_stats;
+
+typedef struct ew_sink_plugin {
+  uint32_t abi_version;   /* EW_SINK_PLUGIN_ABI_VERSION */
+  uint32_t struct_size;   /* sizeof(ew_sink_plugin) */
+  const char* name;
+
+  /**
+   * Creates a sink instance.
+   * @param params: string given to pluginSink()
+   * @param err: receives a message on failure (nul terminated, at most err_size bytes)
+   * @return instance, or NULL on failure
+   */
+  void* (*open)(const char* params, char* err, size_t err_size);
+  /// @return 0 on success. other values are counted as errors. frames keep coming.
+  int (*on_audio_frame)(void* instance, const ew_audio_frame* frame);
+  int (*on_video_frame)(void* instance, const ew_video_frame* frame);
+  /// @return 0 on success
+  int (*flush)(void* instance);
+  /// Fills @a stats. May be NULL if the plugin keeps no stats.
+  void (*get_stats)(void* instance, ew_sink_stats* stats);
+  /// Releases the instance
+  void (*close)(void* instance);
+} ew_sink_plugin;
+
+typedef const ew_sink_plugin* (*ew_sink_plugin_entry_fn)(void);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // EASTWOOD_SINK_PLUGIN_H_
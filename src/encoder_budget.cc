@@ -0,0 +1,94 @@
+/// @copyright © 2017 Airtime Media.  All rights reserved.
+
+#include <algorithm>
+#include <thread>
+
+#include "encoder_budget.h"
+
+namespace ew {
+
+using namespace std;
+
+constexpr const char* EncoderBudget::kThreadsOption;
+constexpr const char* EncoderBudget::kPresetOption;
+
+EncoderBudget& EncoderBudget::Instance() {
+  static EncoderBudget instance;
+  return instance;
+}
+
+EncoderBudget::EncoderBudget()
+  // two cores are left for JS thread and the event loop
+  : default_threads_(max(1u, thread::hardware_concurrency() - min(2u, thread::hardware_concurrency()))) {
+}
+
+shared_ptr<const EncoderLease> EncoderBudget::Acquire(uint32_t weight) {
+  auto lease = new EncoderLease();
+  {
+    lock_guard<mutex> lock(mutex_);
+    ++encoders_;
+    weights_ += weight;
+    lease->threads = ShareLocked(weight, weights_);
+    leased_ += lease->threads;
+    if (adapt_preset_) {
+      // trades compression for speed rather than falling behind real time
+      if (1 == lease->threads) {
+        lease->preset = "ultrafast";
+      } else if (lease->threads < 4) {
+        lease->preset = "veryfast";
+      }
+    }
+  }
+  return shared_ptr<const EncoderLease>(lease, [this, weight](const EncoderLease* lease) {
+    auto threads = lease->threads;
+    delete lease;
+    Release(weight, threads);
+  });
+}
+
+void EncoderBudget::Release(uint32_t weight, uint32_t threads) {
+  lock_guard<mutex> lock(mutex_);
+  --encoders_;
+  weights_ -= weight;
+  leased_ -= threads;
+}
+
+void EncoderBudget::Configure(uint32_t threads, bool adapt_preset) {
+  lock_guard<mutex> lock(mutex_);
+  threads_ = threads;
+  adapt_preset_ = adapt_preset;
+}
+
+uint32_t EncoderBudget::ShareLocked(uint32_t weight, uint32_t weights) const {
+  auto budget = (0 < threads_) ? threads_ : default_threads_;
+  // the running encoders keep the threads they took, which may be more than their weighted share now
+  auto free = (leased_ < budget) ? budget - leased_ : 0u;
+  return max(1u, min(free, budget * weight / max(1u, weights)));
+}
+
+uint32_t EncoderBudget::Threads() const {
+  lock_guard<mutex> lock(mutex_);
+  return (0 < threads_) ? threads_ : default_threads_;
+}
+
+bool EncoderBudget::AdaptPreset() const {
+  lock_guard<mutex> lock(mutex_);
+  return adapt_preset_;
+}
+
+uint32_t EncoderBudget::Encoders() const {
+  lock_guard<mutex> lock(mutex_);
+  return encoders_;
+}
+
+uint32_t EncoderBudget::LeasedThreads() const {
+  lock_guard<mutex> lock(mutex_);
+  return leased_;
+}
+
+uint32_t EncoderBudget::NextEncoderThreads(uint32_t weight) const {
+  lock_guard<mutex> lock(mutex_);
+  return ShareLocked(weight, weights_ + weight);
+}
+
+}  // namespace ew
@@ -0,0 +1,67 @@
+/// @copyright © 2017 Airtime Media.  All rights reserved.
+
+#ifndef ENCODER_BUDGET_H_
+#define ENCODER_BUDGET_H_
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+
+
+namespace ew {
+
+/// Threading given to one FFmpeg encoder. Held by the subscriber until its encoder is stopped.
+struct EncoderLease {
+  uint32_t threads = 0;
+  std::string preset;  // empty keeps the encoder's default or the user's choice
+};
+
+/**
+ * Process-wide thread budget shared by concurrent FFmpeg transcodes,
+ * so that encoders together do not oversubscribe the cores used by the event loop.
+ * Each new encoder gets a share of the budget weighted among encoders running at that point
+ * (see CapacityModel::PriorityWeight()), i.e. an even share between encoders of the same priority,
+ * but no more than the threads not leased yet (at least one).
+ * @note Encoders take their threading at creation, so running encoders keep their share.
+ */
+class EncoderBudget {
+ public:
+  static EncoderBudget& Instance();
+
+  /// Registers an encoder of @a weight. The lease is returned to the budget when the last reference is dropped.
+  std::shared_ptr<const EncoderLease> Acquire(uint32_t weight);
+
+  /// @param threads: budget for all encoders. zero uses the default (all cores but two).
+  /// @param adapt_preset: whether encoders with few threads get faster x264 presets
+  void Configure(uint32_t threads, bool adapt_preset);
+
+  uint32_t Threads() const;
+  bool AdaptPreset() const;
+  uint32_t Encoders() const;
+  /// @return threads leased by the running encoders. over the budget only by encoders given their minimum one.
+  uint32_t LeasedThreads() const;
+  /// @return threads a new encoder of @a weight would get now
+  uint32_t NextEncoderThreads(uint32_t weight) const;
+
+  /// option names passed to FFmpegStreamSinkFactory
+  static constexpr auto kThreadsOption = "ffmpeg_threads";
+  static constexpr auto kPresetOption = "ffmpeg_preset";
+
+ private:
+  EncoderBudget();
+  uint32_t ShareLocked(uint32_t weight, uint32_t weights) const;
+  void Release(uint32_t weight, uint32_t threads);
+
+  const uint32_t default_threads_;
+  mutable std::mutex mutex_;
+  uint32_t threads_ = 0;      // guarded by mutex_. zero is default.
+  bool adapt_preset_ = false;  // guarded by mutex_
+  uint32_t encoders_ = 0;     // guarded by mutex_
+  uint32_t weights_ = 0;      // of the running encoders. guarded by mutex_
+  uint32_t leased_ = 0;       // threads of the running encoders. guarded by mutex_
+};
+
+}  // namespace ew
+
+#endif  // ENCODER_BUDGET_H_
@@ -0,0 +1,161 @@
+/// @copyright © 2017 Airtime Media.  All rights reserved.
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+#include "frame_capture.h"
+#include "steady_clock.h"
+
+namespace ew {
+
+using namespace std;
+
+constexpr size_t FrameRecorder::kMaxQueuedBytes;
+
+shared_ptr<FrameRecorder> FrameRecorder::Open(const string& path, shared_ptr<FramePool> pool) {
+  auto file = fopen(path.c_str(), "wb");
+  if (!file) return nullptr;
+  if (1 != fwrite(kCaptureMagic, sizeof(kCaptureMagic) - 1, 1, file)) {
+    fclose(file);
+    return nullptr;
+  }
+  return shared_ptr<FrameRecorder>(new FrameRecorder(file, move(pool)));
+}
+
+FrameRecorder::FrameRecorder(FILE* file, shared_ptr<FramePool> pool)
+  : file_(file), pool_(move(pool)) {
+  thread_ = thread([this]() { Run(); });
+}
+
+FrameRecorder::~FrameRecorder() {
+  {
+    lock_guard<mutex> lock(mutex_);
+    running_ = false;
+  }
+  wake_.notify_one();
+  thread_.join();
+  fclose(file_);
+}
+
+void FrameRecorder::Record(FrameTrack track, int64_t arrival_ns, const FrameMeta& meta, const uint8_t* payload) {
+  CaptureRecord record = {};
+  record.timestamp_us = meta.timestamp_us;
+  record.size = meta.size;
+  record.sample_rate = meta.sample_rate;
+  record.width = meta.width;
+  record.height = meta.height;
+  record.channels = meta.channels;
+  record.track = track;
+  auto data = (0 < meta.size) ? pool_->Copy(payload, meta.size) : FrameBuffer();
+  {
+    lock_guard<mutex> lock(mutex_);
+    if (kMaxQueuedBytes < queued_bytes_ + meta.size) {
+      dropped_.fetch_add(1, memory_order_relaxed);
+      return;
+    }
+    if (first_arrival_ns_ < 0) first_arrival_ns_ = arrival_ns;
+    record.arrival_ns = arrival_ns - first_arrival_ns_;
+    queued_bytes_ += meta.size;
+    queue_.emplace_back(record, move(data));
+  }
+  wake_.notify_one();
+}
+
+void FrameRecorder::Run() {
+  Batch batch;
+  unique_lock<mutex> lock(mutex_);
+  while (true) {
+    wake_.wait(lock, [this]() { return !running_ || !queue_.empty(); });
+    if (queue_.empty()) break;  // stopped and drained
+    swap(queue_, batch);
+    lock.unlock();
+    size_t bytes = 0;
+    for (const auto& item : batch) {
+      fwrite(&item.first, sizeof(item.first), 1, file_);
+      if (item.second) fwrite(item.second.data(), item.second.size(), 1, file_);
+      bytes += item.second.size();
+    }
+    batch.clear();  // buffers back to the pool
+    lock.lock();
+    queued_bytes_ -= bytes;
+  }
+  fflush(file_);
+}
+
+unique_ptr<FrameReplayer> FrameReplayer::Open(const string& path, double speed, string& err) {
+  auto file = fopen(path.c_str(), "rb");
+  if (!file) {
+    err = "Cannot open " + path;
+    return nullptr;
+  }
+  char magic[sizeof(kCaptureMagic) - 1];
+  if (1 != fread(magic, sizeof(magic), 1, file) || 0 != memcmp(magic, kCaptureMagic, sizeof(magic))) {
+    fclose(file);
+    err = path + " is not a capture file";
+    return nullptr;
+  }
+  return unique_ptr<FrameReplayer>(new FrameReplayer(file, speed));
+}
+
+FrameReplayer::FrameReplayer(FILE* file, double speed)
+  : file_(file), speed_(speed) {
+}
+
+FrameReplayer::~FrameReplayer() {
+  Stop();
+  fclose(file_);
+}
+
+void FrameReplayer::Start(at::eastwood::AudioSink* audio, at::eastwood::VideoSink* video,
+                          function<void(const string& err)> on_done) {
+  thread_ = thread([this, audio, video, on_done]() { Run(audio, video, on_done); });
+}
+
+void FrameReplayer::Stop() {
+  {
+    lock_guard<mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  wake_.notify_one();
+  if (thread_.joinable()) thread_.join();
+}
+
+void FrameReplayer::Run(at::eastwood::AudioSink* audio, at::eastwood::VideoSink* video,
+                        function<void(const string& err)> on_done) {
+  auto start_ns = SteadyNowNs();
+  CaptureRecord record;
+  vector<uint8_t> payload;
+  auto err = ""s;
+  while (1 == fread(&record, sizeof(record), 1, file_)) {
+    payload.resize(record.size);
+    if (0 < record.size && 1 != fread(payload.data(), record.size, 1, file_)) {
+      err = "Truncated capture file";
+      break;
+    }
+    {
+      unique_lock<mutex> lock(mutex_);
+      if (0 < speed_) {
+        auto due_ns = start_ns + static_cast<int64_t>(record.arrival_ns / speed_);
+        wake_.wait_for(lock, chrono::nanoseconds(max<int64_t>(0, due_ns - SteadyNowNs())),
+                       [this]() { return stopping_; });
+      }
+      if (stopping_) return;  // stopped by the subscriber. no notification.
+    }
+    FrameMeta meta;
+    meta.timestamp_us = record.timestamp_us;
+    meta.size = record.size;
+    meta.width = record.width;
+    meta.height = record.height;
+    meta.sample_rate = record.sample_rate;
+    meta.channels = record.channels;
+    if (kTrackAudio == record.track) {
+      audio->OnAudioFrame(MakeAudioFrame(meta, payload.data()));
+    } else {
+      video->OnVideoFrame(MakeVideoFrame(meta, payload.data()));
+    }
+  }
+  on_done(err);
+}
+
+}  // namespace ew
@@ -0,0 +1,96 @@
+/// @copyright © 2017 Airtime Media.  All rights reserved.
+
+#ifndef FRAME_CAPTURE_H_
+#define FRAME_CAPTURE_H_
+
+#include <cstdio>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "eastwood/sink/audio_sink.h"
+#include "eastwood/sink/video_sink.h"
+
+#include "capture_format.h"
+#include "frame_pool.h"
+#include "media_frame.h"
+
+
+namespace ew {
+
+/**
+ * Writes frames reaching the sink taps of a subscriber into a capture file.
+ * Media threads copy frames into pooled buffers in a queue. A writer thread takes the queue a batch at a time
+ * and writes it out, so that neither side allocates once warm.
+ */
+class FrameRecorder {
+ public:
+  /// @param pool: of the subscriber, for frame copies
+  /// @return null if @a path cannot be created
+  static std::shared_ptr<FrameRecorder> Open(const std::string& path, std::shared_ptr<FramePool> pool);
+  ~FrameRecorder();
+
+  /// Called on media threads. Drops the frame if the writer is behind by kMaxQueuedBytes.
+  void Record(FrameTrack track, int64_t arrival_ns, const FrameMeta& meta, const uint8_t* payload);
+
+  uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+  static constexpr size_t kMaxQueuedBytes = 64 << 20;
+
+ private:
+  FrameRecorder(FILE* file, std::shared_ptr<FramePool> pool);
+  void Run();
+
+  using Batch = std::vector<std::pair<CaptureRecord, FrameBuffer>>;
+
+  FILE* file_;
+  std::shared_ptr<FramePool> pool_;
+  int64_t first_arrival_ns_ = -1;  // guarded by mutex_
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  Batch queue_;              // guarded by mutex_. swapped with the writer's batch, keeping both capacities
+  size_t queued_bytes_ = 0;  // guarded by mutex_
+  bool running_ = true;      // guarded by mutex_
+  std::atomic<uint64_t> dropped_{0};
+  std::thread thread_;
+};
+
+/**
+ * Feeds frames of a capture file to sinks on its own thread, with the recorded timing scaled by speed,
+ * or as fast as the sinks take them.
+ */
+class FrameReplayer {
+ public:
+  /// @param speed: 1.0 is real-time. 0 is as fast as possible.
+  /// @return null with @a err set if @a path is not a capture file
+  static std::unique_ptr<FrameReplayer> Open(const std::string& path, double speed, std::string& err);
+  ~FrameReplayer();
+
+  /// Starts feeding. @a on_done is called on the replay thread at the end of the file, with error if any.
+  /// The sinks must outlive Stop().
+  void Start(at::eastwood::AudioSink* audio, at::eastwood::VideoSink* video,
+             std::function<void(const std::string& err)> on_done);
+  /// Stops feeding and joins the thread
+  void Stop();
+
+ private:
+  FrameReplayer(FILE* file, double speed);
+  void Run(at::eastwood::AudioSink* audio, at::eastwood::VideoSink* video,
+           std::function<void(const std::string& err)> on_done);
+
+  FILE* file_;
+  const double speed_;
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  bool stopping_ = false;  // guarded by mutex_
+  std::thread thread_;
+};
+
+}  // namespace ew
+
+#endif  // FRAME_CAPTURE_H_
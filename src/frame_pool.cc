@@ -0,0 +1,103 @@
+/// @copyright © 2017 Airtime Media.  All rights reserved.
+
+#include <cstring>
+#include <new>
+#include <utility>
+
+#include "frame_pool.h"
+
+namespace ew {
+
+using namespace std;
+
+constexpr size_t FrameBlock::kHeaderBytes;
+constexpr size_t FramePool::kMinClassBytes;
+constexpr size_t FramePool::kMaxClassBytes;
+constexpr size_t FramePool::kMaxFreePerClass;
+constexpr uint32_t FramePool::kNumClasses;
+constexpr uint32_t FramePool::kOversize;
+
+static_assert(sizeof(FrameBlock) <= FrameBlock::kHeaderBytes, "FrameBlock header too large");
+
+namespace {
+
+FrameBlock* NewBlock(uint32_t size_class, size_t capacity) {
+  auto memory = new uint8_t[FrameBlock::kHeaderBytes + capacity];
+  auto block = new (memory) FrameBlock;
+  block->size_class = size_class;
+  block->capacity = capacity;
+  return block;
+}
+
+void DeleteBlock(FrameBlock* block) {
+  block->~FrameBlock();
+  delete[] reinterpret_cast<uint8_t*>(block);
+}
+
+}  // namespace
+
+void FrameBuffer::reset() {
+  if (!block_) return;
+  if (1 == block_->refs.fetch_sub(1, memory_order_acq_rel)) {
+    // the pool stays alive until the block is back
+    auto pool = move(block_->pool);
+    pool->Release(block_);
+  }
+  block_ = nullptr;
+}
+
+FramePool::~FramePool() {
+  for (uint32_t size_class = 0; size_class < kNumClasses; ++size_class) {
+    for (size_t i = 0; i < num_free_[size_class]; ++i) DeleteBlock(free_[size_class][i]);
+  }
+}
+
+FrameBuffer FramePool::Copy(const uint8_t* data, size_t size) {
+  uint32_t size_class = 0;
+  auto capacity = kMinClassBytes;
+  while (capacity < size && size_class < kOversize) {
+    capacity *= 2;
+    ++size_class;
+  }
+  if (kOversize == size_class) capacity = size;
+  FrameBlock* block = nullptr;
+  {
+    lock_guard<mutex> lock(mutex_);
+    if (size_class < kOversize && 0 < num_free_[size_class]) {
+      block = free_[size_class][--num_free_[size_class]];
+      stats_.pooled_bytes -= block->capacity;
+      ++stats_.hits;
+    } else {
+      ++stats_.misses;
+    }
+    ++stats_.outstanding;
+    stats_.lent_bytes += capacity;
+  }
+  if (!block) block = NewBlock(size_class, capacity);
+  memcpy(block->data(), data, size);
+  block->size = size;
+  block->refs.store(1, memory_order_relaxed);
+  block->pool = shared_from_this();
+  return FrameBuffer(block);
+}
+
+void FramePool::Release(FrameBlock* block) {
+  {
+    lock_guard<mutex> lock(mutex_);
+    --stats_.outstanding;
+    stats_.lent_bytes -= block->capacity;
+    if (kOversize != block->size_class && num_free_[block->size_class] < kMaxFreePerClass) {
+      free_[block->size_class][num_free_[block->size_class]++] = block;
+      stats_.pooled_bytes += block->capacity;
+      return;
+    }
+  }
+  DeleteBlock(block);
+}
+
+FramePool::Stats FramePool::stats() const {
+  lock_guard<mutex> lock(mutex_);
+  return stats_;
+}
+
+}  // namespace ew
@@ -0,0 +1,104 @@
+/// @copyright © 2017 Airtime Media.  All rights reserved.
+
+#ifndef FRAME_POOL_H_
+#define FRAME_POOL_H_
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+
+namespace ew {
+
+class FramePool;
+
+/// @internal Header of a pooled block. The payload follows it, at kHeaderBytes.
+struct FrameBlock {
+  static constexpr size_t kHeaderBytes = 64;
+
+  std::atomic<uint32_t> refs{0};
+  uint32_t size_class = 0;  // kOversize if not pooled
+  size_t capacity = 0;
+  size_t size = 0;
+  /// set while lent, so that the pool outlives its buffers
+  std::shared_ptr<FramePool> pool;
+
+  uint8_t* data() { return reinterpret_cast<uint8_t*>(this) + kHeaderBytes; }
+};
+
+/// Reference counted handle of a frame buffer taken from a FramePool. Copies share the buffer.
+class FrameBuffer {
+ public:
+  FrameBuffer() = default;
+  FrameBuffer(const FrameBuffer& other) : block_(other.block_) {
+    if (block_) block_->refs.fetch_add(1, std::memory_order_relaxed);
+  }
+  FrameBuffer(FrameBuffer&& other) noexcept : block_(other.block_) { other.block_ = nullptr; }
+  FrameBuffer& operator=(FrameBuffer other) noexcept {
+    std::swap(block_, other.block_);
+    return *this;
+  }
+  ~FrameBuffer() { reset(); }
+
+  /// Returns the buffer to its pool once the last handle is gone
+  void reset();
+
+  const uint8_t* data() const { return block_ ? block_->data() : nullptr; }
+  size_t size() const { return block_ ? block_->size : 0; }
+  explicit operator bool() const { return nullptr != block_; }
+
+ private:
+  friend class FramePool;
+  explicit FrameBuffer(FrameBlock* block) : block_(block) {}
+
+  FrameBlock* block_ = nullptr;
+};
+
+/**
+ * Frame buffers of one subscriber, in power of two size classes, for the copies the addon makes of frames
+ * on the media path (capture, composite). Steady frame sizes then reuse the same few buffers, instead of
+ * contending on malloc with the other subscribers, or page faulting on fresh mmap()ed memory for each picture.
+ * Thread-safe: buffers are usually taken on a media thread and returned on a writer thread.
+ */
+class FramePool : public std::enable_shared_from_this<FramePool> {
+ public:
+  struct Stats {
+    uint64_t hits = 0;      // taken from the pool
+    uint64_t misses = 0;    // allocated, as the class was empty or the frame is larger than kMaxClassBytes
+    size_t pooled_bytes = 0;
+    size_t outstanding = 0;  // buffers lent
+    size_t lent_bytes = 0;   // capacity of the buffers lent
+  };
+
+  ~FramePool();
+
+  /// @return buffer holding a copy of @a size bytes at @a data
+  FrameBuffer Copy(const uint8_t* data, size_t size);
+
+  Stats stats() const;
+
+  static constexpr size_t kMinClassBytes = 4 << 10;
+  static constexpr size_t kMaxClassBytes = 16 << 20;
+  /// released buffers beyond this many per class are freed
+  static constexpr size_t kMaxFreePerClass = 4;
+
+ private:
+  friend class FrameBuffer;
+  static constexpr uint32_t kNumClasses = 13;
+  static constexpr uint32_t kOversize = kNumClasses;
+  static_assert((kMinClassBytes << (kNumClasses - 1)) == kMaxClassBytes, "classes must end at kMaxClassBytes");
+
+  void Release(FrameBlock* block);
+
+  mutable std::mutex mutex_;
+  std::array<std::array<FrameBlock*, kMaxFreePerClass>, kNumClasses> free_{};  // guarded by mutex_
+  std::array<size_t, kNumClasses> num_free_{};  // guarded by mutex_
+  Stats stats_;                                  // guarded by mutex_
+};
+
+}  // namespace ew
+
+#endif  // FRAME_POOL_H_
@@ -0,0 +1,132 @@
+/// @copyright © 2017 Airtime Media.  All rights reserved.
+
+#include <algorithm>
+
+#include "frame_trace.h"
+#include "eastwood.h"
+#include "sink_tap.h"
+
+namespace ew {
+
+using namespace std;
+
+constexpr chrono::milliseconds FrameTrace::kFlushInterval;
+
+FrameTrace& FrameTrace::Instance() {
+  static FrameTrace instance;
+  return instance;
+}
+
+FrameTrace::FrameTrace()
+  : log_(at::log::keywords::channel = "addon.FrameTrace") {
+}
+
+FrameTrace::~FrameTrace() {
+  {
+    lock_guard<mutex> lock(thread_mutex_);
+    if (!running_) return;
+    running_ = false;
+  }
+  wake_.notify_one();
+  thread_.join();
+  Flush();
+}
+
+void FrameTrace::EnsureStarted() {
+  lock_guard<mutex> lock(thread_mutex_);
+  if (running_) return;
+  running_ = true;
+  thread_ = thread([this]() { Run(); });
+}
+
+FrameTrace::Ring& FrameTrace::ThreadRing() {
+  // the ring is released by the thread on exit, and then by Flush() once drained
+  thread_local shared_ptr<Ring> ring;
+  if (!ring) {
+    ring = make_shared<Ring>();
+    lock_guard<mutex> lock(rings_mutex_);
+    rings_.push_back(ring);
+  }
+  return *ring;
+}
+
+void FrameTrace::Record(const FrameTraceRecord& record) {
+  ThreadRing().Push(record);
+}
+
+void FrameTrace::Run() {
+  unique_lock<mutex> lock(thread_mutex_);
+  while (running_) {
+    wake_.wait_for(lock, kFlushInterval);
+    lock.unlock();
+    Flush();
+    lock.lock();
+  }
+}
+
+void FrameTrace::Flush() {
+  vector<shared_ptr<Ring>> rings;
+  {
+    lock_guard<mutex> lock(rings_mutex_);
+    rings = rings_;
+  }
+
+  lock_guard<mutex> lock(flush_mutex_);
+  for (auto& ring : rings) {
+    ring->Drain([this](const FrameTraceRecord& record) {
+      Write(record);
+      history_.push_back(record);
+    });
+    auto dropped = ring->TakeDropped();
+    if (0 < dropped) {
+      AT_LOG_WARNING(log_, "Dropped " << dropped << " frame trace records");
+    }
+  }
+  while (kHistoryCapacity < history_.size()) history_.pop_front();
+
+  // forgets rings of exited threads
+  lock_guard<mutex> rings_lock(rings_mutex_);
+  rings_.erase(remove_if(rings_.begin(), rings_.end(), [](const shared_ptr<Ring>& ring) {
+    return 1 == ring.use_count() && 0 == ring->Size();
+  }), rings_.end());
+}
+
+void FrameTrace::Write(const FrameTraceRecord& r) {
+#define EW_FRAME_TRACE_LINE \
+  "frame sub=" << r.subscriber_id << " " << TrackString(r.track) << " seq=" << r.seq \
+  << " ts=" << r.timestamp_us << "us size=" << r.size \
+  << ((kTrackVideo == r.track) ? " " + to_string(r.width) + "x" + to_string(r.height) : "")
+  switch (r.level) {
+    case EastWood::LogLevel_Fatal:
+    case EastWood::LogLevel_Error:
+      AT_LOG_ERROR(log_, EW_FRAME_TRACE_LINE);
+      break;
+    case EastWood::LogLevel_Warning:
+      AT_LOG_WARNING(log_, EW_FRAME_TRACE_LINE);
+      break;
+    case EastWood::LogLevel_Info:
+      AT_LOG_INFO(log_, EW_FRAME_TRACE_LINE);
+      break;
+    default:
+      AT_LOG_DEBUG(log_, EW_FRAME_TRACE_LINE);
+      break;
+  }
+#undef EW_FRAME_TRACE_LINE
+}
+
+vector<FrameTraceRecord> FrameTrace::Dump(double seconds) {
+  Flush();  // includes records not yet picked up by the background thread
+  auto since_ns = TrackMonitor::NowNs() - static_cast<int64_t>(seconds * 1e9);
+  lock_guard<mutex> lock(flush_mutex_);
+  vector<FrameTraceRecord> records;
+  for (const auto& record : history_) {
+    if (since_ns <= record.time_ns) records.push_back(record);
+  }
+  // rings are drained one by one, so history is ordered per thread only
+  stable_sort(records.begin(), records.end(), [](const FrameTraceRecord& a, const FrameTraceRecord& b) {
+    return a.time_ns < b.time_ns;
+  });
+  return records;
+}
+
+}  // namespace ew
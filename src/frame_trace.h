@@ -0,0 +1,118 @@
+/// @copyright © 2017 Airtime Media.  All rights reserved.
+
+#ifndef FRAME_TRACE_H_
+#define FRAME_TRACE_H_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "mediacore/defs.h"
+#include "mediacore/base/logging.h"
+
+#include "media_frame.h"
+#include "spsc_ring.h"
+
+
+namespace ew {
+
+/// Fixed-size binary record of one traced frame
+struct FrameTraceRecord {
+  int64_t time_ns;        // steady clock when the frame reached the sink
+  int64_t timestamp_us;   // media timestamp
+  uint32_t subscriber_id;
+  uint32_t seq;           // frame number on the track
+  uint32_t size;
+  uint16_t width;
+  uint16_t height;
+  FrameTrack track;
+  uint8_t level;          // EastWood::LogLevel
+};
+
+/**
+ * Decides which frames of a track are traced.
+ * Settings are written by JS thread, Sample() is called by the media thread of the track.
+ */
+struct FrameSampler {
+  std::atomic<uint32_t> every{0};       // traces every Nth frame. 0 disables tracing.
+  std::atomic<uint32_t> per_second{0};  // upper limit of traced frames per second. 0 is unlimited.
+  std::atomic<uint8_t> level{0};
+
+  bool Enabled() const { return 0 < every.load(std::memory_order_relaxed); }
+
+  /// @return true if frame number @a seq should be traced
+  bool Sample(int64_t now_ns, uint32_t seq) {
+    auto n = every.load(std::memory_order_relaxed);
+    if (0 == n || 0 != (seq % n)) return false;
+    auto limit = per_second.load(std::memory_order_relaxed);
+    if (0 < limit) {
+      if (1000000000LL <= now_ns - window_start_ns_) {
+        window_start_ns_ = now_ns;
+        window_count_ = 0;
+      }
+      if (limit <= window_count_) return false;
+      ++window_count_;
+    }
+    return true;
+  }
+
+ private:
+  int64_t window_start_ns_ = 0;
+  uint32_t window_count_ = 0;
+};
+
+/**
+ * Process-wide per-frame trace.
+ * Media threads push records into their own lock-free ring, without formatting nor locking.
+ * A background thread drains the rings, writes log lines and keeps recent records for Dump().
+ */
+class FrameTrace {
+ public:
+  static FrameTrace& Instance();
+
+  /// Starts the background thread if not yet. Called on JS thread when a traced subscriber starts.
+  void EnsureStarted();
+
+  /// Called on media threads. Never blocks. The record is dropped if the thread's ring is full.
+  void Record(const FrameTraceRecord& record);
+
+  /// @return records of the last @a seconds, oldest first
+  std::vector<FrameTraceRecord> Dump(double seconds);
+
+  static constexpr size_t kRingCapacity = 4096;       // per media thread
+  static constexpr size_t kHistoryCapacity = 1 << 16;  // records kept for Dump()
+  static constexpr std::chrono::milliseconds kFlushInterval{100};
+
+ private:
+  using Ring = SpscRing<FrameTraceRecord, kRingCapacity>;
+
+  FrameTrace();
+  ~FrameTrace();
+
+  Ring& ThreadRing();
+  void Run();
+  void Flush();
+  void Write(const FrameTraceRecord& record);
+
+  std::mutex rings_mutex_;
+  std::vector<std::shared_ptr<Ring>> rings_;  // guarded by rings_mutex_
+
+  std::mutex flush_mutex_;  // single consumer of the rings
+  std::deque<FrameTraceRecord> history_;  // guarded by flush_mutex_
+
+  std::mutex thread_mutex_;
+  std::condition_variable wake_;
+  bool running_ = false;  // guarded by thread_mutex_
+  std::thread thread_;
+
+  mutable at::Logger log_;
+};
+
+}  // namespace ew
+
+#endif  // FRAME_TRACE_H_
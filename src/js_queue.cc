@@ -0,0 +1,61 @@
+/// @copyright © 2017 Airtime Media.  All rights reserved.
+
+#include <utility>
+
+#include "js_queue.h"
+#include "uv_handles.h"
+
+namespace ew {
+
+using namespace std;
+
+shared_ptr<JsQueue> JsQueue::New(uv_loop_t* loop) {
+  shared_ptr<JsQueue> queue(new JsQueue());
+  queue->async_ = NewBackgroundAsync(loop, OnAsync, queue.get());
+  return queue;
+}
+
+void JsQueue::Post(function<void()> fn) {
+  lock_guard<mutex> lock(mutex_);
+  if (!async_) return;
+  queued_.push_back(move(fn));
+  uv_async_send(async_);
+}
+
+void JsQueue::Close() {
+  lock_guard<mutex> lock(mutex_);
+  if (!async_) return;
+  CloseHandle(async_);
+  async_ = nullptr;
+  queued_.clear();
+}
+
+void JsQueue::KeepAlive(bool alive) {
+  lock_guard<mutex> lock(mutex_);
+  if (!async_) return;
+  auto handle = reinterpret_cast<uv_handle_t*>(async_);
+  if (alive) {
+    uv_ref(handle);
+  } else {
+    uv_unref(handle);
+  }
+}
+
+void JsQueue::OnAsync(uv_async_t* async) {
+  // a function may release the owner, which closes the queue and drops its reference
+  auto self = static_cast<JsQueue*>(async->data)->shared_from_this();
+  vector<function<void()>> queued;
+  {
+    lock_guard<mutex> lock(self->mutex_);
+    queued.swap(self->queued_);
+  }
+  for (auto& fn : queued) {
+    {
+      lock_guard<mutex> lock(self->mutex_);
+      if (!self->async_) return;  // closed by an earlier one
+    }
+    fn();
+  }
+}
+
+}  // namespace ew
@@ -0,0 +1,45 @@
+/// @copyright © 2017 Airtime Media.  All rights reserved.
+
+#ifndef JS_QUEUE_H_
+#define JS_QUEUE_H_
+
+#include <uv.h>
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+
+namespace ew {
+
+/**
+ * Runs functions posted on any thread on the JS thread, in the order posted.
+ * Shared with the posting threads, e.g. by callbacks of the core, which may come after the owner closed it:
+ * functions posted then are dropped.
+ */
+class JsQueue : public std::enable_shared_from_this<JsQueue> {
+ public:
+  /// Called on JS thread
+  static std::shared_ptr<JsQueue> New(uv_loop_t* loop);
+
+  /// Any thread. Dropped if closed.
+  void Post(std::function<void()> fn);
+  /// Called on JS thread. Functions not run yet are dropped, and those posted from here on.
+  void Close();
+  /// Called on JS thread. Whether the queue keeps the loop alive, i.e. while a posted function is awaited.
+  /// Not by default.
+  void KeepAlive(bool alive);
+
+ private:
+  JsQueue() = default;
+  static void OnAsync(uv_async_t* async);
+
+  std::mutex mutex_;
+  uv_async_t* async_ = nullptr;                // guarded by mutex_. null once closed.
+  std::vector<std::function<void()>> queued_;  // guarded by mutex_
+};
+
+}  // namespace ew
+
+#endif  // JS_QUEUE_H_
@@ -0,0 +1,106 @@
+/// @copyright © 2017 Airtime Media.  All rights reserved.
+
+#include <algorithm>
+
+#include "latency.h"
+
+namespace ew {
+
+using namespace std;
+
+constexpr uint32_t LatencyProfile::kMaxDelayMs;
+constexpr int64_t LatencyMonitor::kWindowNs;
+constexpr int64_t LatencyMonitor::kRebaseNs;
+constexpr int64_t LatencyMonitor::kLateRunNs;
+
+LatencyProfile LatencyProfile::Of(Mode mode) {
+  LatencyProfile profile;
+  profile.mode = mode;
+  switch (mode) {
+    case kLive:
+      profile.max_delay_ms = 1000;
+      break;
+    case kUltraLow:
+      profile.max_delay_ms = 200;
+      break;
+    default:
+      break;
+  }
+  return profile;
+}
+
+bool LatencyProfile::Parse(const string& name, Mode& mode) {
+  for (auto m : { kRecording, kLive, kUltraLow }) {
+    if (name == ModeString(m)) {
+      mode = m;
+      return true;
+    }
+  }
+  return false;
+}
+
+const char* LatencyProfile::ModeString(Mode mode) {
+  switch (mode) {
+    case kLive:
+      return "live";
+    case kUltraLow:
+      return "ultralow";
+    default:
+      return "recording";
+  }
+}
+
+uint32_t LatencyProfile::StreamDelayMs() const {
+  if (kRecording == mode) return 0;
+  // a reader taking frames in bursts (e.g. a muxer) is not behind yet
+  return max(max_delay_ms, min_delay_ms + 100);
+}
+
+// --------------------------------------------
+
+int64_t LatencyMonitor::OnArrival(int64_t arrival_ns, int64_t timestamp_us) {
+  auto transit = arrival_ns - timestamp_us * 1000;
+  if (!started_ || kRebaseNs < abs(transit - last_transit_ns_)) {
+    started_ = true;
+    window_begin_ns_ = arrival_ns;
+    window_min_ns_ = previous_min_ns_ = transit;
+  } else if (kWindowNs <= arrival_ns - window_begin_ns_) {
+    window_begin_ns_ = arrival_ns;
+    previous_min_ns_ = window_min_ns_;
+    window_min_ns_ = transit;
+  } else {
+    window_min_ns_ = min(window_min_ns_, transit);
+  }
+  last_transit_ns_ = transit;
+  auto delay = transit - min(window_min_ns_, previous_min_ns_);
+  Smooth(transit_ns_, delay);
+
+  auto max_delay = max_delay_ns.load(memory_order_relaxed);
+  if (0 == max_delay || delay <= max_delay) {
+    late_since_ns_ = 0;
+    return delay;
+  }
+  late_.fetch_add(1, memory_order_relaxed);
+  if (0 == late_since_ns_) {
+    late_since_ns_ = arrival_ns;
+  } else if (kLateRunNs <= arrival_ns - late_since_ns_) {
+    // transit has shifted for good. this frame is the fastest from now on.
+    late_since_ns_ = 0;
+    window_begin_ns_ = arrival_ns;
+    window_min_ns_ = previous_min_ns_ = transit;
+  }
+  return -1;
+}
+
+void LatencyMonitor::OnDelivered(int64_t held_ns, int64_t sink_ns) {
+  Smooth(held_ns_, held_ns);
+  Smooth(sink_ns_, sink_ns);
+}
+
+void LatencyMonitor::Smooth(atomic<int64_t>& average, int64_t value) {
+  // held frames are delivered by the playout thread, the others by media threads
+  auto prev = average.load(memory_order_relaxed);
+  while (!average.compare_exchange_weak(prev, prev + (value - prev) / 16, memory_order_relaxed)) {}
+}
+
+}  // namespace ew
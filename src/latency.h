@@ -0,0 +1,100 @@
+/// @copyright © 2017 Airtime Media.  All rights reserved.
+
+#ifndef LATENCY_H_
+#define LATENCY_H_
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+
+namespace ew {
+
+/**
+ * Latency profile of a subscriber, set by SubscriberConfig.latencyMode().
+ * The jitter buffer and decoders of the core are not configurable, so the profile shapes what the addon
+ * does with decoded frames: holding them (minDelay), dropping late ones (maxDelay), the queue depth
+ * of stream sinks and FFmpeg output flushing.
+ */
+struct LatencyProfile {
+  enum Mode : uint8_t {
+    kRecording = 0,  // frames as the core delivers them. no drops.
+    kLive,           // late frames dropped, sink queues short
+    kUltraLow,       // likewise, tighter. favors latency over artifacts.
+  };
+
+  Mode mode = kRecording;
+  /// frames are held until this much later than the fastest frame of their track. 0 never holds.
+  uint32_t min_delay_ms = 0;
+  /// frames later than this are dropped. 0 never drops.
+  uint32_t max_delay_ms = 0;
+
+  /// @return defaults of @a mode
+  static LatencyProfile Of(Mode mode);
+  /// @return false if @a name is not a mode
+  static bool Parse(const std::string& name, Mode& mode);
+  static const char* ModeString(Mode mode);
+
+  /// @return how long a stream sink may stay behind before dropping frames (0 is as long as its ring lasts)
+  uint32_t StreamDelayMs() const;
+  /// whether FFmpeg sinks flush each packet instead of buffering output
+  bool FlushPackets() const { return kRecording != mode; }
+
+  /// bounds of both delays
+  static constexpr uint32_t kMaxDelayMs = 10000;
+};
+
+/**
+ * Delay of the frames of one track through the subscriber. Written by media threads and read by the JS thread.
+ * The sender's clock is not known here, so network and core delay is measured as transit (arrival time minus
+ * media timestamp) over that of the fastest recent frame, i.e. what a jitter buffer holds frames for.
+ * The fastest transit is the minimum over the current and the previous window of kWindowNs, following clock drift,
+ * and is rebased at once on a timestamp jump (e.g. after resubscription).
+ */
+class LatencyMonitor {
+ public:
+  /// frames with transit over the fastest one beyond this are late (0 disables). set before the first frame.
+  std::atomic<int64_t> max_delay_ns{0};
+
+  /// Called on media thread for each frame. Single writer per track.
+  /// Late frames rebase the fastest transit once they have been late for kLateRunNs, so that a lasting shift
+  /// of transit costs a short run of drops rather than a whole window of them.
+  /// @return transit of the frame over the fastest one in nanoseconds, or -1 if late (i.e. to be dropped)
+  int64_t OnArrival(int64_t arrival_ns, int64_t timestamp_us);
+  /// Called once the sink returned, for each delivered frame
+  void OnDelivered(int64_t held_ns, int64_t sink_ns);
+  /// Called for frames dropped as the playout buffer was full. counted as late.
+  void OnOverflow() { late_.fetch_add(1, std::memory_order_relaxed); }
+
+  /// smoothed, in nanoseconds
+  int64_t transit_ns() const { return transit_ns_.load(std::memory_order_relaxed); }
+  int64_t held_ns() const { return held_ns_.load(std::memory_order_relaxed); }
+  int64_t sink_ns() const { return sink_ns_.load(std::memory_order_relaxed); }
+  uint64_t late() const { return late_.load(std::memory_order_relaxed); }
+
+  static constexpr int64_t kWindowNs = 10000000000LL;
+  /// transit changes larger than this are timestamp jumps
+  static constexpr int64_t kRebaseNs = 10000000000LL;
+  static constexpr int64_t kLateRunNs = 1000000000LL;
+
+ private:
+  /// exponential average over about 16 frames, as the RTP interarrival jitter
+  static void Smooth(std::atomic<int64_t>& average, int64_t value);
+
+  // media thread only
+  bool started_ = false;
+  int64_t window_begin_ns_ = 0;
+  int64_t window_min_ns_ = 0;
+  int64_t previous_min_ns_ = 0;
+  int64_t last_transit_ns_ = 0;
+  int64_t late_since_ns_ = 0;  // 0 unless in a run of late frames
+
+  std::atomic<int64_t> transit_ns_{0};
+  std::atomic<int64_t> held_ns_{0};
+  std::atomic<int64_t> sink_ns_{0};
+  std::atomic<uint64_t> late_{0};
+};
+
+}  // namespace ew
+
+#endif  // LATENCY_H_
@@ -0,0 +1,109 @@
+/// @copyright © 2017 Airtime Media.  All rights reserved.
+
+#include <chrono>
+#include <utility>
+
+#include "lifecycle.h"
+#include "steady_clock.h"
+
+namespace ew {
+
+using namespace std;
+
+constexpr int64_t Lifecycle::kNegotiationMs;
+
+namespace {
+
+int64_t WallNowMs() {
+  return chrono::duration_cast<chrono::milliseconds>(chrono::system_clock::now().time_since_epoch()).count();
+}
+
+}  // namespace
+
+Lifecycle::Lifecycle(function<void()> notify)
+  : word_(Word(kIdle, WallNowMs()))
+  , notify_(move(notify)) {
+}
+
+const char* Lifecycle::StateString(State state) {
+  switch (state) {
+    case kAllocating:
+      return "allocating";
+    case kConnecting:
+      return "connecting";
+    case kNegotiating:
+      return "negotiating";
+    case kStreaming:
+      return "streaming";
+    case kRetrying:
+      return "retrying";
+    case kStopping:
+      return "stopping";
+    case kStopped:
+      return "stopped";
+    default:
+      return "idle";
+  }
+}
+
+void Lifecycle::Set(State state) {
+  auto time_ms = WallNowMs();
+  // frames count anew for the states waiting for them
+  if (kConnecting == state || kRetrying == state) tracks_.store(0, memory_order_relaxed);
+  lock_guard<mutex> lock(mutex_);
+  auto previous = word_.exchange(Word(state, time_ms), memory_order_acq_rel);
+  if (state != static_cast<State>(previous & 0xff)) Queue(state, time_ms);
+}
+
+bool Lifecycle::Change(State from, State to) {
+  auto time_ms = WallNowMs();
+  // writers are serialized, so that transitions are queued in order
+  lock_guard<mutex> lock(mutex_);
+  if (from != state()) return false;
+  word_.store(Word(to, time_ms), memory_order_release);
+  Queue(to, time_ms);
+  return true;
+}
+
+void Lifecycle::OnFrame(FrameTrack track, int64_t now_ns) {
+  auto state = this->state();
+  if (kStreaming == state) return;
+  if (kRetrying == state) {
+    Change(kRetrying, kStreaming);
+    return;
+  }
+  if (kConnecting != state && kNegotiating != state) return;
+
+  auto bit = static_cast<uint8_t>(1 << track);
+  auto tracks = tracks_.fetch_or(bit, memory_order_relaxed) | bit;
+  if ((1 << kTrackAudio | 1 << kTrackVideo) == tracks) {
+    Change(state, kStreaming);
+  } else if (kConnecting == state) {
+    negotiating_ns_.store(now_ns, memory_order_relaxed);
+    Change(kConnecting, kNegotiating);
+  } else if (kNegotiationMs * 1000000 <= now_ns - negotiating_ns_.load(memory_order_relaxed)) {
+    // a stream of one track only
+    Change(kNegotiating, kStreaming);
+  }
+}
+
+vector<Lifecycle::Transition> Lifecycle::Take() {
+  vector<Transition> transitions;
+  lock_guard<mutex> lock(mutex_);
+  transitions.swap(queued_);
+  return transitions;
+}
+
+void Lifecycle::Close() {
+  lock_guard<mutex> lock(mutex_);
+  notify_ = nullptr;
+  queued_.clear();
+}
+
+void Lifecycle::Queue(State state, int64_t time_ms) {
+  if (!notify_) return;
+  queued_.push_back(Transition{state, time_ms});
+  notify_();
+}
+
+}  // namespace ew
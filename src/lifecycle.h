@@ -0,0 +1,86 @@
+/// @copyright © 2017 Airtime Media.  All rights reserved.
+
+#ifndef LIFECYCLE_H_
+#define LIFECYCLE_H_
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+#include "media_frame.h"
+
+
+namespace ew {
+
+/**
+ * Lifecycle state of a subscriber, readable by any thread in a single atomic load.
+ * The core does not report the progress of a subscription, so the states are what the addon observes:
+ *   idle         created, or start() rejected
+ *   allocating   start() taking admission, sinks and encoder share
+ *   connecting   subscription started, no frame yet
+ *   negotiating  frames on one track, the other not yet (streaming after kNegotiationMs without it)
+ *   streaming    frames on both tracks
+ *   retrying     resubscribing after a stall, until a frame comes
+ *   stopping     stop() waiting for the subscription to end
+ *   stopped      stopped, or ended by itself ('finish')
+ * Transitions are queued for the JS thread, which is woken by the notify function.
+ */
+class Lifecycle {
+ public:
+  enum State : uint8_t {
+    kIdle = 0,
+    kAllocating,
+    kConnecting,
+    kNegotiating,
+    kStreaming,
+    kRetrying,
+    kStopping,
+    kStopped,
+    kNumStates
+  };
+
+  struct Transition {
+    State state;
+    int64_t time_ms;  // wall clock, since the Unix epoch
+  };
+
+  /// @param notify: called on any thread once transitions are queued
+  explicit Lifecycle(std::function<void()> notify);
+
+  State state() const { return static_cast<State>(word_.load(std::memory_order_acquire) & 0xff); }
+  /// @return when the state was entered, in wall clock milliseconds since the Unix epoch
+  int64_t since_ms() const { return static_cast<int64_t>(word_.load(std::memory_order_acquire) >> 8); }
+  static const char* StateString(State state);
+
+  /// Enters @a state. Any thread.
+  void Set(State state);
+  /// Enters @a to if in @a from. Any thread. @return false if in another state
+  bool Change(State from, State to);
+  /// Called by the taps on media threads for each frame. A single load once streaming.
+  void OnFrame(FrameTrack track, int64_t now_ns);
+  /// Called on JS thread. @return transitions queued since the last call, oldest first
+  std::vector<Transition> Take();
+  /// No notification from here on, e.g. as the subscriber is gone. Media threads may still hold this.
+  void Close();
+
+  static constexpr int64_t kNegotiationMs = 3000;
+
+ private:
+  static uint64_t Word(State state, int64_t time_ms) { return (static_cast<uint64_t>(time_ms) << 8) | state; }
+  /// called with mutex_ held
+  void Queue(State state, int64_t time_ms);
+
+  /// state in the low byte, the time it was entered above. written with mutex_ held.
+  std::atomic<uint64_t> word_;
+  std::atomic<uint8_t> tracks_{0};          // bits of FrameTrack with frames since connecting or retrying
+  std::atomic<int64_t> negotiating_ns_{0};  // steady clock
+  std::mutex mutex_;
+  std::function<void()> notify_;            // guarded by mutex_
+  std::vector<Transition> queued_;          // guarded by mutex_
+};
+
+}  // namespace ew
+
+#endif  // LIFECYCLE_H_
@@ -0,0 +1,119 @@
+/// @copyright © 2017 Airtime Media.  All rights reserved.
+
+#include <algorithm>
+
+#include "loop_stats.h"
+#include "steady_clock.h"
+#include "pipeline_trace.h"
+
+namespace ew {
+
+using namespace std;
+
+constexpr size_t LatencyHistogram::kBuckets;
+constexpr chrono::milliseconds LoopStats::kProbeInterval;
+constexpr chrono::milliseconds LoopStats::kLagProbeDelay;
+
+void LatencyHistogram::Add(int64_t duration_ns) {
+  auto us = static_cast<uint64_t>(max<int64_t>(0, duration_ns) / 1000);
+  size_t bucket = 0;
+  for (auto v = us; 0 < v && bucket + 1 < kBuckets; v >>= 1) ++bucket;
+  buckets_[bucket].fetch_add(1, memory_order_relaxed);
+  auto prev = max_us_.load(memory_order_relaxed);
+  while (prev < us && !max_us_.compare_exchange_weak(prev, us, memory_order_relaxed)) {}
+}
+
+LatencyHistogram::Snapshot LatencyHistogram::Take() const {
+  Snapshot snapshot;
+  for (size_t i = 0; i < kBuckets; ++i) {
+    snapshot.buckets[i] = buckets_[i].load(memory_order_relaxed);
+    snapshot.count += snapshot.buckets[i];
+  }
+  snapshot.max_us = max_us_.load(memory_order_relaxed);
+  return snapshot;
+}
+
+uint64_t LatencyHistogram::Snapshot::Percentile(double q) const {
+  if (0 == count) return 0;
+  auto rank = static_cast<uint64_t>(q * count);
+  uint64_t seen = 0;
+  for (size_t i = 0; i < kBuckets; ++i) {
+    seen += buckets[i];
+    if (rank < seen) return min<uint64_t>(uint64_t(1) << i, max_us);
+  }
+  return max_us;
+}
+
+LoopStats& LoopStats::Instance() {
+  static LoopStats instance;
+  return instance;
+}
+
+LoopStats::~LoopStats() {
+  StopProbe();
+}
+
+LoopThreadStats& LoopStats::Current() {
+  thread_local shared_ptr<LoopThreadStats> stats;
+  if (!stats) {
+    lock_guard<mutex> lock(threads_mutex_);
+    stats = make_shared<LoopThreadStats>(static_cast<uint32_t>(threads_.size()));
+    threads_.push_back(stats);
+  }
+  return *stats;
+}
+
+vector<shared_ptr<LoopThreadStats>> LoopStats::Threads() const {
+  lock_guard<mutex> lock(threads_mutex_);
+  return threads_;
+}
+
+void LoopStats::StartProbe(const at::Ptr<at::EventLoop>& loop, uint32_t num_threads) {
+  lock_guard<mutex> lock(probe_mutex_);
+  if (probing_) return;
+  probing_ = true;
+  probe_thread_ = thread([this, loop, num_threads]() {
+    unique_lock<mutex> lock(probe_mutex_);
+    while (probing_) {
+      lock.unlock();
+      Probe(loop, num_threads);
+      lock.lock();
+      wake_.wait_for(lock, kProbeInterval);
+    }
+  });
+}
+
+void LoopStats::StopProbe() {
+  {
+    lock_guard<mutex> lock(probe_mutex_);
+    if (!probing_) return;
+    probing_ = false;
+  }
+  wake_.notify_one();
+  probe_thread_.join();
+}
+
+void LoopStats::Probe(const at::Ptr<at::EventLoop>& loop, uint32_t num_threads) {
+  // one immediate probe per thread, so that idle threads are likely to pick some of them
+  for (uint32_t i = 0; i < num_threads; ++i) {
+    auto posted_ns = SteadyNowNs();
+    pending_probes_.fetch_add(1, memory_order_relaxed);
+    loop->Post([this, posted_ns]() {
+      auto begin_ns = SteadyNowNs();
+      auto& stats = Current();
+      stats.queue_wait.Add(begin_ns - posted_ns);
+      pending_probes_.fetch_sub(1, memory_order_relaxed);
+      stats.tasks.fetch_add(1, memory_order_relaxed);
+      stats.run.Add(SteadyNowNs() - begin_ns);
+      if (PipelineTrace::Enabled()) {
+        PipelineTrace::Instance().Complete("loop.queueWait", posted_ns, begin_ns);
+      }
+    });
+  }
+  auto due_ns = SteadyNowNs() + chrono::duration_cast<chrono::nanoseconds>(kLagProbeDelay).count();
+  loop->PostDelayed([this, due_ns]() {
+    Current().lag.Add(SteadyNowNs() - due_ns);
+  }, kLagProbeDelay);
+}
+
+}  // namespace ew
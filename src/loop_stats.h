@@ -0,0 +1,100 @@
+/// @copyright © 2017 Airtime Media.  All rights reserved.
+
+#ifndef LOOP_STATS_H_
+#define LOOP_STATS_H_
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "mediacore/defs.h"
+#include "mediacore/async/eventloop.h"
+
+
+namespace ew {
+
+/**
+ * Lock-free histogram of durations in log2 microsecond buckets.
+ * Bucket 0 counts durations below 1us, bucket i counts [2^(i-1), 2^i) us, the last one everything longer.
+ */
+class LatencyHistogram {
+ public:
+  static constexpr size_t kBuckets = 24;  // the last bucket starts at ~4.2s
+
+  void Add(int64_t duration_ns);
+
+  struct Snapshot {
+    uint64_t count = 0;
+    uint64_t max_us = 0;
+    std::array<uint64_t, kBuckets> buckets{};
+    /// @return upper bound in microseconds of the bucket containing quantile @a q (0 if empty)
+    uint64_t Percentile(double q) const;
+  };
+  Snapshot Take() const;
+
+ private:
+  std::atomic<uint64_t> buckets_[kBuckets] = {};
+  std::atomic<uint64_t> max_us_{0};
+};
+
+/// Statistics of one thread running event loop tasks. Written by the thread only.
+struct LoopThreadStats {
+  explicit LoopThreadStats(uint32_t index) : index(index) {}
+
+  const uint32_t index;  // in order of first task observed
+  std::atomic<uint64_t> tasks{0};
+  LatencyHistogram queue_wait;  // from post to start, measured by probes
+  LatencyHistogram run;         // run time of probes and sink deliveries
+  LatencyHistogram lag;         // delayed probes firing later than due
+  /// heap allocations by the thread (decode included), as of its latest sink delivery. AllocCounter builds only.
+  std::atomic<uint64_t> allocations{0};
+};
+
+/**
+ * Process-wide health statistics of the shared event loop.
+ * The core loop is opaque, so the loop is sampled by probe tasks posted from a dedicated thread,
+ * and sink deliveries are timed by the sink taps (see TrackContext).
+ */
+class LoopStats {
+ public:
+  static LoopStats& Instance();
+
+  /// @return stats of the calling thread, registered on first call
+  LoopThreadStats& Current();
+  std::vector<std::shared_ptr<LoopThreadStats>> Threads() const;
+  /// @return probes posted and not yet run. grows when the loop cannot keep up.
+  uint64_t PendingProbes() const { return pending_probes_.load(std::memory_order_relaxed); }
+
+  /// Starts probing @a loop. Called when the shared event loop is created.
+  void StartProbe(const at::Ptr<at::EventLoop>& loop, uint32_t num_threads);
+  /// Stops probing. Called before the shared event loop is stopped.
+  void StopProbe();
+
+  static constexpr std::chrono::milliseconds kProbeInterval{100};
+  static constexpr std::chrono::milliseconds kLagProbeDelay{50};
+
+ private:
+  LoopStats() = default;
+  ~LoopStats();
+
+  void Probe(const at::Ptr<at::EventLoop>& loop, uint32_t num_threads);
+
+  mutable std::mutex threads_mutex_;
+  std::vector<std::shared_ptr<LoopThreadStats>> threads_;  // guarded by threads_mutex_
+
+  std::atomic<uint64_t> pending_probes_{0};
+
+  std::mutex probe_mutex_;
+  std::condition_variable wake_;
+  bool probing_ = false;  // guarded by probe_mutex_
+  std::thread probe_thread_;
+};
+
+}  // namespace ew
+
+#endif  // LOOP_STATS_H_
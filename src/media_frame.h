@@ -0,0 +1,62 @@
+/// @copyright © 2017 Airtime Media.  All rights reserved.
+
+#ifndef MEDIA_FRAME_H_
+#define MEDIA_FRAME_H_
+
+#include <cstdint>
+
+#include "eastwood/sink/audio_sink.h"
+#include "eastwood/sink/video_sink.h"
+
+
+namespace ew {
+
+enum FrameTrack : uint8_t { kTrackAudio = 0, kTrackVideo = 1 };
+
+inline const char* TrackString(FrameTrack track) {
+  return (kTrackAudio == track) ? "audio" : "video";
+}
+
+/// Frame properties the addon looks at. This file is the only place that reads or makes mediacore frame objects.
+struct FrameMeta {
+  int64_t timestamp_us = 0;  // media timestamp
+  uint32_t size = 0;         // payload bytes
+  uint16_t width = 0;        // video only
+  uint16_t height = 0;       // video only
+  uint32_t sample_rate = 0;  // audio only
+  uint8_t channels = 0;      // audio only
+};
+
+inline FrameMeta MetaOf(const at::AudioFrame& frame) {
+  FrameMeta meta;
+  meta.timestamp_us = frame.timestamp_us();
+  meta.size = static_cast<uint32_t>(frame.size());
+  meta.sample_rate = static_cast<uint32_t>(frame.sample_rate());
+  meta.channels = static_cast<uint8_t>(frame.channels());
+  return meta;
+}
+
+inline FrameMeta MetaOf(const at::VideoFrame& frame) {
+  FrameMeta meta;
+  meta.timestamp_us = frame.timestamp_us();
+  meta.size = static_cast<uint32_t>(frame.size());
+  meta.width = static_cast<uint16_t>(frame.width());
+  meta.height = static_cast<uint16_t>(frame.height());
+  return meta;
+}
+
+inline const uint8_t* PayloadOf(const at::AudioFrame& frame) { return frame.data(); }
+inline const uint8_t* PayloadOf(const at::VideoFrame& frame) { return frame.data(); }
+
+/// Makes a frame equivalent to the one @a meta and @a payload were taken from
+inline at::AudioFrame MakeAudioFrame(const FrameMeta& meta, const uint8_t* payload) {
+  return at::AudioFrame(payload, meta.size, meta.sample_rate, meta.channels, meta.timestamp_us);
+}
+
+inline at::VideoFrame MakeVideoFrame(const FrameMeta& meta, const uint8_t* payload) {
+  return at::VideoFrame(payload, meta.size, meta.width, meta.height, meta.timestamp_us);
+}
+
+}  // namespace ew
+
+#endif  // MEDIA_FRAME_H_
@@ -0,0 +1,301 @@
+/// @copyright © 2017 Airtime Media.  All rights reserved.
+
+#include <sys/stat.h>
+
+#include <cstdio>
+#include <algorithm>
+#include <utility>
+
+#include "memory_segments.h"
+#include "uv_handles.h"
+
+namespace ew {
+
+using namespace std;
+using namespace string_literals;
+
+constexpr size_t SegmentPool::kMinBlockBytes;
+constexpr size_t SegmentPool::kMaxPooledBytes;
+
+namespace {
+
+bool Before(const uv_timespec_t& a, const uv_timespec_t& b) {
+  return (a.tv_sec < b.tv_sec) || (a.tv_sec == b.tv_sec && a.tv_nsec < b.tv_nsec);
+}
+
+bool IsTemporary(const string& name) {
+  return 4 <= name.size() && 0 == name.compare(name.size() - 4, 4, ".tmp");
+}
+
+/// @return false if @a path does not exist
+bool Stat(const string& path, uv_stat_t& stat) {
+  uv_fs_t req;
+  auto result = uv_fs_stat(nullptr, &req, path.c_str(), nullptr);
+  if (0 == result) stat = req.statbuf;
+  uv_fs_req_cleanup(&req);
+  return 0 == result;
+}
+
+void Unlink(const string& path) {
+  uv_fs_t req;
+  uv_fs_unlink(nullptr, &req, path.c_str(), nullptr);
+  uv_fs_req_cleanup(&req);
+}
+
+vector<string> ListFiles(const string& dir) {
+  vector<string> names;
+  uv_fs_t req;
+  if (0 <= uv_fs_scandir(nullptr, &req, dir.c_str(), 0, nullptr)) {
+    uv_dirent_t entry;
+    while (UV_EOF != uv_fs_scandir_next(&req, &entry)) {
+      if (UV_DIRENT_FILE == entry.type || UV_DIRENT_UNKNOWN == entry.type) names.emplace_back(entry.name);
+    }
+  }
+  uv_fs_req_cleanup(&req);
+  return names;
+}
+
+}  // namespace
+
+// --------------------------------------------
+
+SegmentPool& SegmentPool::Instance() {
+  static SegmentPool pool;
+  return pool;
+}
+
+SegmentPool::~SegmentPool() {
+  for (auto& blocks : free_) {
+    for (auto data : blocks.second) delete[] data;
+  }
+}
+
+uint8_t* SegmentPool::Acquire(size_t size, size_t& capacity) {
+  capacity = kMinBlockBytes;
+  while (capacity < size) capacity *= 2;
+  {
+    lock_guard<mutex> lock(mutex_);
+    auto& blocks = free_[capacity];
+    if (!blocks.empty()) {
+      auto data = blocks.back();
+      blocks.pop_back();
+      pooled_bytes_ -= capacity;
+      return data;
+    }
+  }
+  return new uint8_t[capacity];
+}
+
+void SegmentPool::Release(uint8_t* data, size_t capacity) {
+  {
+    lock_guard<mutex> lock(mutex_);
+    if (pooled_bytes_ + capacity <= kMaxPooledBytes) {
+      free_[capacity].push_back(data);
+      pooled_bytes_ += capacity;
+      return;
+    }
+  }
+  delete[] data;
+}
+
+// --------------------------------------------
+
+SegmentStore::Block* SegmentStore::Load(const string& path) {
+  auto file = fopen(path.c_str(), "rb");
+  if (!file) return nullptr;
+  fseek(file, 0, SEEK_END);
+  auto size = ftell(file);
+  fseek(file, 0, SEEK_SET);
+  if (size < 0) {
+    fclose(file);
+    return nullptr;
+  }
+  auto block = new Block;
+  block->data = SegmentPool::Instance().Acquire(static_cast<size_t>(size), block->capacity);
+  block->size = fread(block->data, 1, static_cast<size_t>(size), file);
+  fclose(file);
+  block->store = shared_from_this();
+  lock_guard<mutex> lock(mutex_);
+  blocks_[block->data] = block;
+  held_bytes_ += block->capacity;
+  ++delivered_;
+  return block;
+}
+
+bool SegmentStore::Holds(const uint8_t* data) const {
+  lock_guard<mutex> lock(mutex_);
+  return blocks_.count(data);
+}
+
+bool SegmentStore::Release(const uint8_t* data) {
+  Block* block = nullptr;
+  {
+    lock_guard<mutex> lock(mutex_);
+    auto it = blocks_.find(data);
+    if (it == blocks_.end()) return false;
+    block = it->second;
+  }
+  // the Buffer still points at the block, which is deleted by Free()
+  Return(block);
+  return true;
+}
+
+void SegmentStore::Return(Block* block) {
+  {
+    lock_guard<mutex> lock(mutex_);
+    blocks_.erase(block->data);
+    held_bytes_ -= block->capacity;
+  }
+  SegmentPool::Instance().Release(block->data, block->capacity);
+  block->data = nullptr;
+}
+
+void SegmentStore::Free(char* data, void* hint) {
+  auto block = static_cast<Block*>(hint);
+  if (block->data) block->store->Return(block);
+  delete block;
+}
+
+uint64_t SegmentStore::delivered() const {
+  lock_guard<mutex> lock(mutex_);
+  return delivered_;
+}
+
+size_t SegmentStore::held() const {
+  lock_guard<mutex> lock(mutex_);
+  return blocks_.size();
+}
+
+int64_t SegmentStore::held_bytes() const {
+  lock_guard<mutex> lock(mutex_);
+  return held_bytes_;
+}
+
+// --------------------------------------------
+
+unique_ptr<SegmentWatcher> SegmentWatcher::Start(uv_loop_t* loop, uint32_t subscriber_id, const string& manifest,
+                                                 shared_ptr<SegmentStore> store, OnFile on_file, string& err) {
+  // tmpfs keeps the segments off the disk
+  auto base = "/dev/shm"s;
+  uv_stat_t stat;
+  if (!Stat(base, stat) || !(stat.st_mode & S_IFDIR)) {
+    char tmp[1024];
+    size_t tmp_size = sizeof(tmp);
+    if (0 != uv_os_tmpdir(tmp, &tmp_size)) {
+      err = "No temporary directory for segments";
+      return nullptr;
+    }
+    base = tmp;
+  }
+  uv_fs_t req;
+  auto pattern = base + "/ew-segments-" + to_string(subscriber_id) + "-XXXXXX";
+  auto result = uv_fs_mkdtemp(nullptr, &req, pattern.c_str(), nullptr);
+  auto dir = (0 == result) ? string(req.path) : ""s;
+  uv_fs_req_cleanup(&req);
+  if (dir.empty()) {
+    err = "Cannot create segment directory in " + base + ": " + uv_strerror(result);
+    return nullptr;
+  }
+
+  unique_ptr<SegmentWatcher> watcher(new SegmentWatcher(dir, manifest, move(store), move(on_file)));
+  watcher->event_ = NewBackgroundFsEvent(loop, watcher.get());
+  result = uv_fs_event_start(watcher->event_, [](uv_fs_event_t* handle, const char* filename, int events, int status) {
+    if (0 == status && handle->data) static_cast<SegmentWatcher*>(handle->data)->Scan(false);
+  }, dir.c_str(), 0);
+  watcher->finish_async_ = NewBackgroundAsync(loop, [](uv_async_t* async) {
+    auto self = static_cast<SegmentWatcher*>(async->data);
+    if (!self) return;
+    function<void()> done;
+    {
+      lock_guard<mutex> lock(self->finish_mutex_);
+      done = move(self->done_);
+    }
+    self->Scan(true);
+    self->Close();
+    if (done) done();
+  }, watcher.get());
+  if (0 != result) {
+    err = "Cannot watch " + dir + ": " + uv_strerror(result);
+    return nullptr;  // the destructor removes the directory
+  }
+  return watcher;
+}
+
+SegmentWatcher::SegmentWatcher(string dir, string manifest, shared_ptr<SegmentStore> store, OnFile on_file)
+  : dir_(move(dir)), manifest_(move(manifest)), store_(move(store)), on_file_(move(on_file)) {
+}
+
+SegmentWatcher::~SegmentWatcher() {
+  Close();
+}
+
+void SegmentWatcher::Finish(function<void()> done) {
+  {
+    lock_guard<mutex> lock(finish_mutex_);
+    if (finish_async_) {
+      done_ = move(done);
+      uv_async_send(finish_async_);
+      return;
+    }
+  }
+  // closed already
+  if (done) done();
+}
+
+void SegmentWatcher::Scan(bool all) {
+  if (finished_) return;
+  uv_stat_t manifest_stat;
+  auto has_manifest = Stat(ManifestPath(), manifest_stat);
+  if (!all && (!has_manifest || !Before(manifest_mtime_, manifest_stat.st_mtim))) return;
+
+  // segments closed before the manifest was rewritten, in the order written
+  vector<pair<uv_timespec_t, string>> segments;
+  for (const auto& name : ListFiles(dir_)) {
+    if (name == manifest_ || IsTemporary(name)) continue;
+    uv_stat_t stat;
+    if (!Stat(dir_ + "/" + name, stat)) continue;
+    if (all || Before(stat.st_mtim, manifest_stat.st_mtim)) segments.emplace_back(stat.st_mtim, name);
+  }
+  sort(segments.begin(), segments.end(), [](const pair<uv_timespec_t, string>& a,
+                                            const pair<uv_timespec_t, string>& b) {
+    return Before(a.first, b.first) || (!Before(b.first, a.first) && a.second < b.second);
+  });
+  for (const auto& segment : segments) {
+    auto path = dir_ + "/" + segment.second;
+    auto block = store_->Load(path);
+    Unlink(path);
+    if (block) on_file_(segment.second, block, false);
+  }
+  if (has_manifest) {
+    manifest_mtime_ = manifest_stat.st_mtim;
+    // the segmenter rewrites it, so it stays until the end
+    auto block = store_->Load(ManifestPath());
+    if (all) Unlink(ManifestPath());
+    if (block) on_file_(manifest_, block, true);
+  }
+}
+
+void SegmentWatcher::Close() {
+  if (finished_) return;
+  finished_ = true;
+  if (event_) {
+    event_->data = nullptr;
+    CloseHandle(event_);
+    event_ = nullptr;
+  }
+  {
+    lock_guard<mutex> lock(finish_mutex_);
+    if (finish_async_) {
+      finish_async_->data = nullptr;
+      CloseHandle(finish_async_);
+      finish_async_ = nullptr;
+    }
+  }
+  // anything not handed over yet is dropped
+  for (const auto& name : ListFiles(dir_)) Unlink(dir_ + "/" + name);
+  uv_fs_t req;
+  uv_fs_rmdir(nullptr, &req, dir_.c_str(), nullptr);
+  uv_fs_req_cleanup(&req);
+}
+
+}  // namespace ew
@@ -0,0 +1,120 @@
+/// @copyright © 2017 Airtime Media.  All rights reserved.
+
+#ifndef MEMORY_SEGMENTS_H_
+#define MEMORY_SEGMENTS_H_
+
+#include <uv.h>
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+
+namespace ew {
+
+/// Process-wide pool of segment buffers, in power of two sizes, so that steady segment sizes reuse memory.
+class SegmentPool {
+ public:
+  static SegmentPool& Instance();
+
+  /// @return block of @a capacity (at least @a size) bytes
+  uint8_t* Acquire(size_t size, size_t& capacity);
+  void Release(uint8_t* data, size_t capacity);
+
+  static constexpr size_t kMinBlockBytes = 64 << 10;
+  /// freed blocks beyond this are returned to the system
+  static constexpr size_t kMaxPooledBytes = 64 << 20;
+
+ private:
+  SegmentPool() = default;
+  ~SegmentPool();
+
+  std::mutex mutex_;
+  std::map<size_t, std::vector<uint8_t*>> free_;  // by capacity. guarded by mutex_
+  size_t pooled_bytes_ = 0;                       // guarded by mutex_
+};
+
+/**
+ * Segments of one subscriber handed to JS, until released or garbage collected.
+ * Blocks are lent to JS as external Buffers, and come back to the pool through Free() or Release().
+ */
+class SegmentStore : public std::enable_shared_from_this<SegmentStore> {
+ public:
+  struct Block {
+    uint8_t* data = nullptr;  // null once returned to the pool
+    size_t capacity = 0;
+    size_t size = 0;
+    std::shared_ptr<SegmentStore> store;  // keeps the accounting alive until the Buffer is gone
+  };
+
+  /// Reads @a path into a pooled block. @return null if it cannot be read
+  Block* Load(const std::string& path);
+  /// @return true if @a data is the start of a block lent to JS
+  bool Holds(const uint8_t* data) const;
+  /// Returns the memory of the block holding @a data to the pool. @return false if not held
+  bool Release(const uint8_t* data);
+  /// node::Buffer free callback. @a hint is the Block.
+  static void Free(char* data, void* hint);
+
+  uint64_t delivered() const;
+  size_t held() const;
+  int64_t held_bytes() const;
+
+ private:
+  void Return(Block* block);
+
+  mutable std::mutex mutex_;
+  std::map<const uint8_t*, Block*> blocks_;  // lent to JS. guarded by mutex_
+  int64_t held_bytes_ = 0;                   // guarded by mutex_
+  uint64_t delivered_ = 0;                   // guarded by mutex_
+};
+
+/**
+ * Private directory the FFmpeg segmenter writes into, on tmpfs where there is one.
+ * Watched on the JS thread: each rewrite of the manifest (playlist) completes the segments written
+ * before it, which are loaded into the store, unlinked and handed to the callback.
+ */
+class SegmentWatcher {
+ public:
+  /// name: file name, block: loaded file, manifest: true for the playlist itself
+  using OnFile = std::function<void(const std::string& name, SegmentStore::Block* block, bool manifest)>;
+
+  /// @return null with @a err set if the directory cannot be made or watched
+  static std::unique_ptr<SegmentWatcher> Start(uv_loop_t* loop, uint32_t subscriber_id, const std::string& manifest,
+                                               std::shared_ptr<SegmentStore> store, OnFile on_file, std::string& err);
+  ~SegmentWatcher();
+
+  /// output to give the FFmpeg sink
+  std::string ManifestPath() const { return dir_ + "/" + manifest_; }
+
+  /**
+   * Called once the segmenter is closed, from any thread. Hands the remaining files over and removes
+   * the directory on the JS thread, and then calls @a done there.
+   */
+  void Finish(std::function<void()> done);
+
+ private:
+  SegmentWatcher(std::string dir, std::string manifest, std::shared_ptr<SegmentStore> store, OnFile on_file);
+  /// @param all: takes every file, as the segmenter is done
+  void Scan(bool all);
+  void Close();
+
+  const std::string dir_;
+  const std::string manifest_;
+  std::shared_ptr<SegmentStore> store_;
+  OnFile on_file_;
+  uv_timespec_t manifest_mtime_ = {0, 0};
+  uv_fs_event_t* event_ = nullptr;
+  uv_async_t* finish_async_ = nullptr;
+  std::mutex finish_mutex_;  // finish_async_ is closed on JS thread while Finish() may be called elsewhere
+  std::function<void()> done_;  // guarded by finish_mutex_
+  bool finished_ = false;
+};
+
+}  // namespace ew
+
+#endif  // MEMORY_SEGMENTS_H_
@@ -0,0 +1,59 @@
+/// @copyright © 2017 Airtime Media.  All rights reserved.
+
+#include <unistd.h>
+
+#include <fstream>
+
+#include "memory_watch.h"
+#include "addon_data.h"
+#include "subscriber.h"
+#include "uv_handles.h"
+
+namespace ew {
+
+using namespace std;
+
+atomic<int64_t> MemoryWatch::rss_bytes_{0};
+atomic<int64_t> MemoryWatch::process_limit_bytes_{0};
+
+MemoryWatch::MemoryWatch(AddonData* data)
+  : data_(data) {
+}
+
+MemoryWatch::~MemoryWatch() {
+  if (timer_) CloseHandle(timer_);
+}
+
+void MemoryWatch::Start() {
+  if (timer_) return;
+  rss_bytes_ = ReadRssBytes();
+  timer_ = NewBackgroundTimer(data_->uv_loop, this);
+  uv_timer_start(timer_, OnTimer, kIntervalMs, kIntervalMs);
+}
+
+int64_t MemoryWatch::ReadRssBytes() {
+  // second field of statm is resident pages. not available other than on Linux.
+  ifstream statm("/proc/self/statm");
+  int64_t size_pages = 0;
+  int64_t resident_pages = 0;
+  if (!(statm >> size_pages >> resident_pages)) return 0;
+  return resident_pages * sysconf(_SC_PAGESIZE);
+}
+
+bool MemoryWatch::OverProcessLimit() {
+  auto limit = ProcessLimit();
+  if (0 == limit) return false;
+  rss_bytes_ = ReadRssBytes();
+  return limit < RssBytes();
+}
+
+void MemoryWatch::OnTimer(uv_timer_t* timer) {
+  auto self = static_cast<MemoryWatch*>(timer->data);
+  rss_bytes_ = ReadRssBytes();
+  // a subscriber may be stopped by its cap, which does not remove it from the set
+  for (auto subscriber : self->data_->subscribers) {
+    subscriber->UpdateMemory();
+  }
+}
+
+}  // namespace ew
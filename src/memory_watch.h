@@ -0,0 +1,54 @@
+/// @copyright © 2017 Airtime Media.  All rights reserved.
+
+#ifndef MEMORY_WATCH_H_
+#define MEMORY_WATCH_H_
+
+#include <uv.h>
+
+#include <atomic>
+#include <cstdint>
+
+
+namespace ew {
+
+struct AddonData;
+
+/**
+ * Periodic native memory accounting of the subscribers of one isolate.
+ * Each subscriber's estimate is reported to V8 as external memory, so that GC heuristics see it,
+ * and checked against its cap. Process RSS is checked against the process-wide limit.
+ */
+class MemoryWatch {
+ public:
+  explicit MemoryWatch(AddonData* data);
+  ~MemoryWatch();
+
+  /// Starts periodic accounting if not yet. Called when a subscriber starts.
+  void Start();
+
+  /// @return resident set size of the process in bytes (0 if unknown), as of the last check
+  static int64_t RssBytes() { return rss_bytes_.load(std::memory_order_relaxed); }
+  /// Reads RSS now. @return bytes, 0 if unavailable
+  static int64_t ReadRssBytes();
+
+  /// process-wide RSS limit in bytes. 0 disables.
+  static void SetProcessLimit(int64_t bytes) { process_limit_bytes_.store(bytes, std::memory_order_relaxed); }
+  static int64_t ProcessLimit() { return process_limit_bytes_.load(std::memory_order_relaxed); }
+  /// @return true if RSS (read now) is over the process limit
+  static bool OverProcessLimit();
+
+  static constexpr uint64_t kIntervalMs = 1000;
+
+ private:
+  static void OnTimer(uv_timer_t* timer);
+
+  AddonData* data_;
+  uv_timer_t* timer_ = nullptr;
+
+  static std::atomic<int64_t> rss_bytes_;
+  static std::atomic<int64_t> process_limit_bytes_;
+};
+
+}  // namespace ew
+
+#endif  // MEMORY_WATCH_H_
@@ -0,0 +1,145 @@
+/// @copyright © 2017 Airtime Media.  All rights reserved.
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <fstream>
+
+#include "pipeline_trace.h"
+
+namespace ew {
+
+using namespace std;
+
+constexpr size_t PipelineTrace::kMaxEvents;
+constexpr chrono::milliseconds PipelineTrace::kCollectInterval;
+
+atomic<bool> PipelineTrace::enabled_{false};
+
+PipelineTrace& PipelineTrace::Instance() {
+  static PipelineTrace instance;
+  return instance;
+}
+
+PipelineTrace::~PipelineTrace() {
+  vector<TraceEvent> events;
+  uint64_t dropped = 0;
+  Stop(events, dropped);
+}
+
+PipelineTrace::ThreadBuffer& PipelineTrace::Current() {
+  thread_local shared_ptr<ThreadBuffer> buffer;
+  if (!buffer) {
+    buffer = make_shared<ThreadBuffer>();
+    lock_guard<mutex> lock(buffers_mutex_);
+    buffer->index = static_cast<uint32_t>(buffers_.size());
+    buffers_.push_back(buffer);
+  }
+  return *buffer;
+}
+
+void PipelineTrace::Complete(const char* name, int64_t begin_ns, int64_t end_ns, uint32_t subscriber_id,
+                             uint32_t seq) {
+  auto& buffer = Current();
+  buffer.ring.Push({ name, begin_ns, end_ns, subscriber_id, seq, buffer.index });
+}
+
+bool PipelineTrace::Start() {
+  lock_guard<mutex> lock(thread_mutex_);
+  if (running_) return false;
+  {
+    // spans completed after the previous Stop()
+    lock_guard<mutex> collect_lock(collect_mutex_);
+    lock_guard<mutex> buffers_lock(buffers_mutex_);
+    for (auto& buffer : buffers_) {
+      buffer->ring.Drain([](const TraceEvent&) {});
+      buffer->ring.TakeDropped();
+    }
+    events_.clear();
+    dropped_ = 0;
+  }
+  running_ = true;
+  enabled_.store(true, memory_order_relaxed);
+  thread_ = thread([this]() {
+    unique_lock<mutex> lock(thread_mutex_);
+    while (running_) {
+      wake_.wait_for(lock, kCollectInterval);
+      lock.unlock();
+      Collect();
+      lock.lock();
+    }
+  });
+  return true;
+}
+
+bool PipelineTrace::Stop(vector<TraceEvent>& events, uint64_t& dropped) {
+  {
+    lock_guard<mutex> lock(thread_mutex_);
+    if (!running_) return false;
+    running_ = false;
+    enabled_.store(false, memory_order_relaxed);
+  }
+  wake_.notify_one();
+  thread_.join();
+  Collect();
+
+  lock_guard<mutex> lock(collect_mutex_);
+  events.swap(events_);
+  events_.clear();
+  dropped = dropped_;
+  return true;
+}
+
+void PipelineTrace::Collect() {
+  vector<shared_ptr<ThreadBuffer>> buffers;
+  {
+    lock_guard<mutex> lock(buffers_mutex_);
+    buffers = buffers_;
+  }
+  lock_guard<mutex> lock(collect_mutex_);
+  for (auto& buffer : buffers) {
+    buffer->ring.Drain([this](const TraceEvent& event) {
+      if (events_.size() < kMaxEvents) {
+        events_.push_back(event);
+      } else {
+        ++dropped_;
+      }
+    });
+    dropped_ += buffer->ring.TakeDropped();
+  }
+  // thread indexes stay unique, so buffers of exited threads are not forgotten here
+}
+
+bool PipelineTrace::WriteChromeTrace(const string& filename, const vector<TraceEvent>& events) {
+  ofstream out(filename, ios::out | ios::trunc);
+  if (!out) return false;
+
+  auto base_ns = events.empty() ? 0 : events.front().begin_ns;
+  uint32_t max_thread = 0;
+  for (const auto& event : events) {
+    base_ns = min(base_ns, event.begin_ns);
+    max_thread = max(max_thread, event.thread);
+  }
+  auto pid = getpid();
+  out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  auto separator = "";
+  for (uint32_t thread = 0; !events.empty() && thread <= max_thread; ++thread) {
+    out << separator << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << pid << ",\"tid\":" << thread
+        << ",\"args\":{\"name\":\"eastwood-" << thread << "\"}}";
+    separator = ",\n";
+  }
+  out.setf(ios::fixed);
+  out.precision(3);
+  for (const auto& event : events) {
+    out << separator << "{\"name\":\"" << event.name << "\",\"cat\":\"eastwood\",\"ph\":\"X\""
+        << ",\"ts\":" << (event.begin_ns - base_ns) / 1e3 << ",\"dur\":" << (event.end_ns - event.begin_ns) / 1e3
+        << ",\"pid\":" << pid << ",\"tid\":" << event.thread
+        << ",\"args\":{\"subscriber\":" << event.subscriber_id << ",\"seq\":" << event.seq << "}}";
+    separator = ",\n";
+  }
+  out << "]}\n";
+  out.close();
+  return !out.fail();
+}
+
+}  // namespace ew
@@ -0,0 +1,107 @@
+/// @copyright © 2017 Airtime Media.  All rights reserved.
+
+#ifndef PIPELINE_TRACE_H_
+#define PIPELINE_TRACE_H_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "spsc_ring.h"
+#include "steady_clock.h"
+
+
+namespace ew {
+
+/// One completed span. @a name must be a string literal (only the pointer is kept).
+struct TraceEvent {
+  const char* name;
+  int64_t begin_ns;
+  int64_t end_ns;
+  uint32_t subscriber_id;  // 0 if not specific to a subscriber
+  uint32_t seq;            // frame number on the track, 0 if not about a frame
+  uint32_t thread;         // index of the recording thread
+};
+
+/**
+ * Process-wide span recorder for the media pipeline, switched on and off at runtime.
+ * Threads push completed spans into their own lock-free ring. A collector thread moves them
+ * into one buffer, written out as Chrome trace-event JSON (loadable by chrome://tracing and Perfetto UI).
+ * When off, recording a span costs one relaxed atomic load.
+ */
+class PipelineTrace {
+ public:
+  static PipelineTrace& Instance();
+
+  static bool Enabled() { return enabled_.load(std::memory_order_relaxed); }
+
+  /// Discards previous spans and starts recording. @return false if already recording
+  bool Start();
+  /// Stops recording. @a events receives recorded spans, @a dropped the number of spans lost.
+  /// @return false if not recording
+  bool Stop(std::vector<TraceEvent>& events, uint64_t& dropped);
+
+  /// Records a span of the calling thread. Never blocks.
+  void Complete(const char* name, int64_t begin_ns, int64_t end_ns, uint32_t subscriber_id = 0, uint32_t seq = 0);
+
+  /// Writes @a events to @a filename in Chrome trace-event format. @return false on I/O failure
+  static bool WriteChromeTrace(const std::string& filename, const std::vector<TraceEvent>& events);
+
+  static constexpr size_t kRingCapacity = 8192;      // per thread
+  static constexpr size_t kMaxEvents = 1 << 20;      // per session. further spans are dropped.
+  static constexpr std::chrono::milliseconds kCollectInterval{50};
+
+ private:
+  struct ThreadBuffer {
+    uint32_t index;
+    SpscRing<TraceEvent, kRingCapacity> ring;
+  };
+
+  PipelineTrace() = default;
+  ~PipelineTrace();
+
+  ThreadBuffer& Current();
+  void Collect();
+
+  static std::atomic<bool> enabled_;
+
+  std::mutex buffers_mutex_;
+  std::vector<std::shared_ptr<ThreadBuffer>> buffers_;  // guarded by buffers_mutex_
+
+  std::mutex collect_mutex_;  // single consumer of the rings
+  std::vector<TraceEvent> events_;  // guarded by collect_mutex_
+  uint64_t dropped_ = 0;            // guarded by collect_mutex_
+
+  std::mutex thread_mutex_;
+  std::condition_variable wake_;
+  bool running_ = false;  // guarded by thread_mutex_
+  std::thread thread_;
+};
+
+/// Records the lifetime of this object as a span, if tracing is on when constructed.
+class TraceSpan {
+ public:
+  explicit TraceSpan(const char* name, uint32_t subscriber_id = 0, uint32_t seq = 0)
+    : name_(PipelineTrace::Enabled() ? name : nullptr),
+      begin_ns_(name_ ? SteadyNowNs() : 0), subscriber_id_(subscriber_id), seq_(seq) {}
+  ~TraceSpan() {
+    if (name_) PipelineTrace::Instance().Complete(name_, begin_ns_, SteadyNowNs(), subscriber_id_, seq_);
+  }
+  TraceSpan(const TraceSpan&) = delete;
+  TraceSpan& operator=(const TraceSpan&) = delete;
+
+ private:
+  const char* name_;
+  int64_t begin_ns_;
+  uint32_t subscriber_id_;
+  uint32_t seq_;
+};
+
+}  // namespace ew
+
+#endif  // PIPELINE_TRACE_H_
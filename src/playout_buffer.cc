@@ -0,0 +1,131 @@
+/// @copyright © 2017 Airtime Media.  All rights reserved.
+
+#include <algorithm>
+#include <chrono>
+#include <utility>
+
+#include "playout_buffer.h"
+
+namespace ew {
+
+using namespace std;
+
+constexpr size_t PlayoutBuffer::kMaxHeldFrames;
+
+PlayoutBuffer::PlayoutBuffer(int64_t delay_ns, shared_ptr<FramePool> pool,
+                             shared_ptr<AudioSinkSlot> audio_slot, shared_ptr<VideoSinkSlot> video_slot,
+                             shared_ptr<TrackContext> audio, shared_ptr<TrackContext> video)
+  : delay_ns_(delay_ns), pool_(move(pool)), audio_slot_(move(audio_slot)), video_slot_(move(video_slot))
+  , audio_(move(audio)), video_(move(video)) {
+  thread_ = thread([this]() { Run(); });
+}
+
+PlayoutBuffer::~PlayoutBuffer() {
+  {
+    lock_guard<mutex> lock(mutex_);
+    running_ = false;
+  }
+  wake_.notify_one();
+  thread_.join();
+}
+
+bool PlayoutBuffer::Hold(FrameTrack track, uint32_t seq, int64_t arrival_ns, int64_t delay_ns,
+                         const FrameMeta& meta, const uint8_t* payload) {
+  auto due_ns = arrival_ns + delay_ns_ - delay_ns;
+  {
+    lock_guard<mutex> lock(mutex_);
+    auto& ring = rings_[track];
+    // a frame on its way to the sink may be of this track
+    if (0 == ring.size && !delivering_ && due_ns <= arrival_ns) return false;
+  }
+  // copied outside the lock. only the taps of this track push to its ring, one frame at a time.
+  auto buffer = pool_->Copy(payload, meta.size);
+  auto first = false;
+  {
+    lock_guard<mutex> lock(mutex_);
+    auto& ring = rings_[track];
+    if (ring.frames.size() == ring.size) {
+      auto& context = (kTrackAudio == track) ? *audio_ : *video_;
+      context.latency.OnOverflow();
+      return true;
+    }
+    first = (0 == ring.size);
+    // never before the frame held ahead of it
+    auto held_due_ns = first ? due_ns : max(due_ns, ring.back().due_ns);
+    auto& held = ring.push();
+    held.arrival_ns = arrival_ns;
+    held.due_ns = held_due_ns;
+    held.seq = seq;
+    held.meta = meta;
+    held.buffer = move(buffer);
+    held_bytes_ += meta.size;
+  }
+  if (first) wake_.notify_one();
+  return true;
+}
+
+void PlayoutBuffer::Flush() {
+  unique_lock<mutex> lock(mutex_);
+  flushing_ = true;
+  wake_.notify_one();
+  drained_.wait(lock, [this]() {
+    return (0 == rings_[kTrackAudio].size && 0 == rings_[kTrackVideo].size && !delivering_) || !running_;
+  });
+  flushing_ = false;
+}
+
+size_t PlayoutBuffer::held_bytes() const {
+  lock_guard<mutex> lock(mutex_);
+  return held_bytes_;
+}
+
+void PlayoutBuffer::Run() {
+  unique_lock<mutex> lock(mutex_);
+  while (running_) {
+    // the earlier of the two tracks' next frames
+    auto track = kTrackAudio;
+    auto& audio = rings_[kTrackAudio];
+    auto& video = rings_[kTrackVideo];
+    if (0 == audio.size || (0 < video.size && video.front().due_ns < audio.front().due_ns)) track = kTrackVideo;
+    auto& ring = rings_[track];
+    if (0 == ring.size) {
+      drained_.notify_all();
+      wake_.wait(lock);
+      continue;
+    }
+    auto wait_ns = ring.front().due_ns - TrackMonitor::NowNs();
+    if (!flushing_ && 0 < wait_ns) {
+      wake_.wait_for(lock, chrono::nanoseconds(wait_ns));
+      continue;
+    }
+    auto held = move(ring.front());
+    ring.pop();
+    held_bytes_ -= held.meta.size;
+    delivering_ = true;
+    lock.unlock();
+    Deliver(track, held);
+    held.buffer.reset();
+    lock.lock();
+    delivering_ = false;
+  }
+  // frames still held are dropped with the rings
+  drained_.notify_all();
+}
+
+void PlayoutBuffer::Deliver(FrameTrack track, Held& held) {
+  auto begin_ns = TrackMonitor::NowNs();
+  auto allocations = AllocCounter::Thread();
+  auto& context = (kTrackAudio == track) ? *audio_ : *video_;
+  if (kTrackAudio == track) {
+    TraceSpan span("audio.deliver", context.subscriber_id, held.seq);
+    lock_guard<mutex> lock(audio_slot_->mutex);
+    if (audio_slot_->sink) audio_slot_->sink->OnAudioFrame(MakeAudioFrame(held.meta, held.buffer.data()));
+  } else {
+    TraceSpan span("video.deliver", context.subscriber_id, held.seq);
+    lock_guard<mutex> lock(video_slot_->mutex);
+    if (video_slot_->sink) video_slot_->sink->OnVideoFrame(MakeVideoFrame(held.meta, held.buffer.data()));
+  }
+  context.OnDelivered(begin_ns, TrackMonitor::NowNs(), allocations, begin_ns - held.arrival_ns);
+}
+
+}  // namespace ew
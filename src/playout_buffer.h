@@ -0,0 +1,93 @@
+/// @copyright © 2017 Airtime Media.  All rights reserved.
+
+#ifndef PLAYOUT_BUFFER_H_
+#define PLAYOUT_BUFFER_H_
+
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "frame_pool.h"
+#include "media_frame.h"
+#include "sink_tap.h"
+
+
+namespace ew {
+
+/**
+ * Holds the frames of a subscriber until minDelay after the fastest frame of their track (see LatencyMonitor),
+ * so that sinks get them evenly paced despite network jitter. Media threads copy frames into pooled buffers
+ * in a ring per track, and its thread delivers them to the slots when due. Frames of a track stay in order:
+ * once one is held, the following ones are held too, even if due already.
+ */
+class PlayoutBuffer {
+ public:
+  PlayoutBuffer(int64_t delay_ns, std::shared_ptr<FramePool> pool,
+                std::shared_ptr<AudioSinkSlot> audio_slot, std::shared_ptr<VideoSinkSlot> video_slot,
+                std::shared_ptr<TrackContext> audio, std::shared_ptr<TrackContext> video);
+  /// Frames still held are dropped
+  ~PlayoutBuffer();
+
+  /// Called on media threads by the taps
+  /// @param delay_ns: transit of the frame over the fastest one
+  /// @return false if the frame is due already with nothing of its track held, for the caller to deliver it now.
+  ///         frames not fitting the ring are dropped, and counted as late.
+  bool Hold(FrameTrack track, uint32_t seq, int64_t arrival_ns, int64_t delay_ns,
+            const FrameMeta& meta, const uint8_t* payload);
+  /// Delivers all frames held, without waiting for them to be due. Called once no more frames come.
+  void Flush();
+
+  size_t held_bytes() const;
+
+  /// per track. about 10s of video at 60fps, or of audio in 10ms frames.
+  static constexpr size_t kMaxHeldFrames = 1024;
+
+ private:
+  struct Held {
+    int64_t arrival_ns = 0;
+    int64_t due_ns = 0;
+    uint32_t seq = 0;
+    FrameMeta meta;
+    FrameBuffer buffer;
+  };
+  /// fixed ring, so that holding frames does not allocate once the pool is warm
+  struct Ring {
+    std::vector<Held> frames = std::vector<Held>(kMaxHeldFrames);
+    size_t begin = 0;
+    size_t size = 0;
+
+    Held& front() { return frames[begin]; }
+    Held& back() { return frames[(begin + size - 1) % frames.size()]; }
+    Held& push() { return frames[(begin + size++) % frames.size()]; }
+    void pop() {
+      begin = (begin + 1) % frames.size();
+      --size;
+    }
+  };
+
+  void Run();
+  void Deliver(FrameTrack track, Held& held);
+
+  const int64_t delay_ns_;
+  std::shared_ptr<FramePool> pool_;
+  std::shared_ptr<AudioSinkSlot> audio_slot_;
+  std::shared_ptr<VideoSinkSlot> video_slot_;
+  std::shared_ptr<TrackContext> audio_;
+  std::shared_ptr<TrackContext> video_;
+  mutable std::mutex mutex_;
+  std::condition_variable wake_;
+  std::condition_variable drained_;
+  Ring rings_[2];             // by FrameTrack. guarded by mutex_
+  size_t held_bytes_ = 0;     // guarded by mutex_
+  bool delivering_ = false;   // a frame is out of the rings, on its way to the sink. guarded by mutex_
+  bool flushing_ = false;     // guarded by mutex_
+  bool running_ = true;       // guarded by mutex_
+  std::thread thread_;
+};
+
+}  // namespace ew
+
+#endif  // PLAYOUT_BUFFER_H_
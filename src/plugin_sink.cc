@@ -0,0 +1,105 @@
+/// @copyright © 2017 Airtime Media.  All rights reserved.
+
+#include <dlfcn.h>
+
+#include <map>
+#include <mutex>
+
+#include "plugin_sink.h"
+#include "media_frame.h"
+
+namespace ew {
+
+using namespace std;
+
+namespace {
+
+mutex libraries_mutex;
+map<string, weak_ptr<PluginLibrary>> libraries;  // guarded by libraries_mutex
+
+}  // namespace
+
+shared_ptr<PluginLibrary> PluginLibrary::Load(const string& path, string& err) {
+  lock_guard<mutex> lock(libraries_mutex);
+  auto it = libraries.find(path);
+  if (it != libraries.end()) {
+    if (auto library = it->second.lock()) return library;
+  }
+
+  auto handle = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+  if (!handle) {
+    err = "Cannot load " + path + ": " + dlerror();
+    return nullptr;
+  }
+  auto entry = reinterpret_cast<ew_sink_plugin_entry_fn>(dlsym(handle, EW_SINK_PLUGIN_ENTRY));
+  auto plugin = entry ? entry() : nullptr;
+  string reason;
+  if (!plugin) {
+    reason = path + " has no " EW_SINK_PLUGIN_ENTRY;
+  } else if (EW_SINK_PLUGIN_ABI_VERSION != plugin->abi_version || plugin->struct_size < sizeof(ew_sink_plugin)) {
+    reason = path + " is built for sink plugin ABI " + to_string(plugin->abi_version) + ", not "
+        + to_string(EW_SINK_PLUGIN_ABI_VERSION);
+  } else if (!plugin->open || !plugin->on_audio_frame || !plugin->on_video_frame || !plugin->flush
+          || !plugin->close) {
+    reason = path + " lacks sink functions";
+  }
+  if (!reason.empty()) {
+    err = reason;
+    dlclose(handle);
+    return nullptr;
+  }
+  auto library = shared_ptr<PluginLibrary>(new PluginLibrary(handle, plugin));
+  libraries[path] = library;
+  return library;
+}
+
+PluginLibrary::PluginLibrary(void* handle, const ew_sink_plugin* plugin)
+  : handle_(handle), plugin_(plugin) {
+}
+
+PluginLibrary::~PluginLibrary() {
+  dlclose(handle_);
+}
+
+shared_ptr<PluginSinkInstance> PluginSinkInstance::Open(const string& path, const string& params, string& err) {
+  auto library = PluginLibrary::Load(path, err);
+  if (!library) return nullptr;
+  char message[256] = "";
+  auto instance = library->plugin().open(params.c_str(), message, sizeof(message));
+  if (!instance) {
+    message[sizeof(message) - 1] = '\0';
+    err = path + " refused to open: " + message;
+    return nullptr;
+  }
+  return shared_ptr<PluginSinkInstance>(new PluginSinkInstance(move(library), instance));
+}
+
+PluginSinkInstance::PluginSinkInstance(shared_ptr<PluginLibrary> library, void* instance)
+  : library_(move(library)), plugin_(library_->plugin()), instance_(instance) {
+}
+
+PluginSinkInstance::~PluginSinkInstance() {
+  plugin_.flush(instance_);
+  plugin_.close(instance_);
+}
+
+void PluginSinkInstance::OnAudioFrame(const at::AudioFrame& frame) {
+  auto meta = MetaOf(frame);
+  ew_audio_frame audio = { PayloadOf(frame), meta.size, meta.sample_rate, meta.channels, meta.timestamp_us };
+  if (0 != plugin_.on_audio_frame(instance_, &audio)) errors_.fetch_add(1, memory_order_relaxed);
+}
+
+void PluginSinkInstance::OnVideoFrame(const at::VideoFrame& frame) {
+  auto meta = MetaOf(frame);
+  ew_video_frame video = { PayloadOf(frame), meta.size, meta.width, meta.height, meta.timestamp_us };
+  if (0 != plugin_.on_video_frame(instance_, &video)) errors_.fetch_add(1, memory_order_relaxed);
+}
+
+ew_sink_stats PluginSinkInstance::Stats() const {
+  ew_sink_stats stats = {};
+  if (plugin_.get_stats) plugin_.get_stats(instance_, &stats);
+  stats.errors += errors_.load(memory_order_relaxed);
+  return stats;
+}
+
+}  // namespace ew
@@ -0,0 +1,84 @@
+/// @copyright © 2017 Airtime Media.  All rights reserved.
+
+#ifndef PLUGIN_SINK_H_
+#define PLUGIN_SINK_H_
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "eastwood/sink/audio_sink.h"
+#include "eastwood/sink/video_sink.h"
+
+#include "eastwood_sink_plugin.h"
+
+
+namespace ew {
+
+/// A loaded sink plugin, shared by the instances of the same path and unloaded with the last of them.
+class PluginLibrary {
+ public:
+  /// @return null with @a err set if @a path cannot be loaded or is not a compatible plugin
+  static std::shared_ptr<PluginLibrary> Load(const std::string& path, std::string& err);
+  ~PluginLibrary();
+
+  const ew_sink_plugin& plugin() const { return *plugin_; }
+
+ private:
+  PluginLibrary(void* handle, const ew_sink_plugin* plugin);
+
+  void* handle_;
+  const ew_sink_plugin* plugin_;
+};
+
+/**
+ * One instance of a plugin, fed by the audio and video sinks of a subscriber.
+ * Flushed and closed when the last of them and the subscriber release it.
+ */
+class PluginSinkInstance {
+ public:
+  /// @return null with @a err set if the plugin cannot be loaded or refuses @a params
+  static std::shared_ptr<PluginSinkInstance> Open(const std::string& path, const std::string& params,
+                                                  std::string& err);
+  ~PluginSinkInstance();
+
+  /// Called on pipeline threads
+  void OnAudioFrame(const at::AudioFrame& frame);
+  void OnVideoFrame(const at::VideoFrame& frame);
+
+  /// @return stats reported by the plugin, with failed frame calls added to errors
+  ew_sink_stats Stats() const;
+
+ private:
+  PluginSinkInstance(std::shared_ptr<PluginLibrary> library, void* instance);
+
+  std::shared_ptr<PluginLibrary> library_;
+  const ew_sink_plugin& plugin_;
+  void* instance_;
+  std::atomic<uint64_t> errors_{0};
+};
+
+/// Audio sink forwarding frames to a plugin instance
+class PluginAudioSink : public at::eastwood::AudioSink {
+ public:
+  explicit PluginAudioSink(std::shared_ptr<PluginSinkInstance> instance) : instance_(std::move(instance)) {}
+  void OnAudioFrame(const at::AudioFrame& frame) override { instance_->OnAudioFrame(frame); }
+
+ private:
+  std::shared_ptr<PluginSinkInstance> instance_;
+};
+
+/// Video counterpart of PluginAudioSink
+class PluginVideoSink : public at::eastwood::VideoSink {
+ public:
+  explicit PluginVideoSink(std::shared_ptr<PluginSinkInstance> instance) : instance_(std::move(instance)) {}
+  void OnVideoFrame(const at::VideoFrame& frame) override { instance_->OnVideoFrame(frame); }
+
+ private:
+  std::shared_ptr<PluginSinkInstance> instance_;
+};
+
+}  // namespace ew
+
+#endif  // PLUGIN_SINK_H_
@@ -0,0 +1,59 @@
+/// @copyright © 2017 Airtime Media.  All rights reserved.
+
+#include <utility>
+
+#include "sink_tap.h"
+#include "playout_buffer.h"
+
+namespace ew {
+
+using namespace std;
+
+TapAudioSink::TapAudioSink(shared_ptr<AudioSinkSlot> slot, shared_ptr<TrackContext> track,
+                           shared_ptr<PlayoutBuffer> playout)
+  : slot_(move(slot)), track_(move(track)), playout_(move(playout)) {
+}
+
+void TapAudioSink::OnAudioFrame(const at::AudioFrame& frame) {
+  if (detached_.load(memory_order_acquire)) return;
+  auto begin_ns = TrackMonitor::NowNs();
+  auto allocations = AllocCounter::Thread();
+  auto meta = MetaOf(frame);
+  auto seq = track_->OnFrame(begin_ns, meta);
+  if (track_->recorder) track_->recorder->Record(track_->track, begin_ns, meta, PayloadOf(frame));
+  auto delay_ns = track_->latency.OnArrival(begin_ns, meta.timestamp_us);
+  if (delay_ns < 0) return;  // late
+  if (playout_ && playout_->Hold(track_->track, seq, begin_ns, delay_ns, meta, PayloadOf(frame))) return;
+  {
+    TraceSpan span("audio.deliver", track_->subscriber_id, seq);
+    lock_guard<mutex> lock(slot_->mutex);
+    if (slot_->sink) slot_->sink->OnAudioFrame(frame);
+  }
+  track_->OnDelivered(begin_ns, TrackMonitor::NowNs(), allocations, 0);
+}
+
+TapVideoSink::TapVideoSink(shared_ptr<VideoSinkSlot> slot, shared_ptr<TrackContext> track,
+                           shared_ptr<PlayoutBuffer> playout)
+  : slot_(move(slot)), track_(move(track)), playout_(move(playout)) {
+}
+
+void TapVideoSink::OnVideoFrame(const at::VideoFrame& frame) {
+  if (detached_.load(memory_order_acquire)) return;
+  auto begin_ns = TrackMonitor::NowNs();
+  auto allocations = AllocCounter::Thread();
+  auto meta = MetaOf(frame);
+  auto seq = track_->OnFrame(begin_ns, meta);
+  if (track_->recorder) track_->recorder->Record(track_->track, begin_ns, meta, PayloadOf(frame));
+  if (track_->Shed(seq)) return;  // pictures are whole, so any of them can go
+  auto delay_ns = track_->latency.OnArrival(begin_ns, meta.timestamp_us);
+  if (delay_ns < 0) return;  // late
+  if (playout_ && playout_->Hold(track_->track, seq, begin_ns, delay_ns, meta, PayloadOf(frame))) return;
+  {
+    TraceSpan span("video.deliver", track_->subscriber_id, seq);
+    lock_guard<mutex> lock(slot_->mutex);
+    if (slot_->sink) slot_->sink->OnVideoFrame(frame);
+  }
+  track_->OnDelivered(begin_ns, TrackMonitor::NowNs(), allocations, 0);
+}
+
+}  // namespace ew
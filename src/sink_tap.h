@@ -0,0 +1,190 @@
+/// @copyright © 2017 Airtime Media.  All rights reserved.
+
+#ifndef SINK_TAP_H_
+#define SINK_TAP_H_
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "mediacore/defs.h"
+#include "eastwood/sink/audio_sink.h"
+#include "eastwood/sink/video_sink.h"
+#include "eastwood/subscribe/subscriber_config.h"
+
+#include "alloc_counter.h"
+#include "media_frame.h"
+#include "frame_trace.h"
+#include "frame_capture.h"
+#include "latency.h"
+#include "lifecycle.h"
+#include "loop_stats.h"
+#include "pipeline_trace.h"
+#include "steady_clock.h"
+
+
+namespace ew {
+
+class PlayoutBuffer;
+
+/// Frame arrival bookkeeping of one track, written by media threads and read by the JS thread.
+struct TrackMonitor {
+  /// steady_clock time of the last frame in nanoseconds (0 if none yet)
+  std::atomic<int64_t> last_frame_ns{0};
+  /// steady_clock time of the first frame in nanoseconds (0 if none yet)
+  std::atomic<int64_t> first_frame_ns{0};
+  std::atomic<uint64_t> frames{0};
+  /// inter-frame gap at least this long is recorded in resume_gap_ns (0 disables)
+  std::atomic<int64_t> gap_threshold_ns{0};
+  /// length of the latest gap that ended with a frame, consumed by the stall watcher
+  std::atomic<int64_t> resume_gap_ns{0};
+  /// heap allocations made while delivering frames (capture and sink). counted with AllocCounter only.
+  std::atomic<uint64_t> allocations{0};
+
+  static int64_t NowNs() { return SteadyNowNs(); }
+  /// @return frame number on the track, starting from 1
+  uint32_t OnFrame(int64_t now) {
+    auto prev = last_frame_ns.exchange(now, std::memory_order_relaxed);
+    if (0 == prev) first_frame_ns.store(now, std::memory_order_relaxed);
+    auto threshold = gap_threshold_ns.load(std::memory_order_relaxed);
+    if (0 < prev && 0 < threshold && threshold <= now - prev) {
+      resume_gap_ns.store(now - prev, std::memory_order_relaxed);
+    }
+    return static_cast<uint32_t>(frames.fetch_add(1, std::memory_order_relaxed) + 1);
+  }
+};
+
+/// Time spent by the real sink of a track, i.e. one task source on the event loop
+struct DeliveryTiming {
+  std::atomic<uint64_t> calls{0};
+  std::atomic<int64_t> total_ns{0};
+  std::atomic<int64_t> max_ns{0};
+
+  void Add(int64_t duration_ns) {
+    calls.fetch_add(1, std::memory_order_relaxed);
+    total_ns.fetch_add(duration_ns, std::memory_order_relaxed);
+    auto prev = max_ns.load(std::memory_order_relaxed);
+    while (prev < duration_ns && !max_ns.compare_exchange_weak(prev, duration_ns, std::memory_order_relaxed)) {}
+  }
+};
+
+/// State of one track of a subscriber, shared by the taps of successive facades
+struct TrackContext {
+  TrackContext(uint32_t subscriber_id, FrameTrack track)
+    : subscriber_id(subscriber_id), track(track) {}
+
+  const uint32_t subscriber_id;
+  const FrameTrack track;
+  /// sink type, for reports. set on JS thread before the first facade starts.
+  std::string sink;
+  TrackMonitor monitor;
+  FrameSampler sampler;
+  DeliveryTiming delivery;
+  LatencyMonitor latency;
+  /// set on JS thread before the first facade starts, if frames are captured
+  std::shared_ptr<FrameRecorder> recorder;
+  /// of the subscriber. set on JS thread before the first facade starts.
+  std::shared_ptr<Lifecycle> lifecycle;
+  /// load shedding: one frame in keep_every goes on to the sink. set on JS thread by CapacityModel.
+  std::atomic<uint32_t> keep_every{1};
+  std::atomic<uint64_t> shed{0};
+
+  /// Called by taps on media thread for each frame, before delivering it to the sink
+  /// @return frame number on the track
+  uint32_t OnFrame(int64_t now, const FrameMeta& meta) {
+    auto seq = monitor.OnFrame(now);
+    if (lifecycle) lifecycle->OnFrame(track, now);
+    if (sampler.Sample(now, seq)) {
+      FrameTraceRecord record = { now, meta.timestamp_us, subscriber_id, seq, meta.size,
+                                  meta.width, meta.height, track,
+                                  sampler.level.load(std::memory_order_relaxed) };
+      FrameTrace::Instance().Record(record);
+    }
+    return seq;
+  }
+
+  /// Called by taps on media thread. @return true if frame @a seq is dropped by load shedding
+  bool Shed(uint32_t seq) {
+    auto every = keep_every.load(std::memory_order_relaxed);
+    if (every <= 1 || 0 == seq % every) return false;
+    shed.fetch_add(1, std::memory_order_relaxed);
+    return true;
+  }
+
+  /// Called by taps on media thread, or by the playout buffer, once the sink returned
+  /// @param allocations_before: AllocCounter::Thread() before the frame was captured and delivered
+  /// @param held_ns: time in the playout buffer
+  void OnDelivered(int64_t begin_ns, int64_t end_ns, uint64_t allocations_before, int64_t held_ns) {
+    delivery.Add(end_ns - begin_ns);
+    latency.OnDelivered(held_ns, end_ns - begin_ns);
+    auto& thread_stats = LoopStats::Instance().Current();
+    thread_stats.tasks.fetch_add(1, std::memory_order_relaxed);
+    thread_stats.run.Add(end_ns - begin_ns);
+    if (AllocCounter::Enabled()) {
+      auto allocations = AllocCounter::Thread();
+      monitor.allocations.fetch_add(allocations - allocations_before, std::memory_order_relaxed);
+      thread_stats.allocations.store(allocations, std::memory_order_relaxed);
+    }
+  }
+};
+
+using AudioSinkPtr = decltype(at::eastwood::SubscriberConfig::audio_sink);
+using VideoSinkPtr = decltype(at::eastwood::SubscriberConfig::video_sink);
+
+/**
+ * Holds the real sink created by a sink factory.
+ * The slot outlives facades, so that a resubscribed facade keeps writing into the same sink
+ * (i.e. the same recording file or RTMP session).
+ */
+template <class SinkPtr>
+struct SinkSlot {
+  std::mutex mutex;
+  SinkPtr sink;
+};
+
+using AudioSinkSlot = SinkSlot<AudioSinkPtr>;
+using VideoSinkSlot = SinkSlot<VideoSinkPtr>;
+
+/**
+ * Audio sink handed to a facade. Forwards frames to the slot and updates the track context.
+ * Late frames (see LatencyMonitor) are dropped, and frames are held in the playout buffer if any.
+ * Once detached (i.e. its facade is being replaced), frames are dropped.
+ */
+class TapAudioSink : public at::eastwood::AudioSink {
+ public:
+  /// @param playout: null unless frames are held
+  TapAudioSink(std::shared_ptr<AudioSinkSlot> slot, std::shared_ptr<TrackContext> track,
+               std::shared_ptr<PlayoutBuffer> playout);
+
+  void OnAudioFrame(const at::AudioFrame& frame) override;
+
+  void Detach() { detached_.store(true, std::memory_order_release); }
+
+ private:
+  std::shared_ptr<AudioSinkSlot> slot_;
+  std::shared_ptr<TrackContext> track_;
+  std::shared_ptr<PlayoutBuffer> playout_;
+  std::atomic<bool> detached_{false};
+};
+
+/// Video counterpart of TapAudioSink
+class TapVideoSink : public at::eastwood::VideoSink {
+ public:
+  TapVideoSink(std::shared_ptr<VideoSinkSlot> slot, std::shared_ptr<TrackContext> track,
+               std::shared_ptr<PlayoutBuffer> playout);
+
+  void OnVideoFrame(const at::VideoFrame& frame) override;
+
+  void Detach() { detached_.store(true, std::memory_order_release); }
+
+ private:
+  std::shared_ptr<VideoSinkSlot> slot_;
+  std::shared_ptr<TrackContext> track_;
+  std::shared_ptr<PlayoutBuffer> playout_;
+  std::atomic<bool> detached_{false};
+};
+
+}  // namespace ew
+
+#endif  // SINK_TAP_H_
@@ -0,0 +1,63 @@
+/// @copyright © 2017 Airtime Media.  All rights reserved.
+
+#ifndef SPSC_RING_H_
+#define SPSC_RING_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+
+namespace ew {
+
+/**
+ * Fixed capacity lock-free ring for one producer thread and one consumer thread.
+ * @a T should be trivially copyable. @a Capacity must be power of two.
+ */
+template <class T, size_t Capacity>
+class SpscRing {
+  static_assert(0 == (Capacity & (Capacity - 1)), "Capacity must be power of two");
+
+ public:
+  /// producer side. @return false (and counts the drop) if full
+  bool Push(const T& item) {
+    auto head = head_.load(std::memory_order_relaxed);
+    if (Capacity <= head - tail_.load(std::memory_order_acquire)) {
+      dropped_.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    items_[head & (Capacity - 1)] = item;
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  /// consumer side. calls @a fn for each item in order. @return number of items consumed
+  template <class Fn>
+  size_t Drain(Fn fn) {
+    auto tail = tail_.load(std::memory_order_relaxed);
+    auto head = head_.load(std::memory_order_acquire);
+    for (auto i = tail; i != head; ++i) {
+      fn(items_[i & (Capacity - 1)]);
+    }
+    tail_.store(head, std::memory_order_release);
+    return static_cast<size_t>(head - tail);
+  }
+
+  size_t Size() const {
+    return static_cast<size_t>(head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire));
+  }
+
+  /// @return number of items dropped since last call
+  uint64_t TakeDropped() { return dropped_.exchange(0, std::memory_order_relaxed); }
+
+ private:
+  T items_[Capacity];
+  // separate cache lines, so that producer and consumer do not false-share
+  alignas(64) std::atomic<uint64_t> head_{0};
+  alignas(64) std::atomic<uint64_t> tail_{0};
+  alignas(64) std::atomic<uint64_t> dropped_{0};
+};
+
+}  // namespace ew
+
+#endif  // SPSC_RING_H_
@@ -0,0 +1,20 @@
+/// @copyright © 2017 Airtime Media.  All rights reserved.
+
+#ifndef STEADY_CLOCK_H_
+#define STEADY_CLOCK_H_
+
+#include <chrono>
+#include <cstdint>
+
+
+namespace ew {
+
+/// @return monotonic time in nanoseconds. Only differences are meaningful.
+inline int64_t SteadyNowNs() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+           std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+}  // namespace ew
+
+#endif  // STEADY_CLOCK_H_
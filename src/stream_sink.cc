@@ -0,0 +1,263 @@
+/// @copyright © 2017 Airtime Media.  All rights reserved.
+
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
+#include "stream_sink.h"
+#include "steady_clock.h"
+
+namespace ew {
+
+using namespace std;
+using namespace string_literals;
+
+constexpr size_t StreamWriter::kDefaultBufferBytes;
+constexpr size_t StreamWriter::kMinBufferBytes;
+constexpr size_t StreamWriter::kMaxBufferBytes;
+constexpr int StreamWriter::kCloseTimeoutMs;
+constexpr int StreamWriter::kPollMs;
+
+namespace {
+
+#ifdef MSG_NOSIGNAL
+constexpr int kSendFlags = MSG_DONTWAIT | MSG_NOSIGNAL;
+#else
+constexpr int kSendFlags = MSG_DONTWAIT;  // SIGPIPE is ignored by node
+#endif
+
+bool StartsWith(const string& s, const char* prefix) {
+  return 0 == s.compare(0, strlen(prefix), prefix);
+}
+
+void CloseOnExec(int fd) {
+  fcntl(fd, F_SETFD, fcntl(fd, F_GETFD) | FD_CLOEXEC);
+}
+
+/// @return -1 with errno set on failure, or with errno 0 if @a target is not well-formed
+int OpenTarget(const string& target) {
+  errno = 0;
+  if (StartsWith(target, "fd:")) {
+    char* end = nullptr;
+    auto n = strtol(target.c_str() + 3, &end, 10);
+    if (3 == target.size() || *end || n < 0 || INT_MAX < n) return -1;
+    auto fd = fcntl(static_cast<int>(n), F_DUPFD, 0);
+    if (0 <= fd) CloseOnExec(fd);
+    return fd;
+  }
+  if (StartsWith(target, "unix:")) {
+    sockaddr_un addr = {};
+    auto path = target.substr(5);
+    if (path.empty() || sizeof(addr.sun_path) <= path.size()) return -1;
+    addr.sun_family = AF_UNIX;
+    memcpy(addr.sun_path, path.c_str(), path.size());
+    auto fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    CloseOnExec(fd);
+    if (0 != connect(fd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr))) {
+      auto error = errno;
+      close(fd);
+      errno = error;
+      return -1;
+    }
+    return fd;
+  }
+  // fails with ENXIO rather than waiting for a reader
+  auto fd = open(target.c_str(), O_WRONLY | O_NONBLOCK);
+  if (0 <= fd) CloseOnExec(fd);
+  return fd;
+}
+
+}  // namespace
+
+shared_ptr<StreamWriter> StreamWriter::Open(const string& target, size_t buffer_bytes, uint32_t max_delay_ms,
+                                            string& err) {
+  auto fd = OpenTarget(target);
+  if (fd < 0) {
+    err = errno ? "Cannot open stream " + target + ": " + strerror(errno) : "Incorrect stream target " + target;
+    return nullptr;
+  }
+  struct stat st;
+  if (0 != fstat(fd, &st) || !(S_ISFIFO(st.st_mode) || S_ISSOCK(st.st_mode) || S_ISREG(st.st_mode))) {
+    close(fd);
+    err = "Stream target " + target + " is not a pipe, a socket or a file";
+    return nullptr;
+  }
+  auto pipe = S_ISFIFO(st.st_mode);
+#ifdef __linux__
+  auto zero_copy = pipe;
+#else
+  auto zero_copy = false;
+#endif
+  // a blocking pipe (e.g. an inherited stdout) takes a write without waiting only up to PIPE_BUF
+  auto blocking = !(fcntl(fd, F_GETFL) & O_NONBLOCK);
+  auto page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  auto capacity = (min(max(buffer_bytes, kMinBufferBytes), kMaxBufferBytes) + page - 1) / page * page;
+  // mapped, so that pages still in the pipe stay valid for the reader even after munmap()
+  auto ring = mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (MAP_FAILED == ring) {
+    close(fd);
+    err = "Cannot allocate " + to_string(capacity) + " bytes for stream " + target;
+    return nullptr;
+  }
+  auto max_write = (pipe && blocking && !zero_copy) ? size_t(PIPE_BUF) : capacity;
+  return shared_ptr<StreamWriter>(new StreamWriter(fd, target, static_cast<uint8_t*>(ring), capacity,
+                                                   S_ISSOCK(st.st_mode), zero_copy, max_write, max_delay_ms));
+}
+
+StreamWriter::StreamWriter(int fd, string target, uint8_t* ring, size_t capacity, bool socket, bool zero_copy,
+                           size_t max_write, uint32_t max_delay_ms)
+  : log_(at::log::keywords::channel = "addon.StreamWriter")
+  , fd_(fd), target_(move(target)), ring_(ring), capacity_(capacity)
+  , socket_(socket), zero_copy_(zero_copy), max_write_(max_write), max_delay_ns_(max_delay_ms * 1000000LL) {
+  AT_LOG_INFO(log_, "Streaming to " << target_ << " with " << capacity_ << " bytes buffer"
+              << (zero_copy_ ? ", zero copy" : ""));
+  thread_ = thread([this]() { Run(); });
+}
+
+StreamWriter::~StreamWriter() {
+  {
+    lock_guard<mutex> lock(mutex_);
+    running_ = false;
+  }
+  wake_.notify_one();
+  thread_.join();
+  close(fd_);
+  munmap(ring_, capacity_);
+}
+
+bool StreamWriter::Write(const uint8_t* data, size_t size) {
+  if (0 == size) return true;
+  auto buffered = size_t(0);
+  auto now_ns = max_delay_ns_ ? SteadyNowNs() : 0;
+  {
+    lock_guard<mutex> lock(mutex_);
+    if (failed_) return false;
+    if (sent_ == head_) behind_since_ns_ = now_ns;
+    if (capacity_ < head_ - free_ + size || (max_delay_ns_ && max_delay_ns_ < now_ns - behind_since_ns_)) {
+      ++overflows_;
+      overflow_bytes_ += size;
+      if (overflowing_) return false;
+      overflowing_ = true;
+      buffered = static_cast<size_t>(head_ - free_);
+    } else {
+      // whole frames only, so that the reader never gets a partial one
+      auto offset = static_cast<size_t>(head_ % capacity_);
+      auto first = min(size, capacity_ - offset);
+      memcpy(ring_ + offset, data, first);
+      memcpy(ring_, data + first, size - first);
+      head_ += size;
+      ++frames_;
+      // a run of drops ends once the reader has caught up half the ring
+      if (overflowing_ && head_ - free_ <= capacity_ / 2) overflowing_ = false;
+    }
+  }
+  if (buffered) {
+    AT_LOG_WARNING(log_, "Reader of " << target_ << " is behind by " << buffered << " bytes. Dropping frames");
+    return false;
+  }
+  wake_.notify_one();
+  return true;
+}
+
+StreamWriter::Stats StreamWriter::stats() const {
+  lock_guard<mutex> lock(mutex_);
+  Stats stats;
+  stats.frames = frames_;
+  stats.bytes = sent_;
+  stats.overflows = overflows_;
+  stats.overflow_bytes = overflow_bytes_;
+  stats.buffered = static_cast<size_t>(head_ - free_);
+  stats.capacity = capacity_;
+  stats.zero_copy = zero_copy_;
+  stats.failed = failed_;
+  return stats;
+}
+
+void StreamWriter::Run() {
+  int64_t close_deadline_ns = 0;
+  unique_lock<mutex> lock(mutex_);
+  while (true) {
+    if (zero_copy_) Reclaim();
+    if (sent_ == head_) {
+      if (!running_) break;
+      // spliced bytes not taken yet are looked at again shortly, as the reader does not wake us
+      if (zero_copy_ && free_ != sent_) {
+        wake_.wait_for(lock, chrono::milliseconds(kPollMs));
+      } else {
+        wake_.wait(lock);
+      }
+      continue;
+    }
+    if (!running_) {
+      if (0 == close_deadline_ns) close_deadline_ns = SteadyNowNs() + kCloseTimeoutMs * 1000000LL;
+      if (close_deadline_ns < SteadyNowNs()) {
+        AT_LOG_WARNING(log_, "Closing " << target_ << " with " << (head_ - sent_) << " bytes not taken by the reader");
+        break;
+      }
+    }
+    auto begin = sent_;
+    auto end = head_;
+    lock.unlock();
+    auto sent = Send(begin, end);
+    auto error = errno;
+    lock.lock();
+    if (sent < 0) {
+      AT_LOG_ERROR(log_, "Stream " << target_ << " failed: " << strerror(error));
+      failed_ = true;
+      break;
+    }
+    sent_ += static_cast<uint64_t>(sent);
+    if (!zero_copy_) free_ = sent_;
+  }
+}
+
+ssize_t StreamWriter::Send(uint64_t begin, uint64_t end) {
+  pollfd pfd = { fd_, POLLOUT, 0 };
+  auto ready = poll(&pfd, 1, kPollMs);
+  if (ready <= 0) return (0 == ready || EINTR == errno) ? 0 : -1;
+  if (!(pfd.revents & POLLOUT)) {
+    errno = EPIPE;  // the reader went away
+    return -1;
+  }
+  auto offset = static_cast<size_t>(begin % capacity_);
+  auto size = min(min(static_cast<size_t>(end - begin), capacity_ - offset), max_write_);
+  ssize_t result;
+#ifdef __linux__
+  if (zero_copy_) {
+    iovec iov = { ring_ + offset, size };
+    result = vmsplice(fd_, &iov, 1, SPLICE_F_NONBLOCK);
+  } else
+#endif
+  if (socket_) {
+    result = send(fd_, ring_ + offset, size, kSendFlags);
+  } else {
+    result = write(fd_, ring_ + offset, size);
+  }
+  if (0 <= result) return result;
+  return (EAGAIN == errno || EWOULDBLOCK == errno || EINTR == errno) ? 0 : -1;
+}
+
+void StreamWriter::Reclaim() {
+#ifdef __linux__
+  int unread = 0;
+  if (0 != ioctl(fd_, FIONREAD, &unread) || unread < 0) return;
+  // the pipe may hold bytes of other writers too. they only make the space come back later.
+  auto in_pipe = min(static_cast<uint64_t>(unread), sent_ - free_);
+  free_ = sent_ - in_pipe;
+#endif
+}
+
+}  // namespace ew
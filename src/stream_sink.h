@@ -0,0 +1,128 @@
+/// @copyright © 2017 Airtime Media.  All rights reserved.
+
+#ifndef STREAM_SINK_H_
+#define STREAM_SINK_H_
+
+#include <sys/types.h>
+
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+
+#include "eastwood/sink/audio_sink.h"
+#include "eastwood/sink/video_sink.h"
+#include "mediacore/base/logging.h"
+
+#include "media_frame.h"
+
+
+namespace ew {
+
+/**
+ * Raw byte stream to an fd, a FIFO or a Unix socket, for reader processes (e.g. ffmpeg reading stdin).
+ * Media threads copy whole frames into a bounded ring and never wait on the reader:
+ * a frame not fitting, or coming while the reader is behind for longer than max delay, is dropped
+ * and counted as overflow. A writer thread feeds the fd.
+ * On Linux a pipe is fed with vmsplice(), handing the ring pages to the pipe instead of copying them,
+ * and their space is reused only once the reader has taken the bytes (readers splicing the pipe
+ * further on, rather than reading it, would see later bytes and are not supported).
+ */
+class StreamWriter {
+ public:
+  struct Stats {
+    uint64_t frames = 0;          // queued
+    uint64_t bytes = 0;           // handed to the fd
+    uint64_t overflows = 0;       // frames dropped as the ring was full
+    uint64_t overflow_bytes = 0;
+    size_t buffered = 0;          // bytes in the ring, not yet taken by the reader
+    size_t capacity = 0;          // of the ring, mapped for the life of the writer
+    bool zero_copy = false;
+    bool failed = false;          // the fd failed, e.g. the reader went away. frames are dropped from then on.
+  };
+
+  /**
+   * @param target: "fd:<n>" (an inherited fd. duplicated, so the caller keeps its own),
+   *                "unix:<path>" (stream socket to connect) or the path of a FIFO (opened without waiting,
+   *                so its reader must have it open already)
+   * @param buffer_bytes: ring capacity. rounded up to pages.
+   * @param max_delay_ms: how long the reader may stay behind before frames are dropped. 0 is as long as the ring lasts.
+   * @return null with @a err set if the target cannot be opened
+   */
+  static std::shared_ptr<StreamWriter> Open(const std::string& target, size_t buffer_bytes, uint32_t max_delay_ms,
+                                            std::string& err);
+  /// Flushes the ring for up to kCloseTimeoutMs, and closes the fd
+  ~StreamWriter();
+
+  /// Called on media threads. @return false if dropped
+  bool Write(const uint8_t* data, size_t size);
+
+  Stats stats() const;
+
+  static constexpr size_t kDefaultBufferBytes = 16 << 20;
+  static constexpr size_t kMinBufferBytes = 64 << 10;
+  static constexpr size_t kMaxBufferBytes = 1 << 30;
+  static constexpr int kCloseTimeoutMs = 1000;
+  /// how often the writer looks at the fd while it is full, or for the reader to take spliced bytes
+  static constexpr int kPollMs = 10;
+
+ private:
+  StreamWriter(int fd, std::string target, uint8_t* ring, size_t capacity, bool socket, bool zero_copy,
+               size_t max_write, uint32_t max_delay_ms);
+  void Run();
+  /// @return bytes handed to the fd from the ring at @a begin, 0 if it is full, -1 on failure
+  ssize_t Send(uint64_t begin, uint64_t end);
+  /// zero copy: makes the space of spliced bytes the reader has taken reusable. called with mutex_ held.
+  void Reclaim();
+
+  mutable at::Logger log_;
+  const int fd_;
+  const std::string target_;
+  uint8_t* const ring_;
+  const size_t capacity_;
+  const bool socket_;
+  const bool zero_copy_;
+  const size_t max_write_;  // per call, so that the writer does not block on the fd
+  const int64_t max_delay_ns_;
+  // positions in bytes since open: free_ <= sent_ <= head_, head_ - free_ <= capacity_
+  mutable std::mutex mutex_;
+  std::condition_variable wake_;
+  uint64_t head_ = 0;  // written by media threads. guarded by mutex_
+  uint64_t sent_ = 0;  // handed to the fd. guarded by mutex_
+  uint64_t free_ = 0;  // taken by the reader. guarded by mutex_
+  int64_t behind_since_ns_ = 0;  // the latest write finding everything handed to the fd. guarded by mutex_
+  uint64_t frames_ = 0;          // guarded by mutex_
+  uint64_t overflows_ = 0;       // guarded by mutex_
+  uint64_t overflow_bytes_ = 0;  // guarded by mutex_
+  bool overflowing_ = false;     // logs once per run of drops. guarded by mutex_
+  bool failed_ = false;          // guarded by mutex_
+  bool running_ = true;          // guarded by mutex_
+  std::thread thread_;
+};
+
+/// Audio sink writing raw samples to a stream
+class StreamAudioSink : public at::eastwood::AudioSink {
+ public:
+  explicit StreamAudioSink(std::shared_ptr<StreamWriter> writer) : writer_(std::move(writer)) {}
+  void OnAudioFrame(const at::AudioFrame& frame) override { writer_->Write(PayloadOf(frame), MetaOf(frame).size); }
+
+ private:
+  std::shared_ptr<StreamWriter> writer_;
+};
+
+/// Video counterpart of StreamAudioSink, writing raw pictures
+class StreamVideoSink : public at::eastwood::VideoSink {
+ public:
+  explicit StreamVideoSink(std::shared_ptr<StreamWriter> writer) : writer_(std::move(writer)) {}
+  void OnVideoFrame(const at::VideoFrame& frame) override { writer_->Write(PayloadOf(frame), MetaOf(frame).size); }
+
+ private:
+  std::shared_ptr<StreamWriter> writer_;
+};
+
+}  // namespace ew
+
+#endif  // STREAM_SINK_H_
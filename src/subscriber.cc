@@ -1,13 +1,17 @@
 /// @copyright © 2017 Airtime Media.  All rights reserved.
 
 #include <algorithm>
+#include <limits>
 #include <utility>
 
+#include <node_buffer.h>
+
 #include <boost/property_tree/ptree.hpp>
 #include <boost/property_tree/ini_parser.hpp>
 
 #include "subscriber.h"
 #include "addon_util/addon_util.h"
+#include "uv_handles.h"
 
 #include "mediacore/base/exception.h"
 #include "eastwood/common/time.h"
@@ -38,6 +42,8 @@ using v8::Undefined;
 using v8::Null;
 using v8::Exception;
 using v8::PropertyAttribute;
+using v8::Promise;
+using v8::HandleScope;
 
 using namespace std;
 using namespace string_literals;
@@ -47,18 +53,59 @@ using namespace at::node_addon;
 
 using at::eastwood::SubscriberFacade;
 
-Persistent<Function> Subscriber::constructor;
-Persistent<Function> Subscriber::SubscriberConfig::constructor;
+static atomic<uint32_t> next_subscriber_id{1};
+
+constexpr const char* Subscriber::kFlushPacketsOption;
+constexpr const char* Subscriber::kTuneOption;
+constexpr const char* Subscriber::kVideoCodecOption;
+constexpr const char* Subscriber::kAudioCodecOption;
 
 // --------------------------------------------
 
 Subscriber::Subscriber(const FunctionCallbackInfo<Value>& args)
   : log_(at::log::keywords::channel = "addon.Subscriber")
-  , config_(args.GetIsolate(), SubscriberConfig::NewInstance(args)) {
+  , addon_(AddonData::Get(args.GetIsolate()))
+  , config_(args.GetIsolate(), SubscriberConfig::NewInstance(args))
+  , audio_slot_(make_shared<AudioSinkSlot>())
+  , video_slot_(make_shared<VideoSinkSlot>())
+  , id_(next_subscriber_id++)
+  , audio_track_(make_shared<TrackContext>(id_, kTrackAudio))
+  , video_track_(make_shared<TrackContext>(id_, kTrackVideo))
+  , lifecycle_async_(NewBackgroundAsync(addon_->uv_loop, OnLifecycleAsync, this)) {
+  auto async = lifecycle_async_;
+  lifecycle_ = make_shared<Lifecycle>([async]() { uv_async_send(async); });
+  audio_track_->lifecycle = video_track_->lifecycle = lifecycle_;
+  js_queue_ = JsQueue::New(addon_->uv_loop);
+  addon_->subscribers.insert(this);
 }
 
 Subscriber::~Subscriber() {
+  if (addon_) Detach();
+}
+
+void Subscriber::Detach() {
+  addon_->subscribers.erase(this);
+  lifecycle_->Close();  // media threads may still hold it, but no longer wake the handle
+  js_queue_->Close();
+  CloseHandle(lifecycle_async_);
+  lifecycle_async_ = nullptr;
+  if (replayer_) replayer_->Stop();
+  StopStallWatch();
+  StopDeadline();
+  addon_->isolate->AdjustAmountOfExternalAllocatedMemory(-memory_bytes_);
+  memory_bytes_ = 0;
   config_.Reset();
+  // strong handles, not reset by their destructors
+  segment_context_.Reset();
+  state_context_.Reset();
+  addon_ = nullptr;
+}
+
+void Subscriber::CloseForCleanup() {
+  // the stop, if any, is given up: its callback would come after the loop is gone
+  auto state = lifecycle_->state();
+  if (facade_ || (Lifecycle::kIdle != state && Lifecycle::kStopped != state)) ForceClose();
+  Detach();
 }
 
 void Subscriber::configuration(const FunctionCallbackInfo<Value>& args) {
@@ -93,9 +140,9 @@ void Subscriber::SubscriberConfig::bixby(const FunctionCallbackInfo<Value>& args
       return true;
     })) return;
 
-  SubscriberConfig* self = Unwrap<SubscriberConfig>(args.Holder());
-  assert(self);
-  self->config_.bixby_endpoint = at::Endpoint(host, port);
+  SubscriberConfig* self = UnwrapMutable(args);
+  if (!self) return;  // thrown
+  self->MutableConfig().bixby_endpoint = at::Endpoint(host, port);
   args.GetReturnValue().Set(args.Holder());
 }
 
@@ -132,10 +179,11 @@ void Subscriber::SubscriberConfig::bixbyAllocator(const FunctionCallbackInfo<Val
       return true;
     })) return;
 
-  SubscriberConfig* self = Unwrap<SubscriberConfig>(args.Holder());
-  assert(self);
-  self->config_.bixby_allocator_endpoint = at::Endpoint(host, port);
-  self->config_.alloc_location = loc;
+  SubscriberConfig* self = UnwrapMutable(args);
+  if (!self) return;  // thrown
+  auto& config = self->MutableConfig();
+  config.bixby_allocator_endpoint = at::Endpoint(host, port);
+  config.alloc_location = loc;
   args.GetReturnValue().Set(args.Holder());
 }
 
@@ -174,12 +222,13 @@ void Subscriber::SubscriberConfig::streamNotifier(const FunctionCallbackInfo<Val
     [](const Local<Value> arg3, string& err_msg) { return arg3->IsBoolean(); },
     [](const Local<Value> arg4, string& err_msg) { return arg4->IsBoolean(); })) return;
 
-  SubscriberConfig* self = Unwrap<SubscriberConfig>(args.Holder());
-  assert(self);
-  self->config_.notifier_endpoint = at::Endpoint(host, port);
-  self->config_.tag = tag;
-  self->config_.use_tls_for_notifier = ToBool(args[3]);
-  self->config_.no_notifier_cert_check = !ToBool(args[4]);
+  SubscriberConfig* self = UnwrapMutable(args);
+  if (!self) return;  // thrown
+  auto& config = self->MutableConfig();
+  config.notifier_endpoint = at::Endpoint(host, port);
+  config.use_tls_for_notifier = ToBool(args[3]);
+  config.no_notifier_cert_check = !ToBool(args[4]);
+  self->tag_ = tag;
   args.GetReturnValue().Set(args.Holder());
 }
 
@@ -200,9 +249,9 @@ void Subscriber::SubscriberConfig::duration(const FunctionCallbackInfo<Value>& a
       return true;
     })) return;
 
-  SubscriberConfig* self = Unwrap<SubscriberConfig>(args.Holder());
-  assert(self);
-  self->config_.duration = dur;
+  SubscriberConfig* self = UnwrapMutable(args);
+  if (!self) return;  // thrown
+  self->MutableConfig().duration = dur;
   args.GetReturnValue().Set(args.Holder());
 }
 
@@ -219,9 +268,9 @@ void Subscriber::SubscriberConfig::userId(const FunctionCallbackInfo<Value>& arg
       return true;
     })) return;
 
-  SubscriberConfig* self = Unwrap<SubscriberConfig>(args.Holder());
-  assert(self);
-  self->config_.user_id = uid;
+  SubscriberConfig* self = UnwrapMutable(args);
+  if (!self) return;  // thrown
+  self->user_id_ = uid;
   args.GetReturnValue().Set(args.Holder());
 }
 
@@ -238,9 +287,9 @@ void Subscriber::SubscriberConfig::streamUrl(const FunctionCallbackInfo<Value>&
       return true;
     })) return;
 
-  SubscriberConfig* self = Unwrap<SubscriberConfig>(args.Holder());
-  assert(self);
-  self->config_.stream_url = url;
+  SubscriberConfig* self = UnwrapMutable(args);
+  if (!self) return;  // thrown
+  self->stream_url_ = url;
   args.GetReturnValue().Set(args.Holder());
 }
 
@@ -248,9 +297,9 @@ void Subscriber::SubscriberConfig::certCheck(const FunctionCallbackInfo<Value>&
   if (!CheckArgs("certCheck", args, 1, 1,
     [](const Local<Value> arg0, string& err_msg) { return arg0->IsBoolean(); })) return;
 
-  SubscriberConfig* self = Unwrap<SubscriberConfig>(args.Holder());
-  assert(self);
-  self->config_.no_cert_check = !ToBool(args[0]);
+  SubscriberConfig* self = UnwrapMutable(args);
+  if (!self) return;  // thrown
+  self->MutableConfig().no_cert_check = !ToBool(args[0]);
   args.GetReturnValue().Set(args.Holder());
 }
 
@@ -259,9 +308,9 @@ void Subscriber::SubscriberConfig::authSecret(const FunctionCallbackInfo<Value>&
   if (!CheckArgs("authSecret", args, 1, 1,
     [](const Local<Value> arg0, string& err_msg) { return arg0->IsString(); })) return;
 
-  SubscriberConfig* self = Unwrap<SubscriberConfig>(args.Holder());
-  assert(self);
-  self->config_.auth_secret = ToString(args[0]);
+  SubscriberConfig* self = UnwrapMutable(args);
+  if (!self) return;  // thrown
+  self->MutableConfig().auth_secret = ToString(args[0]);
   args.GetReturnValue().Set(args.Holder());
 }
 
@@ -270,21 +319,89 @@ void Subscriber::SubscriberConfig::printFrameInfo(const FunctionCallbackInfo<Val
   if (!CheckArgs("printFrameInfo", args, 1, 1,
     [](const Local<Value> arg0, string& err_msg) { return arg0->IsBoolean(); })) return;
 
-  SubscriberConfig* self = Unwrap<SubscriberConfig>(args.Holder());
-  assert(self);
-  self->config_.print_frame_info = ToBool(args[0]);
+  SubscriberConfig* self = UnwrapMutable(args);
+  if (!self) return;  // thrown
+  // traced off media threads instead of the synchronous log of the core config's print_frame_info
+  self->trace_every_ = ToBool(args[0]) ? 1 : 0;
+  self->trace_per_second_ = 0;
+  self->trace_level_ = EastWood::LogLevel_Debug;
+  self->trace_audio_ = false;
+  args.GetReturnValue().Set(args.Holder());
+}
+
+void Subscriber::SubscriberConfig::frameTrace(const FunctionCallbackInfo<Value>& args) {
+  auto isolate = args.GetIsolate();
+  auto context = isolate->GetCurrentContext();
+  const auto& cache = *AddonData::Get(isolate)->v8_cache;
+  auto every = 1u;
+  auto per_second = 0u;
+  auto level = EastWood::LogLevel_Debug;
+  auto audio = false;
+  if (!CheckArgs("frameTrace", args, 1, 1,
+    [&](const Local<Value> arg0, string& err_msg) {
+      if (!arg0->IsObject()) return false;
+      auto options = arg0->ToObject(context).ToLocalChecked();
+      auto every_val = options->Get(context, cache.Key(cache.keys.every)).ToLocalChecked();
+      if (!every_val->IsUndefined()) {
+        if (!every_val->IsUint32()) {
+          err_msg = "every must be zero or positive integer";
+          return false;
+        }
+        every = ToUint32(every_val);
+      }
+      auto per_second_val = options->Get(context, cache.Key(cache.keys.perSecond)).ToLocalChecked();
+      if (!per_second_val->IsUndefined()) {
+        if (!per_second_val->IsUint32()) {
+          err_msg = "perSecond must be zero or positive integer";
+          return false;
+        }
+        per_second = ToUint32(per_second_val);
+      }
+      auto level_val = options->Get(context, cache.Key(cache.keys.level)).ToLocalChecked();
+      if (!level_val->IsUndefined()) {
+        level = static_cast<EastWood::LogLevel>(level_val->IsInt32() ? ToInt32(level_val) : -1);
+        if (level < EastWood::LogLevel_Fatal || EastWood::LogLevel_Debug < level) {
+          err_msg = "Incorrect log level value " + Inspect(level_val);
+          return false;
+        }
+      }
+      auto audio_val = options->Get(context, cache.Key(cache.keys.audio)).ToLocalChecked();
+      if (!audio_val->IsUndefined()) {
+        if (!audio_val->IsBoolean()) {
+          err_msg = "audio must be boolean";
+          return false;
+        }
+        audio = ToBool(audio_val);
+      }
+      return true;
+    })) return;
+
+  SubscriberConfig* self = UnwrapMutable(args);
+  if (!self) return;  // thrown
+  self->trace_every_ = every;
+  self->trace_per_second_ = per_second;
+  self->trace_level_ = level;
+  self->trace_audio_ = audio;
   args.GetReturnValue().Set(args.Holder());
 }
 
 namespace {
 
-bool CheckSinkArg(Isolate* isolate, Local<Context> context, const string& type, Local<Value> arg,
-                  int32_t sinkNoneEnum, int32_t sinkFileEnum,
-                  int32_t& sink_type, string& filename,
+/// @return true if @a output is a file name (no directory) of an HLS or DASH playlist
+bool IsPlaylistName(const string& output) {
+  auto ends_with = [&output](const string& ext) {
+    return ext.size() < output.size() && 0 == output.compare(output.size() - ext.size(), ext.size(), ext);
+  };
+  return string::npos == output.find('/') && (ends_with(".m3u8") || ends_with(".mpd"));
+}
+
+bool CheckSinkArg(const V8Cache& cache, Local<Context> context, const string& type, Local<Value> arg,
+                  int32_t sinkNoneEnum, int32_t sinkFileEnum, int32_t sinkStreamEnum,
+                  int32_t& sink_type, string& filename, uint32_t& buffer_bytes,
                   string& err_msg) {
   if (!arg->IsObject()) return false;
   auto sink_obj = arg->ToObject(context).ToLocalChecked();
-  auto maybe_sink = sink_obj->Get(context, ToLocalString("sink"));
+  auto maybe_sink = sink_obj->Get(context, cache.Key(cache.keys.sink));
   if (maybe_sink.IsEmpty()) {
     err_msg = "Need " + type + " sink type";
     return false;
@@ -299,11 +416,11 @@ bool CheckSinkArg(Isolate* isolate, Local<Context> context, const string& type,
     sink_type = sink;
     return true;
   }
-  if (sinkFileEnum != sink) {
+  if (sinkFileEnum != sink && sinkStreamEnum != sink) {
     err_msg = "Incorrect " + type + " sink type " + to_string(sink);
     return false;
   }
-  auto maybe_file = sink_obj->Get(context, ToLocalString("filename"));
+  auto maybe_file = sink_obj->Get(context, cache.Key(cache.keys.filename));
   if (maybe_file.IsEmpty()) {
     err_msg = "Need " + type + " sink filename";
     return false;
@@ -313,44 +430,84 @@ bool CheckSinkArg(Isolate* isolate, Local<Context> context, const string& type,
     err_msg = "Wrong " + type + " sink filename " + Inspect(file);
     return false;
   }
+  if (sinkStreamEnum == sink) {
+    auto buffer = sink_obj->Get(context, cache.Key(cache.keys.bufferBytes)).ToLocalChecked();
+    if (!buffer->IsUndefined()) {
+      if (!buffer->IsUint32() || ToUint32(buffer) < StreamWriter::kMinBufferBytes
+       || StreamWriter::kMaxBufferBytes < ToUint32(buffer)) {
+        err_msg = "Incorrect " + type + " sink bufferBytes " + Inspect(buffer) + ". must be "
+                + to_string(StreamWriter::kMinBufferBytes) + " to " + to_string(StreamWriter::kMaxBufferBytes);
+        return false;
+      }
+      buffer_bytes = ToUint32(buffer);
+    }
+  }
   sink_type = sink;
   filename = ToString(file);
   return true;
 }
 
+pair<string, string> SplitKeyValue(const string& token, char separator) {
+  auto pos = token.find(separator);
+  if (pos < token.size()) {
+    return make_pair(token.substr(0, pos), token.substr(pos+1));
+  } else {
+    return make_pair(token, ""s);
+  }
+}
 
 }  // anonymous namespace
 
+shared_ptr<const Subscriber::SubscriberConfig::FFmpegOptions>
+Subscriber::SubscriberConfig::ParseFFmpegParams(const string& param) {
+  auto opts = make_shared<FFmpegOptions>();
+  auto params = at::eastwood::StringTokenizer::Tokenize(param, ' ');
+  for (const auto& p : params) {
+    auto key_val = SplitKeyValue(p, '=');  // key-value separator
+    (*opts)[key_val.first] = key_val.second;
+  }
+  return opts;
+}
+
 void Subscriber::SubscriberConfig::sink(const FunctionCallbackInfo<Value>& args) {
   auto isolate = args.GetIsolate();
   auto context = isolate->GetCurrentContext();
+  const auto& cache = *AddonData::Get(isolate)->v8_cache;
   auto audio_sink = static_cast<int32_t>(EastWood::AudioSink_None);
   auto audio_filename = ""s;
+  auto audio_buffer_bytes = static_cast<uint32_t>(StreamWriter::kDefaultBufferBytes);
   auto video_sink = static_cast<int32_t>(EastWood::VideoSink_None);
   auto video_filename = ""s;
+  auto video_buffer_bytes = static_cast<uint32_t>(StreamWriter::kDefaultBufferBytes);
 
   if (!CheckArgs("sink", args, 2, 2,
-        [isolate, context, &audio_sink, &audio_filename](const Local<Value> arg0, string& err_msg) {
-          return CheckSinkArg(isolate, context, "audio", arg0,
+        [&cache, context, &audio_sink, &audio_filename, &audio_buffer_bytes](const Local<Value> arg0,
+                                                                             string& err_msg) {
+          return CheckSinkArg(cache, context, "audio", arg0,
                               static_cast<int32_t>(EastWood::AudioSink_None),
                               static_cast<int32_t>(EastWood::AudioSink_File),
-                              audio_sink, audio_filename,
+                              static_cast<int32_t>(EastWood::AudioSink_Stream),
+                              audio_sink, audio_filename, audio_buffer_bytes,
                               err_msg);
         },
-        [isolate, context, &video_sink, &video_filename](const Local<Value> arg1, string& err_msg) {
-          return CheckSinkArg(isolate, context, "video", arg1,
+        [&cache, context, &video_sink, &video_filename, &video_buffer_bytes](const Local<Value> arg1,
+                                                                             string& err_msg) {
+          return CheckSinkArg(cache, context, "video", arg1,
                               static_cast<int32_t>(EastWood::VideoSink_None),
                               static_cast<int32_t>(EastWood::VideoSink_File),
-                              video_sink, video_filename,
+                              static_cast<int32_t>(EastWood::VideoSink_Stream),
+                              video_sink, video_filename, video_buffer_bytes,
                               err_msg);
         })) return;
 
-  SubscriberConfig* self = Unwrap<SubscriberConfig>(args.Holder());
-  assert(self);
+  SubscriberConfig* self = UnwrapMutable(args);
+  if (!self) return;  // thrown
   self->audio_sink_ = static_cast<EastWood::SinkType>(audio_sink);
   self->audio_sink_filename_ = audio_filename;
+  self->audio_sink_buffer_bytes_ = audio_buffer_bytes;
   self->video_sink_ = static_cast<EastWood::SinkType>(video_sink);
   self->video_sink_filename_ = video_filename;
+  self->video_sink_buffer_bytes_ = video_buffer_bytes;
   args.GetReturnValue().Set(args.Holder());
 }
 
@@ -370,10 +527,46 @@ void Subscriber::SubscriberConfig::ffmpegSink(const FunctionCallbackInfo<Value>&
     return;
   }
 
-  SubscriberConfig* self = Unwrap<SubscriberConfig>(args.Holder());
-  assert(self);
+  SubscriberConfig* self = UnwrapMutable(args);
+  if (!self) return;  // thrown
   self->ffmpeg_output_ = output;
   self->ffmpeg_param_ = ToString(args[1]);
+  self->ffmpeg_options_ = ParseFFmpegParams(self->ffmpeg_param_);
+  args.GetReturnValue().Set(args.Holder());
+}
+
+void Subscriber::SubscriberConfig::pluginSink(const FunctionCallbackInfo<Value>& args) {
+  if (!CheckArgs("pluginSink", args, 2, 2,
+    [](const Local<Value> arg0, string& err_msg) { return arg0->IsString(); },
+    [](const Local<Value> arg1, string& err_msg) { return arg1->IsString(); })) return;
+
+  SubscriberConfig* self = UnwrapMutable(args);
+  if (!self) return;  // thrown
+  self->plugin_path_ = ToString(args[0]);
+  self->plugin_params_ = ToString(args[1]);
+  args.GetReturnValue().Set(args.Holder());
+}
+
+void Subscriber::SubscriberConfig::compositeSink(const FunctionCallbackInfo<Value>& args) {
+  auto isolate = args.GetIsolate();
+  if (!CheckArgs("compositeSink", args, 1, 1,
+    [isolate](const Local<Value> arg0, string& err_msg) {
+      return arg0->IsNull() || Composite::IsInstance(isolate, arg0);
+    })) return;
+
+  SubscriberConfig* self = UnwrapMutable(args);
+  if (!self) return;  // thrown
+  self->composite_ = args[0]->IsNull() ? nullptr : Unwrap<Composite>(Local<Object>::Cast(args[0]))->mixer();
+  args.GetReturnValue().Set(args.Holder());
+}
+
+void Subscriber::SubscriberConfig::memorySegments(const FunctionCallbackInfo<Value>& args) {
+  if (!CheckArgs("memorySegments", args, 1, 1,
+    [](const Local<Value> arg0, string& err_msg) { return arg0->IsBoolean(); })) return;
+
+  SubscriberConfig* self = UnwrapMutable(args);
+  if (!self) return;  // thrown
+  self->memory_segments_ = ToBool(args[0]);
   args.GetReturnValue().Set(args.Holder());
 }
 
@@ -399,27 +592,194 @@ void Subscriber::SubscriberConfig::subscriptionErrorRetry(const FunctionCallback
       return true;
     })) return;
 
-  SubscriberConfig* self = Unwrap<SubscriberConfig>(args.Holder());
-  assert(self);
-  self->config_.err_max_retries = max_retries;
-  self->config_.err_retry_delay_init_ms = ToUint32(args[1]);;
-  self->config_.err_retry_delay_progression = progression;
+  SubscriberConfig* self = UnwrapMutable(args);
+  if (!self) return;  // thrown
+  auto& config = self->MutableConfig();
+  config.err_max_retries = max_retries;
+  config.err_retry_delay_init_ms = ToUint32(args[1]);
+  config.err_retry_delay_progression = progression;
+  args.GetReturnValue().Set(args.Holder());
+}
+
+void Subscriber::SubscriberConfig::stallTimeout(const FunctionCallbackInfo<Value>& args) {
+  if (!CheckArgs("stallTimeout", args, 2, 2,
+    [](const Local<Value> arg0, string& err_msg) { return arg0->IsUint32(); },
+    [](const Local<Value> arg1, string& err_msg) { return arg1->IsUint32(); })) return;
+
+  SubscriberConfig* self = UnwrapMutable(args);
+  if (!self) return;  // thrown
+  self->audio_stall_ms_ = ToUint32(args[0]);
+  self->video_stall_ms_ = ToUint32(args[1]);
+  args.GetReturnValue().Set(args.Holder());
+}
+
+void Subscriber::SubscriberConfig::memoryCap(const FunctionCallbackInfo<Value>& args) {
+  if (!CheckArgs("memoryCap", args, 1, 1,
+    [](const Local<Value> arg0, string& err_msg) { return arg0->IsUint32(); })) return;
+
+  SubscriberConfig* self = UnwrapMutable(args);
+  if (!self) return;  // thrown
+  self->memory_cap_mb_ = ToUint32(args[0]);
+  args.GetReturnValue().Set(args.Holder());
+}
+
+void Subscriber::SubscriberConfig::captureFile(const FunctionCallbackInfo<Value>& args) {
+  if (!CheckArgs("captureFile", args, 1, 1,
+    [](const Local<Value> arg0, string& err_msg) { return arg0->IsString(); })) return;
+
+  SubscriberConfig* self = UnwrapMutable(args);
+  if (!self) return;  // thrown
+  self->capture_filename_ = ToString(args[0]);
+  args.GetReturnValue().Set(args.Holder());
+}
+
+void Subscriber::SubscriberConfig::replayFile(const FunctionCallbackInfo<Value>& args) {
+  if (!CheckArgs("replayFile", args, 2, 2,
+    [](const Local<Value> arg0, string& err_msg) { return arg0->IsString(); },
+    [](const Local<Value> arg1, string& err_msg) { return arg1->IsNumber() && 0 <= ToDouble(arg1); })) return;
+
+  SubscriberConfig* self = UnwrapMutable(args);
+  if (!self) return;  // thrown
+  self->replay_filename_ = ToString(args[0]);
+  self->replay_speed_ = ToDouble(args[1]);
+  args.GetReturnValue().Set(args.Holder());
+}
+
+void Subscriber::SubscriberConfig::latencyMode(const FunctionCallbackInfo<Value>& args) {
+  auto mode = LatencyProfile::kRecording;
+  auto check_delay = [](const Local<Value> arg, string& err_msg) {
+    if (!arg->IsUint32()) return false;
+    if (LatencyProfile::kMaxDelayMs < ToUint32(arg)) {
+      err_msg = "delay must be up to " + to_string(LatencyProfile::kMaxDelayMs) + "ms";
+      return false;
+    }
+    return true;
+  };
+  if (!CheckArgs("latencyMode", args, 1, 3,
+    [&mode](const Local<Value> arg0, string& err_msg) {
+      if (!arg0->IsString()) return false;
+      if (!LatencyProfile::Parse(ToString(arg0), mode)) {
+        err_msg = "mode must be 'recording', 'live' or 'ultralow'";
+        return false;
+      }
+      return true;
+    },
+    check_delay, check_delay)) return;
+
+  auto profile = LatencyProfile::Of(mode);
+  if (2 <= args.Length()) profile.min_delay_ms = ToUint32(args[1]);
+  if (3 <= args.Length()) {
+    profile.max_delay_ms = ToUint32(args[2]);
+    if (0 < profile.max_delay_ms && profile.max_delay_ms < profile.min_delay_ms) {
+      ThrowException(args, Exception::Error, "latencyMode maxDelayMS must not be shorter than minDelayMS");
+      return;
+    }
+  } else if (0 < profile.max_delay_ms) {
+    // the default of the mode gives way to a longer minDelay
+    profile.max_delay_ms = max(profile.max_delay_ms, profile.min_delay_ms);
+  }
+
+  SubscriberConfig* self = UnwrapMutable(args);
+  if (!self) return;  // thrown
+  self->latency_ = profile;
+  args.GetReturnValue().Set(args.Holder());
+}
+
+void Subscriber::SubscriberConfig::timeline(const FunctionCallbackInfo<Value>& args) {
+  auto clock = Timeline::kClockNone;
+  if (!CheckArgs("timeline", args, 1, 2,
+    [&clock](const Local<Value> arg0, string& err_msg) {
+      if (!arg0->IsString()) return false;
+      if (!Timeline::Parse(ToString(arg0), clock)) {
+        err_msg = "clock must be 'none', 'monotonic' or 'ntp'";
+        return false;
+      }
+      return true;
+    },
+    [](const Local<Value> arg1, string& err_msg) {
+      if (!arg1->IsUint32()) return false;
+      if (Timeline::kMaxFillFps < ToUint32(arg1)) {
+        err_msg = "fillFps must be up to " + to_string(Timeline::kMaxFillFps);
+        return false;
+      }
+      return true;
+    })) return;
+
+  SubscriberConfig* self = UnwrapMutable(args);
+  if (!self) return;  // thrown
+  self->timeline_clock_ = clock;
+  self->timeline_fill_fps_ = (2 <= args.Length()) ? ToUint32(args[1]) : 0;
+  args.GetReturnValue().Set(args.Holder());
+}
+
+void Subscriber::SubscriberConfig::priority(const FunctionCallbackInfo<Value>& args) {
+  auto priority = kPriorityNormal;
+  if (!CheckArgs("priority", args, 1, 1,
+    [&priority](const Local<Value> arg0, string& err_msg) {
+      if (!arg0->IsString()) return false;
+      if (!CapacityModel::ParsePriority(ToString(arg0), priority)) {
+        err_msg = "priority must be 'low', 'normal' or 'high'";
+        return false;
+      }
+      return true;
+    })) return;
+
+  SubscriberConfig* self = UnwrapMutable(args);
+  if (!self) return;  // thrown
+  self->priority_ = priority;
   args.GetReturnValue().Set(args.Holder());
 }
 
 void Subscriber::on(const FunctionCallbackInfo<Value>& args) {
+  auto event = ""s;
   if (!CheckArgs("on", args, 2, 2,
-    [](const Local<Value> arg0, string& err_msg) {
+    [&event](const Local<Value> arg0, string& err_msg) {
       if (!arg0->IsString()) return false;
-      auto event = ToString(arg0);
-      return ("finish" == event);
+      event = ToString(arg0);
+      return ("finish" == event || "stall" == event || "recover" == event
+           || "segment" == event || "playlist" == event || "state" == event);
     },
     [](const Local<Value> arg1, string& err_msg) { return arg1->IsFunction(); })) return;
 
   Subscriber* self = Unwrap<Subscriber>(args.Holder());
   assert(self);
 
-  self->finish_event_.AddListener(Local<Function>::Cast(args[1]));
+  if ("segment" == event || "playlist" == event) {
+    // emitted on JS thread only, so called directly
+    auto isolate = args.GetIsolate();
+    self->segment_context_.Reset(isolate, isolate->GetCurrentContext());
+    auto& listeners = ("segment" == event) ? self->segment_listeners_ : self->playlist_listeners_;
+    listeners.emplace_back(isolate, Local<Function>::Cast(args[1]));
+  } else if ("state" == event) {
+    // likewise, from OnLifecycleAsync()
+    auto isolate = args.GetIsolate();
+    self->state_context_.Reset(isolate, isolate->GetCurrentContext());
+    self->state_listeners_.emplace_back(isolate, Local<Function>::Cast(args[1]));
+  } else if ("stall" == event) {
+    self->stall_event_.AddListener(Local<Function>::Cast(args[1]));
+  } else if ("recover" == event) {
+    self->recover_event_.AddListener(Local<Function>::Cast(args[1]));
+  } else {
+    self->finish_event_.AddListener(Local<Function>::Cast(args[1]));
+  }
+}
+
+void Subscriber::releaseSegment(const FunctionCallbackInfo<Value>& args) {
+  if (!CheckArgs("releaseSegment", args, 1, 1,
+    [](const Local<Value> arg0, string& err_msg) { return node::Buffer::HasInstance(arg0); })) return;
+  Subscriber* self = Unwrap<Subscriber>(args.Holder());
+  assert(self);
+
+  auto data = reinterpret_cast<const uint8_t*>(node::Buffer::Data(args[0]));
+  auto array_buffer = Local<v8::ArrayBufferView>::Cast(args[0])->Buffer();
+  if (!self->segments_ || !self->segments_->Holds(data) || !array_buffer->IsDetachable()) {
+    args.GetReturnValue().Set(ToLocalBoolean(false));
+    return;
+  }
+  // JS cannot reach the memory any more once detached. detaching may have freed it already.
+  array_buffer->Detach();
+  self->segments_->Release(data);
+  args.GetReturnValue().Set(ToLocalBoolean(true));
 }
 
 void Subscriber::start(const FunctionCallbackInfo<Value>& args) {
@@ -427,7 +787,17 @@ void Subscriber::start(const FunctionCallbackInfo<Value>& args) {
   Subscriber* self = Unwrap<Subscriber>(args.Holder());
   assert(self);
 
+  auto state = self->lifecycle_->state();
+  if (Lifecycle::kIdle != state && Lifecycle::kStopped != state) {
+    // starting again would reopen (and truncate) the outputs being written
+    ThrowException(args, Exception::Error, "Subscription is already running");
+    return;
+  }
+
   AT_LOG_INFO(self->log_, "Starting");
+  TraceSpan span("subscriber.start", self->id_);
+  if (0 == self->start_ns_) self->start_ns_ = TrackMonitor::NowNs();
+  ++self->run_;
 
   SubscriberConfig* config = Unwrap<SubscriberConfig>(self->config_.Get(args.GetIsolate()));
   assert(config);
@@ -436,39 +806,227 @@ void Subscriber::start(const FunctionCallbackInfo<Value>& args) {
     return;
   }
 
+  auto context = args.GetIsolate()->GetCurrentContext();
+  auto resolver = Promise::Resolver::New(context).ToLocalChecked();
+  args.GetReturnValue().Set(resolver->GetPromise());
+
   // starts event emission
   self->finish_event_.Start();
+  self->stall_event_.Start();
+  self->recover_event_.Start();
+  self->lifecycle_->Set(Lifecycle::kAllocating);
+
+  if (MemoryWatch::OverProcessLimit()) {
+    AT_LOG_ERROR(self->log_, "Not starting. RSS " << MemoryWatch::RssBytes() << " is over the limit "
+                 << MemoryWatch::ProcessLimit());
+    self->lifecycle_->Set(Lifecycle::kIdle);
+    resolver->Reject(context, Exception::Error(ToLocalString(kErrorMemoryLimit))).FromJust();
+    return;
+  }
 
-  if (!self->CreateSinks(*config)) {
-    AT_LOG_ERROR(self->log_, "Failed to create sinks");
+  if (CapacityModel::HasPolicy()) {
+    auto reason = self->addon_->capacity->CheckAdmission(SinkClassOf(*config));
+    if (!reason.empty()) {
+      AT_LOG_WARNING(self->log_, "Not starting " << CapacityModel::SinkClassString(SinkClassOf(*config))
+                     << ". " << kErrorAdmission << reason);
+      self->lifecycle_->Set(Lifecycle::kIdle);
+      resolver->Reject(context, Exception::Error(ToLocalString(kErrorAdmission + reason))).FromJust();
+      return;
+    }
+  }
+
+  auto sink_err = ""s;
+  if (!self->CreateSinks(*config, sink_err)) {
+    auto msg = "Failed to create sinks"s + (sink_err.empty() ? "" : ": " + sink_err);
+    AT_LOG_ERROR(self->log_, msg);
+    self->AbandonStart();
+    self->lifecycle_->Set(Lifecycle::kIdle);
+    resolver->Reject(context, Exception::Error(ToLocalString(msg))).FromJust();
     return;
   }
 
+  // read by load shedding, so that priority() applies from the next start as the encoder share does
+  self->priority_ = config->priority_;
+
   // Lazy init of facade
   if (!self->facade_) {
-    self->facade_ = SubscriberFacade::New(EastWood::event_loop, move(config->config_));
+    self->facade_config_ = config->FacadeConfig();
+    self->audio_stall_.threshold_ms = config->audio_stall_ms_;
+    self->video_stall_.threshold_ms = config->video_stall_ms_;
+    self->ApplyFrameTrace(*config);
+    self->memory_cap_mb_ = config->memory_cap_mb_;
+    self->ApplyLatency(*config);
+    auto err = ""s;
+    if (!self->StartCapture(*config, err)) {
+      AT_LOG_ERROR(self->log_, err);
+      self->AbandonStart();
+      self->lifecycle_->Set(Lifecycle::kIdle);
+      resolver->Reject(context, Exception::Error(ToLocalString(err))).FromJust();
+      return;
+    }
+    if (!config->replay_filename_.empty()) {
+      self->replayer_ = FrameReplayer::Open(config->replay_filename_, config->replay_speed_, err);
+      if (!self->replayer_) {
+        AT_LOG_ERROR(self->log_, err);
+        self->AbandonStart();
+        self->lifecycle_->Set(Lifecycle::kIdle);
+        resolver->Reject(context, Exception::Error(ToLocalString(err))).FromJust();
+        return;
+      }
+      self->NewTaps(self->replay_audio_sink_, self->replay_video_sink_);
+      self->lifecycle_->Set(Lifecycle::kConnecting);  // before the first frame
+      self->replayer_->Start(self->audio_tap_, self->video_tap_, [self](const string& err) {
+        self->NotifyFinish(err);
+      });
+    } else {
+      self->NewFacade(self->facade_config_.duration);
+    }
+  } else if (self->facade_duration_ != config->config_->duration) {
+    // renewed or reconfigured in the previous run. this run gets the configured duration.
+    self->facade_config_.duration = config->config_->duration;
+    if (self->audio_tap_) self->audio_tap_->Detach();
+    if (self->video_tap_) self->video_tap_->Detach();
+    self->NewFacade(self->facade_config_.duration);
   }
 
-  self->facade_->on_finished([self]() {
-      self->NotifyFinish();
-  });
-  self->facade_->Start();
+  if (self->facade_) {
+    self->lifecycle_->Set(Lifecycle::kConnecting);
+    self->facade_->Start();
+  }
+  self->run_start_ns_ = self->subscribed_ns_ = TrackMonitor::NowNs();
+  self->deadline_ns_ = 0;  // a duration given to reconfigure() in an earlier run
+  self->StartStallWatch();
+  self->addon_->memory_watch->Start();
+  self->addon_->capacity->Start();
   AT_LOG_INFO(self->log_, "Started");
+  resolver->Resolve(context, Undefined(args.GetIsolate())).FromJust();
 }
 
-bool Subscriber::CreateSinks(SubscriberConfig& config) {
-  // a/v sink integrity has been checked already, so just checking one of them is sufficient here.
+void Subscriber::AbandonStart() {
+  // nothing feeds the outputs yet. they close right away, and the encoder share returns to the budget.
+  ReleaseSinks();
+  segment_watcher_.reset();
+  encoder_lease_.reset();
+}
+
+void Subscriber::ApplyFrameTrace(const SubscriberConfig& config) {
+  if (0 == config.trace_every_) return;
+  for (auto track : { video_track_.get(), config.trace_audio_ ? audio_track_.get() : nullptr }) {
+    if (!track) continue;
+    track->sampler.level = static_cast<uint8_t>(config.trace_level_);
+    track->sampler.per_second = config.trace_per_second_;
+    track->sampler.every = config.trace_every_;
+  }
+  FrameTrace::Instance().EnsureStarted();
+}
+
+void Subscriber::ApplyLatency(const SubscriberConfig& config) {
+  const auto& profile = config.latency_;
+  for (auto track : { audio_track_.get(), video_track_.get() }) {
+    track->latency.max_delay_ns = profile.max_delay_ms * 1000000LL;
+  }
+  if (0 < profile.min_delay_ms) {
+    playout_ = make_shared<PlayoutBuffer>(profile.min_delay_ms * 1000000LL, frame_pool_, audio_slot_, video_slot_,
+                                          audio_track_, video_track_);
+  }
+  AT_LOG_INFO(log_, "Latency " << LatencyProfile::ModeString(profile.mode) << ", delay " << profile.min_delay_ms
+              << "ms to " << profile.max_delay_ms << "ms");
+}
+
+void Subscriber::NewTaps(AudioSinkPtr& audio_sink, VideoSinkPtr& video_sink) {
+  audio_tap_ = new TapAudioSink(audio_slot_, audio_track_, playout_);
+  audio_sink = AudioSinkPtr(audio_tap_);
+  video_tap_ = new TapVideoSink(video_slot_, video_track_, playout_);
+  video_sink = VideoSinkPtr(video_tap_);
+}
+
+bool Subscriber::StartCapture(const SubscriberConfig& config, string& err) {
+  if (config.capture_filename_.empty()) return true;
+  auto recorder = FrameRecorder::Open(config.capture_filename_, frame_pool_);
+  if (!recorder) {
+    err = "Cannot create " + config.capture_filename_;
+    return false;
+  }
+  // both tracks share the file
+  audio_track_->recorder = video_track_->recorder = recorder;
+  return true;
+}
+
+void Subscriber::NewFacade(at::Duration duration) {
+  // sinks stay in the slots. each facade gets its own taps in front of them.
+  auto config = facade_config_;
+  config.duration = facade_duration_ = duration;
+  NewTaps(config.audio_sink, config.video_sink);
+
+  facade_ = SubscriberFacade::New(addon_->AcquireEventLoop(), move(config));
+  auto generation = ++facade_generation_;
+  facade_->on_finished([this, generation]() {
+    if (generation != facade_generation_) return;  // replaced by resubscription
+    NotifyFinish();
+  });
+}
+
+SinkClass Subscriber::SinkClassOf(const SubscriberConfig& config) {
+  if (!config.plugin_path_.empty()) return kSinkClassPlugin;
+  if (config.composite_) return kSinkClassNone;  // the encode is the composite's
   if (!config.ffmpeg_output_.empty()) {
-    return CreateFFMpegSinks(config);
+    // stream copy of any track is taken as remux
+    for (auto name : { kVideoCodecOption, kAudioCodecOption }) {
+      auto it = config.ffmpeg_options_->find(name);
+      if (it != config.ffmpeg_options_->end() && "copy" == it->second) return kSinkClassRemux;
+    }
+    return kSinkClassTranscode;
+  }
+  if (EastWood::AudioSink_File == config.audio_sink_ || EastWood::VideoSink_File == config.video_sink_
+   || EastWood::AudioSink_Stream == config.audio_sink_ || EastWood::VideoSink_Stream == config.video_sink_) {
+    return kSinkClassFile;  // raw writes alike
+  }
+  return kSinkClassNone;
+}
+
+bool Subscriber::CreateSinks(SubscriberConfig& config, string& err) {
+  sink_class_ = SinkClassOf(config);
+  NewSinks sinks;
+  auto result = false;
+  // a/v sink integrity has been checked already, so just checking one of them is sufficient here.
+  if (!config.plugin_path_.empty()) {
+    audio_track_->sink = video_track_->sink = "plugin";
+    result = CreatePluginSinks(config, sinks, err);
+  } else if (config.composite_) {
+    audio_track_->sink = video_track_->sink = "composite";
+    result = CreateCompositeSinks(config, sinks);
+  } else if (!config.ffmpeg_output_.empty()) {
+    audio_track_->sink = video_track_->sink = "ffmpeg";
+    result = CreateFFMpegSinks(config, sinks, err);
   } else {
-    return CreateRegularSinks(config);
+    audio_track_->sink = EastWood::SinkString(config.audio_sink_);
+    video_track_->sink = EastWood::SinkString(config.video_sink_);
+    result = CreateRegularSinks(config, sinks, err);
+  }
+  // those created before a failure close here
+  if (result) SwapSinks(sinks, true, true);
+  return result;
+}
+
+void Subscriber::SwapSinks(NewSinks& sinks, bool audio, bool video) {
+  {
+    // frames are delivered with the slot locked, so each track switches between two frames.
+    // both are locked at once, so that a muxer shared by the tracks gets them from the same point on.
+    unique_lock<mutex> audio_lock(audio_slot_->mutex, defer_lock);
+    unique_lock<mutex> video_lock(video_slot_->mutex, defer_lock);
+    lock(audio_lock, video_lock);
+    if (audio) swap(audio_slot_->sink, sinks.audio);
+    if (video) swap(video_slot_->sink, sinks.video);
   }
+  if (audio) swap(audio_stream_, sinks.audio_stream);
+  if (video) swap(video_stream_, sinks.video_stream);
 }
 
-bool Subscriber::CreateRegularSinks(SubscriberConfig& config) {
+bool Subscriber::CreateRegularSinks(SubscriberConfig& config, NewSinks& sinks, string& err) {
   at::eastwood::AudioSinkConfig audio_config;
   switch (config.audio_sink_) {
     case EastWood::AudioSink_None:
+    case EastWood::AudioSink_Stream:  // replaced below
       audio_config.audio_sink = at::eastwood::audio_sink_t::kAudioSinkNone;
       break;
     case EastWood::AudioSink_File:
@@ -484,6 +1042,7 @@ bool Subscriber::CreateRegularSinks(SubscriberConfig& config) {
   at::eastwood::VideoSinkConfig video_config;
   switch (config.video_sink_) {
     case EastWood::VideoSink_None:
+    case EastWood::VideoSink_Stream:  // replaced below
       video_config.video_sink = at::eastwood::video_sink_t::kVideoSinkNone;
       break;
     case EastWood::VideoSink_File:
@@ -496,30 +1055,56 @@ bool Subscriber::CreateRegularSinks(SubscriberConfig& config) {
       break;
   }
 
-  auto a_v_sinks = at::eastwood::StreamSinkFactory().CreateSinks(audio_config, video_config);
-  config.config_.audio_sink = move(a_v_sinks.first);
-  config.config_.video_sink = move(a_v_sinks.second);
-  return true;
-}
-
-static pair<string, string> SplitKeyValue(const string& token, char separator) {
-  auto pos = token.find(separator);
-  if (pos < token.size()) {
-    return make_pair(token.substr(0, pos), token.substr(pos+1));
-  } else {
-    return make_pair(token, ""s);
+  if (EastWood::AudioSink_Stream == config.audio_sink_) {
+    sinks.audio_stream = StreamWriter::Open(config.audio_sink_filename_, config.audio_sink_buffer_bytes_,
+                                            config.latency_.StreamDelayMs(), err);
+    if (!sinks.audio_stream) return false;
+  }
+  if (EastWood::VideoSink_Stream == config.video_sink_) {
+    sinks.video_stream = StreamWriter::Open(config.video_sink_filename_, config.video_sink_buffer_bytes_,
+                                            config.latency_.StreamDelayMs(), err);
+    if (!sinks.video_stream) {
+      sinks.audio_stream.reset();
+      return false;
+    }
   }
+
+  auto a_v_sinks = at::eastwood::StreamSinkFactory().CreateSinks(audio_config, video_config);
+  sinks.audio = sinks.audio_stream ? AudioSinkPtr(new StreamAudioSink(sinks.audio_stream)) : move(a_v_sinks.first);
+  sinks.video = sinks.video_stream ? VideoSinkPtr(new StreamVideoSink(sinks.video_stream)) : move(a_v_sinks.second);
+
+  auto audio_file = (EastWood::AudioSink_File == config.audio_sink_);
+  auto video_file = (EastWood::VideoSink_File == config.video_sink_);
+  return ApplyTimeline(config, sinks, audio_file || sinks.audio_stream, video_file || sinks.video_stream,
+                       audio_file ? config.audio_sink_filename_ : "", video_file ? config.video_sink_filename_ : "",
+                       config.timeline_fill_fps_, err);
 }
 
-bool Subscriber::CreateFFMpegSinks(SubscriberConfig& config) {
+bool Subscriber::CreateFFMpegSinks(SubscriberConfig& config, NewSinks& sinks, string& err) {
   using at::eastwood::FFmpegStreamSinkFactory;
-  FFmpegStreamSinkFactory::OptionMap opts;
-  auto params = at::eastwood::StringTokenizer::Tokenize(config.ffmpeg_param_, ' ');
-  for (const auto& param : params) {
-    auto key_val = SplitKeyValue(param, '=');  // key-value separator
-    opts[key_val.first] = key_val.second;
+  // parsed once by ffmpegSink(), possibly shared with other subscribers via config template
+  auto options = *config.ffmpeg_options_;
+  if (kSinkClassTranscode == sink_class_) {
+    encoder_lease_ = EncoderBudget::Instance().Acquire(CapacityModel::PriorityWeight(config.priority_));
+    // given parameters take precedence
+    options.emplace(EncoderBudget::kThreadsOption, to_string(encoder_lease_->threads));
+    if (!encoder_lease_->preset.empty()) options.emplace(EncoderBudget::kPresetOption, encoder_lease_->preset);
+    AT_LOG_INFO(log_, "Encoder threads " << options[EncoderBudget::kThreadsOption]);
+    if (LatencyProfile::kUltraLow == config.latency_.mode) options.emplace(kTuneOption, "zerolatency");
   }
-  auto factory = FFmpegStreamSinkFactory(config.ffmpeg_output_, opts);
+  if (config.latency_.FlushPackets()) options.emplace(kFlushPacketsOption, "1");
+  auto output = config.ffmpeg_output_;
+  if (config.memory_segments_) {
+    segments_ = make_shared<SegmentStore>();
+    segment_watcher_ = SegmentWatcher::Start(addon_->uv_loop, id_, output, segments_,
+        [this](const string& name, SegmentStore::Block* block, bool manifest) {
+          EmitSegment(name, block, manifest);
+        }, err);
+    if (!segment_watcher_) return false;
+    output = segment_watcher_->ManifestPath();
+    AT_LOG_INFO(log_, "Segments in memory via " << output);
+  }
+  auto factory = FFmpegStreamSinkFactory(output, options);
 
   bool result = true;
 
@@ -533,13 +1118,138 @@ bool Subscriber::CreateFFMpegSinks(SubscriberConfig& config) {
   });
 
   auto a_v_sinks = factory.CreateSinks(at::eastwood::AudioSinkConfig(), at::eastwood::VideoSinkConfig());
-  config.config_.audio_sink = move(a_v_sinks.first);
-  config.config_.video_sink = move(a_v_sinks.second);
-  return result;
+  sinks.audio = move(a_v_sinks.first);
+  sinks.video = move(a_v_sinks.second);
+  // the muxer gets timestamps of the shared timeline, so that the output needs no re-encode to fix drift.
+  // not filled: the muxer takes gaps, and repeated pictures would only cost encoding.
+  return ApplyTimeline(config, sinks, true, true, "", "", 0, err) && result;
+}
+
+bool Subscriber::CreatePluginSinks(SubscriberConfig& config, NewSinks& sinks, string& err) {
+  plugin_ = PluginSinkInstance::Open(config.plugin_path_, config.plugin_params_, err);
+  if (!plugin_) return false;
+  AT_LOG_INFO(log_, "Plugin sink " << config.plugin_path_);
+  sinks.audio = AudioSinkPtr(new PluginAudioSink(plugin_));
+  sinks.video = VideoSinkPtr(new PluginVideoSink(plugin_));
+  return true;
+}
+
+bool Subscriber::CreateCompositeSinks(SubscriberConfig& config, NewSinks& sinks) {
+  // the subscriber leaves the composite when the slots release the input
+  auto input = config.composite_->AddInput(id_, frame_pool_);
+  sinks.audio = AudioSinkPtr(new CompositeAudioSink(input));
+  sinks.video = VideoSinkPtr(new CompositeVideoSink(input));
+  return true;
+}
+
+bool Subscriber::ApplyTimeline(const SubscriberConfig& config, NewSinks& sinks, bool audio, bool video,
+                               const string& audio_file, const string& video_file, uint32_t fill_fps, string& err) {
+  if (Timeline::kClockNone == config.timeline_clock_) return true;
+  FILE* audio_sidecar = nullptr;
+  FILE* video_sidecar = nullptr;
+  if (!audio_file.empty()) {
+    audio_sidecar = TrackTimeline::OpenSidecar(audio_file, config.timeline_clock_, err);
+    if (!audio_sidecar) return false;
+  }
+  if (!video_file.empty()) {
+    video_sidecar = TrackTimeline::OpenSidecar(video_file, config.timeline_clock_, err);
+    if (!video_sidecar) {
+      if (audio_sidecar) fclose(audio_sidecar);
+      return false;
+    }
+  }
+  // shared by the sinks created together. sinks swapped in later by reconfigure() start a timeline of their own.
+  auto timeline = make_shared<Timeline>(config.timeline_clock_);
+  if (audio) {
+    sinks.audio = AudioSinkPtr(new TimelineAudioSink(move(sinks.audio), timeline, audio_sidecar, 0 < fill_fps));
+  }
+  if (video) {
+    sinks.video = VideoSinkPtr(new TimelineVideoSink(move(sinks.video), timeline, video_sidecar, fill_fps,
+                                                     frame_pool_));
+  }
+  AT_LOG_INFO(log_, "Timeline " << Timeline::ClockString(config.timeline_clock_) << ", filling at "
+              << fill_fps << "fps");
+  return true;
+}
+
+void Subscriber::FinishSegments(function<void()> done) {
+  if (!segment_watcher_) {
+    done();
+    return;
+  }
+  // the sinks are closed already, so the segmenter has written the last segment and the final playlist
+  segment_watcher_->Finish(move(done));
+}
+
+void Subscriber::EmitSegment(const string& name, SegmentStore::Block* block, bool manifest) {
+  auto isolate = addon_->isolate;
+  const auto& listeners = manifest ? playlist_listeners_ : segment_listeners_;
+  if (listeners.empty()) {
+    SegmentStore::Free(nullptr, block);  // back to the pool
+    return;
+  }
+  HandleScope scope(isolate);
+  auto context = segment_context_.Get(isolate);
+  Context::Scope context_scope(context);
+  // the Buffer owns the block from here. SegmentStore::Free() returns it to the pool.
+  auto buffer = node::Buffer::New(isolate, reinterpret_cast<char*>(block->data), block->size,
+                                  SegmentStore::Free, block).ToLocalChecked();
+  Local<Value> argv[] = { ToLocalString(name), buffer };
+  for (const auto& listener : listeners) {
+    node::MakeCallback(isolate, handle(), listener.Get(isolate), 2, argv, {0, 0});
+  }
+}
+
+void Subscriber::OnLifecycleAsync(uv_async_t* async) {
+  auto self = static_cast<Subscriber*>(async->data);
+  // taken even without listeners, so that the queue does not grow
+  auto transitions = self->lifecycle_->Take();
+  if (transitions.empty() || self->state_listeners_.empty()) return;
+  auto isolate = self->addon_->isolate;
+  HandleScope scope(isolate);
+  auto context = self->state_context_.Get(isolate);
+  Context::Scope context_scope(context);
+  const auto& cache = *self->addon_->v8_cache;
+  for (const auto& transition : transitions) {
+    Local<Value> argv[] = { StateKey(cache, transition.state),
+                            ToLocalNumber(static_cast<double>(transition.time_ms)) };
+    for (const auto& listener : self->state_listeners_) {
+      node::MakeCallback(isolate, self->handle(), listener.Get(isolate), 2, argv, {0, 0});
+    }
+  }
+}
+
+Local<String> Subscriber::StateKey(const V8Cache& cache, Lifecycle::State state) {
+  const auto& k = cache.keys;
+  switch (state) {
+    case Lifecycle::kAllocating:
+      return cache.Key(k.allocating);
+    case Lifecycle::kConnecting:
+      return cache.Key(k.connecting);
+    case Lifecycle::kNegotiating:
+      return cache.Key(k.negotiating);
+    case Lifecycle::kStreaming:
+      return cache.Key(k.streaming);
+    case Lifecycle::kRetrying:
+      return cache.Key(k.retrying);
+    case Lifecycle::kStopping:
+      return cache.Key(k.stopping);
+    case Lifecycle::kStopped:
+      return cache.Key(k.stopped);
+    default:
+      return cache.Key(k.idle);
+  }
 }
 
 void Subscriber::NotifyFinish(const string& err) {
+  auto state = lifecycle_->state();
+  if (Lifecycle::kStopping == state || Lifecycle::kStopped == state) {
+    // events run until the stop completes. one 'finish' per start.
+    AT_LOG_INFO(log_, "Not notifying finish after stop: " << err);
+    return;
+  }
   AT_LOG_INFO(log_, "Notifying finish: " << err);
+  lifecycle_->Set(Lifecycle::kStopped);
   if (err.empty()) {
     finish_event_.Emit(nullptr);
   } else {
@@ -556,73 +1266,766 @@ void Subscriber::stop(const FunctionCallbackInfo<Value>& args) {
   Subscriber* self = Unwrap<Subscriber>(args.Holder());
   assert(self);
 
+  auto isolate = args.GetIsolate();
+  auto context = isolate->GetCurrentContext();
+  Local<Function> fn;
   if (1 == args.Length()) {
-    self->stop_callback_.SetCallbackFn(Local<Function>::Cast(args[0]));
+    fn = Local<Function>::Cast(args[0]);
   } else {
-    auto isolate = args.GetIsolate();
-    self->stop_callback_.SetCallbackFn(
-                               Function::New(isolate->GetCurrentContext(),
-                                   [](const FunctionCallbackInfo<Value>& args){}).ToLocalChecked());
+    // resolves the returned promise with the result
+    auto resolver = Promise::Resolver::New(context).ToLocalChecked();
+    fn = Function::New(context,
+                       [](const FunctionCallbackInfo<Value>& args) {
+                         auto context = args.GetIsolate()->GetCurrentContext();
+                         Local<Promise::Resolver>::Cast(args.Data())->Resolve(context, args[0]).FromJust();
+                       }, resolver).ToLocalChecked();
+    args.GetReturnValue().Set(resolver->GetPromise());
   }
 
-  self->StopFacade([self](exception_ptr ex, bool result) {
+  // held by this call, so that overlapping stops (or a stop() during stopAll()) each get their result
+  auto callback = make_shared<v8::Global<Function>>(isolate, fn);
+  auto callback_context = make_shared<v8::Global<Context>>(isolate, context);
+  self->StopFacade([self, callback, callback_context](exception_ptr ex, bool result) {
     if (ex) {
       AT_LOG_ERROR(self->log_, "Stop callback with exception: " << ex);
-      self->stop_callback_.Call(false);
-      return;
+      result = false;
     }
-    self->stop_callback_.Call(result);
+    auto isolate = self->addon_->isolate;
+    HandleScope scope(isolate);
+    auto context = callback_context->Get(isolate);
+    Context::Scope context_scope(context);
+    Local<Value> argv[] = { ToLocalBoolean(result) };
+    node::MakeCallback(isolate, self->handle(), callback->Get(isolate), 1, argv, {0, 0});
   });
 }
 
+namespace {
+
+/// deadline of a duration that never ends, i.e. 'infinite'
+constexpr int64_t kNeverNs = numeric_limits<int64_t>::max();
+
+/// @return @a duration in nanoseconds, kNeverNs if as long or longer
+int64_t DurationNs(at::Duration duration) {
+  if (chrono::duration_cast<at::Duration>(chrono::nanoseconds::max()) <= duration) return kNeverNs;
+  return chrono::duration_cast<chrono::nanoseconds>(duration).count();
+}
+
+/// @return @a duration_ns after @a at_ns, kNeverNs if not before
+int64_t AfterNs(int64_t at_ns, int64_t duration_ns) {
+  return (kNeverNs - at_ns <= duration_ns) ? kNeverNs : at_ns + duration_ns;
+}
+
+}  // namespace
+
+void Subscriber::reconfigure(const FunctionCallbackInfo<Value>& args) {
+  auto isolate = args.GetIsolate();
+  auto context = isolate->GetCurrentContext();
+  Subscriber* self = Unwrap<Subscriber>(args.Holder());
+  assert(self);
+  SubscriberConfig* config = Unwrap<SubscriberConfig>(self->config_.Get(isolate));
+  assert(config);
+
+  // applied to a copy first, so that nothing changes if any of them is wrong
+  SubscriberConfig next(self->addon_);
+  next.CopyFrom(*config);
+  SubscriberConfig::Changes changed;
+  if (!CheckArgs("reconfigure", args, 1, 1,
+    [context, &next, &changed](const Local<Value> arg0, string& err_msg) {
+      if (!arg0->IsObject()) return false;
+      return next.ApplyChanges(context, Local<Object>::Cast(arg0), changed, err_msg);
+    })) return;
+  auto state = self->lifecycle_->state();
+  if (!self->facade_ || state < Lifecycle::kAllocating || Lifecycle::kRetrying < state) {
+    ThrowException(args, Exception::Error, "Subscription is not running");
+    return;
+  }
+
+  AT_LOG_INFO(self->log_, "Reconfiguring");
+  TraceSpan span("subscriber.reconfigure", self->id_);
+  auto resolver = Promise::Resolver::New(context).ToLocalChecked();
+  args.GetReturnValue().Set(resolver->GetPromise());
+
+  auto sink_class = self->sink_class_;
+  auto encoder_lease = self->encoder_lease_;  // the old encoder keeps its share until it is closed
+  NewSinks sinks;
+  auto result = true;
+  auto sink_err = ""s;
+  if (changed.ffmpeg) {
+    self->sink_class_ = SinkClassOf(next);
+    self->encoder_lease_.reset();  // a remux output needs none
+    result = self->CreateFFMpegSinks(next, sinks, sink_err);
+  } else if (changed.audio || changed.video) {
+    // only the tracks given get new sinks. an unchanged file must not be opened again.
+    SubscriberConfig tracks(self->addon_);
+    tracks.CopyFrom(next);
+    if (!changed.audio) tracks.audio_sink_ = EastWood::AudioSink_None;
+    if (!changed.video) tracks.video_sink_ = EastWood::VideoSink_None;
+    self->sink_class_ = SinkClassOf(next);
+    result = self->CreateRegularSinks(tracks, sinks, sink_err);
+  }
+  if (!result) {
+    self->sink_class_ = sink_class;
+    self->encoder_lease_ = encoder_lease;
+    auto msg = "Failed to create sinks"s + (sink_err.empty() ? "" : ": " + sink_err);
+    AT_LOG_ERROR(self->log_, msg);
+    resolver->Reject(context, Exception::Error(ToLocalString(msg))).FromJust();
+    return;
+  }
+
+  auto audio = changed.ffmpeg || changed.audio;
+  auto video = changed.ffmpeg || changed.video;
+  if (audio || video) {
+    self->SwapSinks(sinks, audio, video);
+    if (changed.audio) self->audio_track_->sink = EastWood::SinkString(next.audio_sink_);
+    if (changed.video) self->video_track_->sink = EastWood::SinkString(next.video_sink_);
+    // closes the old outputs, e.g. writing the trailer of the previous FFmpeg output
+    sinks = NewSinks();
+    encoder_lease.reset();
+    AT_LOG_INFO(self->log_, "Sinks replaced");
+  }
+  if (changed.duration) {
+    self->deadline_duration_ = next.config_->duration;
+    auto duration_ns = DurationNs(self->deadline_duration_);
+    self->deadline_ns_ = AfterNs(self->run_start_ns_, duration_ns);
+    AT_LOG_INFO(self->log_, "Duration "
+                << (kNeverNs == duration_ns ? "infinite"s : to_string(duration_ns / 1000000) + "ms"));
+    self->StartDeadline();
+  }
+  // configuration().toObject() shows the configuration in use
+  config->CopyFrom(next);
+  resolver->Resolve(context, Undefined(isolate)).FromJust();
+}
+
 void Subscriber::StopFacade(std::function<void(exception_ptr, bool)> callback) {
   AT_LOG_INFO(log_, "Stopping");
 
+  StopStallWatch();
+  StopDeadline();
+  // stays stopped once ended by itself ('finish')
+  if (Lifecycle::kStopped != lifecycle_->state()) lifecycle_->Set(Lifecycle::kStopping);
+
+  // stays referenced until stopped, even if released by JS or given up by stopAll() meanwhile
+  Ref();
+  // the completion comes through the queue, which keeps the loop alive for it. not once force closed.
+  if (0 == pending_stops_++) js_queue_->KeepAlive(true);
+  auto force_closes = force_closes_;
+  callback = [this, callback, force_closes](exception_ptr ex, bool result) {
+    if (callback) callback(ex, result);
+    if (force_closes == force_closes_ && 0 == --pending_stops_) js_queue_->KeepAlive(false);
+    Unref();
+  };
+  // the encoder thread share returns to the budget once the encoder is gone
+  auto encoder_lease = move(encoder_lease_);
+  if (replayer_) replayer_->Stop();  // no more frames once this returns
+  if (!facade_) {
+    // Stopped before Start, or replaying... pretending 'stopped'
+    if (playout_) playout_->Flush();
+    auto now_ns = TrackMonitor::NowNs();
+    CompleteStop(run_, now_ns, now_ns, nullptr, true, move(callback));
+    return;
+  }
+
+  stop_latency_ms_ = -1;
+  auto run = run_;
+  auto begin_ns = TrackMonitor::NowNs();
+  auto complete = [this, run, begin_ns, callback](exception_ptr ex, bool result, int64_t end_ns) {
+    CompleteStop(run, begin_ns, end_ns, ex, result, callback);
+  };
+  // called on a thread of the core, possibly after ForceClose(). nothing of the subscriber but these is touched there.
+  auto queue = js_queue_;
+  auto playout = playout_;
+  facade_->Stop()->on_result([queue, playout, complete, encoder_lease](exception_ptr ex, bool result) {
+    if (playout) playout->Flush();  // the tail of a recording is not dropped
+    auto end_ns = TrackMonitor::NowNs();
+    queue->Post([complete, ex, result, end_ns]() { complete(ex, result, end_ns); });
+  });
+}
+
+void Subscriber::CompleteStop(uint32_t run, int64_t begin_ns, int64_t end_ns, exception_ptr ex, bool result,
+                              std::function<void(exception_ptr, bool)> callback) {
+  if (run != run_) {
+    // force closed, or started again meanwhile. the sinks are not those of this stop any more.
+    callback(ex, result);
+    return;
+  }
+  stop_latency_ms_ = (end_ns - begin_ns) / 1000000;
+  AT_LOG_INFO(log_, "Stopped in " << stop_latency_ms_ << "ms");
+  // a turn later, so that a 'finish' emitted right before the stop (memory cap, deadline) is delivered first
+  js_queue_->Post([this, run]() {
+    if (run == run_) StopEvents();
+  });
+  ReleaseSinks();
+  FinishSegments([this, callback, ex, result]() {
+    lifecycle_->Set(Lifecycle::kStopped);
+    callback(ex, result);
+  });
+}
+
+void Subscriber::StopEvents() {
   finish_event_.Stop();
+  stall_event_.Stop();
+  recover_event_.Stop();
+}
 
-  if (!facade_) {
-    // Stopped before Start... pretending 'stopped'
-    if (callback) callback(nullptr, true);
+void Subscriber::ReleaseSinks() {
+  // closes outputs (files, RTMP sessions)
+  {
+    lock_guard<mutex> lock(audio_slot_->mutex);
+    audio_slot_->sink = AudioSinkPtr();
+  }
+  {
+    lock_guard<mutex> lock(video_slot_->mutex);
+    video_slot_->sink = VideoSinkPtr();
+  }
+  plugin_.reset();  // the slots released theirs, so the plugin instance closes here
+  audio_stream_.reset();  // likewise, flushing what the reader has not taken yet
+  video_stream_.reset();
+}
+
+void Subscriber::ForceClose() {
+  AT_LOG_WARNING(log_, "Force closing");
+  ++run_;  // a stop completing later leaves everything as closed here
+  ++force_closes_;  // nor keeps the loop alive
+  pending_stops_ = 0;
+  js_queue_->KeepAlive(false);
+  lifecycle_->Set(Lifecycle::kStopped);
+  StopEvents();
+  StopStallWatch();
+  StopDeadline();
+  if (audio_tap_) audio_tap_->Detach();
+  if (video_tap_) video_tap_->Detach();
+  ++facade_generation_;
+  facade_.reset();
+  retiring_facades_.clear();
+  ReleaseSinks();  // right away
+  segment_watcher_.reset();  // segments not handed over yet are dropped
+  encoder_lease_.reset();
+}
+
+string Subscriber::UserId() const {
+  if (!facade_config_.user_id.empty()) return facade_config_.user_id;
+  HandleScope scope(addon_->isolate);
+  auto config = Unwrap<SubscriberConfig>(config_.Get(addon_->isolate));
+  return config ? config->user_id_ : "";
+}
+
+int64_t Subscriber::EstimateMemoryBytes() const {
+  auto state = lifecycle_->state();
+  if (Lifecycle::kIdle == state || Lifecycle::kStopped == state) return 0;
+  // copies held by the playout buffer, capture, composite and timeline are lent by the pool
+  auto pool = frame_pool_->stats();
+  int64_t bytes = pool.pooled_bytes + pool.lent_bytes;
+  for (auto stream : { audio_stream_.get(), video_stream_.get() }) {
+    if (stream) bytes += stream->stats().capacity;
+  }
+  if (segments_) bytes += segments_->held_bytes();
+  return bytes;
+}
+
+void Subscriber::UpdateMemory() {
+  auto bytes = EstimateMemoryBytes();
+  addon_->isolate->AdjustAmountOfExternalAllocatedMemory(bytes - memory_bytes_);
+  memory_bytes_ = bytes;
+
+  if (0 == memory_cap_mb_ || memory_cap_exceeded_ || bytes <= (int64_t(memory_cap_mb_) << 20)) return;
+  memory_cap_exceeded_ = true;
+  AT_LOG_ERROR(log_, "Estimated memory " << bytes << " is over the cap " << memory_cap_mb_ << "MB. Stopping");
+  NotifyFinish(kErrorMemoryCap);
+  StopFacade();
+}
+
+void Subscriber::StartStallWatch() {
+  auto interval_ms = 0u;
+  for (auto threshold_ms : { audio_stall_.threshold_ms, video_stall_.threshold_ms }) {
+    if (0 < threshold_ms && (0 == interval_ms || threshold_ms < interval_ms)) interval_ms = threshold_ms;
+  }
+  if (0 == interval_ms || stall_timer_) return;
+
+  audio_track_->monitor.gap_threshold_ns = audio_stall_.threshold_ms * 1000000LL;
+  video_track_->monitor.gap_threshold_ns = video_stall_.threshold_ms * 1000000LL;
+
+  // polls a few times per threshold, so that a stall is noticed within a fraction of it
+  interval_ms = min(max(interval_ms / 4, uint32_t(kMinStallPollMs)), uint32_t(kMaxStallPollMs));
+  stall_timer_ = NewBackgroundTimer(addon_->uv_loop, this);
+  uv_timer_start(stall_timer_, OnStallTimer, interval_ms, interval_ms);
+}
+
+void Subscriber::StopStallWatch() {
+  if (!stall_timer_) return;
+  CloseHandle(stall_timer_);
+  stall_timer_ = nullptr;
+}
+
+void Subscriber::OnStallTimer(uv_timer_t* timer) {
+  auto self = static_cast<Subscriber*>(timer->data);
+  auto now_ns = TrackMonitor::NowNs();
+
+  self->retiring_facades_.erase(
+    remove_if(self->retiring_facades_.begin(), self->retiring_facades_.end(),
+              [](const decltype(self->retiring_facades_)::value_type& f) { return f.second->load(); }),
+    self->retiring_facades_.end());
+
+  // evaluates both tracks so that each gets its own events
+  auto audio_stalled = self->CheckStall("audio", self->audio_track_->monitor, self->audio_stall_, now_ns);
+  auto video_stalled = self->CheckStall("video", self->video_track_->monitor, self->video_stall_, now_ns);
+  if (audio_stalled || video_stalled) {
+    self->Resubscribe();
+  }
+}
+
+bool Subscriber::CheckStall(const char* track, TrackMonitor& monitor, StallState& state, int64_t now_ns) {
+  if (0 == state.threshold_ms) return false;
+  auto threshold_ns = state.threshold_ms * 1000000LL;
+
+  if (state.stalled) {
+    auto gap_ns = monitor.resume_gap_ns.exchange(0);
+    if (0 < gap_ns) {
+      state.stalled = false;
+      state.last_ms = gap_ns / 1000000;
+      state.total_ms += state.last_ms;
+      AT_LOG_INFO(log_, "Recovered " << track << " after " << state.last_ms << "ms");
+      recover_event_.Emit(track, static_cast<double>(state.last_ms));
+      return false;
+    }
+    // still nothing since the last resubscription. tries again.
+    return threshold_ns <= now_ns - subscribed_ns_;
+  }
+
+  // never stalls before the first frame. slow initial subscription is reported via 'finish'.
+  if (0 == monitor.frames.load(memory_order_relaxed)) return false;
+  auto last_ns = max(monitor.last_frame_ns.load(memory_order_relaxed), subscribed_ns_);
+  if (now_ns - last_ns < threshold_ns) return false;
+
+  monitor.resume_gap_ns = 0;
+  state.stalled = true;
+  ++state.count;
+  auto idle_ms = (now_ns - monitor.last_frame_ns.load(memory_order_relaxed)) / 1000000;
+  AT_LOG_WARNING(log_, "No " << track << " frame for " << idle_ms << "ms");
+  stall_event_.Emit(track, static_cast<double>(idle_ms));
+  return true;
+}
+
+void Subscriber::Resubscribe() {
+  if (!facade_) return;
+  AT_LOG_WARNING(log_, "Resubscribing");
+  TraceSpan span("subscriber.resubscribe", id_);
+  ++resubscribes_;
+
+  // the old facade must not reach the sinks any longer
+  if (audio_tap_) audio_tap_->Detach();
+  if (video_tap_) video_tap_->Detach();
+  auto stopped = make_shared<atomic<bool>>(false);
+  facade_->Stop()->on_result([stopped](exception_ptr ex, bool result) {
+    *stopped = true;
+  });
+  retiring_facades_.emplace_back(move(facade_), stopped);
+
+  NewFacade(NextFacadeDuration());
+  lifecycle_->Set(Lifecycle::kRetrying);  // until a frame comes from the new facade
+  facade_->Start();
+  subscribed_ns_ = TrackMonitor::NowNs();
+  if (deadline_timer_) StartDeadline();  // from the end of the new facade
+}
+
+at::Duration Subscriber::NextFacadeDuration() const {
+  if (0 == deadline_ns_) return facade_config_.duration;
+  if (kNeverNs == deadline_ns_) return deadline_duration_;
+  // the rest until the deadline
+  auto remaining_ms = max((deadline_ns_ - TrackMonitor::NowNs() + 999999) / 1000000, int64_t(1));
+  return chrono::duration_cast<at::Duration>(chrono::milliseconds(remaining_ms));
+}
+
+void Subscriber::StartDeadline() {
+  auto facade_end_ns = AfterNs(subscribed_ns_, DurationNs(facade_duration_));
+  if (kNeverNs == deadline_ns_ && kNeverNs == facade_end_ns) {
+    StopDeadline();  // nothing ends, nothing to renew
+    return;
+  }
+  auto at_ns = (deadline_ns_ <= facade_end_ns) ? deadline_ns_ : facade_end_ns - kRenewLeadMs * 1000000;
+  auto timeout_ms = max(at_ns - TrackMonitor::NowNs(), int64_t(0)) / 1000000;
+  if (!deadline_timer_) deadline_timer_ = NewBackgroundTimer(addon_->uv_loop, this);
+  uv_timer_start(deadline_timer_, OnDeadlineTimer, static_cast<uint64_t>(timeout_ms), 0);
+}
+
+void Subscriber::StopDeadline() {
+  if (!deadline_timer_) return;
+  CloseHandle(deadline_timer_);
+  deadline_timer_ = nullptr;
+}
+
+void Subscriber::OnDeadlineTimer(uv_timer_t* timer) {
+  auto self = static_cast<Subscriber*>(timer->data);
+  if (self->deadline_ns_ <= TrackMonitor::NowNs()) {
+    self->EndAtDeadline();
     return;
   }
+  // the facade would end before the deadline. its duration is fixed, so a new one takes over.
+  AT_LOG_INFO(self->log_, "Renewing subscription");
+  self->Resubscribe();
+}
+
+void Subscriber::EndAtDeadline() {
+  AT_LOG_INFO(log_, "Duration reached");
+  StopDeadline();
+  StopStallWatch();  // no resubscription from here on
+  if (audio_tap_) audio_tap_->Detach();
+  if (video_tap_) video_tap_->Detach();
+  ++facade_generation_;  // the facade ending by itself later is not notified again
+  NotifyFinish();
+  StopFacade();
+}
+
+void Subscriber::stats(const FunctionCallbackInfo<Value>& args) {
+  if (!CheckArgs("stats", args, 0, 0)) return;
+  Subscriber* self = Unwrap<Subscriber>(args.Holder());
+  assert(self);
+
+  auto context = args.GetIsolate()->GetCurrentContext();
+  const auto& cache = *self->addon_->v8_cache;
+  const auto& k = cache.keys;
+  auto start_ns = self->start_ns_;
+  auto track_stats = [&cache, &k, context, start_ns](const TrackContext& track_context, const StallState& state,
+                                                     const StreamWriter* writer) {
+    const auto& monitor = track_context.monitor;
+    const auto& latency_monitor = track_context.latency;
+    auto track = cache.NewObject(context, V8Cache::kShapeTrackStats);
+    cache.Put(context, track, k.frames,
+              ToLocalNumber(static_cast<double>(monitor.frames.load(memory_order_relaxed))));
+    cache.Put(context, track, k.stalls, ToLocalInteger(state.count));
+    cache.Put(context, track, k.stalled, ToLocalBoolean(state.stalled));
+    cache.Put(context, track, k.stalledTotal_ms, ToLocalNumber(static_cast<double>(state.total_ms)));
+    cache.Put(context, track, k.lastStall_ms, ToLocalNumber(static_cast<double>(state.last_ms)));
+    auto first_ns = monitor.first_frame_ns.load(memory_order_relaxed);
+    cache.Put(context, track, k.firstFrame_ms,
+              ToLocalNumber((0 < first_ns) ? max<int64_t>(0, first_ns - start_ns) / 1e6 : -1.0));
+    cache.Put(context, track, k.allocations, ToLocalNumber(AllocCounter::Enabled()
+        ? static_cast<double>(monitor.allocations.load(memory_order_relaxed)) : -1.0));
+    cache.Put(context, track, k.shed,
+              ToLocalNumber(static_cast<double>(track_context.shed.load(memory_order_relaxed))));
+    auto latency = cache.NewObject(context, V8Cache::kShapeLatencyStats);
+    auto transit_ms = latency_monitor.transit_ns() / 1e6;
+    auto held_ms = latency_monitor.held_ns() / 1e6;
+    auto sink_ms = latency_monitor.sink_ns() / 1e6;
+    cache.Put(context, latency, k.transit_ms, ToLocalNumber(transit_ms));
+    cache.Put(context, latency, k.held_ms, ToLocalNumber(held_ms));
+    cache.Put(context, latency, k.sink_ms, ToLocalNumber(sink_ms));
+    cache.Put(context, latency, k.total_ms, ToLocalNumber(transit_ms + held_ms + sink_ms));
+    cache.Put(context, latency, k.late, ToLocalNumber(static_cast<double>(latency_monitor.late())));
+    cache.Put(context, track, k.latency, latency);
+    auto stream_stats = writer ? writer->stats() : StreamWriter::Stats();
+    auto stream = cache.NewObject(context, V8Cache::kShapeStreamStats);
+    cache.Put(context, stream, k.frames, ToLocalNumber(static_cast<double>(stream_stats.frames)));
+    cache.Put(context, stream, k.bytes, ToLocalNumber(static_cast<double>(stream_stats.bytes)));
+    cache.Put(context, stream, k.overflows, ToLocalNumber(static_cast<double>(stream_stats.overflows)));
+    cache.Put(context, stream, k.overflowBytes, ToLocalNumber(static_cast<double>(stream_stats.overflow_bytes)));
+    cache.Put(context, stream, k.buffered, ToLocalNumber(static_cast<double>(stream_stats.buffered)));
+    cache.Put(context, stream, k.zeroCopy, ToLocalBoolean(stream_stats.zero_copy));
+    cache.Put(context, stream, k.failed, ToLocalBoolean(stream_stats.failed));
+    cache.Put(context, track, k.stream, stream);
+    return track;
+  };
+
+  auto obj = cache.NewObject(context, V8Cache::kShapeSubscriberStats);
+  cache.Put(context, obj, k.resubscribes, ToLocalInteger(self->resubscribes_));
+  cache.Put(context, obj, k.stop_ms, ToLocalNumber(static_cast<double>(self->stop_latency_ms_.load())));
+  cache.Put(context, obj, k.memory_bytes, ToLocalNumber(static_cast<double>(self->memory_bytes_)));
+  self->UpdateSpeed();
+  auto encoder = cache.NewObject(context, V8Cache::kShapeEncoderStats);
+  cache.Put(context, encoder, k.threads, ToLocalInteger(self->encoder_lease_ ? self->encoder_lease_->threads : 0));
+  cache.Put(context, encoder, k.preset, ToLocalString(self->encoder_lease_ ? self->encoder_lease_->preset : ""));
+  cache.Put(context, encoder, k.encodeFps, ToLocalNumber(self->speed_.encode_fps));
+  cache.Put(context, encoder, k.sourceFps, ToLocalNumber(self->speed_.source_fps));
+  cache.Put(context, encoder, k.speed,
+            ToLocalNumber(0 < self->speed_.source_fps ? self->speed_.encode_fps / self->speed_.source_fps : 0.0));
+  cache.Put(context, obj, k.encoder, encoder);
+  auto plugin_stats = self->plugin_ ? self->plugin_->Stats() : ew_sink_stats{};
+  auto plugin = cache.NewObject(context, V8Cache::kShapePluginStats);
+  cache.Put(context, plugin, k.frames, ToLocalNumber(static_cast<double>(plugin_stats.frames)));
+  cache.Put(context, plugin, k.bytes, ToLocalNumber(static_cast<double>(plugin_stats.bytes)));
+  cache.Put(context, plugin, k.errors, ToLocalNumber(static_cast<double>(plugin_stats.errors)));
+  cache.Put(context, obj, k.plugin, plugin);
+  auto segments = cache.NewObject(context, V8Cache::kShapeSegmentStats);
+  cache.Put(context, segments, k.delivered,
+            ToLocalNumber(static_cast<double>(self->segments_ ? self->segments_->delivered() : 0)));
+  cache.Put(context, segments, k.held,
+            ToLocalNumber(static_cast<double>(self->segments_ ? self->segments_->held() : 0)));
+  cache.Put(context, segments, k.held_bytes,
+            ToLocalNumber(static_cast<double>(self->segments_ ? self->segments_->held_bytes() : 0)));
+  cache.Put(context, obj, k.segments, segments);
+  auto pool_stats = self->frame_pool_->stats();
+  auto pool = cache.NewObject(context, V8Cache::kShapePoolStats);
+  cache.Put(context, pool, k.hits, ToLocalNumber(static_cast<double>(pool_stats.hits)));
+  cache.Put(context, pool, k.misses, ToLocalNumber(static_cast<double>(pool_stats.misses)));
+  cache.Put(context, pool, k.pooledBytes, ToLocalNumber(static_cast<double>(pool_stats.pooled_bytes)));
+  cache.Put(context, pool, k.outstanding, ToLocalNumber(static_cast<double>(pool_stats.outstanding)));
+  cache.Put(context, obj, k.pool, pool);
+  cache.Put(context, obj, k.audio,
+            track_stats(*self->audio_track_, self->audio_stall_, self->audio_stream_.get()));
+  cache.Put(context, obj, k.video,
+            track_stats(*self->video_track_, self->video_stall_, self->video_stream_.get()));
+  args.GetReturnValue().Set(obj);
+}
+
+void Subscriber::UpdateSpeed() {
+  auto now_ns = TrackMonitor::NowNs();
+  const auto& track = *video_track_;
+  auto frames = track.monitor.frames.load(memory_order_relaxed);
+  auto calls = track.delivery.calls.load(memory_order_relaxed);
+  auto delivery_ns = track.delivery.total_ns.load(memory_order_relaxed);
+  if (0 < speed_.at_ns) {
+    auto elapsed_ns = now_ns - speed_.at_ns;
+    if (elapsed_ns < kMinSpeedWindowNs) return;  // keeps the previous estimate
+    speed_.source_fps = (frames - speed_.frames) * 1e9 / elapsed_ns;
+    auto busy_ns = delivery_ns - speed_.delivery_ns;
+    speed_.encode_fps = (0 < busy_ns) ? (calls - speed_.calls) * 1e9 / busy_ns : 0;
+  }
+  speed_.at_ns = now_ns;
+  speed_.frames = frames;
+  speed_.calls = calls;
+  speed_.delivery_ns = delivery_ns;
+}
 
-  if (!callback) callback = [](exception_ptr ex, bool s){};
-  facade_->Stop()->on_result(callback);
+Subscriber::SubscriberConfig* Subscriber::SubscriberConfig::UnwrapMutable(const FunctionCallbackInfo<Value>& args) {
+  SubscriberConfig* self = Unwrap<SubscriberConfig>(args.Holder());
+  assert(self);
+  if (self->frozen_) {
+    ThrowException(args, Exception::Error, "Config template cannot be modified");
+    return nullptr;
+  }
+  return self;
+}
+
+at::eastwood::SubscriberConfig& Subscriber::SubscriberConfig::MutableConfig() {
+  if (1 != config_.use_count()) config_ = make_shared<at::eastwood::SubscriberConfig>(*config_);
+  // nobody else holds it, so this is the only one to see the change
+  return const_cast<at::eastwood::SubscriberConfig&>(*config_);
+}
+
+at::eastwood::SubscriberConfig Subscriber::SubscriberConfig::FacadeConfig() const {
+  auto config = *config_;
+  config.user_id = user_id_;
+  config.tag = tag_;
+  config.stream_url = stream_url_;
+  return config;
+}
+
+void Subscriber::SubscriberConfig::CopyFrom(const SubscriberConfig& other) {
+  config_ = other.config_;  // shared until modified
+  user_id_ = other.user_id_;
+  tag_ = other.tag_;
+  stream_url_ = other.stream_url_;
+  audio_sink_ = other.audio_sink_;
+  audio_sink_filename_ = other.audio_sink_filename_;
+  audio_sink_buffer_bytes_ = other.audio_sink_buffer_bytes_;
+  video_sink_ = other.video_sink_;
+  video_sink_filename_ = other.video_sink_filename_;
+  video_sink_buffer_bytes_ = other.video_sink_buffer_bytes_;
+  ffmpeg_output_ = other.ffmpeg_output_;
+  ffmpeg_param_ = other.ffmpeg_param_;
+  ffmpeg_options_ = other.ffmpeg_options_;  // shared, not re-parsed
+  plugin_path_ = other.plugin_path_;
+  plugin_params_ = other.plugin_params_;
+  composite_ = other.composite_;
+  memory_segments_ = other.memory_segments_;
+  audio_stall_ms_ = other.audio_stall_ms_;
+  video_stall_ms_ = other.video_stall_ms_;
+  trace_every_ = other.trace_every_;
+  trace_per_second_ = other.trace_per_second_;
+  trace_level_ = other.trace_level_;
+  trace_audio_ = other.trace_audio_;
+  memory_cap_mb_ = other.memory_cap_mb_;
+  capture_filename_ = other.capture_filename_;
+  replay_filename_ = other.replay_filename_;
+  replay_speed_ = other.replay_speed_;
+  latency_ = other.latency_;
+  timeline_clock_ = other.timeline_clock_;
+  timeline_fill_fps_ = other.timeline_fill_fps_;
+  priority_ = other.priority_;
+}
+
+bool Subscriber::SubscriberConfig::IsInstance(Isolate* isolate, Local<Value> value) {
+  if (!value->IsObject()) return false;
+  auto ctor = AddonData::Get(isolate)->subscriber_config_constructor.Get(isolate);
+  return value->InstanceOf(isolate->GetCurrentContext(), ctor).FromMaybe(false);
+}
+
+bool Subscriber::SubscriberConfig::ApplyOverrides(Local<Context> context, Local<Object> overrides, string& err_msg) {
+  const auto& cache = *addon_->v8_cache;
+  const auto& k = cache.keys;
+  // each key is optional, but must be a non-empty string when given
+  auto get = [&](const v8::Eternal<String>& key, const char* name, string& out) {
+    auto val = overrides->Get(context, cache.Key(key)).ToLocalChecked();
+    if (val->IsUndefined()) return true;
+    if (!val->IsString() || ToString(val).empty()) {
+      err_msg = "Override "s + name + " must be non-empty string";
+      return false;
+    }
+    out = ToString(val);
+    return true;
+  };
+  auto uid = ""s, tag = ""s, url = ""s, output = ""s;
+  if (!get(k.userId, "userId", uid) || !get(k.tag, "tag", tag)
+   || !get(k.streamURL, "streamURL", url) || !get(k.output, "output", output)) return false;
+
+  if (!tag.empty() && at::Endpoint() == config_->notifier_endpoint) {
+    err_msg = "Override tag needs stream notifier in template";
+    return false;
+  }
+  if (!url.empty() && stream_url_.empty()) {
+    err_msg = "Override streamURL needs stream URL in template";
+    return false;
+  }
+  if (!output.empty() && ffmpeg_output_.empty()) {
+    err_msg = "Override output needs FFMpeg sink in template";
+    return false;
+  }
+  if (!uid.empty()) user_id_ = uid;
+  if (!tag.empty()) tag_ = tag;
+  if (!url.empty()) stream_url_ = url;
+  if (!output.empty()) ffmpeg_output_ = output;
+  return true;
+}
+
+bool Subscriber::SubscriberConfig::ApplyChanges(Local<Context> context, Local<Object> changes, Changes& changed,
+                                                string& err_msg) {
+  const auto& cache = *addon_->v8_cache;
+  const auto& k = cache.keys;
+  auto regular = ffmpeg_output_.empty() && plugin_path_.empty() && !composite_;
+  auto get = [&](const v8::Eternal<String>& key) { return changes->Get(context, cache.Key(key)).ToLocalChecked(); };
+
+  auto duration = get(k.duration);
+  if (!duration->IsUndefined()) {
+    at::Duration dur = 0s;
+    try {
+      if (duration->IsString()) dur = at::eastwood::DurationFromString(ToString(duration));
+    } catch (const exception& ex) {
+      dur = 0s;
+    }
+    if (dur <= 0s) {
+      err_msg = "Incorrect duration " + Inspect(duration) + ". must be longer than zero";
+      return false;
+    }
+    MutableConfig().duration = dur;
+    changed.duration = true;
+  }
+
+  auto apply_sink = [&](const v8::Eternal<String>& key, const char* type, int32_t none, int32_t file, int32_t stream,
+                        EastWood::SinkType& sink, string& filename, uint32_t& buffer_bytes, bool& track_changed) {
+    auto arg = get(key);
+    if (arg->IsUndefined()) return true;
+    if (!regular) {
+      err_msg = "Changing "s + type + " sink needs regular sinks";
+      return false;
+    }
+    auto sink_type = none;
+    auto name = ""s;
+    auto bytes = static_cast<uint32_t>(StreamWriter::kDefaultBufferBytes);
+    if (!CheckSinkArg(cache, context, type, arg, none, file, stream, sink_type, name, bytes, err_msg)) {
+      if (err_msg.empty()) err_msg = "Incorrect "s + type + " sink " + Inspect(arg);
+      return false;
+    }
+    sink = static_cast<EastWood::SinkType>(sink_type);
+    filename = name;
+    buffer_bytes = bytes;
+    track_changed = true;
+    return true;
+  };
+  if (!apply_sink(k.audio, "audio", EastWood::AudioSink_None, EastWood::AudioSink_File, EastWood::AudioSink_Stream,
+                  audio_sink_, audio_sink_filename_, audio_sink_buffer_bytes_, changed.audio)
+   || !apply_sink(k.video, "video", EastWood::VideoSink_None, EastWood::VideoSink_File, EastWood::VideoSink_Stream,
+                  video_sink_, video_sink_filename_, video_sink_buffer_bytes_, changed.video)) return false;
+
+  auto ffmpeg = get(k.ffmpeg);
+  if (!ffmpeg->IsUndefined()) {
+    if (ffmpeg_output_.empty()) {
+      err_msg = "Changing ffmpeg needs FFMpeg sink";
+      return false;
+    }
+    if (memory_segments_) {
+      err_msg = "Changing ffmpeg is not supported with memory segments";
+      return false;
+    }
+    auto output = ffmpeg->IsObject()
+                ? ffmpeg->ToObject(context).ToLocalChecked()->Get(context, cache.Key(k.output)).ToLocalChecked()
+                : Local<Value>();
+    if (output.IsEmpty() || !output->IsString() || ToString(output).empty()) {
+      err_msg = "Incorrect ffmpeg " + Inspect(ffmpeg) + ". needs non-empty output";
+      return false;
+    }
+    auto params = ffmpeg->ToObject(context).ToLocalChecked()->Get(context, cache.Key(k.params)).ToLocalChecked();
+    if (!params->IsUndefined() && !params->IsString()) {
+      err_msg = "Incorrect ffmpeg params " + Inspect(params);
+      return false;
+    }
+    ffmpeg_output_ = ToString(output);
+    if (params->IsString()) {
+      ffmpeg_param_ = ToString(params);
+      ffmpeg_options_ = ParseFFmpegParams(ffmpeg_param_);
+    }
+    changed.ffmpeg = true;
+  }
+
+  if (!changed.duration && !changed.audio && !changed.video && !changed.ffmpeg) {
+    err_msg = "Need duration, audio, video or ffmpeg";
+    return false;
+  }
+  return true;
 }
 
 void Subscriber::SubscriberConfig::verify(const FunctionCallbackInfo<Value>& args) {
   if (!CheckArgs("verify", args, 0, 0)) return;
   SubscriberConfig* self = Unwrap<SubscriberConfig>(args.Holder());
   assert(self);
-  self->VerifyConfigIntegrity(args);
+  self->VerifyConfigIntegrity(args, self->frozen_);
 }
 
-bool Subscriber::SubscriberConfig::VerifyConfigIntegrity(const FunctionCallbackInfo<Value>& args) const {
+bool Subscriber::SubscriberConfig::VerifyConfigIntegrity(const FunctionCallbackInfo<Value>& args,
+                                                         bool for_template) const {
   auto err = ""s;
-  if (at::Endpoint() == config_.bixby_endpoint && at::Endpoint() == config_.bixby_allocator_endpoint) {
+  // replay needs nothing about subscription
+  auto replay = !replay_filename_.empty();
+  if (!replay && at::Endpoint() == config_->bixby_endpoint && at::Endpoint() == config_->bixby_allocator_endpoint) {
     err += "Need either Bixby endpoint or Allocator endpoint\n";
   }
-  if (at::Endpoint() != config_.bixby_endpoint && at::Endpoint() != config_.bixby_allocator_endpoint) {
+  if (at::Endpoint() != config_->bixby_endpoint && at::Endpoint() != config_->bixby_allocator_endpoint) {
     err += "Bixby endpoint and Allocator endpoint are mutually exclusive\n";
   }
-  if (at::Endpoint() == config_.notifier_endpoint && config_.stream_url.empty()) {
+  if (!replay && at::Endpoint() == config_->notifier_endpoint && stream_url_.empty()) {
     err += "Need either Stream notifier endpoint or Stream URL\n";
   }
-  if (at::Endpoint() != config_.notifier_endpoint && !config_.stream_url.empty()) {
+  if (at::Endpoint() != config_->notifier_endpoint && !stream_url_.empty()) {
     err += "Stream notifier endpoint and Stream URL are mutually exclusive\n";
   }
-  if (ffmpeg_output_.empty()
+  if (ffmpeg_output_.empty() && plugin_path_.empty() && !composite_
    && ((video_sink_ == EastWood::Sink_Undefined) && (audio_sink_ == EastWood::Sink_Undefined))) {
     err += "Need sink\n";
   }
+  if (composite_ && (!ffmpeg_output_.empty() || !plugin_path_.empty()
+   || (video_sink_ != EastWood::Sink_Undefined) || (audio_sink_ != EastWood::Sink_Undefined))) {
+    err += "Composite sink is mutually exclusive with other sinks\n";
+  }
+  if (memory_segments_ && ffmpeg_output_.empty()) {
+    err += "Memory segments need FFMpeg sink\n";
+  } else if (memory_segments_ && !for_template && !IsPlaylistName(ffmpeg_output_)) {
+    // templates may leave the output to each subscriber
+    err += "Memory segments need a playlist file name (.m3u8 or .mpd) as FFMpeg output\n";
+  }
+  if (!plugin_path_.empty() && (!ffmpeg_output_.empty()
+   || (video_sink_ != EastWood::Sink_Undefined) || (audio_sink_ != EastWood::Sink_Undefined))) {
+    err += "Plugin sink is mutually exclusive with regular and FFMpeg sinks\n";
+  }
+  if (Timeline::kClockNone != timeline_clock_ && (!plugin_path_.empty() || composite_)) {
+    err += "Timeline needs regular or FFMpeg sinks\n";
+  }
   if (!ffmpeg_output_.empty()
    && ((video_sink_ != EastWood::Sink_Undefined) || (audio_sink_ != EastWood::Sink_Undefined))) {
     err += "Regular sink and FFMpeg sink are mutually exclusive\n";
   }
-  if (config_.duration == at::Duration()) {
+  if (!replay && config_->duration == at::Duration()) {
     err += "Need duration\n";
   }
-  if (config_.user_id.empty()) {
+  if (!replay && user_id_.empty() && !for_template) {
+    // templates may leave it to each subscriber
     err += "Need user id\n";
   }
 
@@ -645,84 +2048,99 @@ void Subscriber::SubscriberConfig::toObject(const v8::FunctionCallbackInfo<v8::V
 Local<Object> Subscriber::SubscriberConfig::ToObjectImpl() const {
   auto isolate = Isolate::GetCurrent();
   auto context = isolate->GetCurrentContext();
-  auto obj = Object::New(isolate);
-  auto bixby = Object::New(isolate);
-  obj->Set(context, ToLocalString("bixby"), bixby).FromJust();
-  bixby->Set(context, ToLocalString("host"),
-                      ToLocalString(config_.bixby_endpoint.host())).FromJust();
-  bixby->Set(context, ToLocalString("port"),
-                      ToLocalInteger(config_.bixby_endpoint.port())).FromJust();
-  auto allocator = Object::New(isolate);
-  obj->Set(context, ToLocalString("allocator"), allocator).FromJust();
-  allocator->Set(context, ToLocalString("host"),
-                      ToLocalString(config_.bixby_allocator_endpoint.host())).FromJust();
-  allocator->Set(context, ToLocalString("port"),
-                      ToLocalInteger(config_.bixby_allocator_endpoint.port())).FromJust();
-  allocator->Set(context, ToLocalString("loc"),
-                      ToLocalString(config_.alloc_location)).FromJust();
-  auto notifier = Object::New(isolate);
-  obj->Set(context, ToLocalString("notifier"), notifier).FromJust();
-  notifier->Set(context, ToLocalString("host"),
-                      ToLocalString(config_.notifier_endpoint.host())).FromJust();
-  notifier->Set(context, ToLocalString("port"),
-                      ToLocalInteger(config_.notifier_endpoint.port())).FromJust();
-  notifier->Set(context, ToLocalString("tag"),
-                      ToLocalString(config_.tag)).FromJust();
-  notifier->Set(context, ToLocalString("tls"),
-                      ToLocalBoolean(config_.use_tls_for_notifier)).FromJust();
-  notifier->Set(context, ToLocalString("cert"),
-                      ToLocalBoolean(!config_.no_notifier_cert_check)).FromJust();
-  obj->Set(context, ToLocalString("duration_ms"),
-                      ToLocalInteger(chrono::duration_cast<chrono::milliseconds>(config_.duration).count())).FromJust();
-  obj->Set(context, ToLocalString("userId"),
-                      ToLocalString(config_.user_id)).FromJust();
-  obj->Set(context, ToLocalString("streamURL"),
-                      ToLocalString(config_.stream_url)).FromJust();
-  obj->Set(context, ToLocalString("cert"),
-                      ToLocalBoolean(!config_.no_cert_check)).FromJust();
-  obj->Set(context, ToLocalString("secret"),
-                      ToLocalString(config_.auth_secret)).FromJust();
-  obj->Set(context, ToLocalString("frameInfo"),
-                      ToLocalBoolean(config_.print_frame_info)).FromJust();
+  const auto& cache = *addon_->v8_cache;
+  const auto& k = cache.keys;
+  auto obj = cache.NewObject(context, ffmpeg_output_.empty() ? V8Cache::kShapeConfigRegular
+                                                             : V8Cache::kShapeConfigFFmpeg);
+  auto bixby = cache.NewObject(context, V8Cache::kShapeEndpoint);
+  cache.Put(context, obj, k.bixby, bixby);
+  cache.Put(context, bixby, k.host, ToLocalString(config_->bixby_endpoint.host()));
+  cache.Put(context, bixby, k.port, ToLocalInteger(config_->bixby_endpoint.port()));
+  auto allocator = cache.NewObject(context, V8Cache::kShapeAllocator);
+  cache.Put(context, obj, k.allocator, allocator);
+  cache.Put(context, allocator, k.host, ToLocalString(config_->bixby_allocator_endpoint.host()));
+  cache.Put(context, allocator, k.port, ToLocalInteger(config_->bixby_allocator_endpoint.port()));
+  cache.Put(context, allocator, k.loc, ToLocalString(config_->alloc_location));
+  auto notifier = cache.NewObject(context, V8Cache::kShapeNotifier);
+  cache.Put(context, obj, k.notifier, notifier);
+  cache.Put(context, notifier, k.host, ToLocalString(config_->notifier_endpoint.host()));
+  cache.Put(context, notifier, k.port, ToLocalInteger(config_->notifier_endpoint.port()));
+  cache.Put(context, notifier, k.tag, ToLocalString(tag_));
+  cache.Put(context, notifier, k.tls, ToLocalBoolean(config_->use_tls_for_notifier));
+  cache.Put(context, notifier, k.cert, ToLocalBoolean(!config_->no_notifier_cert_check));
+  cache.Put(context, obj, k.duration_ms,
+            ToLocalInteger(chrono::duration_cast<chrono::milliseconds>(config_->duration).count()));
+  cache.Put(context, obj, k.userId, ToLocalString(user_id_));
+  cache.Put(context, obj, k.streamURL, ToLocalString(stream_url_));
+  cache.Put(context, obj, k.cert, ToLocalBoolean(!config_->no_cert_check));
+  cache.Put(context, obj, k.secret, ToLocalString(config_->auth_secret));
+  cache.Put(context, obj, k.frameInfo, ToLocalBoolean(0 < trace_every_));
+  auto trace = cache.NewObject(context, V8Cache::kShapeFrameTrace);
+  cache.Put(context, obj, k.frameTrace, trace);
+  cache.Put(context, trace, k.every, ToLocalInteger(trace_every_));
+  cache.Put(context, trace, k.perSecond, ToLocalInteger(trace_per_second_));
+  cache.Put(context, trace, k.level, ToLocalInteger(trace_level_));
+  cache.Put(context, trace, k.audio, ToLocalBoolean(trace_audio_));
   if (!ffmpeg_output_.empty()) {
-    auto ffmpeg = Object::New(isolate);
-    obj->Set(context, ToLocalString("ffmpeg"), ffmpeg).FromJust();
-    ffmpeg->Set(context, ToLocalString("output"),
-                         ToLocalString(ffmpeg_output_)).FromJust();
-    ffmpeg->Set(context, ToLocalString("params"),
-                         ToLocalString(ffmpeg_param_)).FromJust();
+    auto ffmpeg = cache.NewObject(context, V8Cache::kShapeFFmpeg);
+    cache.Put(context, obj, k.ffmpeg, ffmpeg);
+    cache.Put(context, ffmpeg, k.output, ToLocalString(ffmpeg_output_));
+    cache.Put(context, ffmpeg, k.params, ToLocalString(ffmpeg_param_));
   } else {
-    auto audio = Object::New(isolate);
-    obj->Set(context, ToLocalString("audio"), audio).FromJust();
-    audio->Set(context, ToLocalString("sink"),
-                        ToLocalString(EastWood::SinkString(audio_sink_))).FromJust();
-    audio->Set(context, ToLocalString("filename"),
-                        ToLocalString(audio_sink_filename_)).FromJust();
-    auto video = Object::New(isolate);
-    obj->Set(context, ToLocalString("video"), video).FromJust();
-    video->Set(context, ToLocalString("sink"),
-                        ToLocalString(EastWood::SinkString(video_sink_))).FromJust();
-    video->Set(context, ToLocalString("filename"),
-                        ToLocalString(video_sink_filename_)).FromJust();
-  }
-  auto retry = Object::New(isolate);
-  obj->Set(context, ToLocalString("retry"), retry).FromJust();
-  retry->Set(context, ToLocalString("max"),
-                      ToLocalInteger(config_.err_max_retries)).FromJust();
-  retry->Set(context, ToLocalString("initDelay_ms"),
-                      ToLocalInteger(config_.err_retry_delay_init_ms)).FromJust();
-  retry->Set(context, ToLocalString("progression"),
-                      ToLocalNumber(config_.err_retry_delay_progression)).FromJust();
+    auto audio = cache.NewObject(context, V8Cache::kShapeSink);
+    cache.Put(context, obj, k.audio, audio);
+    cache.Put(context, audio, k.sink, ToLocalString(EastWood::SinkString(audio_sink_)));
+    cache.Put(context, audio, k.filename, ToLocalString(audio_sink_filename_));
+    cache.Put(context, audio, k.bufferBytes, ToLocalInteger(audio_sink_buffer_bytes_));
+    auto video = cache.NewObject(context, V8Cache::kShapeSink);
+    cache.Put(context, obj, k.video, video);
+    cache.Put(context, video, k.sink, ToLocalString(EastWood::SinkString(video_sink_)));
+    cache.Put(context, video, k.filename, ToLocalString(video_sink_filename_));
+    cache.Put(context, video, k.bufferBytes, ToLocalInteger(video_sink_buffer_bytes_));
+  }
+  auto retry = cache.NewObject(context, V8Cache::kShapeRetry);
+  cache.Put(context, obj, k.retry, retry);
+  cache.Put(context, retry, k.max, ToLocalInteger(config_->err_max_retries));
+  cache.Put(context, retry, k.initDelay_ms, ToLocalInteger(config_->err_retry_delay_init_ms));
+  cache.Put(context, retry, k.progression, ToLocalNumber(config_->err_retry_delay_progression));
+  auto stall = cache.NewObject(context, V8Cache::kShapeStall);
+  cache.Put(context, obj, k.stall, stall);
+  cache.Put(context, stall, k.audio_ms, ToLocalInteger(audio_stall_ms_));
+  cache.Put(context, stall, k.video_ms, ToLocalInteger(video_stall_ms_));
+  cache.Put(context, obj, k.memoryCap_mb, ToLocalInteger(memory_cap_mb_));
+  cache.Put(context, obj, k.capture, ToLocalString(capture_filename_));
+  auto replay = cache.NewObject(context, V8Cache::kShapeReplay);
+  cache.Put(context, obj, k.replay, replay);
+  cache.Put(context, replay, k.filename, ToLocalString(replay_filename_));
+  cache.Put(context, replay, k.speed, ToLocalNumber(replay_speed_));
+  auto plugin = cache.NewObject(context, V8Cache::kShapePlugin);
+  cache.Put(context, obj, k.plugin, plugin);
+  cache.Put(context, plugin, k.path, ToLocalString(plugin_path_));
+  cache.Put(context, plugin, k.params, ToLocalString(plugin_params_));
+  cache.Put(context, obj, k.composite, ToLocalBoolean(static_cast<bool>(composite_)));
+  cache.Put(context, obj, k.memorySegments, ToLocalBoolean(memory_segments_));
+  auto latency = cache.NewObject(context, V8Cache::kShapeLatency);
+  cache.Put(context, obj, k.latency, latency);
+  cache.Put(context, latency, k.mode, ToLocalString(LatencyProfile::ModeString(latency_.mode)));
+  cache.Put(context, latency, k.minDelay_ms, ToLocalInteger(latency_.min_delay_ms));
+  cache.Put(context, latency, k.maxDelay_ms, ToLocalInteger(latency_.max_delay_ms));
+  auto timeline = cache.NewObject(context, V8Cache::kShapeTimeline);
+  cache.Put(context, obj, k.timeline, timeline);
+  cache.Put(context, timeline, k.clock, ToLocalString(Timeline::ClockString(timeline_clock_)));
+  cache.Put(context, timeline, k.fillFps, ToLocalInteger(timeline_fill_fps_));
+  cache.Put(context, obj, k.priority, ToLocalString(CapacityModel::PriorityString(priority_)));
   return obj;
 }
 
 
-Subscriber::SubscriberConfig::SubscriberConfig() 
-  : log_(at::log::keywords::channel = "addon.SubscriberConfig") {
+Subscriber::SubscriberConfig::SubscriberConfig(AddonData* addon)
+  : addon_(addon)
+  , config_(make_shared<at::eastwood::SubscriberConfig>())
+  , log_(at::log::keywords::channel = "addon.SubscriberConfig") {
 }
 
-void Subscriber::SubscriberConfig::Init(Local<Object> exports) {
-  InitClass(exports, "SubscriberConfig", New, constructor,
+void Subscriber::SubscriberConfig::Init(Local<Object> exports, AddonData* data) {
+  InitClass(exports, "SubscriberConfig", New, data->subscriber_config_constructor,
     AT_ADDON_PROTOTYPE_METHOD(bixby),
     AT_ADDON_PROTOTYPE_METHOD(bixbyAllocator),
     AT_ADDON_PROTOTYPE_METHOD(streamNotifier),
@@ -732,37 +2150,59 @@ void Subscriber::SubscriberConfig::Init(Local<Object> exports) {
     AT_ADDON_PROTOTYPE_METHOD(certCheck),
     AT_ADDON_PROTOTYPE_METHOD(authSecret),
     AT_ADDON_PROTOTYPE_METHOD(printFrameInfo),
+    AT_ADDON_PROTOTYPE_METHOD(frameTrace),
     AT_ADDON_PROTOTYPE_METHOD(sink),
     AT_ADDON_PROTOTYPE_METHOD(ffmpegSink),
+    AT_ADDON_PROTOTYPE_METHOD(pluginSink),
+    AT_ADDON_PROTOTYPE_METHOD(compositeSink),
+    AT_ADDON_PROTOTYPE_METHOD(memorySegments),
     AT_ADDON_PROTOTYPE_METHOD(subscriptionErrorRetry),
+    AT_ADDON_PROTOTYPE_METHOD(stallTimeout),
+    AT_ADDON_PROTOTYPE_METHOD(memoryCap),
+    AT_ADDON_PROTOTYPE_METHOD(captureFile),
+    AT_ADDON_PROTOTYPE_METHOD(replayFile),
+    AT_ADDON_PROTOTYPE_METHOD(latencyMode),
+    AT_ADDON_PROTOTYPE_METHOD(timeline),
+    AT_ADDON_PROTOTYPE_METHOD(priority),
     AT_ADDON_PROTOTYPE_METHOD(verify),
     AT_ADDON_PROTOTYPE_METHOD(toObject)
   );
 }
 
 Local<Object> Subscriber::SubscriberConfig::NewInstance(const FunctionCallbackInfo<Value>& args) {
-  return NewV8Instance(constructor, args);
+  return NewV8Instance(AddonData::Get(args.GetIsolate())->subscriber_config_constructor, args);
 }
 
 void Subscriber::SubscriberConfig::New(const FunctionCallbackInfo<Value>& args) {
-  NewCppInstance(args, new SubscriberConfig());
+  NewCppInstance(args, new SubscriberConfig(AddonData::Get(args.GetIsolate())));
 }
 
 
 
-void Subscriber::Init(Local<Object> exports) {
-  InitClass(exports, "Subscriber", New, constructor,
+void Subscriber::state(const FunctionCallbackInfo<Value>& args) {
+  if (!CheckArgs("state", args, 0, 0)) return;
+  Subscriber* self = Unwrap<Subscriber>(args.Holder());
+  assert(self);
+  args.GetReturnValue().Set(StateKey(*self->addon_->v8_cache, self->lifecycle_->state()));
+}
+
+void Subscriber::Init(Local<Object> exports, AddonData* data) {
+  InitClass(exports, "Subscriber", New, data->subscriber_constructor,
     AT_ADDON_PROTOTYPE_METHOD(configuration),
     AT_ADDON_PROTOTYPE_METHOD(on),
     AT_ADDON_PROTOTYPE_METHOD(start),
-    AT_ADDON_PROTOTYPE_METHOD(stop)
+    AT_ADDON_PROTOTYPE_METHOD(stop),
+    AT_ADDON_PROTOTYPE_METHOD(reconfigure),
+    AT_ADDON_PROTOTYPE_METHOD(stats),
+    AT_ADDON_PROTOTYPE_METHOD(state),
+    AT_ADDON_PROTOTYPE_METHOD(releaseSegment)
   );
 
-  SubscriberConfig::Init(exports);
+  SubscriberConfig::Init(exports, data);
 }
 
 Local<Object> Subscriber::NewInstance(const FunctionCallbackInfo<Value>& args) {
-  return NewV8Instance(constructor, args);
+  return NewV8Instance(AddonData::Get(args.GetIsolate())->subscriber_constructor, args);
 }
 
 void Subscriber::New(const FunctionCallbackInfo<Value>& args) {
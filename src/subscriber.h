@@ -6,17 +6,36 @@
 #include <node.h>
 #include <node_object_wrap.h>
 
+#include <atomic>
+#include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
+#include <uv.h>
+
 #include "mediacore/defs.h"
 #include "tecate/defs.h"
 #include "mediacore/base/logging.h"
 #include "mediacore/base/endpoint.h"
 #include "eastwood/subscribe/subscriber_config.h"
 #include "facade/subscriber_facade.h"
+#include "eastwood/ffmpeg/ffmpeg_stream_sink_factory.h"
 
 #include "eastwood.h"
+#include "sink_tap.h"
+#include "capacity.h"
+#include "encoder_budget.h"
+#include "plugin_sink.h"
+#include "composite.h"
+#include "memory_segments.h"
+#include "stream_sink.h"
+#include "frame_pool.h"
+#include "latency.h"
+#include "lifecycle.h"
+#include "js_queue.h"
+#include "playout_buffer.h"
+#include "timeline.h"
 #include "addon_util/addon_util.h"
 
 
@@ -112,6 +131,7 @@ class Subscriber : public node::ObjectWrap {
 
     /**
      * Enables extra debug log for each video frame (optional. default is off)
+     * Same as frameTrace({ every: 1 }) or frameTrace({ every: 0 }).
      * Signature:
      *   SubscriberConfig printFrameInfo(Boolean print);
      * @return self
@@ -119,14 +139,30 @@ class Subscriber : public node::ObjectWrap {
      */
     static void printFrameInfo(const v8::FunctionCallbackInfo<v8::Value>& args);
 
+    /**
+     * Sets sampled per-frame trace (optional. default is off)
+     * Traced frames are recorded without blocking media threads, and logged by a background thread.
+     * Recent records can be retrieved by EastWood.dumpFrameTrace().
+     * Signature:
+     *   SubscriberConfig frameTrace(Object options);
+     * @return self
+     * @param options: { every: Number (traces every Nth frame. 0 disables. default 1),
+     *                   perSecond: Number (max traced frames per second. 0 is unlimited. default 0),
+     *                   level: EastWood::LogLevel (default LogLevel_Debug),
+     *                   audio: Boolean (traces audio frames as well as video. default false) }
+     */
+    static void frameTrace(const v8::FunctionCallbackInfo<v8::Value>& args);
+
     /**
      * Sets regular audio/video sink (optional. default is null-sink)
      * Use FFMpegSink() to set up FFMpeg sinks. (these are mutually exclusive)
      * Signature:
      *   SubscriberConfig sink(Object audio_sink, Object video_sink);
      * @return self
-     * @param audio_sink: { sink: EastWood::SinkType, filename: <filename> }
-     * @param video_sink: { sink: EastWood::SinkType, filename: <filename> }
+     * @param audio_sink: { sink: EastWood::SinkType, filename: <filename>, bufferBytes: Number }
+     * @param video_sink: { sink: EastWood::SinkType, filename: <filename>, bufferBytes: Number }
+     * With AudioSink_Stream/VideoSink_Stream, filename is the stream target: 'fd:<n>', 'unix:<path>' or a FIFO path,
+     * and bufferBytes (optional. default 16MB) bounds what is kept for a slow reader. Frames beyond it are dropped.
      */
     static void sink(const v8::FunctionCallbackInfo<v8::Value>& args);
 
@@ -138,9 +174,46 @@ class Subscriber : public node::ObjectWrap {
      * @return self
      * @param output: output destination (filename or rtmp-URL)
      * @param param: ffmpeg parameters. see libew-ffmpeg
+     * Unless given in @a param, transcodes get threads (and preset) from the budget set by EastWood.setEncoderBudget().
      */
     static void ffmpegSink(const v8::FunctionCallbackInfo<v8::Value>& args);
 
+    /**
+     * Sets a native sink plugin taking both audio and video (optional. default is regular null-sink)
+     * The shared object is loaded with dlopen() and runs on the subscriber's pipeline threads.
+     * See eastwood_sink_plugin.h for the C ABI. Mutually exclusive with sink() and ffmpegSink().
+     * Signature:
+     *   SubscriberConfig pluginSink(String path, String params);
+     * @return self
+     * @param path: shared object path. empty string disables.
+     * @param params: passed as is to the plugin's open()
+     */
+    static void pluginSink(const v8::FunctionCallbackInfo<v8::Value>& args);
+
+    /**
+     * Feeds audio and video to a composite made by EastWood.createComposite() (optional. default is regular null-sink)
+     * Frames go to the composite instead of an output of the subscriber's own.
+     * The subscriber joins the composite on start() and leaves it once stopped, its tile then disappearing.
+     * Mutually exclusive with sink(), ffmpegSink() and pluginSink().
+     * Signature:
+     *   SubscriberConfig compositeSink(Composite composite);
+     * @return self
+     * @param composite: composite to join, or null to disable
+     */
+    static void compositeSink(const v8::FunctionCallbackInfo<v8::Value>& args);
+
+    /**
+     * Keeps the segments of a segmenting FFMpeg sink (HLS or DASH) in memory and hands them to JS
+     * by 'segment' and 'playlist' events, instead of leaving them on disk. (optional. default is off)
+     * The FFMpeg output is then the playlist file name alone (e.g. 'live.m3u8' or 'live.mpd'),
+     * written in a private directory on tmpfs where available.
+     * Signature:
+     *   SubscriberConfig memorySegments(Boolean enable);
+     * @return self
+     * @param enable: whether to hand segments to JS
+     */
+    static void memorySegments(const v8::FunctionCallbackInfo<v8::Value>& args);
+
     /**
      * Sets subscription error retry. (optional. default is no-retry)
      * Signature:
@@ -155,6 +228,103 @@ class Subscriber : public node::ObjectWrap {
      */
     static void subscriptionErrorRetry(const v8::FunctionCallbackInfo<v8::Value>& args);
 
+    /**
+     * Sets media stall thresholds. (optional. default is disabled)
+     * When no frame arrives on a track for the threshold, the subscriber resubscribes
+     * in place while keeping its sinks, and emits 'stall' and then 'recover' events.
+     * Signature:
+     *   SubscriberConfig stallTimeout(uint32_t audioMS, uint32_t videoMS);
+     * @return self
+     * @param audioMS: audio stall threshold in milli-sec. zero disables.
+     * @param videoMS: video stall threshold in milli-sec. zero disables.
+     */
+    static void stallTimeout(const v8::FunctionCallbackInfo<v8::Value>& args);
+
+    /**
+     * Sets native memory cap of the subscriber. (optional. default is unlimited)
+     * Native memory is summed from the buffers the addon holds: pooled frame copies, stream sink rings and
+     * memory segments. Memory of the core and of FFmpeg is not included.
+     * When over the cap, the subscriber stops and emits 'finish' with 'memory cap exceeded'.
+     * Signature:
+     *   SubscriberConfig memoryCap(uint32_t megabytes);
+     * @return self
+     * @param megabytes: cap in MB. zero disables.
+     */
+    static void memoryCap(const v8::FunctionCallbackInfo<v8::Value>& args);
+
+    /**
+     * Captures frames reaching the sinks, with their arrival timing, into a file for replayFile().
+     * (optional. default is off)
+     * Signature:
+     *   SubscriberConfig captureFile(String filename);
+     * @return self
+     * @param filename: capture file. empty string disables.
+     */
+    static void captureFile(const v8::FunctionCallbackInfo<v8::Value>& args);
+
+    /**
+     * Feeds frames of a capture file to the sinks instead of subscribing. (optional. default is off)
+     * No Bixby, allocator, notifier, stream URL, duration nor user id is needed then.
+     * 'finish' is emitted at the end of the file.
+     * Signature:
+     *   SubscriberConfig replayFile(String filename, Number speed);
+     * @return self
+     * @param filename: file made with captureFile(). empty string disables.
+     * @param speed: 1 replays in real-time, 2 twice as fast etc. 0 is as fast as sinks take frames.
+     */
+    static void replayFile(const v8::FunctionCallbackInfo<v8::Value>& args);
+
+    /**
+     * Sets the latency profile. (optional. default is 'recording')
+     * The jitter buffer of the subscription is not changed. Decoded frames are then:
+     *  - 'recording': delivered as they come, for the smoothest recording.
+     *  - 'live': dropped once later than maxDelay after the fastest frame of their track.
+     *    stream sinks drop frames while the reader is behind by as long, FFmpeg sinks flush each packet.
+     *  - 'ultralow': likewise with a shorter maxDelay. transcodes are tuned for latency, too.
+     * In any mode, a minDelay holds frames until that much later than the fastest frame, evening out jitter.
+     * Signature:
+     *   SubscriberConfig latencyMode(String mode [, uint32_t minDelayMS, uint32_t maxDelayMS]);
+     * @return self
+     * @param mode: 'recording', 'live' or 'ultralow'
+     * @param minDelayMS: defaults to 0 (not held)
+     * @param maxDelayMS: defaults to 0 (never dropped) for 'recording', 1000 for 'live' and 200 for 'ultralow',
+     *                    or to minDelayMS if longer. zero never drops. both delays are up to 10000.
+     */
+    static void latencyMode(const v8::FunctionCallbackInfo<v8::Value>& args);
+
+    /**
+     * Puts the frames of regular and FFMpeg sinks on a timeline shared by both tracks, so that their outputs
+     * align: timestamps count from the first frame of either track, mapped onto the clock by the fastest
+     * transit of each track. File sinks get a sidecar "<filename>.timeline" (timestamp format v2 of mkvmerge,
+     * with the clock and the origin on it in comments), for outputs of several subscribers to align too.
+     * The sidecar is complete once the subscriber stops, being closed with the sink of its file.
+     * With fillFps, raw outputs (file and stream sinks) are continuous from the origin and muxing them is a
+     * straight copy: audio gaps get silence and overlaps are trimmed, and video is resampled to fillFps by
+     * repeating the previous picture over gaps and dropping pictures beyond the rate. Gaps over a minute are not
+     * filled. FFMpeg outputs are not filled, their muxer taking the gaps.
+     * Signature:
+     *   SubscriberConfig timeline(String clock [, uint32_t fillFps]);
+     * @return self
+     * @param clock: 'none' (media timestamps of the core, the default), 'monotonic' or 'ntp' (the system clock,
+     *               i.e. as kept by NTP, since the Unix epoch)
+     * @param fillFps: up to 120. defaults to 0, not filling.
+     */
+    static void timeline(const v8::FunctionCallbackInfo<v8::Value>& args);
+
+    /**
+     * Sets the priority class, for subscribers sharing the event loop and the encoder thread budget.
+     * FFmpeg transcodes of higher classes get more encoder threads (see EastWood.setEncoderBudget()).
+     * Under overload (see EastWood.setLoadShedding()), video of lower classes is delivered at a fraction of its
+     * frame rate, 'low' first, so that higher classes keep running smooth. 'high' is never shed.
+     * Audio, captureFile() and stats() frame counts are not shed.
+     * Signature:
+     *   SubscriberConfig priority(String priority);
+     * @return self
+     * @param priority: 'low' (e.g. archival recordings and monitoring), 'normal' (the default) or 'high'
+     *                  (e.g. paid live restreams)
+     */
+    static void priority(const v8::FunctionCallbackInfo<v8::Value>& args);
+
     /**
      * Verifies the given config params. Will be implicitly called by Subscriber::start()
      * Signature:
@@ -172,30 +342,85 @@ class Subscriber : public node::ObjectWrap {
     static void toObject(const v8::FunctionCallbackInfo<v8::Value>& args);
 
     /// @internal constructed only (indirectly) by Subscriber
-    SubscriberConfig();
-
-    at::eastwood::SubscriberConfig config_;
+    explicit SubscriberConfig(AddonData* addon);
+
+    AddonData* addon_;
+    /// settings of the core. shared with the template and the other subscribers made from it until modified.
+    /// user id, tag and stream URL, which each subscriber of a template may override, are kept apart.
+    std::shared_ptr<const at::eastwood::SubscriberConfig> config_;
+    std::string user_id_;
+    std::string tag_;
+    std::string stream_url_;
     EastWood::SinkType audio_sink_ = EastWood::Sink_Undefined;
     std::string audio_sink_filename_;
+    uint32_t audio_sink_buffer_bytes_ = StreamWriter::kDefaultBufferBytes;
     EastWood::SinkType video_sink_ = EastWood::Sink_Undefined;
     std::string video_sink_filename_;
+    uint32_t video_sink_buffer_bytes_ = StreamWriter::kDefaultBufferBytes;
     std::string ffmpeg_output_;
     std::string ffmpeg_param_;
+    using FFmpegOptions = at::eastwood::FFmpegStreamSinkFactory::OptionMap;
+    /// parsed from ffmpeg_param_. immutable, so that config templates can share it.
+    std::shared_ptr<const FFmpegOptions> ffmpeg_options_;
+    std::string plugin_path_;
+    std::string plugin_params_;
+    /// shared with the Composite object and the other subscribers feeding it
+    std::shared_ptr<CompositeMixer> composite_;
+    bool memory_segments_ = false;
+    uint32_t audio_stall_ms_ = 0;
+    uint32_t video_stall_ms_ = 0;
+    uint32_t trace_every_ = 0;
+    uint32_t trace_per_second_ = 0;
+    EastWood::LogLevel trace_level_ = EastWood::LogLevel_Debug;
+    bool trace_audio_ = false;
+    uint32_t memory_cap_mb_ = 0;
+    std::string capture_filename_;
+    std::string replay_filename_;
+    double replay_speed_ = 1;
+    LatencyProfile latency_;
+    Timeline::Clock timeline_clock_ = Timeline::kClockNone;
+    uint32_t timeline_fill_fps_ = 0;
+    Priority priority_ = kPriorityNormal;
+    /// set on config templates (see EastWood::createConfigTemplate()). setters throw if set.
+    bool frozen_ = false;
 
     v8::Local<v8::Object> ToObjectImpl() const;
-    bool VerifyConfigIntegrity(const v8::FunctionCallbackInfo<v8::Value>& args) const;
+    /// @param for_template: skips checks of items that each subscriber may override
+    bool VerifyConfigIntegrity(const v8::FunctionCallbackInfo<v8::Value>& args, bool for_template = false) const;
+    /// @return self, or null after throwing JS exception if frozen
+    static SubscriberConfig* UnwrapMutable(const v8::FunctionCallbackInfo<v8::Value>& args);
+    static std::shared_ptr<const FFmpegOptions> ParseFFmpegParams(const std::string& param);
+
+    /// @return settings of the core for this config alone, copied first if shared
+    at::eastwood::SubscriberConfig& MutableConfig();
+    /// @return settings of the core with user id, tag and stream URL, as given to the facade
+    at::eastwood::SubscriberConfig FacadeConfig() const;
+    /// @internal Used by EastWood to make and use config templates. The settings of the core are shared.
+    void CopyFrom(const SubscriberConfig& other);
+    /// Applies { userId, tag, streamURL, output } given to createSubscriber() with a template
+    bool ApplyOverrides(v8::Local<v8::Context> context, v8::Local<v8::Object> overrides, std::string& err_msg);
+    /// items given to Subscriber.reconfigure()
+    struct Changes {
+      bool duration = false;
+      bool audio = false;
+      bool video = false;
+      bool ffmpeg = false;
+    };
+    /// Applies { duration, audio, video, ffmpeg } given to Subscriber.reconfigure()
+    bool ApplyChanges(v8::Local<v8::Context> context, v8::Local<v8::Object> changes, Changes& changed,
+                      std::string& err_msg);
+    static bool IsInstance(v8::Isolate* isolate, v8::Local<v8::Value> value);
 
     static v8::Local<v8::Object> NewInstance(const v8::FunctionCallbackInfo<v8::Value>& args);
     /// @internal Used by V8 framework
     static void New(const v8::FunctionCallbackInfo<v8::Value>& args);
-    /// @internal Used by V8 framework
-    static v8::Persistent<v8::Function> constructor;
     /// @internal Used for V8 framework
-    static void Init(v8::Local<v8::Object> exports);
+    static void Init(v8::Local<v8::Object> exports, AddonData* data);
 
     mutable at::Logger log_;
 
     friend class Subscriber;
+    friend class EastWood;
     AT_ADDON_CLASS;
   };
 
@@ -214,23 +439,61 @@ class Subscriber : public node::ObjectWrap {
    * Registers event listener.
    * Signature:
    *  void on(String name, v8::Function callback)
-   * @param name : 'finish' is the only event at this moment
-   * @param callback : function(err)
+   * @param name : 'finish', 'stall', 'recover', 'segment', 'playlist' or 'state'
+   * @param callback : function(err) for 'finish',
+   *                   function(track, idleMS) for 'stall',
+   *                   function(track, gapMS) for 'recover',
+   *                   function(name, buffer) for 'segment' and 'playlist',
+   *                   function(state, timeMS) for 'state'
    *
-   * One callback will be given once started.
+   * One 'finish' callback will be given once started.
    * If FFMpeg sinks are used, @a err in "finish" event may contain string either 'idle timeout' or 'output failure'
+   * If memoryCap() is set, @a err may be 'memory cap exceeded'.
    * For all sink types, other string in @a err maybe notified.
+   * 'stall' is emitted when a track ('audio' or 'video') exceeded its stall threshold (see stallTimeout()),
+   * 'recover' when frames on the track resumed, with the length of the gap.
+   * With memorySegments(), 'segment' is emitted with each finished segment and 'playlist' with each
+   * rewrite of the playlist, after the segments it lists. The last ones come before stop() completes.
+   * Segments emitted without a listener are dropped.
+   * 'state' is emitted with each change of state() and the time it happened, in milliseconds since the Unix epoch.
+   * Changes coming close together are emitted together, in order.
    */
   static void on(const v8::FunctionCallbackInfo<v8::Value>& args);
 
+  /**
+   * Returns the memory of a Buffer given by a 'segment' or 'playlist' event to the pool right away,
+   * e.g. once uploaded. The Buffer is emptied. Otherwise the memory returns when the Buffer is garbage collected.
+   * Signature:
+   *  Boolean releaseSegment(Buffer buffer);
+   * @return false if @a buffer is not one given by the events or was released already
+   */
+  static void releaseSegment(const v8::FunctionCallbackInfo<v8::Value>& args);
+
   static constexpr auto kErrorIdleTimeout = "idle timeout";
   static constexpr auto kErrorOutputFailure = "output failure";
+  static constexpr auto kErrorMemoryCap = "memory cap exceeded";
+  static constexpr auto kErrorMemoryLimit = "Process memory limit exceeded";
+  static constexpr auto kErrorAdmission = "Admission rejected: ";
+  static constexpr uint32_t kMinStallPollMs = 20;
+  static constexpr uint32_t kMaxStallPollMs = 250;
+  /// how long before its end a subscription is renewed, to last until the deadline of reconfigure()
+  static constexpr int64_t kRenewLeadMs = 2000;
+  /// FFmpeg sink options set by latencyMode(), unless given in its params
+  static constexpr auto kFlushPacketsOption = "ffmpeg_flush_packets";
+  static constexpr auto kTuneOption = "ffmpeg_tune";
+  /// FFmpeg sink options telling a stream copy ("copy") from a transcode
+  static constexpr auto kVideoCodecOption = "ffmpeg_force_video_codec";
+  static constexpr auto kAudioCodecOption = "ffmpeg_force_audio_codec";
 
   /**
    * Starts the subscription.
    * Signature:
-   *  void start();
-   * @throw exception if configuration is incomplete or incorrect.
+   *  Promise start();
+   * @return Promise resolved once the subscription is started, rejected if sinks could not be created,
+   *         if the process is over the limit set by EastWood.setMemoryLimit(),
+   *         or with 'Admission rejected: <reason>' if the policy set by EastWood.setAdmission() is not met
+   * @throw exception if configuration is incomplete or incorrect, or if already started and not stopped yet
+   *        (see state()).
    * @note It is important to call stop() in order to clean up resource.
    * Otherwise JS process might not terminate at the end.
    */
@@ -240,40 +503,266 @@ class Subscriber : public node::ObjectWrap {
    * Stops the subscription.
    * Signature:
    *  void stop(callback);
+   *  Promise stop();
+   * Each call gets the result, also while an earlier stop is in progress. The JS process runs until it comes.
    * @param callback: function(bool)
+   * @return Promise resolved with bool if callback was not given
    */
   static void stop(const v8::FunctionCallbackInfo<v8::Value>& args);
 
+  /**
+   * Changes sinks or duration of a running subscription, without resubscribing.
+   * New sinks are created first, and replace the old ones between two frames of each track, both tracks at once.
+   * A new FFmpeg output thus starts with a whole picture, i.e. a keyframe. The old outputs are closed then.
+   * The duration counts from the latest start(). Past the duration given to the subscription at start(), the subscription
+   * is renewed shortly before it ends (counted in stats().resubscribes). A shorter one ends the subscription
+   * at the new duration with 'finish'. 'infinite' lifts the end. The next start() subscribes for the duration given
+   * here, from then on.
+   * Signature:
+   *  Promise reconfigure(Object changes);
+   * @param changes: { duration: String (as duration()),
+   *                   audio: Object, video: Object (as sink(). either or both. regular sinks only),
+   *                   ffmpeg: { output: String, params: String (defaults to the current ones) }
+   *                           (FFMpeg sink only, not with memorySegments()) }
+   *                 at least one of them. the other sinks stay as they are.
+   * @return Promise resolved once the changes are made, rejected if the new sinks could not be created.
+   *         the old ones are kept then.
+   * @throw exception if @a changes are incorrect, or the subscription is not running (e.g. not started, replaying)
+   */
+  static void reconfigure(const v8::FunctionCallbackInfo<v8::Value>& args);
+
+  /**
+   * Returns a snapshot of runtime statistics.
+   * Signature:
+   *  Object stats();
+   * @return { resubscribes: Number, stop_ms: Number (-1 until stopped),
+   *           memory_bytes: Number (estimated native memory),
+   *           encoder: { threads, preset (FFmpeg transcode only),
+   *                      encodeFps (video frames per second the sink can take), sourceFps, speed (encodeFps / sourceFps.
+   *                      below 1 means falling behind real time) },
+   *           plugin: { frames, bytes, errors } (as reported by the sink plugin. zeros without one),
+   *           segments: { delivered, held (Buffers not yet released), held_bytes } (memorySegments() only),
+   *           pool: { hits, misses (frame copies of captureFile(), compositeSink(), latencyMode() minDelay and
+   *                   timeline() fillFps taking a pooled buffer, or allocating one), pooledBytes,
+   *                   outstanding (buffers in use) },
+   *           audio: { frames, stalls, stalled, stalledTotal_ms, lastStall_ms,
+   *                    firstFrame_ms (from start() to the first frame, -1 until then),
+   *                    allocations (heap allocations while delivering frames. -1 unless built with
+   *                                 -Dew_count_allocations=1),
+   *                    shed (frames dropped by load shedding. see SubscriberConfig.priority()),
+   *                    latency: { transit_ms (arrival over that of the fastest recent frame, i.e. network and
+   *                               subscription jitter), held_ms (by minDelay), sink_ms (taken by the sink),
+   *                               total_ms (the sum of them), late (frames dropped as later than maxDelay) },
+   *                    stream: { frames, bytes (taken by the fd), overflows, overflowBytes (frames dropped as the
+   *                              reader was behind by bufferBytes), buffered, zeroCopy (vmsplice to a pipe),
+   *                              failed (e.g. the reader went away) } (AudioSink_Stream only. zeros otherwise) },
+   *           video: { frames, stalls, stalled, stalledTotal_ms, lastStall_ms, firstFrame_ms, allocations,
+   *                    shed, latency, stream } }
+   *         latency values are smoothed over the latest frames.
+   */
+  static void stats(const v8::FunctionCallbackInfo<v8::Value>& args);
+
+  /**
+   * Returns the lifecycle state, without going to any other thread.
+   * Signature:
+   *  String state();
+   * @return 'idle' (created, or start() rejected), 'allocating' (start() creating sinks),
+   *         'connecting' (subscribed, no frame yet), 'negotiating' (frames on one track only, for up to 3s),
+   *         'streaming', 'retrying' (resubscribed after a stall, no frame yet), 'stopping' (stop() in progress),
+   *         or 'stopped' (stopped, or ended with 'finish')
+   */
+  static void state(const v8::FunctionCallbackInfo<v8::Value>& args);
+
   /// @internal Used for V8 framework
-  static void Init(v8::Local<v8::Object> exports);
+  static void Init(v8::Local<v8::Object> exports, AddonData* data);
 
   /// @internal only internally used
   explicit Subscriber(const v8::FunctionCallbackInfo<v8::Value>& args);
 
  private:
   ~Subscriber();
-  bool CreateSinks(SubscriberConfig& config);
-  bool CreateRegularSinks(SubscriberConfig& config);
-  bool CreateFFMpegSinks(SubscriberConfig& config);
+  /// sinks made by Create*Sinks(), until they go into the slots
+  struct NewSinks {
+    AudioSinkPtr audio;
+    VideoSinkPtr video;
+    std::shared_ptr<StreamWriter> audio_stream;
+    std::shared_ptr<StreamWriter> video_stream;
+  };
+  /// @param err: reason of failure, if known
+  bool CreateSinks(SubscriberConfig& config, std::string& err);
+  bool CreateRegularSinks(SubscriberConfig& config, NewSinks& sinks, std::string& err);
+  bool CreateFFMpegSinks(SubscriberConfig& config, NewSinks& sinks, std::string& err);
+  bool CreatePluginSinks(SubscriberConfig& config, NewSinks& sinks, std::string& err);
+  bool CreateCompositeSinks(SubscriberConfig& config, NewSinks& sinks);
+  /// Puts the sinks of the tracks given on a new timeline, if configured
+  /// @param audio_file, video_file: raw file of the track, to write a sidecar for. empty if none.
+  /// @param fill_fps: as timeline(). 0 not to fill.
+  bool ApplyTimeline(const SubscriberConfig& config, NewSinks& sinks, bool audio, bool video,
+                     const std::string& audio_file, const std::string& video_file, uint32_t fill_fps,
+                     std::string& err);
+  /// Puts the sinks of the given tracks into the slots, between frames. @a sinks get the old ones.
+  void SwapSinks(NewSinks& sinks, bool audio, bool video);
   void NotifyFinish(const string& err = "");
+  /// Waits for the segmenter, closed with the sinks by ReleaseSinks(), to hand its last segments over.
+  /// Then calls @a done on JS thread
+  void FinishSegments(std::function<void()> done);
+  void EmitSegment(const std::string& name, SegmentStore::Block* block, bool manifest);
   void StopFacade(std::function<void(std::exception_ptr, bool)> callback = std::function<void(std::exception_ptr, bool)>());
+  /// Called on JS thread once the stop of @a run completed. Calls @a callback once stopped.
+  void CompleteStop(uint32_t run, int64_t begin_ns, int64_t end_ns, std::exception_ptr ex, bool result,
+                    std::function<void(std::exception_ptr, bool)> callback);
+  /// Makes facade_ from facade_config_, subscribing for @a duration
+  void NewFacade(at::Duration duration);
+  void NewTaps(AudioSinkPtr& audio_sink, VideoSinkPtr& video_sink);
+  /// Sets the late frame bound of the tracks and makes the playout buffer. Before the first taps.
+  void ApplyLatency(const SubscriberConfig& config);
+  bool StartCapture(const SubscriberConfig& config, std::string& err);
+  void ApplyFrameTrace(const SubscriberConfig& config);
+  /// Empties the slots and drops the sinks held besides, which closes the outputs. Called on JS thread.
+  void ReleaseSinks();
+  /// Releases what a start() rejected after creating sinks took
+  void AbandonStart();
+  /// Ends event emission. Once a stop completes, not when it is issued.
+  void StopEvents();
+  /// @internal Used by EastWood::stopAll() to give up on a subscriber whose stop did not complete.
+  /// The subscriber stays referenced until the stop completes, if ever.
+  void ForceClose();
+  /// @internal Used by AddonData::Cleanup(). Force closes the subscriber if running, and releases its uv handles
+  /// and everything else of the addon data, which the subscriber object may outlive.
+  void CloseForCleanup();
+  /// Releases what the destructor does. Once called, the subscriber no longer belongs to the addon data.
+  void Detach();
+  /// @return user id of the subscription, or of the configuration until started
+  std::string UserId() const;
+  /// @internal Used by MemoryWatch. Re-estimates native memory, reports it to V8 and enforces the cap.
+  void UpdateMemory();
+  int64_t EstimateMemoryBytes() const;
+  static SinkClass SinkClassOf(const SubscriberConfig& config);
+  static v8::Local<v8::String> StateKey(const V8Cache& cache, Lifecycle::State state);
+  /// Emits the 'state' events of the transitions queued by lifecycle_
+  static void OnLifecycleAsync(uv_async_t* async);
+
+  /// Per track stall bookkeeping. Only touched on JS thread.
+  struct StallState {
+    uint32_t threshold_ms = 0;
+    bool stalled = false;
+    uint32_t count = 0;
+    int64_t total_ms = 0;
+    int64_t last_ms = 0;
+  };
+  void StartStallWatch();
+  void StopStallWatch();
+  static void OnStallTimer(uv_timer_t* timer);
+  bool CheckStall(const char* track, TrackMonitor& monitor, StallState& state, int64_t now_ns);
+  void Resubscribe();
+  /// @return duration of the next facade: until the deadline set by reconfigure() if any, else as configured
+  at::Duration NextFacadeDuration() const;
+  /// Duration set by reconfigure(). The timer fires at the deadline, or to renew the subscription before.
+  void StartDeadline();
+  void StopDeadline();
+  static void OnDeadlineTimer(uv_timer_t* timer);
+  void EndAtDeadline();
 
   /// @internal Used by V8 framework
   static void New(const v8::FunctionCallbackInfo<v8::Value>& args);
-  /// @internal Used by V8 framework
-  static v8::Persistent<v8::Function> constructor;
 
   /// @internal Used by EastWood
   static v8::Local<v8::Object> NewInstance(const v8::FunctionCallbackInfo<v8::Value>& args);
   friend class EastWood;
+  friend class MemoryWatch;
+  friend class CapacityModel;
+  friend struct AddonData;
 
   mutable at::Logger log_;
+  AddonData* addon_;  // null once detached
   v8::Persistent<v8::Object> config_;
   at::node_addon::EventEmitter<at::node_addon::V8Exception> finish_event_;
-  at::node_addon::CallbackInvoker<bool> stop_callback_;
+  at::node_addon::EventEmitter<std::string, double> stall_event_;
+  at::node_addon::EventEmitter<std::string, double> recover_event_;
   bool sink_output_failed_ = false;
   at::Ptr<at::eastwood::SubscriberFacade> facade_;
 
+  /// config given to each facade, sinks excluded. those are held by the slots and wrapped in taps.
+  at::eastwood::SubscriberConfig facade_config_;
+  std::shared_ptr<AudioSinkSlot> audio_slot_;
+  std::shared_ptr<VideoSinkSlot> video_slot_;
+  const uint32_t id_;  // process-wide unique. identifies the subscriber in traces.
+  std::shared_ptr<TrackContext> audio_track_;
+  std::shared_ptr<TrackContext> video_track_;
+  TapAudioSink* audio_tap_ = nullptr;  // owned by facade_
+  TapVideoSink* video_tap_ = nullptr;  // owned by facade_
+  /// identifies facade_, so that callbacks of replaced facades are ignored
+  std::atomic<uint32_t> facade_generation_{0};
+  /// facades replaced by resubscription, kept until their stop completes
+  std::vector<std::pair<at::Ptr<at::eastwood::SubscriberFacade>, std::shared_ptr<std::atomic<bool>>>> retiring_facades_;
+
+  uv_timer_t* stall_timer_ = nullptr;
+  StallState audio_stall_;
+  StallState video_stall_;
+  int64_t subscribed_ns_ = 0;
+  int64_t start_ns_ = 0;  // first start() call
+  int64_t run_start_ns_ = 0;  // latest start() call
+  uint32_t resubscribes_ = 0;
+  /// end of the subscription set by reconfigure(), 0 if the duration given to the facade applies.
+  /// INT64_MAX if 'infinite'.
+  int64_t deadline_ns_ = 0;
+  at::Duration deadline_duration_{};  // given to reconfigure()
+  /// given to facade_: that of facade_config_, or the rest until the deadline once renewed
+  at::Duration facade_duration_{};
+  uv_timer_t* deadline_timer_ = nullptr;
+  /// counts start() and ForceClose() calls, so that a stop completing late does not touch a later run
+  uint32_t run_ = 0;
+  std::atomic<int64_t> stop_latency_ms_{-1};
+  /// completions of the core's stop callbacks, handed to JS thread
+  std::shared_ptr<JsQueue> js_queue_;
+  /// stops whose completion keeps the loop alive. reset by ForceClose(), which those issued before leave alone.
+  uint32_t pending_stops_ = 0;
+  uint32_t force_closes_ = 0;
+  SinkClass sink_class_ = kSinkClassNone;
+  Priority priority_ = kPriorityNormal;  // read by CapacityModel
+  /// shared with the plugin sinks in the slots, for stats
+  std::shared_ptr<PluginSinkInstance> plugin_;
+  /// shared with the stream sinks in the slots, for stats
+  std::shared_ptr<StreamWriter> audio_stream_;
+  std::shared_ptr<StreamWriter> video_stream_;
+  /// buffers of the frame copies made for capture, composite, playout and timeline fill
+  std::shared_ptr<FramePool> frame_pool_ = std::make_shared<FramePool>();
+  /// shared with the taps. null unless latencyMode() has a minDelay.
+  std::shared_ptr<PlayoutBuffer> playout_;
+  uint32_t memory_cap_mb_ = 0;
+  /// reported to V8 as external memory
+  int64_t memory_bytes_ = 0;
+  bool memory_cap_exceeded_ = false;
+  /// frame source replacing the facade, if replayFile() is given
+  std::unique_ptr<FrameReplayer> replayer_;
+  AudioSinkPtr replay_audio_sink_;
+  VideoSinkPtr replay_video_sink_;
+  /// segments handed to JS, with memorySegments()
+  std::shared_ptr<SegmentStore> segments_;
+  std::unique_ptr<SegmentWatcher> segment_watcher_;
+  v8::Persistent<v8::Context> segment_context_;  // of the listeners
+  std::vector<v8::Global<v8::Function>> segment_listeners_;
+  std::vector<v8::Global<v8::Function>> playlist_listeners_;
+  /// shared with the tracks, which move it on with frames
+  std::shared_ptr<Lifecycle> lifecycle_;
+  uv_async_t* lifecycle_async_ = nullptr;  // woken by lifecycle_ on any thread
+  v8::Persistent<v8::Context> state_context_;  // of the listeners
+  std::vector<v8::Global<v8::Function>> state_listeners_;
+  /// threading of the FFmpeg encoder. released once the encoder is stopped.
+  std::shared_ptr<const EncoderLease> encoder_lease_;
+  /// video delivery counters as of the previous speed estimate
+  struct SpeedWindow {
+    int64_t at_ns = 0;
+    uint64_t frames = 0;
+    uint64_t calls = 0;
+    int64_t delivery_ns = 0;
+    double encode_fps = 0;
+    double source_fps = 0;
+  };
+  SpeedWindow speed_;
+  static constexpr int64_t kMinSpeedWindowNs = 500000000;
+  void UpdateSpeed();
+
   AT_ADDON_CLASS;
 };
 
@@ -0,0 +1,222 @@
+/// @copyright © 2017 Airtime Media.  All rights reserved.
+
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <limits>
+#include <utility>
+
+#include "steady_clock.h"
+#include "timeline.h"
+
+namespace ew {
+
+using namespace std;
+
+constexpr uint32_t Timeline::kMaxFillFps;
+constexpr int64_t Timeline::kMaxFillUs;
+constexpr int64_t TrackTimeline::kRebaseUs;
+constexpr int64_t TimelineAudioSink::kToleranceUs;
+constexpr int64_t TimelineAudioSink::kSilenceChunkUs;
+
+namespace {
+
+constexpr int64_t kOriginUnset = numeric_limits<int64_t>::min();
+
+}  // namespace
+
+bool Timeline::Parse(const string& name, Clock& clock) {
+  for (auto c : { kClockNone, kClockMonotonic, kClockNtp }) {
+    if (name == ClockString(c)) {
+      clock = c;
+      return true;
+    }
+  }
+  return false;
+}
+
+const char* Timeline::ClockString(Clock clock) {
+  switch (clock) {
+    case kClockMonotonic:
+      return "monotonic";
+    case kClockNtp:
+      return "ntp";
+    default:
+      return "none";
+  }
+}
+
+Timeline::Timeline(Clock clock)
+  : clock_(clock)
+  , offset_us_((kClockNtp == clock)
+               ? chrono::duration_cast<chrono::microseconds>(chrono::system_clock::now().time_since_epoch()).count()
+                 - SteadyNowNs() / 1000
+               : 0)
+  , origin_us_(kOriginUnset) {
+}
+
+int64_t Timeline::NowUs() const {
+  return SteadyNowNs() / 1000 + offset_us_;
+}
+
+int64_t Timeline::Origin(int64_t at_us) {
+  auto origin_us = kOriginUnset;
+  if (origin_us_.compare_exchange_strong(origin_us, at_us)) return at_us;
+  return origin_us;  // set by the other track
+}
+
+// --------------------------------------------
+
+TrackTimeline::TrackTimeline(shared_ptr<Timeline> timeline, FILE* sidecar)
+  : timeline_(move(timeline))
+  , sidecar_(sidecar) {
+}
+
+TrackTimeline::~TrackTimeline() {
+  if (sidecar_) fclose(sidecar_);
+}
+
+FILE* TrackTimeline::OpenSidecar(const string& filename, Timeline::Clock clock, string& err) {
+  auto path = filename + ".timeline";
+  auto sidecar = fopen(path.c_str(), "w");
+  if (!sidecar) {
+    err = "Cannot create " + path;
+    return nullptr;
+  }
+  fprintf(sidecar, "# timestamp format v2\n# clock %s\n", Timeline::ClockString(clock));
+  return sidecar;
+}
+
+int64_t TrackTimeline::Place(int64_t timestamp_us) {
+  auto now_us = timeline_->NowUs();
+  auto transit_us = now_us - timestamp_us;
+  if (!started_) {
+    started_ = true;
+    offset_us_ = transit_us;
+    origin_us_ = timeline_->Origin(now_us);
+    if (sidecar_) fprintf(sidecar_, "# origin %" PRId64 " us\n", origin_us_);
+  } else if (transit_us < offset_us_ || kRebaseUs < transit_us - offset_us_) {
+    // faster than any frame so far, or a jump of timestamps
+    offset_us_ = transit_us;
+  }
+  last_us_ = max(timestamp_us + offset_us_ - origin_us_, last_us_);
+  return last_us_;
+}
+
+void TrackTimeline::Stamp(int64_t at_us) {
+  if (sidecar_) fprintf(sidecar_, "%.3f\n", at_us / 1000.0);
+}
+
+// --------------------------------------------
+
+TimelineAudioSink::TimelineAudioSink(AudioSinkPtr sink, shared_ptr<Timeline> timeline, FILE* sidecar, bool fill)
+  : log_(at::log::keywords::channel = "addon.TimelineAudioSink")
+  , sink_(move(sink))
+  , track_(move(timeline), sidecar)
+  , fill_(fill) {
+}
+
+void TimelineAudioSink::OnAudioFrame(const at::AudioFrame& frame) {
+  auto meta = MetaOf(frame);
+  auto payload = PayloadOf(frame);
+  auto at_us = track_.Place(meta.timestamp_us);
+  if (!fill_ || 0 == meta.sample_rate || 0 == meta.channels) {
+    meta.timestamp_us = at_us;
+    track_.Stamp(at_us);
+    sink_->OnAudioFrame(MakeAudioFrame(meta, payload));
+    return;
+  }
+
+  if (meta.sample_rate != sample_rate_ || meta.channels != channels_) {
+    // samples count anew from here. the first layout counts from the origin.
+    base_us_ = (0 == sample_rate_) ? 0 : at_us;
+    written_ = 0;
+    sample_rate_ = meta.sample_rate;
+    channels_ = meta.channels;
+  }
+  const size_t sample_bytes = sizeof(int16_t) * channels_;
+  auto bytes = static_cast<size_t>(meta.size) - meta.size % sample_bytes;
+  auto gap = (at_us - base_us_) * sample_rate_ / 1000000 - written_;
+  auto tolerance = kToleranceUs * sample_rate_ / 1000000;
+  if (tolerance < gap) {
+    if (Timeline::kMaxFillUs * sample_rate_ / 1000000 < gap) {
+      AT_LOG_WARNING(log_, "Not filling a gap of " << gap * 1000 / sample_rate_ << "ms");
+      base_us_ = at_us;
+      written_ = 0;
+    } else {
+      FillSilence(meta, gap);
+    }
+  } else if (gap < -tolerance) {
+    auto trim = min(static_cast<size_t>(-gap) * sample_bytes, bytes);
+    payload += trim;
+    bytes -= trim;
+  }
+  if (0 < bytes) Deliver(meta, payload, bytes);
+}
+
+void TimelineAudioSink::Deliver(FrameMeta meta, const uint8_t* payload, size_t bytes) {
+  auto at_us = base_us_ + written_ * 1000000 / sample_rate_;
+  meta.timestamp_us = at_us;
+  meta.size = static_cast<uint32_t>(bytes);
+  track_.Stamp(at_us);
+  sink_->OnAudioFrame(MakeAudioFrame(meta, payload));
+  written_ += bytes / (sizeof(int16_t) * channels_);
+}
+
+void TimelineAudioSink::FillSilence(const FrameMeta& meta, int64_t samples) {
+  const size_t sample_bytes = sizeof(int16_t) * channels_;
+  auto chunk = max<int64_t>(1, kSilenceChunkUs * sample_rate_ / 1000000);
+  // zeros. grows once per layout.
+  if (silence_.size() < chunk * sample_bytes) silence_.resize(chunk * sample_bytes);
+  for (auto left = samples; 0 < left; left -= chunk) {
+    Deliver(meta, silence_.data(), min(left, chunk) * sample_bytes);
+  }
+}
+
+// --------------------------------------------
+
+TimelineVideoSink::TimelineVideoSink(VideoSinkPtr sink, shared_ptr<Timeline> timeline, FILE* sidecar,
+                                     uint32_t fill_fps, shared_ptr<FramePool> pool)
+  : log_(at::log::keywords::channel = "addon.TimelineVideoSink")
+  , sink_(move(sink))
+  , track_(move(timeline), sidecar)
+  , fill_fps_(fill_fps)
+  , pool_(move(pool)) {
+}
+
+void TimelineVideoSink::OnVideoFrame(const at::VideoFrame& frame) {
+  auto meta = MetaOf(frame);
+  auto payload = PayloadOf(frame);
+  auto at_us = track_.Place(meta.timestamp_us);
+  if (0 == fill_fps_) {
+    Deliver(meta, payload, at_us);
+    return;
+  }
+
+  // the nearest picture at the constant rate
+  auto index = (at_us * fill_fps_ + 500000) / 1000000;
+  if (index < next_) return;  // beyond the rate
+  if (Timeline::kMaxFillUs * fill_fps_ / 1000000 < index - next_) {
+    AT_LOG_WARNING(log_, "Not filling a gap of " << (index - next_) << " pictures");
+    next_ = index;
+  }
+  for (; next_ < index; ++next_) {
+    // a track starting after the origin has no previous picture. its first one fills the lead.
+    if (previous_) {
+      Deliver(previous_meta_, previous_.data(), TimeOf(next_));
+    } else {
+      Deliver(meta, payload, TimeOf(next_));
+    }
+  }
+  Deliver(meta, payload, TimeOf(next_++));
+  previous_ = pool_->Copy(payload, meta.size);
+  previous_meta_ = meta;
+}
+
+void TimelineVideoSink::Deliver(FrameMeta meta, const uint8_t* payload, int64_t at_us) {
+  meta.timestamp_us = at_us;
+  track_.Stamp(at_us);
+  sink_->OnVideoFrame(MakeVideoFrame(meta, payload));
+}
+
+}  // namespace ew
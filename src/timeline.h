@@ -0,0 +1,153 @@
+/// @copyright © 2017 Airtime Media.  All rights reserved.
+
+#ifndef TIMELINE_H_
+#define TIMELINE_H_
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "eastwood/sink/audio_sink.h"
+#include "eastwood/sink/video_sink.h"
+#include "mediacore/base/logging.h"
+
+#include "frame_pool.h"
+#include "media_frame.h"
+#include "sink_tap.h"
+
+
+namespace ew {
+
+/**
+ * Common timebase of the sinks created together for a subscriber, set by SubscriberConfig.timeline().
+ * Times are microseconds since the origin, the first frame of either track, so that raw outputs of both tracks
+ * start at the same instant. The origin itself is on the clock, for aligning outputs across subscribers or hosts.
+ */
+class Timeline {
+ public:
+  enum Clock : uint8_t {
+    kClockNone = 0,   // frames keep the media timestamps of the core
+    kClockMonotonic,  // steady clock of the host
+    kClockNtp,        // system clock as kept by NTP, since the Unix epoch. advances with the steady clock.
+  };
+
+  /// @return false if @a name is not a clock
+  static bool Parse(const std::string& name, Clock& clock);
+  static const char* ClockString(Clock clock);
+
+  explicit Timeline(Clock clock);
+
+  Clock clock() const { return clock_; }
+  /// @return now on the clock, in microseconds
+  int64_t NowUs() const;
+  /// @return the origin on the clock. the first call sets it to @a at_us.
+  int64_t Origin(int64_t at_us);
+
+  /// video frame rates fillFps may take
+  static constexpr uint32_t kMaxFillFps = 120;
+  /// longer gaps are not filled. the track restarts after them, as outputs would grow by minutes of nothing.
+  static constexpr int64_t kMaxFillUs = 60000000;
+
+ private:
+  const Clock clock_;
+  const int64_t offset_us_;  // of the clock from the steady clock, sampled once so that it never steps
+  std::atomic<int64_t> origin_us_;
+};
+
+/**
+ * Places the frames of one track on a Timeline, and writes them to a sidecar if given.
+ * Media timestamps are mapped by the fastest transit seen (arrival on the clock minus timestamp), which takes out
+ * network jitter, and rebased on a jump of over kRebaseUs, e.g. after resubscription.
+ * Called by one sink, under its slot lock.
+ */
+class TrackTimeline {
+ public:
+  /// @param sidecar: closed by this, i.e. when the sink is released from its slot (at stop or replacement).
+  ///                 null writes none.
+  TrackTimeline(std::shared_ptr<Timeline> timeline, FILE* sidecar);
+  ~TrackTimeline();
+
+  /// @return microseconds since the origin of a frame with @a timestamp_us arriving now. never before the previous.
+  int64_t Place(int64_t timestamp_us);
+  /// Writes a sidecar line for a frame written at @a at_us
+  void Stamp(int64_t at_us);
+
+  /**
+   * Opens the sidecar of a raw file, "<filename>.timeline", in the timestamp format v2 of mkvmerge
+   * (a line per frame in milliseconds since the origin), with the clock and origin in comments.
+   * @return null with @a err set if it cannot be created
+   */
+  static FILE* OpenSidecar(const std::string& filename, Timeline::Clock clock, std::string& err);
+
+  static constexpr int64_t kRebaseUs = 10000000;
+
+ private:
+  std::shared_ptr<Timeline> timeline_;
+  FILE* sidecar_;
+  bool started_ = false;
+  int64_t offset_us_ = 0;  // clock minus media timestamp
+  int64_t origin_us_ = 0;
+  int64_t last_us_ = 0;
+};
+
+/**
+ * Audio sink restamping frames onto a Timeline. With fill, the track is made continuous from the origin:
+ * gaps get silence and overlaps are trimmed, so that the sample count of the output is its time.
+ * Samples are taken as interleaved 16 bit PCM.
+ */
+class TimelineAudioSink : public at::eastwood::AudioSink {
+ public:
+  TimelineAudioSink(AudioSinkPtr sink, std::shared_ptr<Timeline> timeline, FILE* sidecar, bool fill);
+  void OnAudioFrame(const at::AudioFrame& frame) override;
+
+  /// drift tolerated before filling or trimming
+  static constexpr int64_t kToleranceUs = 20000;
+  static constexpr int64_t kSilenceChunkUs = 100000;
+
+ private:
+  void Deliver(FrameMeta meta, const uint8_t* payload, size_t bytes);
+  void FillSilence(const FrameMeta& meta, int64_t samples);
+
+  mutable at::Logger log_;
+  AudioSinkPtr sink_;
+  TrackTimeline track_;
+  const bool fill_;
+  uint32_t sample_rate_ = 0;
+  uint8_t channels_ = 0;
+  int64_t base_us_ = 0;  // time of the first sample written at the current layout
+  int64_t written_ = 0;  // samples since base_us_
+  std::vector<uint8_t> silence_;
+};
+
+/**
+ * Video counterpart of TimelineAudioSink. With fill, pictures are resampled to a constant rate from the origin:
+ * the previous picture is repeated over gaps, and pictures beyond the rate are dropped.
+ */
+class TimelineVideoSink : public at::eastwood::VideoSink {
+ public:
+  /// @param fill_fps: 0 does not fill
+  /// @param pool: keeps the previous picture
+  TimelineVideoSink(VideoSinkPtr sink, std::shared_ptr<Timeline> timeline, FILE* sidecar, uint32_t fill_fps,
+                    std::shared_ptr<FramePool> pool);
+  void OnVideoFrame(const at::VideoFrame& frame) override;
+
+ private:
+  void Deliver(FrameMeta meta, const uint8_t* payload, int64_t at_us);
+  int64_t TimeOf(int64_t index) const { return index * 1000000 / fill_fps_; }
+
+  mutable at::Logger log_;
+  VideoSinkPtr sink_;
+  TrackTimeline track_;
+  const uint32_t fill_fps_;
+  std::shared_ptr<FramePool> pool_;
+  int64_t next_ = 0;  // index of the next picture at fill_fps_
+  FrameMeta previous_meta_;
+  FrameBuffer previous_;
+};
+
+}  // namespace ew
+
+#endif  // TIMELINE_H_
@@ -0,0 +1,52 @@
+/// @copyright © 2017 Airtime Media.  All rights reserved.
+
+#ifndef UV_HANDLES_H_
+#define UV_HANDLES_H_
+
+#include <uv.h>
+
+
+namespace ew {
+
+/**
+ * Handles the addon keeps on the loop of the JS thread for its own bookkeeping: timers polling or ending
+ * subscriptions, asyncs waking the JS thread up for media threads, watchers of segment files.
+ * They are allocated unref'd, as none must keep the JS process alive by itself: whatever needs the process
+ * keeps it alive by its own means (e.g. a pending promise, or the subscription delivering frames).
+ * CloseHandle() deletes them once closed.
+ */
+inline uv_timer_t* NewBackgroundTimer(uv_loop_t* loop, void* data) {
+  auto timer = new uv_timer_t;
+  uv_timer_init(loop, timer);
+  timer->data = data;
+  uv_unref(reinterpret_cast<uv_handle_t*>(timer));
+  return timer;
+}
+
+inline uv_async_t* NewBackgroundAsync(uv_loop_t* loop, uv_async_cb callback, void* data) {
+  auto async = new uv_async_t;
+  uv_async_init(loop, async, callback);
+  async->data = data;
+  uv_unref(reinterpret_cast<uv_handle_t*>(async));
+  return async;
+}
+
+inline uv_fs_event_t* NewBackgroundFsEvent(uv_loop_t* loop, void* data) {
+  auto event = new uv_fs_event_t;
+  uv_fs_event_init(loop, event);
+  event->data = data;
+  uv_unref(reinterpret_cast<uv_handle_t*>(event));
+  return event;
+}
+
+/// Closes (i.e. stops) a handle made by one of the above, and deletes it once closed
+template <typename Handle>
+void CloseHandle(Handle* handle) {
+  uv_close(reinterpret_cast<uv_handle_t*>(handle), [](uv_handle_t* closed) {
+    delete reinterpret_cast<Handle*>(closed);
+  });
+}
+
+}  // namespace ew
+
+#endif  // UV_HANDLES_H_
@@ -0,0 +1,87 @@
+/// @copyright © 2017 Airtime Media.  All rights reserved.
+
+#include "v8_cache.h"
+
+namespace ew {
+
+using v8::Eternal;
+using v8::Isolate;
+using v8::NewStringType;
+using v8::ObjectTemplate;
+using v8::String;
+using v8::Undefined;
+
+V8Cache::V8Cache(Isolate* isolate)
+  : isolate_(isolate) {
+#define EW_INIT_KEY(name) \
+  keys.name.Set(isolate, String::NewFromUtf8(isolate, #name, NewStringType::kInternalized).ToLocalChecked());
+  EW_PROPERTY_KEYS(EW_INIT_KEY)
+#undef EW_INIT_KEY
+
+  auto& k = keys;
+  InitShape(kShapeConfigRegular, { &k.bixby, &k.allocator, &k.notifier, &k.duration_ms, &k.userId,
+                                   &k.streamURL, &k.cert, &k.secret, &k.frameInfo, &k.frameTrace,
+                                   &k.audio, &k.video, &k.retry, &k.stall, &k.memoryCap_mb,
+                                   &k.capture, &k.replay, &k.plugin, &k.composite, &k.memorySegments,
+                                   &k.latency, &k.timeline, &k.priority });
+  InitShape(kShapeConfigFFmpeg, { &k.bixby, &k.allocator, &k.notifier, &k.duration_ms, &k.userId,
+                                  &k.streamURL, &k.cert, &k.secret, &k.frameInfo, &k.frameTrace,
+                                  &k.ffmpeg, &k.retry, &k.stall, &k.memoryCap_mb,
+                                  &k.capture, &k.replay, &k.plugin, &k.composite, &k.memorySegments,
+                                  &k.latency, &k.timeline, &k.priority });
+  InitShape(kShapeEndpoint, { &k.host, &k.port });
+  InitShape(kShapeAllocator, { &k.host, &k.port, &k.loc });
+  InitShape(kShapeNotifier, { &k.host, &k.port, &k.tag, &k.tls, &k.cert });
+  InitShape(kShapeFFmpeg, { &k.output, &k.params });
+  InitShape(kShapeSink, { &k.sink, &k.filename, &k.bufferBytes });
+  InitShape(kShapeRetry, { &k.max, &k.initDelay_ms, &k.progression });
+  InitShape(kShapeStall, { &k.audio_ms, &k.video_ms });
+  InitShape(kShapeFrameTrace, { &k.every, &k.perSecond, &k.level, &k.audio });
+  InitShape(kShapeSubscriberStats, { &k.resubscribes, &k.stop_ms, &k.memory_bytes, &k.encoder, &k.plugin,
+                                     &k.segments, &k.pool, &k.audio, &k.video });
+  InitShape(kShapeTrackStats, { &k.frames, &k.stalls, &k.stalled, &k.stalledTotal_ms, &k.lastStall_ms,
+                                &k.firstFrame_ms, &k.allocations, &k.shed, &k.latency,
+                                &k.stream });
+  InitShape(kShapeStopTiming, { &k.userId, &k.stop_ms, &k.forced });
+  InitShape(kShapeStopAllResult, { &k.deadlineExceeded, &k.subscribers });
+  InitShape(kShapeFrameInfo, { &k.time_ms, &k.subscriber, &k.track, &k.seq, &k.timestamp_us,
+                               &k.size, &k.width, &k.height });
+  InitShape(kShapeLoopStats, { &k.pendingProbes, &k.threads, &k.slowest });
+  InitShape(kShapeLoopThread, { &k.thread, &k.tasks, &k.queueWait, &k.run, &k.lag, &k.allocations });
+  InitShape(kShapeHistogram, { &k.count, &k.p50_us, &k.p99_us, &k.max_us, &k.buckets });
+  InitShape(kShapeTaskSource, { &k.subscriber, &k.userId, &k.track, &k.sink, &k.calls, &k.total_ms, &k.max_ms });
+  InitShape(kShapeTraceResult, { &k.filename, &k.events, &k.dropped });
+  InitShape(kShapeMemoryUsage, { &k.rss_bytes, &k.estimated_bytes, &k.limit_bytes });
+  InitShape(kShapeCapacity, { &k.cpus, &k.cpuUsed, &k.subscribers, &k.cpuPerSubscriber_ms, &k.admissible,
+                              &k.loop, &k.memory, &k.admission, &k.shedding });
+  InitShape(kShapeSinkClasses, { &k.none, &k.file, &k.ffmpegRemux, &k.ffmpegTranscode, &k.plugin });
+  InitShape(kShapeCapacityLoop, { &k.queueWaitP99_ms, &k.pendingProbes });
+  InitShape(kShapeCapacityMemory, { &k.rss_bytes, &k.limit_bytes, &k.perSubscriber_bytes });
+  InitShape(kShapeAdmission, { &k.cpuHeadroom, &k.memoryHeadroom_mb, &k.maxQueueWait_ms });
+  InitShape(kShapeReplay, { &k.filename, &k.speed });
+  InitShape(kShapeEncoderStats, { &k.threads, &k.preset, &k.encodeFps, &k.sourceFps, &k.speed });
+  InitShape(kShapeEncoderBudget, { &k.threads, &k.adaptPreset, &k.encoders, &k.leasedThreads, &k.perEncoder });
+  InitShape(kShapePlugin, { &k.path, &k.params });
+  InitShape(kShapePluginStats, { &k.frames, &k.bytes, &k.errors });
+  InitShape(kShapeCompositeStats, { &k.inputs, &k.audioFrames, &k.videoFrames, &k.late, &k.dropped,
+                                    &k.compose_ms, &k.outputFailed });
+  InitShape(kShapeSegmentStats, { &k.delivered, &k.held, &k.held_bytes });
+  InitShape(kShapeStreamStats, { &k.frames, &k.bytes, &k.overflows, &k.overflowBytes, &k.buffered, &k.zeroCopy,
+                                 &k.failed });
+  InitShape(kShapePoolStats, { &k.hits, &k.misses, &k.pooledBytes, &k.outstanding });
+  InitShape(kShapeLatency, { &k.mode, &k.minDelay_ms, &k.maxDelay_ms });
+  InitShape(kShapeLatencyStats, { &k.transit_ms, &k.held_ms, &k.sink_ms, &k.total_ms, &k.late });
+  InitShape(kShapeTimeline, { &k.clock, &k.fillFps });
+  InitShape(kShapeLoadShedding, { &k.queueWait_ms, &k.cpuUsed, &k.level });
+  InitShape(kShapeSubscriberState, { &k.subscriber, &k.userId, &k.state, &k.since_ms });
+}
+
+void V8Cache::InitShape(Shape shape, std::initializer_list<const Eternal<String>*> properties) {
+  auto tmpl = ObjectTemplate::New(isolate_);
+  for (auto key : properties) {
+    tmpl->Set(key->Get(isolate_), Undefined(isolate_));
+  }
+  shapes_[shape].Set(isolate_, tmpl);
+}
+
+}  // namespace ew
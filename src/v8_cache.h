@@ -0,0 +1,121 @@
+/// @copyright © 2017 Airtime Media.  All rights reserved.
+
+#ifndef V8_CACHE_H_
+#define V8_CACHE_H_
+
+#include <node.h>
+
+#include <initializer_list>
+
+
+namespace ew {
+
+/// Property names of objects handed to JS. Add here before using a new one.
+#define EW_PROPERTY_KEYS(V) \
+  V(adaptPreset) V(admissible) V(admission) V(allocating) V(allocations) V(allocator) V(audio) \
+  V(audio_ms) V(audioFrames) V(bixby) V(buckets) V(bufferBytes) V(buffered) V(bytes) V(calls) \
+  V(capture) V(cert) V(channels) V(clock) V(compose_ms) V(composite) V(connecting) V(count) \
+  V(cpuHeadroom) V(cpuPerSubscriber_ms) V(cpus) V(cpuUsed) V(deadlineExceeded) V(deadlineMs) \
+  V(delivered) V(dropped) V(duration) V(duration_ms) V(encodeFps) V(encoder) V(encoders) \
+  V(errors) V(estimated_bytes) V(events) V(every) V(failed) V(ffmpeg) V(ffmpegRemux) \
+  V(ffmpegTranscode) V(file) V(filename) V(fillFps) V(firstFrame_ms) V(forced) V(fps) \
+  V(frameInfo) V(frames) V(frameTrace) V(height) V(held) V(held_bytes) V(held_ms) V(hits) V(host) \
+  V(idle) V(initDelay_ms) V(inputs) V(joinEventLoop) V(lag) V(lastStall_ms) V(late) V(latency) \
+  V(leasedThreads) V(level) V(limit_bytes) V(loc) V(loop) V(max) V(max_ms) V(max_us) \
+  V(maxDelay_ms) V(maxQueueWait_ms) V(memory) V(memory_bytes) V(memoryCap_mb) \
+  V(memoryHeadroom_mb) V(memorySegments) V(minDelay_ms) V(misses) V(mode) V(negotiating) V(none) \
+  V(notifier) V(output) V(outputFailed) V(outstanding) V(overflowBytes) V(overflows) V(p50_us) \
+  V(p99_us) V(params) V(path) V(pendingProbes) V(perEncoder) V(perSecond) V(perSubscriber_bytes) \
+  V(plugin) V(pool) V(pooledBytes) V(port) V(preset) V(priority) V(progression) V(queueWait) \
+  V(queueWait_ms) V(queueWaitP99_ms) V(replay) V(resubscribes) V(retry) V(retrying) V(rss_bytes) \
+  V(run) V(sampleRate) V(secret) V(segments) V(seq) V(shed) V(shedding) V(since_ms) V(sink) \
+  V(sink_ms) V(size) V(slowest) V(sourceFps) V(speed) V(stall) V(stalled) V(stalledTotal_ms) \
+  V(stalls) V(state) V(stop_ms) V(stopped) V(stopping) V(stream) V(streaming) V(streamURL) \
+  V(subscriber) V(subscribers) V(tag) V(tasks) V(thread) V(threads) V(time_ms) V(timeline) \
+  V(timestamp_us) V(tls) V(total_ms) V(track) V(transit_ms) V(userId) V(video) V(video_ms) \
+  V(videoFrames) V(width) V(zeroCopy)
+
+/**
+ * Per-isolate cache for building JS objects cheaply.
+ * Keys are internalized strings created once, and object templates pre-define the properties,
+ * so that every object of the same kind shares one hidden class from its creation.
+ */
+class V8Cache {
+ public:
+  struct Keys {
+#define EW_DECLARE_KEY(name) v8::Eternal<v8::String> name;
+    EW_PROPERTY_KEYS(EW_DECLARE_KEY)
+#undef EW_DECLARE_KEY
+  };
+
+  enum Shape {
+    kShapeConfigRegular = 0,  // SubscriberConfig.toObject() with sink()
+    kShapeConfigFFmpeg,       // SubscriberConfig.toObject() with ffmpegSink()
+    kShapeEndpoint,
+    kShapeAllocator,
+    kShapeNotifier,
+    kShapeFFmpeg,
+    kShapeSink,
+    kShapeRetry,
+    kShapeStall,
+    kShapeFrameTrace,
+    kShapeSubscriberStats,
+    kShapeTrackStats,
+    kShapeStopTiming,         // each entry of stopAll() result
+    kShapeStopAllResult,
+    kShapeFrameInfo,          // per-frame metadata
+    kShapeLoopStats,          // EastWood.getLoopStats()
+    kShapeLoopThread,
+    kShapeHistogram,
+    kShapeTaskSource,
+    kShapeTraceResult,        // EastWood.stopTrace()
+    kShapeMemoryUsage,        // EastWood.getMemoryUsage()
+    kShapeCapacity,           // EastWood.getCapacity()
+    kShapeSinkClasses,
+    kShapeCapacityLoop,
+    kShapeCapacityMemory,
+    kShapeAdmission,
+    kShapeLoadShedding,
+    kShapeReplay,
+    kShapeEncoderStats,
+    kShapeEncoderBudget,      // EastWood.getEncoderBudget()
+    kShapePlugin,
+    kShapePluginStats,
+    kShapeCompositeStats,     // Composite.stats()
+    kShapeSegmentStats,
+    kShapeStreamStats,
+    kShapePoolStats,
+    kShapeLatency,
+    kShapeLatencyStats,
+    kShapeTimeline,
+    kShapeSubscriberState,    // each entry of EastWood.listSubscribers()
+    kNumShapes
+  };
+
+  explicit V8Cache(v8::Isolate* isolate);
+
+  Keys keys;
+
+  v8::Local<v8::String> Key(const v8::Eternal<v8::String>& key) const { return key.Get(isolate_); }
+
+  /// @return new object whose properties of @a shape are pre-defined as undefined
+  v8::Local<v8::Object> NewObject(v8::Local<v8::Context> context, Shape shape) const {
+    return shapes_[shape].Get(isolate_)->NewInstance(context).ToLocalChecked();
+  }
+
+  /// Sets own data property. Skips setters and prototype chain lookup of generic Set().
+  void Put(v8::Local<v8::Context> context, v8::Local<v8::Object> obj,
+           const v8::Eternal<v8::String>& key, v8::Local<v8::Value> value) const {
+    obj->CreateDataProperty(context, key.Get(isolate_), value).FromJust();
+  }
+
+ private:
+  void InitShape(Shape shape, std::initializer_list<const v8::Eternal<v8::String>*> properties);
+
+  v8::Isolate* isolate_;
+  v8::Eternal<v8::ObjectTemplate> shapes_[kNumShapes];
+};
+
+}  // namespace ew
+
+#endif  // V8_CACHE_H_
@@ -107,6 +107,11 @@ describe('EastWood', function() {
     expect(EastWood.VideoSink_None).to.be.a('number');
     expect(EastWood.VideoSink_File).to.be.a('number');
     expect(EastWood.VideoSink_None).to.not.equal(EastWood.VideoSink_File);
+
+    expect(EastWood.AudioSink_Stream).to.be.a('number');
+    expect(EastWood.VideoSink_Stream).to.be.a('number');
+    expect(EastWood.AudioSink_Stream).to.not.equal(EastWood.AudioSink_File);
+    expect(EastWood.VideoSink_Stream).to.not.equal(EastWood.VideoSink_File);
   });
   describe('createSubscriber', function() {
     it('should create subscriber', function() {
@@ -116,6 +121,20 @@ describe('EastWood', function() {
       expect(s).to.be.an('object');
     });
     it('should throw if got extra arg', function() {
+      const ew = new EastWood(testLogLevel, true, false);
+      const t = ew.createConfigTemplate(ew.createSubscriber().configuration()
+        .bixby('host1', 10).streamUrl('surl2').duration('infinite')
+        .sink({ sink: EastWood.AudioSink_None }, { sink: EastWood.VideoSink_None }));
+      try {
+        ew.createSubscriber(t, {}, 123);
+        expect(false).to.be.ok;
+      } catch (e) {
+        expect(e.toString()).to.contain('EastWood');
+        expect(e.toString()).to.contain('createSubscriber');
+        expect(e.toString()).to.contain('Takes 2 args but given 3');
+      }
+    });
+    it('should throw if got incorrect arg', function() {
       const ew = new EastWood(testLogLevel, true, false);
       try {
         ew.createSubscriber(123);
@@ -123,12 +142,599 @@ describe('EastWood', function() {
       } catch (e) {
         expect(e.toString()).to.contain('EastWood');
         expect(e.toString()).to.contain('createSubscriber');
-        expect(e.toString()).to.contain('Takes 0 args but given 1');
+        expect(e.toString()).to.contain('Wrong argument at 0');
+      }
+      try {
+        ew.createSubscriber(ew.createSubscriber().configuration());
+        expect(false).to.be.ok;
+      } catch (e) {
+        expect(e.toString()).to.contain('createSubscriber');
+        expect(e.toString()).to.contain('Need config template made by createConfigTemplate()');
+      }
+    });
+  });
+
+  describe('createConfigTemplate', function() {
+    function baseConfig(ew) {
+      return ew.createSubscriber().configuration()
+        .bixby('host1', 10).streamNotifier('host2', 123, 'tag', true, true).duration('infinite')
+        .authSecret('sec').ffmpegSink('z.mp4', 'ffmpeg_output_format=mp4');
+    }
+    it('should throw if given incomplete config', function() {
+      const ew = new EastWood(testLogLevel, true, false);
+      try {
+        ew.createConfigTemplate(ew.createSubscriber().configuration().bixby('host1', 10));
+        expect(false).to.be.ok;
+      } catch (e) {
+        expect(e.toString()).to.contain('Need either Stream notifier endpoint or Stream URL');
+      }
+    });
+    it('should make frozen template', function() {
+      const ew = new EastWood(testLogLevel, true, false);
+      const t = ew.createConfigTemplate(baseConfig(ew));
+      expect(t.toObject().secret).to.equal('sec');
+      try {
+        t.userId('uuu');
+        expect(false).to.be.ok;
+      } catch (e) {
+        expect(e.toString()).to.contain('Config template cannot be modified');
+      }
+    });
+    it('should create subscriber with overrides', function() {
+      const ew = new EastWood(testLogLevel, true, false);
+      const t = ew.createConfigTemplate(baseConfig(ew));
+      const c = ew.createSubscriber(t, { userId: 'u1', tag: 't1', output: 'u1.mp4' }).configuration();
+      c.verify();
+      const o = c.toObject();
+      expect(o.userId).to.equal('u1');
+      expect(o.notifier.tag).to.equal('t1');
+      expect(o.ffmpeg.output).to.equal('u1.mp4');
+      expect(o.ffmpeg.params).to.equal('ffmpeg_output_format=mp4');
+      expect(o.secret).to.equal('sec');
+      // template itself is untouched
+      expect(t.toObject().userId).to.equal('');
+    });
+    it('should keep template and other subscribers untouched by setters', function() {
+      const ew = new EastWood(testLogLevel, true, false);
+      const t = ew.createConfigTemplate(baseConfig(ew).duration('00:10:00'));
+      const c1 = ew.createSubscriber(t, { userId: 'u1' }).configuration();
+      const c2 = ew.createSubscriber(t, { userId: 'u2' }).configuration();
+      c1.duration('00:00:10').authSecret('other');
+      expect(c1.toObject().duration_ms).to.equal(10000);
+      expect(c1.toObject().secret).to.equal('other');
+      expect(c2.toObject().duration_ms).to.equal(600000);
+      expect(c2.toObject().secret).to.equal('sec');
+      expect(c2.toObject().userId).to.equal('u2');
+      expect(t.toObject().duration_ms).to.equal(600000);
+    });
+    it('should throw if given incorrect overrides', function() {
+      const ew = new EastWood(testLogLevel, true, false);
+      const t = ew.createConfigTemplate(baseConfig(ew));
+      try {
+        ew.createSubscriber(t, { userId: 123 });
+        expect(false).to.be.ok;
+      } catch (e) {
+        expect(e.toString()).to.contain('Override userId must be non-empty string');
+      }
+      try {
+        ew.createSubscriber(t, { streamURL: 'url' });
+        expect(false).to.be.ok;
+      } catch (e) {
+        expect(e.toString()).to.contain('Override streamURL needs stream URL in template');
+      }
+    });
+  });
+
+  it('should be usable from worker_threads', function(done) {
+    var worker_threads;
+    try {
+      worker_threads = require('worker_threads');
+    } catch (e) {
+      this.skip();  // node without worker_threads
+    }
+    const worker = new worker_threads.Worker(
+      "const EastWood = require(" + JSON.stringify(require.resolve('../libs/index')) + ").EastWood;" +
+      "const ew = new EastWood(EastWood.LogLevel_Fatal, true, false);" +
+      "const c = ew.createSubscriber().configuration().userId('workerUser').toObject();" +
+      "require('worker_threads').parentPort.postMessage(c.userId);",
+      { eval: true });
+    worker.on('message', function(uid) {
+      expect(uid).to.equal('workerUser');
+    });
+    worker.on('error', done);
+    worker.on('exit', function(code) {
+      expect(code).to.equal(0);
+      done();
+    });
+  });
+
+  it('should let a worker with running subscribers exit', function(done) {
+    var worker_threads;
+    try {
+      worker_threads = require('worker_threads');
+    } catch (e) {
+      this.skip();  // node without worker_threads
+    }
+    // the subscriber is still connecting when the worker exits. its uv handles must be gone by then.
+    const worker = new worker_threads.Worker(
+      "const EastWood = require(" + JSON.stringify(require.resolve('../libs/index')) + ").EastWood;" +
+      "const ew = new EastWood(EastWood.LogLevel_Fatal, true, false);" +
+      "const s = ew.createSubscriber();" +
+      "s.configuration().bixbyAllocator('127.0.0.1', 1, 'local').streamNotifier('127.0.0.1', 1, 'tag', false, false)" +
+      "  .userId('workerUser').duration('00:01:00').stallTimeout(1000, 1000)" +
+      "  .sink({ sink: EastWood.AudioSink_None }, { sink: EastWood.VideoSink_None });" +
+      "s.start().catch(function() {});" +
+      "require('worker_threads').parentPort.postMessage(s.state());",
+      { eval: true });
+    worker.on('error', done);
+    worker.on('exit', function(code) {
+      expect(code).to.equal(0);
+      done();
+    });
+  });
+
+  describe('stopAll', function() {
+    it('should throw if given incorrect args', function() {
+      try {
+        EastWood.stopAll(123);
+        expect(false).to.be.ok;
+      } catch (e) {
+        expect(e.toString()).to.contain('EastWood');
+        expect(e.toString()).to.contain('stopAll');
+        expect(e.toString()).to.contain('Wrong argument at 0');
+      }
+    });
+    it('should stop subscribers and report each', function() {
+      const ew = new EastWood(testLogLevel, true, false);
+      ew.createSubscriber().configuration().userId('stopAllUser');
+      return EastWood.stopAll({ deadlineMs: 1000, joinEventLoop: false }).then(function(result) {
+        expect(result.deadlineExceeded).to.equal(false);
+        expect(result.subscribers).to.be.an('array');
+        result.subscribers.forEach(function(s) {
+          expect(s.forced).to.equal(false);
+          expect(s.stop_ms).to.be.at.least(0);
+        });
+      });
+    });
+  });
+
+  describe('dumpFrameTrace', function() {
+    it('should throw if given incorrect args', function() {
+      try {
+        EastWood.dumpFrameTrace('aaa');
+        expect(false).to.be.ok;
+      } catch (e) {
+        expect(e.toString()).to.contain('EastWood');
+        expect(e.toString()).to.contain('dumpFrameTrace');
+        expect(e.toString()).to.contain('Wrong argument at 0');
+      }
+    });
+    it('should return array of records', function() {
+      const records = EastWood.dumpFrameTrace(1);
+      expect(records).to.be.an('array');
+      records.forEach(function(r) {
+        expect(r.track).to.be.oneOf(['audio', 'video']);
+        expect(r.seq).to.be.at.least(1);
+      });
+    });
+  });
+
+  describe('getLoopStats', function() {
+    it('should throw if given incorrect args', function() {
+      try {
+        EastWood.getLoopStats('aaa');
+        expect(false).to.be.ok;
+      } catch (e) {
+        expect(e.toString()).to.contain('EastWood');
+        expect(e.toString()).to.contain('getLoopStats');
+        expect(e.toString()).to.contain('Wrong argument at 0');
+      }
+    });
+    it('should report threads and task sources', function() {
+      const ew = new EastWood(testLogLevel, true, false);
+      const stats = EastWood.getLoopStats(3);
+      expect(stats.pendingProbes).to.be.at.least(0);
+      expect(stats.threads).to.be.an('array');
+      stats.threads.forEach(function(t) {
+        expect(t.queueWait.buckets).to.have.lengthOf(24);
+        expect(t.run.p99_us).to.be.at.most(t.run.max_us);
+        expect(t.lag.count).to.be.at.least(0);
+      });
+      expect(stats.slowest).to.be.an('array');
+      expect(stats.slowest.length).to.be.at.most(3);
+    });
+  });
+
+  describe('startTrace / stopTrace', function() {
+    it('should throw if given incorrect args', function() {
+      try {
+        EastWood.stopTrace(123);
+        expect(false).to.be.ok;
+      } catch (e) {
+        expect(e.toString()).to.contain('EastWood');
+        expect(e.toString()).to.contain('stopTrace');
+        expect(e.toString()).to.contain('Wrong argument at 0');
+      }
+    });
+    it('should throw if not started', function() {
+      try {
+        EastWood.stopTrace('/tmp/eastwood-trace.json');
+        expect(false).to.be.ok;
+      } catch (e) {
+        expect(e.toString()).to.contain('Tracing is not started');
+      }
+    });
+    it('should write chrome trace', function() {
+      const fs = require('fs');
+      const filename = '/tmp/eastwood-trace-' + process.pid + '.json';
+      expect(EastWood.startTrace()).to.equal(true);
+      expect(EastWood.startTrace()).to.equal(false);
+      return EastWood.stopTrace(filename).then(function(result) {
+        expect(result.filename).to.equal(filename);
+        expect(result.dropped).to.equal(0);
+        const trace = JSON.parse(fs.readFileSync(filename));
+        expect(trace.traceEvents).to.be.an('array');
+        fs.unlinkSync(filename);
+      });
+    });
+  });
+
+  describe('setMemoryLimit / getMemoryUsage', function() {
+    it('should throw if given incorrect args', function() {
+      try {
+        EastWood.setMemoryLimit(-1);
+        expect(false).to.be.ok;
+      } catch (e) {
+        expect(e.toString()).to.contain('EastWood');
+        expect(e.toString()).to.contain('setMemoryLimit');
+        expect(e.toString()).to.contain('Wrong argument at 0');
+      }
+    });
+    it('should report limit and usage', function() {
+      const ew = new EastWood(testLogLevel, true, false);
+      ew.createSubscriber();
+      EastWood.setMemoryLimit(4096);
+      let usage = EastWood.getMemoryUsage();
+      expect(usage.limit_bytes).to.equal(4096 * 1024 * 1024);
+      expect(usage.rss_bytes).to.be.at.least(0);
+      expect(usage.estimated_bytes).to.equal(0);  // not started
+      EastWood.setMemoryLimit(0);
+      usage = EastWood.getMemoryUsage();
+      expect(usage.limit_bytes).to.equal(0);
+    });
+  });
+
+  describe('setAdmission / getCapacity', function() {
+    it('should throw if given incorrect args', function() {
+      try {
+        EastWood.setAdmission({ cpuHeadroom: 2 });
+        expect(false).to.be.ok;
+      } catch (e) {
+        expect(e.toString()).to.contain('EastWood');
+        expect(e.toString()).to.contain('setAdmission');
+        expect(e.toString()).to.contain('Wrong argument at 0');
+        expect(e.toString()).to.contain('cpuHeadroom must be between 0 and 1');
+      }
+    });
+    it('should report capacity model and policy', function() {
+      const ew = new EastWood(testLogLevel, true, false);
+      EastWood.setAdmission({ cpuHeadroom: 0.25, maxQueueWait_ms: 50 });
+      const capacity = EastWood.getCapacity();
+      expect(capacity.cpus).to.be.at.least(1);
+      expect(capacity.subscribers).to.have.all.keys('none', 'file', 'ffmpegRemux', 'ffmpegTranscode', 'plugin');
+      expect(capacity.cpuPerSubscriber_ms.none).to.be.at.least(0);
+      expect(capacity.loop.queueWaitP99_ms).to.be.at.least(0);
+      expect(capacity.admission.cpuHeadroom).to.equal(0.25);
+      expect(capacity.admission.memoryHeadroom_mb).to.equal(0);
+      expect(capacity.admission.maxQueueWait_ms).to.equal(50);
+      EastWood.setAdmission({});
+    });
+  });
+
+  describe('setLoadShedding', function() {
+    it('should throw if given incorrect args', function() {
+      try {
+        EastWood.setLoadShedding({ cpuUsed: 1.5 });
+        expect(false).to.be.ok;
+      } catch (e) {
+        expect(e.toString()).to.contain('EastWood');
+        expect(e.toString()).to.contain('setLoadShedding');
+        expect(e.toString()).to.contain('Wrong argument at 0');
+        expect(e.toString()).to.contain('cpuUsed must be between 0 and 1');
+      }
+      try {
+        EastWood.setLoadShedding({ queueWait_ms: -1 });
+        expect(false).to.be.ok;
+      } catch (e) {
+        expect(e.toString()).to.contain('queueWait_ms must be zero or positive integer');
+      }
+    });
+    it('should report policy and level in capacity', function() {
+      const ew = new EastWood(testLogLevel, true, false);
+      EastWood.setLoadShedding({ queueWait_ms: 40, cpuUsed: 0.9 });
+      const shedding = EastWood.getCapacity().shedding;
+      expect(shedding.queueWait_ms).to.equal(40);
+      expect(shedding.cpuUsed).to.equal(0.9);
+      expect(shedding.level).to.equal(0);
+      EastWood.setLoadShedding({});
+    });
+  });
+
+  describe('setEncoderBudget / getEncoderBudget', function() {
+    it('should throw if given incorrect args', function() {
+      try {
+        EastWood.setEncoderBudget({ threads: 'aaa' });
+        expect(false).to.be.ok;
+      } catch (e) {
+        expect(e.toString()).to.contain('EastWood');
+        expect(e.toString()).to.contain('setEncoderBudget');
+        expect(e.toString()).to.contain('threads must be zero or positive integer');
+      }
+    });
+    it('should set if given correct args', function() {
+      EastWood.setEncoderBudget({ threads: 12, adaptPreset: true });
+      let budget = EastWood.getEncoderBudget();
+      expect(budget.threads).to.equal(12);
+      expect(budget.adaptPreset).to.equal(true);
+      expect(budget.encoders).to.equal(0);
+      expect(budget.leasedThreads).to.equal(0);
+      expect(budget.perEncoder).to.equal(12);
+      EastWood.setEncoderBudget({});
+      budget = EastWood.getEncoderBudget();
+      expect(budget.threads).to.be.at.least(1);
+      expect(budget.adaptPreset).to.equal(false);
+    });
+  });
+
+  describe('listSubscribers', function() {
+    it('should throw if given incorrect args', function() {
+      try {
+        EastWood.listSubscribers(123);
+        expect(false).to.be.ok;
+      } catch (e) {
+        expect(e.toString()).to.contain('EastWood');
+        expect(e.toString()).to.contain('listSubscribers');
+      }
+    });
+    it('should list subscribers with their state', function() {
+      const ew = new EastWood(testLogLevel, true, false);
+      const s = ew.createSubscriber();
+      s.configuration().userId('listUser');
+      const entry = EastWood.listSubscribers().find(function(e) { return 'listUser' === e.userId; });
+      expect(entry).to.be.ok;
+      expect(entry.subscriber).to.be.a('number');
+      expect(entry.state).to.equal('idle');
+      expect(entry.since_ms).to.be.at.most(Date.now());
+    });
+  });
+
+  describe('createComposite', function() {
+    it('should throw if given insufficient args', function() {
+      const ew = new EastWood(testLogLevel, true, false);
+      try {
+        ew.createComposite({}, 'out.mp4');
+        expect(false).to.be.ok;
+      } catch (e) {
+        expect(e.toString()).to.contain('EastWood');
+        expect(e.toString()).to.contain('createComposite');
+        expect(e.toString()).to.contain('Needs 3');
+        expect(e.toString()).to.contain('given 2');
+      }
+    });
+    it('should throw if given incorrect args', function() {
+      const ew = new EastWood(testLogLevel, true, false);
+      try {
+        ew.createComposite({ width: 641 }, 'out.mp4', '');
+        expect(false).to.be.ok;
+      } catch (e) {
+        expect(e.toString()).to.contain('createComposite');
+        expect(e.toString()).to.contain('width and height must be even');
+      }
+      try {
+        ew.createComposite({ channels: 6 }, 'out.mp4', '');
+        expect(false).to.be.ok;
+      } catch (e) {
+        expect(e.toString()).to.contain('createComposite');
+        expect(e.toString()).to.contain('channels must be positive integer up to 2');
+      }
+      try {
+        ew.createComposite({}, '', '');
+        expect(false).to.be.ok;
+      } catch (e) {
+        expect(e.toString()).to.contain('createComposite');
+        expect(e.toString()).to.contain('output cannot be empty');
       }
     });
+    it('should create if given correct args', function() {
+      const ew = new EastWood(testLogLevel, true, false);
+      const composite = ew.createComposite({ width: 640, height: 360, fps: 25 }, 'out.mp4', '-vcodec=libx264');
+      const stats = composite.stats();
+      expect(stats.inputs).to.equal(0);
+      expect(stats.videoFrames).to.equal(0);
+      expect(stats.outputFailed).to.equal(false);
+      return composite.stop().then(function(stopped) {
+        expect(stopped).to.equal(false);
+      });
+    });
   });
 
   describe('Subscriber', function() {
+    describe('stats', function() {
+      it('should report encoder speed', function() {
+        const ew = new EastWood(testLogLevel, true, false);
+        const stats = ew.createSubscriber().stats();
+        expect(stats.encoder.threads).to.equal(0);  // not a transcode
+        expect(stats.encoder.speed).to.equal(0);
+      });
+
+      it('should report no first frame before start', function() {
+        const ew = new EastWood(testLogLevel, true, false);
+        const stats = ew.createSubscriber().stats();
+        expect(stats.audio.firstFrame_ms).to.equal(-1);
+        expect(stats.video.firstFrame_ms).to.equal(-1);
+      });
+
+      it('should report no stream without stream sinks', function() {
+        const ew = new EastWood(testLogLevel, true, false);
+        const stats = ew.createSubscriber().stats();
+        expect(stats.audio.stream.bytes).to.equal(0);
+        expect(stats.video.stream.overflows).to.equal(0);
+        expect(stats.video.stream.failed).to.equal(false);
+      });
+
+      it('should report an unused frame pool before start', function() {
+        const ew = new EastWood(testLogLevel, true, false);
+        const stats = ew.createSubscriber().stats();
+        expect(stats.pool.hits).to.equal(0);
+        expect(stats.pool.misses).to.equal(0);
+        expect(stats.pool.outstanding).to.equal(0);
+        expect(stats.audio.allocations).to.be.a('number');
+        expect(stats.video.allocations).to.be.at.most(0);  // -1 unless allocations are counted
+      });
+
+      it('should report no latency before start', function() {
+        const ew = new EastWood(testLogLevel, true, false);
+        const stats = ew.createSubscriber().stats();
+        expect(stats.audio.latency.total_ms).to.equal(0);
+        expect(stats.video.latency.held_ms).to.equal(0);
+        expect(stats.video.latency.late).to.equal(0);
+      });
+
+      it('should report no shed frames before start', function() {
+        const ew = new EastWood(testLogLevel, true, false);
+        const stats = ew.createSubscriber().stats();
+        expect(stats.audio.shed).to.equal(0);
+        expect(stats.video.shed).to.equal(0);
+      });
+    });
+
+    describe('stop', function() {
+      it('should return promise if callback is not given', function() {
+        const ew = new EastWood(testLogLevel, true, false);
+        return ew.createSubscriber().stop().then(function(result) {
+          expect(result).to.equal(true);
+        });
+      });
+      it('should settle each of overlapping stops', function() {
+        const ew = new EastWood(testLogLevel, true, false);
+        const s = ew.createSubscriber();
+        const byCallback = new Promise(function(resolve) { s.stop(resolve); });
+        return Promise.all([s.stop(), byCallback, s.stop()]).then(function(results) {
+          expect(results).to.deep.equal([true, true, true]);
+        });
+      });
+    });
+
+    describe('start', function() {
+      it('should throw if already started', function() {
+        const ew = new EastWood(testLogLevel, true, false);
+        const s = ew.createSubscriber();
+        s.configuration().bixbyAllocator('127.0.0.1', 1, 'local').streamNotifier('127.0.0.1', 1, 'tag', false, false)
+          .userId('startTwiceUser').duration('00:01:00')
+          .sink({ sink: EastWood.AudioSink_None }, { sink: EastWood.VideoSink_None });
+        return s.start().then(function() {
+          try {
+            s.start();
+            expect(false).to.be.ok;
+          } catch (e) {
+            expect(e.toString()).to.contain('Subscription is already running');
+          }
+          return s.stop();
+        });
+      });
+    });
+
+    describe('state', function() {
+      it('should throw if given incorrect args', function() {
+        const ew = new EastWood(testLogLevel, true, false);
+        try {
+          ew.createSubscriber().state(123);
+          expect(false).to.be.ok;
+        } catch (e) {
+          expect(e.toString()).to.contain('Subscriber');
+          expect(e.toString()).to.contain('state');
+        }
+      });
+      it('should be idle until started and stopped once stopped', function() {
+        const ew = new EastWood(testLogLevel, true, false);
+        const s = ew.createSubscriber();
+        s.on('state', function(state, timeMS) {});
+        expect(s.state()).to.equal('idle');
+        return s.stop().then(function() {
+          expect(s.state()).to.equal('stopped');
+        });
+      });
+    });
+
+    describe('reconfigure', function() {
+      it('should throw if given insufficient args', function() {
+        const ew = new EastWood(testLogLevel, true, false);
+        try {
+          ew.createSubscriber().reconfigure();
+          expect(false).to.be.ok;
+        } catch (e) {
+          expect(e.toString()).to.contain('reconfigure');
+          expect(e.toString()).to.contain('Needs 1');
+          expect(e.toString()).to.contain('given 0');
+        }
+      });
+      it('should throw if given incorrect args', function() {
+        const ew = new EastWood(testLogLevel, true, false);
+        const s = ew.createSubscriber();
+        try {
+          s.reconfigure({});
+          expect(false).to.be.ok;
+        } catch (e) {
+          expect(e.toString()).to.contain('reconfigure');
+          expect(e.toString()).to.contain('Need duration, audio, video or ffmpeg');
+        }
+        try {
+          s.reconfigure({ duration: 'never' });
+          expect(false).to.be.ok;
+        } catch (e) {
+          expect(e.toString()).to.contain('Incorrect duration');
+        }
+        try {
+          s.reconfigure({ audio: { sink: 123 } });
+          expect(false).to.be.ok;
+        } catch (e) {
+          expect(e.toString()).to.contain('Incorrect audio sink type 123');
+        }
+        try {
+          s.reconfigure({ ffmpeg: { output: 'rtmp://host/app' } });
+          expect(false).to.be.ok;
+        } catch (e) {
+          expect(e.toString()).to.contain('Changing ffmpeg needs FFMpeg sink');
+        }
+      });
+      it('should throw if changing sinks of another kind', function() {
+        const ew = new EastWood(testLogLevel, true, false);
+        const s = ew.createSubscriber();
+        s.configuration().ffmpegSink('out.flv', '-c:v libx264');
+        try {
+          s.reconfigure({ video: { sink: EastWood.VideoSink_File, filename: 'v.raw' } });
+          expect(false).to.be.ok;
+        } catch (e) {
+          expect(e.toString()).to.contain('Changing video sink needs regular sinks');
+        }
+        try {
+          s.reconfigure({ ffmpeg: { output: '' } });
+          expect(false).to.be.ok;
+        } catch (e) {
+          expect(e.toString()).to.contain('needs non-empty output');
+        }
+      });
+      it('should throw if not started', function() {
+        const ew = new EastWood(testLogLevel, true, false);
+        try {
+          ew.createSubscriber().reconfigure({ duration: '00:00:10' });
+          expect(false).to.be.ok;
+        } catch (e) {
+          expect(e.toString()).to.contain('Subscription is not running');
+        }
+      });
+    });
+
     describe('Configuration', function() {
       describe('bixby', function() {
         it('should throw if given insufficient args', function() {
@@ -906,6 +1512,35 @@ describe('EastWood', function() {
             expect(e.toString()).to.contain('Wrong argument at 0');
             expect(e.toString()).to.contain('audio sink filename 123');
           }
+          try {
+            c.sink({ sink: EastWood.AudioSink_None }, { sink: EastWood.VideoSink_Stream });
+            expect(false).to.be.ok;
+          } catch (e) {
+            expect(e.toString()).to.contain('SubscriberConfig');
+            expect(e.toString()).to.contain('sink');
+            expect(e.toString()).to.contain('Wrong argument at 1');
+            expect(e.toString()).to.contain('video sink filename');
+          }
+          try {
+            c.sink({ sink: EastWood.AudioSink_Stream, filename: 'fd:3', bufferBytes: 100 },
+                   { sink: EastWood.VideoSink_None });
+            expect(false).to.be.ok;
+          } catch (e) {
+            expect(e.toString()).to.contain('SubscriberConfig');
+            expect(e.toString()).to.contain('sink');
+            expect(e.toString()).to.contain('Wrong argument at 0');
+            expect(e.toString()).to.contain('audio sink bufferBytes 100');
+          }
+          try {
+            c.sink({ sink: EastWood.AudioSink_None },
+                   { sink: EastWood.VideoSink_Stream, filename: 'unix:/tmp/video.sock', bufferBytes: 'big' });
+            expect(false).to.be.ok;
+          } catch (e) {
+            expect(e.toString()).to.contain('SubscriberConfig');
+            expect(e.toString()).to.contain('sink');
+            expect(e.toString()).to.contain('Wrong argument at 1');
+            expect(e.toString()).to.contain('video sink bufferBytes');
+          }
         });
         it('should set if given correct args', function() {
           const ew = new EastWood(testLogLevel, true, false);
@@ -923,6 +1558,18 @@ describe('EastWood', function() {
           expect(c.audio.filename).to.equal('file/name.a');
           expect(c.video.sink).to.equal('file');
           expect(c.video.filename).to.equal('file/name.b');
+
+          c = ew.createSubscriber().configuration()
+                        .sink({ sink: EastWood.AudioSink_Stream, filename: 'fd:3' },
+                              { sink: EastWood.VideoSink_Stream, filename: 'unix:/tmp/video.sock',
+                                bufferBytes: 4 << 20 })
+                        .toObject();
+          expect(c.audio.sink).to.equal('stream');
+          expect(c.audio.filename).to.equal('fd:3');
+          expect(c.audio.bufferBytes).to.equal(16 << 20);
+          expect(c.video.sink).to.equal('stream');
+          expect(c.video.filename).to.equal('unix:/tmp/video.sock');
+          expect(c.video.bufferBytes).to.equal(4 << 20);
         });
       });
 
@@ -994,21 +1641,136 @@ describe('EastWood', function() {
         });
       });
 
-      describe('subscriptionErrorRetry', function() {
+      describe('pluginSink', function() {
         it('should throw if given insufficient args', function() {
           const ew = new EastWood(testLogLevel, true, false);
           const c = ew.createSubscriber().configuration();
           try {
-            c.subscriptionErrorRetry();
+            c.pluginSink('/some/plugin.so');
             expect(false).to.be.ok;
           } catch (e) {
             expect(e.toString()).to.contain('SubscriberConfig');
-            expect(e.toString()).to.contain('subscriptionErrorRetry');
-            expect(e.toString()).to.contain('Needs 3');
-            expect(e.toString()).to.contain('given 0');
+            expect(e.toString()).to.contain('pluginSink');
+            expect(e.toString()).to.contain('Needs 2');
+            expect(e.toString()).to.contain('given 1');
           }
-          try {
-            c.subscriptionErrorRetry(1);
+        });
+        it('should throw if given incorrect args', function() {
+          const ew = new EastWood(testLogLevel, true, false);
+          const c = ew.createSubscriber().configuration();
+          try {
+            c.pluginSink(123, '');
+            expect(false).to.be.ok;
+          } catch (e) {
+            expect(e.toString()).to.contain('SubscriberConfig');
+            expect(e.toString()).to.contain('pluginSink');
+            expect(e.toString()).to.contain('Wrong argument at 0');
+            expect(e.toString()).to.contain('given 123');
+          }
+          try {
+            c.pluginSink('/some/plugin.so', {});
+            expect(false).to.be.ok;
+          } catch (e) {
+            expect(e.toString()).to.contain('SubscriberConfig');
+            expect(e.toString()).to.contain('pluginSink');
+            expect(e.toString()).to.contain('Wrong argument at 1');
+          }
+        });
+        it('should set if given correct args', function() {
+          const ew = new EastWood(testLogLevel, true, false);
+          const c = ew.createSubscriber().configuration()
+                        .pluginSink('/some/plugin.so', 'level=3')
+                        .toObject();
+          expect(c.plugin.path).to.equal('/some/plugin.so');
+          expect(c.plugin.params).to.equal('level=3');
+        });
+      });
+
+      describe('compositeSink', function() {
+        it('should throw if given insufficient args', function() {
+          const ew = new EastWood(testLogLevel, true, false);
+          const c = ew.createSubscriber().configuration();
+          try {
+            c.compositeSink();
+            expect(false).to.be.ok;
+          } catch (e) {
+            expect(e.toString()).to.contain('SubscriberConfig');
+            expect(e.toString()).to.contain('compositeSink');
+            expect(e.toString()).to.contain('Needs 1');
+            expect(e.toString()).to.contain('given 0');
+          }
+        });
+        it('should throw if given incorrect args', function() {
+          const ew = new EastWood(testLogLevel, true, false);
+          const c = ew.createSubscriber().configuration();
+          try {
+            c.compositeSink({});
+            expect(false).to.be.ok;
+          } catch (e) {
+            expect(e.toString()).to.contain('SubscriberConfig');
+            expect(e.toString()).to.contain('compositeSink');
+            expect(e.toString()).to.contain('Wrong argument at 0');
+          }
+        });
+        it('should set if given correct args', function() {
+          const ew = new EastWood(testLogLevel, true, false);
+          const composite = ew.createComposite({}, 'out.mp4', '');
+          const c = ew.createSubscriber().configuration();
+          expect(c.toObject().composite).to.equal(false);
+          expect(c.compositeSink(composite).toObject().composite).to.equal(true);
+          expect(c.compositeSink(null).toObject().composite).to.equal(false);
+        });
+      });
+
+      describe('memorySegments', function() {
+        it('should throw if given insufficient args', function() {
+          const ew = new EastWood(testLogLevel, true, false);
+          const c = ew.createSubscriber().configuration();
+          try {
+            c.memorySegments();
+            expect(false).to.be.ok;
+          } catch (e) {
+            expect(e.toString()).to.contain('SubscriberConfig');
+            expect(e.toString()).to.contain('memorySegments');
+            expect(e.toString()).to.contain('Needs 1');
+            expect(e.toString()).to.contain('given 0');
+          }
+        });
+        it('should throw if given incorrect args', function() {
+          const ew = new EastWood(testLogLevel, true, false);
+          const c = ew.createSubscriber().configuration();
+          try {
+            c.memorySegments('yes');
+            expect(false).to.be.ok;
+          } catch (e) {
+            expect(e.toString()).to.contain('SubscriberConfig');
+            expect(e.toString()).to.contain('memorySegments');
+            expect(e.toString()).to.contain('Wrong argument at 0');
+          }
+        });
+        it('should set if given correct args', function() {
+          const ew = new EastWood(testLogLevel, true, false);
+          const c = ew.createSubscriber().configuration();
+          expect(c.toObject().memorySegments).to.equal(false);
+          expect(c.memorySegments(true).toObject().memorySegments).to.equal(true);
+        });
+      });
+
+      describe('subscriptionErrorRetry', function() {
+        it('should throw if given insufficient args', function() {
+          const ew = new EastWood(testLogLevel, true, false);
+          const c = ew.createSubscriber().configuration();
+          try {
+            c.subscriptionErrorRetry();
+            expect(false).to.be.ok;
+          } catch (e) {
+            expect(e.toString()).to.contain('SubscriberConfig');
+            expect(e.toString()).to.contain('subscriptionErrorRetry');
+            expect(e.toString()).to.contain('Needs 3');
+            expect(e.toString()).to.contain('given 0');
+          }
+          try {
+            c.subscriptionErrorRetry(1);
             expect(false).to.be.ok;
           } catch (e) {
             expect(e.toString()).to.contain('SubscriberConfig');
@@ -1077,6 +1839,396 @@ describe('EastWood', function() {
         });
       });
 
+      describe('stallTimeout', function() {
+        it('should throw if given insufficient args', function() {
+          const ew = new EastWood(testLogLevel, true, false);
+          const c = ew.createSubscriber().configuration();
+          try {
+            c.stallTimeout(1000);
+            expect(false).to.be.ok;
+          } catch (e) {
+            expect(e.toString()).to.contain('SubscriberConfig');
+            expect(e.toString()).to.contain('stallTimeout');
+            expect(e.toString()).to.contain('Needs 2');
+            expect(e.toString()).to.contain('given 1');
+          }
+        });
+        it('should throw if given incorrect args', function() {
+          const ew = new EastWood(testLogLevel, true, false);
+          const c = ew.createSubscriber().configuration();
+          try {
+            c.stallTimeout('aaa', 2000);
+            expect(false).to.be.ok;
+          } catch (e) {
+            expect(e.toString()).to.contain('SubscriberConfig');
+            expect(e.toString()).to.contain('stallTimeout');
+            expect(e.toString()).to.contain('Wrong argument at 0');
+            expect(e.toString()).to.contain('given aaa');
+          }
+          try {
+            c.stallTimeout(1000, -1);
+            expect(false).to.be.ok;
+          } catch (e) {
+            expect(e.toString()).to.contain('SubscriberConfig');
+            expect(e.toString()).to.contain('stallTimeout');
+            expect(e.toString()).to.contain('Wrong argument at 1');
+            expect(e.toString()).to.contain('given -1');
+          }
+        });
+        it('should set if given correct args', function() {
+          const ew = new EastWood(testLogLevel, true, false);
+          c = ew.createSubscriber().configuration()
+                        .stallTimeout(1000, 2000)
+                        .toObject();
+          expect(c.stall.audio_ms).to.equal(1000);
+          expect(c.stall.video_ms).to.equal(2000);
+        });
+      });
+
+      describe('memoryCap', function() {
+        it('should throw if given insufficient args', function() {
+          const ew = new EastWood(testLogLevel, true, false);
+          const c = ew.createSubscriber().configuration();
+          try {
+            c.memoryCap();
+            expect(false).to.be.ok;
+          } catch (e) {
+            expect(e.toString()).to.contain('SubscriberConfig');
+            expect(e.toString()).to.contain('memoryCap');
+            expect(e.toString()).to.contain('Needs 1');
+            expect(e.toString()).to.contain('given 0');
+          }
+        });
+        it('should throw if given incorrect args', function() {
+          const ew = new EastWood(testLogLevel, true, false);
+          const c = ew.createSubscriber().configuration();
+          try {
+            c.memoryCap('aaa');
+            expect(false).to.be.ok;
+          } catch (e) {
+            expect(e.toString()).to.contain('SubscriberConfig');
+            expect(e.toString()).to.contain('memoryCap');
+            expect(e.toString()).to.contain('Wrong argument at 0');
+            expect(e.toString()).to.contain('given aaa');
+          }
+        });
+        it('should set if given correct args', function() {
+          const ew = new EastWood(testLogLevel, true, false);
+          c = ew.createSubscriber().configuration()
+                        .memoryCap(256)
+                        .toObject();
+          expect(c.memoryCap_mb).to.equal(256);
+        });
+      });
+
+      describe('captureFile', function() {
+        it('should throw if given incorrect args', function() {
+          const ew = new EastWood(testLogLevel, true, false);
+          const c = ew.createSubscriber().configuration();
+          try {
+            c.captureFile(123);
+            expect(false).to.be.ok;
+          } catch (e) {
+            expect(e.toString()).to.contain('SubscriberConfig');
+            expect(e.toString()).to.contain('captureFile');
+            expect(e.toString()).to.contain('Wrong argument at 0');
+            expect(e.toString()).to.contain('given 123');
+          }
+        });
+        it('should set if given correct args', function() {
+          const ew = new EastWood(testLogLevel, true, false);
+          c = ew.createSubscriber().configuration()
+                        .captureFile('/tmp/capture.ewcap')
+                        .toObject();
+          expect(c.capture).to.equal('/tmp/capture.ewcap');
+        });
+      });
+
+      describe('replayFile', function() {
+        it('should throw if given insufficient args', function() {
+          const ew = new EastWood(testLogLevel, true, false);
+          const c = ew.createSubscriber().configuration();
+          try {
+            c.replayFile('/tmp/capture.ewcap');
+            expect(false).to.be.ok;
+          } catch (e) {
+            expect(e.toString()).to.contain('SubscriberConfig');
+            expect(e.toString()).to.contain('replayFile');
+            expect(e.toString()).to.contain('Needs 2');
+            expect(e.toString()).to.contain('given 1');
+          }
+        });
+        it('should throw if given incorrect args', function() {
+          const ew = new EastWood(testLogLevel, true, false);
+          const c = ew.createSubscriber().configuration();
+          try {
+            c.replayFile('/tmp/capture.ewcap', -1);
+            expect(false).to.be.ok;
+          } catch (e) {
+            expect(e.toString()).to.contain('SubscriberConfig');
+            expect(e.toString()).to.contain('replayFile');
+            expect(e.toString()).to.contain('Wrong argument at 1');
+            expect(e.toString()).to.contain('given -1');
+          }
+        });
+        it('should set if given correct args', function() {
+          const ew = new EastWood(testLogLevel, true, false);
+          c = ew.createSubscriber().configuration()
+                        .replayFile('/tmp/capture.ewcap', 0)
+                        .toObject();
+          expect(c.replay.filename).to.equal('/tmp/capture.ewcap');
+          expect(c.replay.speed).to.equal(0);
+        });
+        it('should need only sink to verify', function() {
+          const ew = new EastWood(testLogLevel, true, false);
+          ew.createSubscriber().configuration()
+            .replayFile('/tmp/capture.ewcap', 1)
+            .sink({ sink: EastWood.AudioSink_None }, { sink: EastWood.VideoSink_None })
+            .verify();
+        });
+        it('should reject start if the file is not a capture', function() {
+          const ew = new EastWood(testLogLevel, true, false);
+          const s = ew.createSubscriber();
+          s.configuration()
+            .replayFile(__filename, 0)
+            .sink({ sink: EastWood.AudioSink_None }, { sink: EastWood.VideoSink_None });
+          return s.start().then(function() {
+            expect(false).to.be.ok;
+          }, function(e) {
+            expect(e.toString()).to.contain('is not a capture file');
+          });
+        });
+        it('should return the encoder threads of a rejected start', function() {
+          const ew = new EastWood(testLogLevel, true, false);
+          const s = ew.createSubscriber();
+          s.configuration()
+            .replayFile(__filename, 0)
+            .ffmpegSink('/tmp/eastwood-rejected-' + process.pid + '.mp4', 'ffmpeg_output_format=mp4');
+          return s.start().then(function() {
+            expect(false).to.be.ok;
+          }, function(e) {
+            expect(e.toString()).to.contain('is not a capture file');
+            expect(EastWood.getEncoderBudget().leasedThreads).to.equal(0);
+          });
+        });
+      });
+
+      describe('latencyMode', function() {
+        it('should throw if given insufficient args', function() {
+          const ew = new EastWood(testLogLevel, true, false);
+          const c = ew.createSubscriber().configuration();
+          try {
+            c.latencyMode();
+            expect(false).to.be.ok;
+          } catch (e) {
+            expect(e.toString()).to.contain('SubscriberConfig');
+            expect(e.toString()).to.contain('latencyMode');
+            expect(e.toString()).to.contain('Needs 1');
+            expect(e.toString()).to.contain('given 0');
+          }
+        });
+        it('should throw if given incorrect args', function() {
+          const ew = new EastWood(testLogLevel, true, false);
+          const c = ew.createSubscriber().configuration();
+          try {
+            c.latencyMode('fast');
+            expect(false).to.be.ok;
+          } catch (e) {
+            expect(e.toString()).to.contain('latencyMode');
+            expect(e.toString()).to.contain('Wrong argument at 0');
+            expect(e.toString()).to.contain("mode must be 'recording', 'live' or 'ultralow'");
+          }
+          try {
+            c.latencyMode('live', 20000);
+            expect(false).to.be.ok;
+          } catch (e) {
+            expect(e.toString()).to.contain('latencyMode');
+            expect(e.toString()).to.contain('Wrong argument at 1');
+            expect(e.toString()).to.contain('delay must be up to 10000ms');
+          }
+          try {
+            c.latencyMode('live', 500, 100);
+            expect(false).to.be.ok;
+          } catch (e) {
+            expect(e.toString()).to.contain('maxDelayMS must not be shorter than minDelayMS');
+          }
+        });
+        it('should set if given correct args', function() {
+          const ew = new EastWood(testLogLevel, true, false);
+          let c = ew.createSubscriber().configuration().toObject();
+          expect(c.latency.mode).to.equal('recording');
+          expect(c.latency.minDelay_ms).to.equal(0);
+          expect(c.latency.maxDelay_ms).to.equal(0);
+          c = ew.createSubscriber().configuration()
+                        .latencyMode('ultralow')
+                        .toObject();
+          expect(c.latency.mode).to.equal('ultralow');
+          expect(c.latency.maxDelay_ms).to.equal(200);
+          c = ew.createSubscriber().configuration()
+                        .latencyMode('recording', 300, 2000)
+                        .toObject();
+          expect(c.latency.mode).to.equal('recording');
+          expect(c.latency.minDelay_ms).to.equal(300);
+          expect(c.latency.maxDelay_ms).to.equal(2000);
+          // the default maxDelay of the mode gives way to a longer minDelay
+          c = ew.createSubscriber().configuration()
+                        .latencyMode('live', 1500)
+                        .toObject();
+          expect(c.latency.minDelay_ms).to.equal(1500);
+          expect(c.latency.maxDelay_ms).to.equal(1500);
+          c = ew.createSubscriber().configuration()
+                        .latencyMode('recording', 1500)
+                        .toObject();
+          expect(c.latency.maxDelay_ms).to.equal(0);
+        });
+      });
+
+      describe('timeline', function() {
+        it('should throw if given insufficient args', function() {
+          const ew = new EastWood(testLogLevel, true, false);
+          const c = ew.createSubscriber().configuration();
+          try {
+            c.timeline();
+            expect(false).to.be.ok;
+          } catch (e) {
+            expect(e.toString()).to.contain('SubscriberConfig');
+            expect(e.toString()).to.contain('timeline');
+            expect(e.toString()).to.contain('Needs 1');
+            expect(e.toString()).to.contain('given 0');
+          }
+        });
+        it('should throw if given incorrect args', function() {
+          const ew = new EastWood(testLogLevel, true, false);
+          const c = ew.createSubscriber().configuration();
+          try {
+            c.timeline('sundial');
+            expect(false).to.be.ok;
+          } catch (e) {
+            expect(e.toString()).to.contain('timeline');
+            expect(e.toString()).to.contain('Wrong argument at 0');
+            expect(e.toString()).to.contain("clock must be 'none', 'monotonic' or 'ntp'");
+          }
+          try {
+            c.timeline('ntp', 500);
+            expect(false).to.be.ok;
+          } catch (e) {
+            expect(e.toString()).to.contain('timeline');
+            expect(e.toString()).to.contain('Wrong argument at 1');
+            expect(e.toString()).to.contain('fillFps must be up to 120');
+          }
+          try {
+            c.timeline('ntp', -1);
+            expect(false).to.be.ok;
+          } catch (e) {
+            expect(e.toString()).to.contain('Wrong argument at 1');
+          }
+        });
+        it('should set if given correct args', function() {
+          const ew = new EastWood(testLogLevel, true, false);
+          let c = ew.createSubscriber().configuration().toObject();
+          expect(c.timeline.clock).to.equal('none');
+          expect(c.timeline.fillFps).to.equal(0);
+          c = ew.createSubscriber().configuration().timeline('monotonic').toObject();
+          expect(c.timeline.clock).to.equal('monotonic');
+          expect(c.timeline.fillFps).to.equal(0);
+          c = ew.createSubscriber().configuration().timeline('ntp', 30).toObject();
+          expect(c.timeline.clock).to.equal('ntp');
+          expect(c.timeline.fillFps).to.equal(30);
+        });
+      });
+
+      describe('priority', function() {
+        it('should throw if given insufficient args', function() {
+          const ew = new EastWood(testLogLevel, true, false);
+          const c = ew.createSubscriber().configuration();
+          try {
+            c.priority();
+            expect(false).to.be.ok;
+          } catch (e) {
+            expect(e.toString()).to.contain('SubscriberConfig');
+            expect(e.toString()).to.contain('priority');
+            expect(e.toString()).to.contain('Needs 1');
+            expect(e.toString()).to.contain('given 0');
+          }
+        });
+        it('should throw if given incorrect args', function() {
+          const ew = new EastWood(testLogLevel, true, false);
+          const c = ew.createSubscriber().configuration();
+          try {
+            c.priority('urgent');
+            expect(false).to.be.ok;
+          } catch (e) {
+            expect(e.toString()).to.contain('priority');
+            expect(e.toString()).to.contain('Wrong argument at 0');
+            expect(e.toString()).to.contain("priority must be 'low', 'normal' or 'high'");
+          }
+          try {
+            c.priority(1);
+            expect(false).to.be.ok;
+          } catch (e) {
+            expect(e.toString()).to.contain('Wrong argument at 0');
+          }
+        });
+        it('should set if given correct args', function() {
+          const ew = new EastWood(testLogLevel, true, false);
+          expect(ew.createSubscriber().configuration().toObject().priority).to.equal('normal');
+          expect(ew.createSubscriber().configuration().priority('low').toObject().priority).to.equal('low');
+          expect(ew.createSubscriber().configuration().priority('high').toObject().priority).to.equal('high');
+        });
+      });
+
+      describe('frameTrace', function() {
+        it('should throw if given insufficient args', function() {
+          const ew = new EastWood(testLogLevel, true, false);
+          const c = ew.createSubscriber().configuration();
+          try {
+            c.frameTrace();
+            expect(false).to.be.ok;
+          } catch (e) {
+            expect(e.toString()).to.contain('SubscriberConfig');
+            expect(e.toString()).to.contain('frameTrace');
+            expect(e.toString()).to.contain('Needs 1');
+            expect(e.toString()).to.contain('given 0');
+          }
+        });
+        it('should throw if given incorrect args', function() {
+          const ew = new EastWood(testLogLevel, true, false);
+          const c = ew.createSubscriber().configuration();
+          try {
+            c.frameTrace({ every: -1 });
+            expect(false).to.be.ok;
+          } catch (e) {
+            expect(e.toString()).to.contain('SubscriberConfig');
+            expect(e.toString()).to.contain('frameTrace');
+            expect(e.toString()).to.contain('Wrong argument at 0');
+            expect(e.toString()).to.contain('every must be zero or positive integer');
+          }
+          try {
+            c.frameTrace({ level: 99 });
+            expect(false).to.be.ok;
+          } catch (e) {
+            expect(e.toString()).to.contain('SubscriberConfig');
+            expect(e.toString()).to.contain('frameTrace');
+            expect(e.toString()).to.contain('Incorrect log level value 99');
+          }
+        });
+        it('should set if given correct args', function() {
+          const ew = new EastWood(testLogLevel, true, false);
+          c = ew.createSubscriber().configuration()
+                        .frameTrace({ every: 30, perSecond: 2, level: EastWood.LogLevel_Info, audio: true })
+                        .toObject();
+          expect(c.frameInfo).to.equal(true);
+          expect(c.frameTrace.every).to.equal(30);
+          expect(c.frameTrace.perSecond).to.equal(2);
+          expect(c.frameTrace.level).to.equal(EastWood.LogLevel_Info);
+          expect(c.frameTrace.audio).to.equal(true);
+          c = ew.createSubscriber().configuration()
+                        .frameTrace({ every: 0 })
+                        .toObject();
+          expect(c.frameInfo).to.equal(false);
+        });
+      });
+
       describe('Configuration integrity', function() {
         it('should throw if none of bixby and allocator were given', function() {
           const ew = new EastWood(testLogLevel, true, false);
@@ -1197,6 +2349,67 @@ describe('EastWood', function() {
             expect(e.toString()).to.contain('Regular sink and FFMpeg sink are mutually exclusive');
           }
         });
+        it('should throw if plugin sink and another sink were both given', function() {
+          const ew = new EastWood(testLogLevel, true, false);
+          const c = ew.createSubscriber().configuration()
+            // set other mandatory items
+            .bixby('host1', 10).streamUrl('surl2').duration('infinite').userId('aa')
+            // then conflicts
+            .ffmpegSink('z.mp4', '--some-param=123')
+            .pluginSink('/some/plugin.so', '');
+          try {
+            c.verify();
+            expect(false).to.be.ok;
+          } catch (e) {
+            expect(e.toString()).to.contain('SubscriberConfig');
+            expect(e.toString()).to.contain('Plugin sink is mutually exclusive with regular and FFMpeg sinks');
+          }
+        });
+        it('should throw if timeline is given with plugin sink', function() {
+          const ew = new EastWood(testLogLevel, true, false);
+          const c = ew.createSubscriber().configuration()
+            .bixby('host1', 10).streamUrl('surl2').duration('infinite').userId('aa')
+            .pluginSink('/some/plugin.so', '')
+            .timeline('monotonic');
+          try {
+            c.verify();
+            expect(false).to.be.ok;
+          } catch (e) {
+            expect(e.toString()).to.contain('Timeline needs regular or FFMpeg sinks');
+          }
+        });
+        it('should throw if memory segments are not given a playlist name as FFMpeg output', function() {
+          const ew = new EastWood(testLogLevel, true, false);
+          const c = ew.createSubscriber().configuration()
+            // set other mandatory items
+            .bixby('host1', 10).streamUrl('surl2').duration('infinite').userId('aa')
+            .memorySegments(true)
+            .ffmpegSink('some/where/live.m3u8', '-f=hls');
+          try {
+            c.verify();
+            expect(false).to.be.ok;
+          } catch (e) {
+            expect(e.toString()).to.contain('SubscriberConfig');
+            expect(e.toString()).to.contain('Memory segments need a playlist file name (.m3u8 or .mpd) as FFMpeg output');
+          }
+          c.ffmpegSink('live.m3u8', '-f=hls').verify();
+        });
+        it('should throw if composite sink and another sink were both given', function() {
+          const ew = new EastWood(testLogLevel, true, false);
+          const c = ew.createSubscriber().configuration()
+            // set other mandatory items
+            .bixby('host1', 10).streamUrl('surl2').duration('infinite').userId('aa')
+            // then conflicts
+            .sink({ sink: EastWood.AudioSink_None }, { sink: EastWood.VideoSink_None })
+            .compositeSink(ew.createComposite({}, 'out.mp4', ''));
+          try {
+            c.verify();
+            expect(false).to.be.ok;
+          } catch (e) {
+            expect(e.toString()).to.contain('SubscriberConfig');
+            expect(e.toString()).to.contain('Composite sink is mutually exclusive with other sinks');
+          }
+        });
       });
     });
 